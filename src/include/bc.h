@@ -0,0 +1,605 @@
+#ifndef BC_H
+#define BC_H
+
+#include "jobs.h"
+#include "texture.h"
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Block compression encoders for BC1, BC3, BC4, BC5 and BC7 (mode 6).
+// Blocks are handled as 16 texels in channel-major float form: block[channel][texel].
+
+typedef enum {
+    BC_QUALITY_FAST,   // bounding box endpoints
+    BC_QUALITY_NORMAL, // principal axis endpoints
+    BC_QUALITY_HIGH,   // principal axis plus least squares refinement and extra mode searches
+} BCQuality;
+
+typedef float BCBlock[4][16];
+
+// Squared error of every texel against its closest palette entry; returns the summed error of texels in mask.
+float BC_fit_indices(BCBlock block, float palette[][4], int palette_size, const float weights[4], unsigned int mask, unsigned char indices[16]) {
+    float errors[16];
+#if defined(__SSE2__)
+    __m128 wr = _mm_set1_ps(weights[0]);
+    __m128 wg = _mm_set1_ps(weights[1]);
+    __m128 wb = _mm_set1_ps(weights[2]);
+    __m128 wa = _mm_set1_ps(weights[3]);
+    for (int i = 0; i < 16; i += 4) {
+        __m128 r = _mm_loadu_ps(&block[0][i]);
+        __m128 g = _mm_loadu_ps(&block[1][i]);
+        __m128 b = _mm_loadu_ps(&block[2][i]);
+        __m128 a = _mm_loadu_ps(&block[3][i]);
+        __m128 best = _mm_set1_ps(FLT_MAX);
+        __m128i best_index = _mm_setzero_si128();
+        for (int k = 0; k < palette_size; k++) {
+            __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[k][0]));
+            __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[k][1]));
+            __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[k][2]));
+            __m128 da = _mm_sub_ps(a, _mm_set1_ps(palette[k][3]));
+            __m128 d = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_mul_ps(dr, dr), wr), _mm_mul_ps(_mm_mul_ps(dg, dg), wg)),
+                _mm_add_ps(_mm_mul_ps(_mm_mul_ps(db, db), wb), _mm_mul_ps(_mm_mul_ps(da, da), wa)));
+            __m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+            best = _mm_min_ps(d, best);
+            best_index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(k)), _mm_andnot_si128(closer, best_index));
+        }
+        _mm_storeu_ps(&errors[i], best);
+        int lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, best_index);
+        for (int j = 0; j < 4; j++) indices[i + j] = (unsigned char)lanes[j];
+    }
+#else
+    for (int i = 0; i < 16; i++) {
+        float best = FLT_MAX;
+        int best_index = 0;
+        for (int k = 0; k < palette_size; k++) {
+            float d = 0.0f;
+            for (int c = 0; c < 4; c++) {
+                float delta = block[c][i] - palette[k][c];
+                d += delta * delta * weights[c];
+            }
+            if (d < best) {
+                best = d;
+                best_index = k;
+            }
+        }
+        errors[i] = best;
+        indices[i] = (unsigned char)best_index;
+    }
+#endif
+    float total = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        if (mask & (1u << i)) total += errors[i];
+    }
+    return total;
+}
+
+// Endpoints a, b spanning the texels in mask, along the weighted principal axis or the bounding box diagonal.
+void BC_find_endpoints(BCBlock block, int channels, const float weights[4], unsigned int mask, BCQuality quality, float a[4], float b[4]) {
+    float mean[4] = { 0 }, lo[4], hi[4];
+    int count = 0;
+    for (int c = 0; c < 4; c++) {
+        lo[c] = FLT_MAX;
+        hi[c] = -FLT_MAX;
+    }
+    for (int i = 0; i < 16; i++) {
+        if (!(mask & (1u << i))) continue;
+        for (int c = 0; c < channels; c++) {
+            mean[c] += block[c][i];
+            if (block[c][i] < lo[c]) lo[c] = block[c][i];
+            if (block[c][i] > hi[c]) hi[c] = block[c][i];
+        }
+        count++;
+    }
+    for (int c = channels; c < 4; c++) {
+        a[c] = b[c] = lo[c] = hi[c] = mean[c] = 0.0f;
+    }
+    if (count == 0) {
+        for (int c = 0; c < channels; c++) a[c] = b[c] = 0.0f;
+        return;
+    }
+    for (int c = 0; c < channels; c++) mean[c] /= count;
+
+    float covariance[4][4] = { { 0 } };
+    for (int i = 0; i < 16; i++) {
+        if (!(mask & (1u << i))) continue;
+        for (int x = 0; x < channels; x++) {
+            for (int y = x; y < channels; y++) {
+                covariance[x][y] += (block[x][i] - mean[x]) * (block[y][i] - mean[y]) * weights[x] * weights[y];
+            }
+        }
+    }
+    for (int x = 0; x < channels; x++) {
+        for (int y = 0; y < x; y++) covariance[x][y] = covariance[y][x];
+    }
+
+    float axis[4] = { 0 };
+    if (quality == BC_QUALITY_FAST) {
+        // Flip channels that fall while the dominant channel rises.
+        int dominant = 0;
+        for (int c = 1; c < channels; c++) {
+            if (covariance[c][c] > covariance[dominant][dominant]) dominant = c;
+        }
+        for (int c = 0; c < channels; c++) {
+            a[c] = lo[c];
+            b[c] = hi[c];
+            if (covariance[dominant][c] < 0.0f) {
+                a[c] = hi[c];
+                b[c] = lo[c];
+            }
+        }
+        return;
+    }
+
+    for (int c = 0; c < channels; c++) axis[c] = hi[c] - lo[c];
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[4] = { 0 };
+        float length = 0.0f;
+        for (int x = 0; x < channels; x++) {
+            for (int y = 0; y < channels; y++) next[x] += covariance[x][y] * axis[y];
+            length = fmaxf(length, fabsf(next[x]));
+        }
+        if (length == 0.0f) break;
+        for (int c = 0; c < channels; c++) axis[c] = next[c] / length;
+    }
+
+    float length = 0.0f;
+    for (int c = 0; c < channels; c++) length += axis[c] * axis[c];
+    if (length == 0.0f) {
+        for (int c = 0; c < channels; c++) a[c] = b[c] = mean[c];
+        return;
+    }
+    length = sqrtf(length);
+    for (int c = 0; c < channels; c++) axis[c] /= length;
+
+    float t_min = FLT_MAX, t_max = -FLT_MAX;
+    for (int i = 0; i < 16; i++) {
+        if (!(mask & (1u << i))) continue;
+        float t = 0.0f;
+        for (int c = 0; c < channels; c++) t += (block[c][i] - mean[c]) * axis[c];
+        if (t < t_min) t_min = t;
+        if (t > t_max) t_max = t;
+    }
+    for (int c = 0; c < channels; c++) {
+        a[c] = fminf(fmaxf(mean[c] + axis[c] * t_min, 0.0f), 255.0f);
+        b[c] = fminf(fmaxf(mean[c] + axis[c] * t_max, 0.0f), 255.0f);
+    }
+}
+
+// Solves for the endpoints that best reproduce the texels in mask given fixed interpolation weights.
+int BC_least_squares(BCBlock block, int channels, const unsigned char indices[16], const float *index_weights, unsigned int mask, float a[4], float b[4]) {
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = { 0 }, bx[4] = { 0 };
+    for (int i = 0; i < 16; i++) {
+        if (!(mask & (1u << i))) continue;
+        float t = index_weights[indices[i]];
+        float s = 1.0f - t;
+        aa += s * s;
+        ab += s * t;
+        bb += t * t;
+        for (int c = 0; c < channels; c++) {
+            ax[c] += s * block[c][i];
+            bx[c] += t * block[c][i];
+        }
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (fabsf(determinant) < 1e-6f) return 0;
+    for (int c = 0; c < channels; c++) {
+        a[c] = fminf(fmaxf((bb * ax[c] - ab * bx[c]) / determinant, 0.0f), 255.0f);
+        b[c] = fminf(fmaxf((aa * bx[c] - ab * ax[c]) / determinant, 0.0f), 255.0f);
+    }
+    return 1;
+}
+
+/* BC1 color blocks */
+
+unsigned short BC_pack_565(const float color[4]) {
+    int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+    int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+    int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+    return (unsigned short)(r << 11 | g << 5 | b);
+}
+
+void BC_unpack_565(unsigned short packed, float color[4]) {
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    color[0] = (float)(r << 3 | r >> 2);
+    color[1] = (float)(g << 2 | g >> 4);
+    color[2] = (float)(b << 3 | b >> 2);
+    color[3] = 0.0f;
+}
+
+void BC_color_palette(unsigned short c0, unsigned short c1, int three_color, float palette[4][4]) {
+    BC_unpack_565(c0, palette[0]);
+    BC_unpack_565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        if (three_color) {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0f;
+            palette[3][c] = 0.0f;
+        } else {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+    }
+    palette[2][3] = palette[3][3] = 0.0f;
+}
+
+// BC1 color block. With allow_transparent, texels with alpha below 128 use the punch-through mode.
+void BC_encode_color_block(unsigned char out[8], BCBlock block, BCQuality quality, int allow_transparent) {
+    static const float weights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+    static const float four_color_weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    static const float three_color_weights[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+
+    unsigned int opaque = 0xffff;
+    if (allow_transparent) {
+        for (int i = 0; i < 16; i++) {
+            if (block[3][i] < 128.0f) opaque &= ~(1u << i);
+        }
+    }
+    int three_color = opaque != 0xffff;
+    int palette_size = three_color ? 3 : 4;
+    const float *index_weights = three_color ? three_color_weights : four_color_weights;
+
+    float a[4], b[4];
+    BC_find_endpoints(block, 3, weights, opaque, quality, a, b);
+
+    unsigned short c0 = BC_pack_565(a), c1 = BC_pack_565(b);
+    float palette[4][4];
+    unsigned char indices[16];
+    BC_color_palette(c0, c1, three_color, palette);
+    float error = BC_fit_indices(block, palette, palette_size, weights, opaque, indices);
+
+    int iterations = quality == BC_QUALITY_HIGH ? 2 : quality == BC_QUALITY_NORMAL ? 1 : 0;
+    for (int iteration = 0; iteration < iterations && error > 0.0f; iteration++) {
+        float refined_a[4], refined_b[4];
+        if (!BC_least_squares(block, 3, indices, index_weights, opaque, refined_a, refined_b)) break;
+
+        unsigned short r0 = BC_pack_565(refined_a), r1 = BC_pack_565(refined_b);
+        float refined_palette[4][4];
+        unsigned char refined_indices[16];
+        BC_color_palette(r0, r1, three_color, refined_palette);
+        float refined_error = BC_fit_indices(block, refined_palette, palette_size, weights, opaque, refined_indices);
+        if (refined_error >= error) break;
+
+        c0 = r0;
+        c1 = r1;
+        error = refined_error;
+        memcpy(indices, refined_indices, sizeof(indices));
+    }
+
+    // Four color mode needs c0 > c1, three color mode c0 <= c1; swapping endpoints remaps 0<->1 and 2<->3.
+    if (three_color ? c0 > c1 : c0 < c1) {
+        unsigned short swap = c0;
+        c0 = c1;
+        c1 = swap;
+        static const unsigned char four_color_swap[4] = { 1, 0, 3, 2 };
+        static const unsigned char three_color_swap[4] = { 1, 0, 2, 3 };
+        for (int i = 0; i < 16; i++) {
+            indices[i] = three_color ? three_color_swap[indices[i]] : four_color_swap[indices[i]];
+        }
+    }
+
+    unsigned int bits = 0;
+    for (int i = 0; i < 16; i++) {
+        unsigned int index = indices[i];
+        if (!(opaque & (1u << i))) index = 3;
+        else if (!three_color && c0 == c1) index = 0;
+        bits |= index << (2 * i);
+    }
+
+    out[0] = c0 & 0xff;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xff;
+    out[3] = c1 >> 8;
+    out[4] = bits & 0xff;
+    out[5] = (bits >> 8) & 0xff;
+    out[6] = (bits >> 16) & 0xff;
+    out[7] = bits >> 24;
+}
+
+/* BC4 single channel blocks, also the alpha half of BC3 and both halves of BC5 */
+
+void BC_alpha_palette(int r0, int r1, float palette[8]) {
+    palette[0] = (float)r0;
+    palette[1] = (float)r1;
+    if (r0 > r1) {
+        for (int i = 2; i < 8; i++) palette[i] = ((8 - i) * r0 + (i - 1) * r1) / 7.0f;
+    } else {
+        for (int i = 2; i < 6; i++) palette[i] = ((6 - i) * r0 + (i - 1) * r1) / 5.0f;
+        palette[6] = 0.0f;
+        palette[7] = 255.0f;
+    }
+}
+
+float BC_fit_alpha_indices(const float values[16], const float palette[8], unsigned char indices[16]) {
+    float total = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float best = FLT_MAX;
+        for (int k = 0; k < 8; k++) {
+            float d = (values[i] - palette[k]) * (values[i] - palette[k]);
+            if (d < best) {
+                best = d;
+                indices[i] = (unsigned char)k;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+int BC_round_channel(float value) {
+    int rounded = (int)(value + 0.5f);
+    return rounded < 0 ? 0 : rounded > 255 ? 255 : rounded;
+}
+
+void BC_encode_alpha_block(unsigned char out[8], const float values[16], BCQuality quality) {
+    static const float eight_value_weights[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+
+    float lo = 255.0f, hi = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        lo = fminf(lo, values[i]);
+        hi = fmaxf(hi, values[i]);
+    }
+
+    int r0 = BC_round_channel(hi), r1 = BC_round_channel(lo);
+    unsigned char indices[16] = { 0 };
+    float palette[8];
+    if (r0 == r1) {
+        // Single value: six value mode with every index on the first endpoint.
+        BC_alpha_palette(r0, r1, palette);
+    } else {
+        BC_alpha_palette(r0, r1, palette);
+        float error = BC_fit_alpha_indices(values, palette, indices);
+
+        if (quality != BC_QUALITY_FAST && error > 0.0f) {
+            BCBlock block;
+            memcpy(block[0], values, sizeof(block[0]));
+            float a[4], b[4];
+            if (BC_least_squares(block, 1, indices, eight_value_weights, 0xffff, a, b)) {
+                int s0 = BC_round_channel(a[0]), s1 = BC_round_channel(b[0]);
+                if (s0 < s1) {
+                    int swap = s0;
+                    s0 = s1;
+                    s1 = swap;
+                }
+                if (s0 > s1) {
+                    float refined_palette[8];
+                    unsigned char refined_indices[16];
+                    BC_alpha_palette(s0, s1, refined_palette);
+                    float refined_error = BC_fit_alpha_indices(values, refined_palette, refined_indices);
+                    if (refined_error < error) {
+                        r0 = s0;
+                        r1 = s1;
+                        error = refined_error;
+                        memcpy(indices, refined_indices, sizeof(indices));
+                    }
+                }
+            }
+        }
+
+        // Six value mode spends its extra entries on exact 0 and 255, which helps blocks with cut-outs.
+        if (quality == BC_QUALITY_HIGH && error > 0.0f) {
+            float inner_lo = 255.0f, inner_hi = 0.0f;
+            for (int i = 0; i < 16; i++) {
+                if (values[i] <= 0.0f || values[i] >= 255.0f) continue;
+                inner_lo = fminf(inner_lo, values[i]);
+                inner_hi = fmaxf(inner_hi, values[i]);
+            }
+            if (inner_lo <= inner_hi) {
+                int s0 = BC_round_channel(inner_lo), s1 = BC_round_channel(inner_hi);
+                float six_palette[8];
+                unsigned char six_indices[16];
+                BC_alpha_palette(s0, s1, six_palette);
+                float six_error = BC_fit_alpha_indices(values, six_palette, six_indices);
+                if (six_error < error) {
+                    r0 = s0;
+                    r1 = s1;
+                    memcpy(indices, six_indices, sizeof(indices));
+                }
+            }
+        }
+    }
+
+    unsigned long long bits = 0;
+    for (int i = 0; i < 16; i++) bits |= (unsigned long long)indices[i] << (3 * i);
+    out[0] = (unsigned char)r0;
+    out[1] = (unsigned char)r1;
+    for (int i = 0; i < 6; i++) out[2 + i] = (bits >> (8 * i)) & 0xff;
+}
+
+/* BC7 mode 6: one subset, RGBA 7.7.7.7 endpoints with a p-bit each and 4-bit indices */
+
+static const float BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+void BC_bc7_quantize(const float endpoint[4], int p, int quantized[4]) {
+    for (int c = 0; c < 4; c++) {
+        int q = (int)((endpoint[c] - p) / 2.0f + 0.5f);
+        quantized[c] = q < 0 ? 0 : q > 127 ? 127 : q;
+    }
+}
+
+float BC_bc7_quantize_error(const float endpoint[4], int p) {
+    int quantized[4];
+    BC_bc7_quantize(endpoint, p, quantized);
+    float error = 0.0f;
+    for (int c = 0; c < 4; c++) {
+        float d = (float)(quantized[c] << 1 | p) - endpoint[c];
+        error += d * d;
+    }
+    return error;
+}
+
+float BC_bc7_fit(BCBlock block, const float a[4], const float b[4], int p0, int p1, int q0[4], int q1[4], unsigned char indices[16]) {
+    static const float weights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    BC_bc7_quantize(a, p0, q0);
+    BC_bc7_quantize(b, p1, q1);
+
+    float palette[16][4];
+    for (int k = 0; k < 16; k++) {
+        int w = (int)BC7_WEIGHTS[k];
+        for (int c = 0; c < 4; c++) {
+            int e0 = q0[c] << 1 | p0;
+            int e1 = q1[c] << 1 | p1;
+            palette[k][c] = (float)(((64 - w) * e0 + w * e1 + 32) >> 6);
+        }
+    }
+    return BC_fit_indices(block, palette, 16, weights, 0xffff, indices);
+}
+
+void BC_bc7_write_bits(unsigned char out[16], int *position, unsigned int value, int count) {
+    for (int i = 0; i < count; i++, (*position)++) {
+        if (value & (1u << i)) out[*position >> 3] |= (unsigned char)(1u << (*position & 7));
+    }
+}
+
+void BC_encode_bc7_block(unsigned char out[16], BCBlock block, BCQuality quality) {
+    static const float weights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    float index_weights[16];
+    for (int k = 0; k < 16; k++) index_weights[k] = BC7_WEIGHTS[k] / 64.0f;
+
+    int opaque = 1;
+    for (int i = 0; i < 16; i++) {
+        if (block[3][i] < 255.0f) opaque = 0;
+    }
+
+    float a[4], b[4];
+    BC_find_endpoints(block, 4, weights, 0xffff, quality, a, b);
+
+    // Opaque blocks keep both p-bits set so alpha decodes to exactly 255.
+    int p0 = 1, p1 = 1;
+    if (!opaque) {
+        p0 = BC_bc7_quantize_error(a, 1) < BC_bc7_quantize_error(a, 0);
+        p1 = BC_bc7_quantize_error(b, 1) < BC_bc7_quantize_error(b, 0);
+    }
+
+    int q0[4], q1[4];
+    unsigned char indices[16];
+    float error = BC_bc7_fit(block, a, b, p0, p1, q0, q1, indices);
+
+    int iterations = quality == BC_QUALITY_HIGH ? 2 : quality == BC_QUALITY_NORMAL ? 1 : 0;
+    for (int iteration = 0; iteration < iterations && error > 0.0f; iteration++) {
+        float refined_a[4], refined_b[4];
+        if (!BC_least_squares(block, 4, indices, index_weights, 0xffff, refined_a, refined_b)) break;
+
+        int improved = 0;
+        int combinations = (quality == BC_QUALITY_HIGH && !opaque) ? 4 : 1;
+        for (int combination = 0; combination < combinations; combination++) {
+            int r0 = combinations == 1 ? p0 : combination & 1;
+            int r1 = combinations == 1 ? p1 : combination >> 1;
+            int s0[4], s1[4];
+            unsigned char refined_indices[16];
+            float refined_error = BC_bc7_fit(block, refined_a, refined_b, r0, r1, s0, s1, refined_indices);
+            if (refined_error < error) {
+                error = refined_error;
+                p0 = r0;
+                p1 = r1;
+                memcpy(q0, s0, sizeof(q0));
+                memcpy(q1, s1, sizeof(q1));
+                memcpy(indices, refined_indices, sizeof(indices));
+                improved = 1;
+            }
+        }
+        if (!improved) break;
+    }
+
+    // The anchor texel stores only three index bits, so its index must be below 8.
+    if (indices[0] >= 8) {
+        for (int c = 0; c < 4; c++) {
+            int swap = q0[c];
+            q0[c] = q1[c];
+            q1[c] = swap;
+        }
+        int swap = p0;
+        p0 = p1;
+        p1 = swap;
+        for (int i = 0; i < 16; i++) indices[i] = 15 - indices[i];
+    }
+
+    memset(out, 0, 16);
+    int position = 0;
+    BC_bc7_write_bits(out, &position, 1 << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        BC_bc7_write_bits(out, &position, q0[c], 7);
+        BC_bc7_write_bits(out, &position, q1[c], 7);
+    }
+    BC_bc7_write_bits(out, &position, p0, 1);
+    BC_bc7_write_bits(out, &position, p1, 1);
+    BC_bc7_write_bits(out, &position, indices[0], 3);
+    for (int i = 1; i < 16; i++) BC_bc7_write_bits(out, &position, indices[i], 4);
+}
+
+/* Whole images */
+
+void BC_encode_block(unsigned char *out, BCBlock block, TextureFormat format, BCQuality quality) {
+    switch (format) {
+        case TEXTURE_FORMAT_BC1:
+            BC_encode_color_block(out, block, quality, 1);
+            break;
+        case TEXTURE_FORMAT_BC3:
+            BC_encode_alpha_block(out, block[3], quality);
+            BC_encode_color_block(out + 8, block, quality, 0);
+            break;
+        case TEXTURE_FORMAT_BC4:
+            BC_encode_alpha_block(out, block[0], quality);
+            break;
+        case TEXTURE_FORMAT_BC5:
+            BC_encode_alpha_block(out, block[0], quality);
+            BC_encode_alpha_block(out + 8, block[1], quality);
+            break;
+        case TEXTURE_FORMAT_BC7:
+            BC_encode_bc7_block(out, block, quality);
+            break;
+        default:
+            break;
+    }
+}
+
+typedef struct {
+    const unsigned char *rgba;
+    unsigned int width;
+    unsigned int height;
+    TextureFormat format;
+    BCQuality quality;
+    unsigned char *out;
+} BCImageJob;
+
+void BC_encode_rows(void *data, int begin, int end) {
+    BCImageJob *job = data;
+    unsigned int blocks_x = (job->width + 3) / 4;
+    unsigned int block_bytes = TextureFormat_block_bytes(job->format);
+
+    BCBlock block;
+    for (int by = begin; by < end; by++) {
+        for (unsigned int bx = 0; bx < blocks_x; bx++) {
+            for (int i = 0; i < 16; i++) {
+                // Edge blocks repeat the last row and column.
+                unsigned int x = bx * 4 + (i & 3);
+                unsigned int y = by * 4 + (i >> 2);
+                if (x >= job->width) x = job->width - 1;
+                if (y >= job->height) y = job->height - 1;
+                const unsigned char *texel = job->rgba + ((size_t)y * job->width + x) * 4;
+                for (int c = 0; c < 4; c++) block[c][i] = texel[c];
+            }
+            BC_encode_block(job->out + ((size_t)by * blocks_x + bx) * block_bytes, block, job->format, job->quality);
+        }
+    }
+}
+
+// Encodes a tightly packed RGBA8 image into out, which must hold TextureFormat_level_size bytes.
+// Block rows are spread over the job system when one is given.
+void BC_compress(unsigned char *out, const unsigned char *rgba, unsigned int width, unsigned int height, TextureFormat format, BCQuality quality, JobSystem *jobs) {
+    BCImageJob job = { rgba, width, height, format, quality, out };
+    int block_rows = (height + 3) / 4;
+    int batch_size = jobs ? block_rows / (4 * (jobs->thread_count + 1)) : block_rows;
+    JobSystem_parallel_for(jobs, block_rows, batch_size, BC_encode_rows, &job);
+}
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef COMMAND_LIST_H
+#define COMMAND_LIST_H
+
+#include "glad/glad.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A CPU side recording of GL calls, so draws can be prepared on any thread and replayed on the one
+// that owns the context. Commands are packed back to back in one growing buffer, each a header with
+// its type and size followed by its arguments. Recording makes no GL calls; anything that does,
+// like binding a material's textures, is recorded as a CommandFunction to run during replay.
+
+#define COMMAND_LIST_MIN_CAPACITY 4096
+
+typedef enum {
+    COMMAND_USE_PROGRAM,
+    COMMAND_BIND_VERTEX_ARRAY,
+    COMMAND_BIND_BUFFER_RANGE,
+    COMMAND_ENABLE,
+    COMMAND_DISABLE,
+    COMMAND_FRONT_FACE,
+    COMMAND_DEPTH_MASK,
+    COMMAND_BLEND_FUNC,
+    COMMAND_DRAW_ELEMENTS,
+    COMMAND_DRAW_ARRAYS,
+    COMMAND_CALL,
+} CommandType;
+
+typedef void (*CommandFunction)(void *user, GLuint program, int argument);
+
+typedef struct {
+    uint32_t type;
+    uint32_t size; // of the whole command, header included
+} CommandHeader;
+
+typedef struct {
+    CommandHeader header;
+    GLuint name; // program, vertex array, capability, or front face
+} CommandName;
+
+typedef struct {
+    CommandHeader header;
+    GLenum target;
+    GLuint index;
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+} CommandBufferRange;
+
+typedef struct {
+    CommandHeader header;
+    GLenum first;
+    GLenum second;
+} CommandPair;
+
+typedef struct {
+    CommandHeader header;
+    GLenum mode;
+    GLenum index_type;
+    GLsizei count;
+    uintptr_t offset; // index buffer bytes, or the first vertex for glDrawArrays
+} CommandDraw;
+
+typedef struct {
+    CommandHeader header;
+    CommandFunction function;
+    void *user;
+    GLuint program;
+    int argument;
+} CommandCall;
+
+typedef struct {
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+    unsigned int draws;
+} CommandList;
+
+void CommandList_init(CommandList *list) {
+    memset(list, 0, sizeof(*list));
+}
+
+void CommandList_free(CommandList *list) {
+    free(list->data);
+    memset(list, 0, sizeof(*list));
+}
+
+void CommandList_reset(CommandList *list) {
+    list->size = 0;
+    list->draws = 0;
+}
+
+// Room for a command of size bytes, header included; sizes are rounded up to keep commands aligned.
+void *CommandList_push(CommandList *list, CommandType type, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    if (list->size + size > list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : COMMAND_LIST_MIN_CAPACITY;
+        while (capacity < list->size + size) capacity *= 2;
+        list->data = realloc(list->data, capacity);
+        if (!list->data) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        list->capacity = capacity;
+    }
+    CommandHeader *header = (CommandHeader *)(list->data + list->size);
+    header->type = type;
+    header->size = (uint32_t)size;
+    list->size += size;
+    return header;
+}
+
+void CommandList_name(CommandList *list, CommandType type, GLuint name) {
+    CommandName *command = CommandList_push(list, type, sizeof(CommandName));
+    command->name = name;
+}
+
+void CommandList_use_program(CommandList *list, GLuint program) {
+    CommandList_name(list, COMMAND_USE_PROGRAM, program);
+}
+
+void CommandList_bind_vertex_array(CommandList *list, GLuint vao) {
+    CommandList_name(list, COMMAND_BIND_VERTEX_ARRAY, vao);
+}
+
+void CommandList_enable(CommandList *list, GLenum capability, int enable) {
+    CommandList_name(list, enable ? COMMAND_ENABLE : COMMAND_DISABLE, capability);
+}
+
+void CommandList_front_face(CommandList *list, GLenum mode) {
+    CommandList_name(list, COMMAND_FRONT_FACE, mode);
+}
+
+void CommandList_depth_mask(CommandList *list, GLboolean mask) {
+    CommandList_name(list, COMMAND_DEPTH_MASK, mask);
+}
+
+void CommandList_blend_func(CommandList *list, GLenum source, GLenum destination) {
+    CommandPair *command = CommandList_push(list, COMMAND_BLEND_FUNC, sizeof(CommandPair));
+    command->first = source;
+    command->second = destination;
+}
+
+void CommandList_bind_buffer_range(CommandList *list, GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    CommandBufferRange *command = CommandList_push(list, COMMAND_BIND_BUFFER_RANGE, sizeof(CommandBufferRange));
+    command->target = target;
+    command->index = index;
+    command->buffer = buffer;
+    command->offset = offset;
+    command->size = size;
+}
+
+void CommandList_draw_elements(CommandList *list, GLenum mode, GLsizei count, GLenum index_type, uintptr_t offset) {
+    CommandDraw *command = CommandList_push(list, COMMAND_DRAW_ELEMENTS, sizeof(CommandDraw));
+    *command = (CommandDraw){ command->header, mode, index_type, count, offset };
+    list->draws++;
+}
+
+void CommandList_draw_arrays(CommandList *list, GLenum mode, GLint first, GLsizei count) {
+    CommandDraw *command = CommandList_push(list, COMMAND_DRAW_ARRAYS, sizeof(CommandDraw));
+    *command = (CommandDraw){ command->header, mode, 0, count, (uintptr_t)first };
+    list->draws++;
+}
+
+void CommandList_call(CommandList *list, CommandFunction function, void *user, GLuint program, int argument) {
+    CommandCall *command = CommandList_push(list, COMMAND_CALL, sizeof(CommandCall));
+    command->function = function;
+    command->user = user;
+    command->program = program;
+    command->argument = argument;
+}
+
+// Makes the recorded calls; only on the thread that owns the GL context.
+void CommandList_execute(const CommandList *list) {
+    for (size_t at = 0; at < list->size;) {
+        const CommandHeader *header = (const CommandHeader *)(list->data + at);
+        const CommandName *named = (const CommandName *)header;
+        switch (header->type) {
+            case COMMAND_USE_PROGRAM: glUseProgram(named->name); break;
+            case COMMAND_BIND_VERTEX_ARRAY: glBindVertexArray(named->name); break;
+            case COMMAND_ENABLE: glEnable(named->name); break;
+            case COMMAND_DISABLE: glDisable(named->name); break;
+            case COMMAND_FRONT_FACE: glFrontFace(named->name); break;
+            case COMMAND_DEPTH_MASK: glDepthMask((GLboolean)named->name); break;
+            case COMMAND_BLEND_FUNC: {
+                const CommandPair *pair = (const CommandPair *)header;
+                glBlendFunc(pair->first, pair->second);
+                break;
+            }
+            case COMMAND_BIND_BUFFER_RANGE: {
+                const CommandBufferRange *range = (const CommandBufferRange *)header;
+                glBindBufferRange(range->target, range->index, range->buffer, range->offset, range->size);
+                break;
+            }
+            case COMMAND_DRAW_ELEMENTS: {
+                const CommandDraw *draw = (const CommandDraw *)header;
+                glDrawElements(draw->mode, draw->count, draw->index_type, (const void *)draw->offset);
+                break;
+            }
+            case COMMAND_DRAW_ARRAYS: {
+                const CommandDraw *draw = (const CommandDraw *)header;
+                glDrawArrays(draw->mode, (GLint)draw->offset, draw->count);
+                break;
+            }
+            case COMMAND_CALL: {
+                const CommandCall *call = (const CommandCall *)header;
+                call->function(call->user, call->program, call->argument);
+                break;
+            }
+        }
+        at += header->size;
+    }
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef DRAW_DATA_H
+#define DRAW_DATA_H
+
+#include "glad/glad.h"
+#include "linalg.h"
+#include "stream_buffer.h"
+#include <string.h>
+
+// Per-draw constants, the std140 DrawData block in vertex.glsl. A frame's worth are written into
+// the stream buffer with one map, each at a multiple of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, and
+// each draw picks its own with glBindBufferRange instead of glUniform calls. Draws that do not
+// care, like the model and the instance grid, see an identity block from a buffer of its own.
+
+#define DRAW_DATA_BINDING 0
+
+typedef struct {
+    Matrix4 model; // uModel, object to world
+} DrawData;
+
+typedef struct {
+    StreamBuffer *stream;
+    GLsizeiptr stride; // sizeof(DrawData) rounded up to the offset alignment
+    GLuint identity_buffer;
+    GLintptr offset; // of the first block in stream->buffer
+    unsigned int count;
+    unsigned char *mapped;
+} DrawDataBuffer;
+
+void DrawDataBuffer_init(DrawDataBuffer *draws, StreamBuffer *stream) {
+    memset(draws, 0, sizeof(*draws));
+    draws->stream = stream;
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment < 1) alignment = 1;
+    draws->stride = ((GLsizeiptr)sizeof(DrawData) + alignment - 1) / alignment * alignment;
+
+    DrawData identity;
+    Matrix4_identity(identity.model);
+    glGenBuffers(1, &draws->identity_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, draws->identity_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(DrawData), &identity, GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void DrawDataBuffer_free(DrawDataBuffer *draws) {
+    glDeleteBuffers(1, &draws->identity_buffer);
+    draws->identity_buffer = 0;
+}
+
+// Room for count blocks, written through DrawDataBuffer_at before DrawDataBuffer_unmap. The writes
+// may come from any thread; mapping and unmapping only from the GL thread.
+void DrawDataBuffer_map(DrawDataBuffer *draws, unsigned int count) {
+    draws->count = count;
+    draws->mapped = count ? StreamBuffer_map(draws->stream, (GLsizeiptr)count * draws->stride, draws->stride, &draws->offset) : NULL;
+}
+
+DrawData *DrawDataBuffer_at(const DrawDataBuffer *draws, unsigned int index) {
+    return (DrawData *)(draws->mapped + (GLsizeiptr)index * draws->stride);
+}
+
+void DrawDataBuffer_unmap(DrawDataBuffer *draws) {
+    if (!draws->mapped) return;
+    // Lost contents are drawn with whatever is there; the next frame writes them again.
+    StreamBuffer_unmap(draws->stream);
+    draws->mapped = NULL;
+}
+
+GLintptr DrawDataBuffer_offset(const DrawDataBuffer *draws, unsigned int index) {
+    return draws->offset + (GLintptr)index * draws->stride;
+}
+
+void DrawDataBuffer_bind(const DrawDataBuffer *draws, unsigned int index) {
+    glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_DATA_BINDING, draws->stream->buffer, DrawDataBuffer_offset(draws, index), sizeof(DrawData));
+}
+
+void DrawDataBuffer_bind_identity(const DrawDataBuffer *draws) {
+    glBindBufferBase(GL_UNIFORM_BUFFER, DRAW_DATA_BINDING, draws->identity_buffer);
+}
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef FRAME_SYNC_H
+#define FRAME_SYNC_H
+
+#include "glad/glad.h"
+#include <SDL2/SDL_timer.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Keeps the CPU at most max_latency frames ahead of the GPU. Every frame ends with a fence; ending
+// one when max_latency frames are already unfinished waits for the oldest. Finished frames tell
+// what the GPU is done with: per-frame storage last used by a finished frame can be rewritten, and
+// GL objects handed to FrameSync_delete are deleted once every frame that could still use them is.
+
+#define FRAME_SYNC_MAX_LATENCY 4
+#define FRAME_SYNC_WAIT_NS 1000000 // per glClientWaitSync call while waiting
+
+typedef enum {
+    FRAME_DELETE_BUFFER,
+    FRAME_DELETE_TEXTURE,
+    FRAME_DELETE_VERTEX_ARRAY,
+    FRAME_DELETE_SAMPLER,
+    FRAME_DELETE_FRAMEBUFFER,
+    FRAME_DELETE_RENDERBUFFER,
+    FRAME_DELETE_QUERY,
+} FrameDeletionType;
+
+typedef struct {
+    FrameDeletionType type;
+    GLuint name;
+    unsigned int frame; // the last one that may use it
+} FrameDeletion;
+
+typedef struct {
+    unsigned int waits; // frames that had to wait for an older one, in total
+    double wait_ms;
+    unsigned int deleted;
+} FrameSyncStats;
+
+typedef struct {
+    unsigned int max_latency;
+    unsigned int frame;     // being recorded; the first is 1, so 0 can mean never
+    unsigned int completed; // every frame before this one is finished on the GPU
+    GLsync fences[FRAME_SYNC_MAX_LATENCY + 1]; // of unfinished frames, by frame number
+    FrameDeletion *deletions;
+    unsigned int deletion_count;
+    unsigned int deletion_capacity;
+    FrameSyncStats stats;
+} FrameSync;
+
+void FrameSync_init(FrameSync *frames, unsigned int max_latency) {
+    memset(frames, 0, sizeof(*frames));
+    if (max_latency < 1) max_latency = 1;
+    if (max_latency > FRAME_SYNC_MAX_LATENCY) max_latency = FRAME_SYNC_MAX_LATENCY;
+    frames->max_latency = max_latency;
+    frames->frame = 1;
+    frames->completed = 1;
+}
+
+GLsync *FrameSync_fence(FrameSync *frames, unsigned int frame) {
+    return &frames->fences[frame % (FRAME_SYNC_MAX_LATENCY + 1)];
+}
+
+// Moves completed past the frames whose fences have signaled, without blocking.
+void FrameSync_poll(FrameSync *frames) {
+    while (frames->completed < frames->frame) {
+        GLsync *fence = FrameSync_fence(frames, frames->completed);
+        GLenum status = glClientWaitSync(*fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) break;
+        glDeleteSync(*fence);
+        *fence = NULL;
+        frames->completed++;
+    }
+}
+
+// Blocks until frame is finished on the GPU. Returns 1 if that meant waiting.
+int FrameSync_wait(FrameSync *frames, unsigned int frame) {
+    FrameSync_poll(frames);
+    if (frame < frames->completed) return 0;
+    if (frame >= frames->frame) {
+        fprintf(stderr, "Waiting for frame %u, which has not ended\n", frame);
+        exit(1);
+    }
+    Uint64 start = SDL_GetPerformanceCounter();
+    while (frames->completed <= frame) {
+        GLsync *fence = FrameSync_fence(frames, frames->completed);
+        GLenum status;
+        do status = glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, FRAME_SYNC_WAIT_NS);
+        while (status == GL_TIMEOUT_EXPIRED);
+        glDeleteSync(*fence);
+        *fence = NULL;
+        frames->completed++;
+    }
+    frames->stats.waits++;
+    frames->stats.wait_ms += (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    return 1;
+}
+
+void FrameSync_delete_now(const FrameDeletion *deletion) {
+    switch (deletion->type) {
+        case FRAME_DELETE_BUFFER: glDeleteBuffers(1, &deletion->name); break;
+        case FRAME_DELETE_TEXTURE: glDeleteTextures(1, &deletion->name); break;
+        case FRAME_DELETE_VERTEX_ARRAY: glDeleteVertexArrays(1, &deletion->name); break;
+        case FRAME_DELETE_SAMPLER: glDeleteSamplers(1, &deletion->name); break;
+        case FRAME_DELETE_FRAMEBUFFER: glDeleteFramebuffers(1, &deletion->name); break;
+        case FRAME_DELETE_RENDERBUFFER: glDeleteRenderbuffers(1, &deletion->name); break;
+        case FRAME_DELETE_QUERY: glDeleteQueries(1, &deletion->name); break;
+    }
+}
+
+// Deletes name once the frame being recorded, the last that may draw with it, is finished.
+void FrameSync_delete(FrameSync *frames, FrameDeletionType type, GLuint name) {
+    if (!name) return;
+    if (frames->deletion_count == frames->deletion_capacity) {
+        frames->deletion_capacity = frames->deletion_capacity ? frames->deletion_capacity * 2 : 64;
+        frames->deletions = realloc(frames->deletions, frames->deletion_capacity * sizeof(FrameDeletion));
+        if (!frames->deletions) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    frames->deletions[frames->deletion_count++] = (FrameDeletion){ type, name, frames->frame };
+}
+
+// Queued in frame order, so the finished ones are always at the front.
+void FrameSync_collect(FrameSync *frames) {
+    unsigned int done = 0;
+    while (done < frames->deletion_count && frames->deletions[done].frame < frames->completed) {
+        FrameSync_delete_now(&frames->deletions[done]);
+        done++;
+    }
+    if (done == 0) return;
+    frames->deletion_count -= done;
+    memmove(frames->deletions, frames->deletions + done, frames->deletion_count * sizeof(FrameDeletion));
+    frames->stats.deleted += done;
+}
+
+// Call once the frame's commands are all issued, after the swap.
+void FrameSync_end_frame(FrameSync *frames) {
+    *FrameSync_fence(frames, frames->frame) = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frames->frame++;
+    if (frames->frame - frames->completed > frames->max_latency) FrameSync_wait(frames, frames->frame - frames->max_latency - 1);
+    else FrameSync_poll(frames);
+    FrameSync_collect(frames);
+}
+
+// Waits for everything in flight and deletes whatever is still queued.
+void FrameSync_free(FrameSync *frames) {
+    if (frames->frame > frames->completed) FrameSync_wait(frames, frames->frame - 1);
+    FrameSync_collect(frames);
+    free(frames->deletions);
+    frames->deletions = NULL;
+    frames->deletion_count = 0;
+    frames->deletion_capacity = 0;
+}
+
+void FrameSync_print_stats(const FrameSync *frames) {
+    const FrameSyncStats *stats = &frames->stats;
+    printf("FRAMES:\t\t%u in flight of at most %u, %u waits (%.1f ms), %u deferred deletions done, %u pending\n", frames->frame - frames->completed,
+        frames->max_latency, stats->waits, stats->wait_ms, stats->deleted, frames->deletion_count);
+}
+
+#endif
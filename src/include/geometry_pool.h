@@ -0,0 +1,365 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include "glad/glad.h"
+#include "mesh.h"
+#include "mesh_codec.h"
+#include "vertex_format.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Shared vertex and index buffers that many meshes are suballocated from, with one vertex array
+// per vertex format and index type. Indices stay relative to their mesh's own vertices and draws
+// add the allocation's first vertex as the base vertex, so 16 bit indices keep working for any
+// mesh of up to 65536 vertices no matter where it lands in the pool.
+// - Free space is a sorted list of ranges, allocated first fit and merged with its neighbours
+//   when released. A pool that runs out grows to twice its size, keeping its buffer names so the
+//   vertex arrays pointing at them stay valid.
+// - GeometryBatch collects draws from one pool and submits them with a single call:
+//   glMultiDrawElementsIndirect where GL_ARB_multi_draw_indirect (core in 4.3) is available,
+//   glMultiDrawElementsBaseVertex otherwise.
+
+#define GEOMETRY_POOL_MAX_POOLS 8
+#define GEOMETRY_POOL_MIN_VERTICES 65536
+#define GEOMETRY_POOL_MIN_INDICES (3 * 65536)
+#define GEOMETRY_BATCH_MIN_CAPACITY 64
+
+typedef struct {
+    unsigned int first;
+    unsigned int count;
+} GeometryRange;
+
+typedef struct {
+    GeometryRange *ranges; // sorted by first, never adjacent
+    unsigned int count;
+    unsigned int capacity;
+} GeometryFreeList;
+
+typedef struct {
+    unsigned int first_vertex;
+    unsigned int vertex_count;
+    unsigned int first_index;
+    unsigned int index_count;
+} GeometryAllocation;
+
+typedef struct {
+    VertexFormat format;
+    GLenum index_type;
+    unsigned int index_size;
+    GLuint vao;
+    GLuint vertex_buffer;
+    GLuint index_buffer;
+    unsigned int vertex_capacity;
+    unsigned int index_capacity;
+    unsigned int vertices_used;
+    unsigned int indices_used;
+    GeometryFreeList free_vertices;
+    GeometryFreeList free_indices;
+} GeometryPool;
+
+typedef struct {
+    GeometryPool pools[GEOMETRY_POOL_MAX_POOLS];
+    int pool_count;
+} GeometryPools;
+
+// Laid out as glMultiDrawElementsIndirect reads it.
+typedef struct {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+} GeometryDrawCommand;
+
+typedef struct {
+    const GeometryPool *pool;
+    GeometryDrawCommand *commands;
+    GLsizei *counts; // the same draws for glMultiDrawElementsBaseVertex
+    const void **offsets;
+    GLint *base_vertices;
+    unsigned int count;
+    unsigned int capacity;
+    GLuint indirect_buffer; // 0 without GL_ARB_multi_draw_indirect
+    int uploaded;
+} GeometryBatch;
+
+void GeometryFreeList_release(GeometryFreeList *list, unsigned int first, unsigned int count) {
+    if (count == 0) return;
+    unsigned int at = 0;
+    while (at < list->count && list->ranges[at].first < first) at++;
+    int joins_previous = at > 0 && list->ranges[at - 1].first + list->ranges[at - 1].count == first;
+    int joins_next = at < list->count && first + count == list->ranges[at].first;
+    if (joins_previous && joins_next) {
+        list->ranges[at - 1].count += count + list->ranges[at].count;
+        memmove(&list->ranges[at], &list->ranges[at + 1], (list->count - at - 1) * sizeof(GeometryRange));
+        list->count--;
+    } else if (joins_previous) {
+        list->ranges[at - 1].count += count;
+    } else if (joins_next) {
+        list->ranges[at].first = first;
+        list->ranges[at].count += count;
+    } else {
+        if (list->count == list->capacity) {
+            list->capacity = list->capacity ? list->capacity * 2 : 16;
+            list->ranges = realloc(list->ranges, list->capacity * sizeof(GeometryRange));
+            if (!list->ranges) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+        }
+        memmove(&list->ranges[at + 1], &list->ranges[at], (list->count - at) * sizeof(GeometryRange));
+        list->ranges[at] = (GeometryRange){ first, count };
+        list->count++;
+    }
+}
+
+int GeometryFreeList_allocate(GeometryFreeList *list, unsigned int count, unsigned int *first) {
+    if (count == 0) {
+        *first = 0;
+        return 1;
+    }
+    for (unsigned int i = 0; i < list->count; i++) {
+        GeometryRange *range = &list->ranges[i];
+        if (range->count < count) continue;
+        *first = range->first;
+        range->first += count;
+        range->count -= count;
+        if (range->count == 0) {
+            memmove(range, range + 1, (list->count - i - 1) * sizeof(GeometryRange));
+            list->count--;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+// Resizes buffer's storage to new_size bytes, keeping the first old_size. The copy goes through the
+// copy targets so no vertex array's element buffer binding is touched.
+void GeometryPool_resize_buffer(GLuint buffer, GLsizeiptr old_size, GLsizeiptr new_size) {
+    GLuint scratch = 0;
+    if (old_size > 0) {
+        glGenBuffers(1, &scratch);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+        glBufferData(GL_COPY_WRITE_BUFFER, old_size, NULL, GL_STREAM_COPY);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_size);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, new_size, NULL, GL_STATIC_DRAW);
+    if (old_size > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, scratch);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_size);
+        glDeleteBuffers(1, &scratch);
+    }
+}
+
+void GeometryPool_grow(GeometryPool *pool, unsigned int vertex_capacity, unsigned int index_capacity) {
+    if (vertex_capacity > pool->vertex_capacity) {
+        GeometryPool_resize_buffer(pool->vertex_buffer, (GLsizeiptr)pool->vertex_capacity * pool->format.stride,
+            (GLsizeiptr)vertex_capacity * pool->format.stride);
+        GeometryFreeList_release(&pool->free_vertices, pool->vertex_capacity, vertex_capacity - pool->vertex_capacity);
+        pool->vertex_capacity = vertex_capacity;
+    }
+    if (index_capacity > pool->index_capacity) {
+        GeometryPool_resize_buffer(pool->index_buffer, (GLsizeiptr)pool->index_capacity * pool->index_size, (GLsizeiptr)index_capacity * pool->index_size);
+        GeometryFreeList_release(&pool->free_indices, pool->index_capacity, index_capacity - pool->index_capacity);
+        pool->index_capacity = index_capacity;
+    }
+}
+
+void GeometryPool_init(GeometryPool *pool, const VertexFormat *format, GLenum index_type) {
+    memset(pool, 0, sizeof(*pool));
+    pool->format = *format;
+    pool->index_type = index_type;
+    pool->index_size = Mesh_index_size(index_type);
+    glGenBuffers(1, &pool->vertex_buffer);
+    glGenBuffers(1, &pool->index_buffer);
+    GeometryPool_grow(pool, GEOMETRY_POOL_MIN_VERTICES, GEOMETRY_POOL_MIN_INDICES);
+
+    glGenVertexArrays(1, &pool->vao);
+    glBindVertexArray(pool->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, pool->vertex_buffer);
+    VertexFormat_apply(&pool->format, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool->index_buffer);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryPool_free(GeometryPool *pool) {
+    glDeleteVertexArrays(1, &pool->vao);
+    glDeleteBuffers(1, &pool->vertex_buffer);
+    glDeleteBuffers(1, &pool->index_buffer);
+    free(pool->free_vertices.ranges);
+    free(pool->free_indices.ranges);
+    memset(pool, 0, sizeof(*pool));
+}
+
+// Returns 0 if the mesh has more vertices than the pool's index type can address.
+int GeometryPool_allocate(GeometryPool *pool, unsigned int vertex_count, unsigned int index_count, GeometryAllocation *allocation) {
+    if (pool->index_type == GL_UNSIGNED_SHORT && vertex_count > 65536) return 0;
+    allocation->vertex_count = vertex_count;
+    allocation->index_count = index_count;
+    while (!GeometryFreeList_allocate(&pool->free_vertices, vertex_count, &allocation->first_vertex)) {
+        GeometryPool_grow(pool, pool->vertex_capacity * 2 + vertex_count, pool->index_capacity);
+    }
+    while (!GeometryFreeList_allocate(&pool->free_indices, index_count, &allocation->first_index)) {
+        GeometryPool_grow(pool, pool->vertex_capacity, pool->index_capacity * 2 + index_count);
+    }
+    pool->vertices_used += vertex_count;
+    pool->indices_used += index_count;
+    return 1;
+}
+
+void GeometryPool_release(GeometryPool *pool, const GeometryAllocation *allocation) {
+    GeometryFreeList_release(&pool->free_vertices, allocation->first_vertex, allocation->vertex_count);
+    GeometryFreeList_release(&pool->free_indices, allocation->first_index, allocation->index_count);
+    pool->vertices_used -= allocation->vertex_count;
+    pool->indices_used -= allocation->index_count;
+}
+
+// vertices are in the pool's format and indices of its type, counted from the allocation's first vertex.
+void GeometryPool_upload(const GeometryPool *pool, const GeometryAllocation *allocation, const void *vertices, const void *indices) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, pool->vertex_buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocation->first_vertex * pool->format.stride,
+        (GLsizeiptr)allocation->vertex_count * pool->format.stride, vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, pool->index_buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocation->first_index * pool->index_size, (GLsizeiptr)allocation->index_count * pool->index_size,
+        indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+// Like GeometryPool_upload for MeshCodec streams, which are decoded straight into the mapped buffer
+// ranges without a copy in between. Returns 0 if either stream is malformed or a range cannot be mapped.
+int GeometryPool_upload_encoded(const GeometryPool *pool, const GeometryAllocation *allocation, const unsigned char *vertices, size_t vertices_size,
+    const unsigned char *indices, size_t indices_size) {
+    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, pool->vertex_buffer);
+    void *mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, (GLintptr)allocation->first_vertex * pool->format.stride,
+        (GLsizeiptr)allocation->vertex_count * pool->format.stride, access);
+    int success = mapped && MeshCodec_decode_vertices(mapped, allocation->vertex_count, pool->format.stride, vertices, vertices_size);
+    if (mapped) success = glUnmapBuffer(GL_COPY_WRITE_BUFFER) && success;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, pool->index_buffer);
+    mapped = success ? glMapBufferRange(GL_COPY_WRITE_BUFFER, (GLintptr)allocation->first_index * pool->index_size,
+        (GLsizeiptr)allocation->index_count * pool->index_size, access) : NULL;
+    success = mapped && MeshCodec_decode_indices(mapped, pool->index_size, allocation->index_count, allocation->vertex_count, indices, indices_size);
+    if (mapped) success = glUnmapBuffer(GL_COPY_WRITE_BUFFER) && success;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return success;
+}
+
+int GeometryPool_matches(const GeometryPool *pool, const VertexFormat *format, GLenum index_type) {
+    if (pool->index_type != index_type || pool->format.stride != format->stride || pool->format.attribute_count != format->attribute_count) return 0;
+    for (int i = 0; i < format->attribute_count; i++) {
+        const VertexAttribute *a = &pool->format.attributes[i], *b = &format->attributes[i];
+        if (a->location != b->location || a->components != b->components || a->type != b->type || a->normalized != b->normalized
+            || a->integer != b->integer || a->offset != b->offset) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void GeometryPools_init(GeometryPools *pools) {
+    pools->pool_count = 0;
+}
+
+// The pool for format and index_type, made on first use.
+GeometryPool *GeometryPools_get(GeometryPools *pools, const VertexFormat *format, GLenum index_type) {
+    for (int i = 0; i < pools->pool_count; i++) {
+        if (GeometryPool_matches(&pools->pools[i], format, index_type)) return &pools->pools[i];
+    }
+    if (pools->pool_count == GEOMETRY_POOL_MAX_POOLS) {
+        fprintf(stderr, "Too many geometry pools\n");
+        exit(1);
+    }
+    GeometryPool *pool = &pools->pools[pools->pool_count++];
+    GeometryPool_init(pool, format, index_type);
+    return pool;
+}
+
+void GeometryPools_print_stats(const GeometryPools *pools) {
+    for (int i = 0; i < pools->pool_count; i++) {
+        const GeometryPool *pool = &pools->pools[i];
+        printf("GEOMETRY:\tpool %d, %d byte vertices, %u bit indices: %u of %u vertices, %u of %u indices, %u and %u free ranges\n", i,
+            pool->format.stride, pool->index_size * 8, pool->vertices_used, pool->vertex_capacity, pool->indices_used, pool->index_capacity,
+            pool->free_vertices.count, pool->free_indices.count);
+    }
+}
+
+void GeometryBatch_init(GeometryBatch *batch) {
+    memset(batch, 0, sizeof(*batch));
+    if (GLAD_GL_ARB_multi_draw_indirect) glGenBuffers(1, &batch->indirect_buffer);
+}
+
+void GeometryBatch_free(GeometryBatch *batch) {
+    free(batch->commands);
+    free(batch->counts);
+    free(batch->offsets);
+    free(batch->base_vertices);
+    if (batch->indirect_buffer) glDeleteBuffers(1, &batch->indirect_buffer);
+    memset(batch, 0, sizeof(*batch));
+}
+
+void GeometryBatch_begin(GeometryBatch *batch, const GeometryPool *pool) {
+    batch->pool = pool;
+    batch->count = 0;
+    batch->uploaded = 0;
+}
+
+// Adds index_count indices from first_index, counted in the pool's whole index buffer. A draw
+// continuing the previous one in the buffer with the same base vertex is merged into it.
+void GeometryBatch_add(GeometryBatch *batch, unsigned int first_index, unsigned int index_count, GLint base_vertex) {
+    if (index_count == 0) return;
+    if (batch->count > 0) {
+        GeometryDrawCommand *last = &batch->commands[batch->count - 1];
+        if (last->base_vertex == base_vertex && last->first_index + last->count == first_index) {
+            last->count += index_count;
+            batch->counts[batch->count - 1] += (GLsizei)index_count;
+            return;
+        }
+    }
+    if (batch->count == batch->capacity) {
+        batch->capacity = batch->capacity ? batch->capacity * 2 : GEOMETRY_BATCH_MIN_CAPACITY;
+        batch->commands = realloc(batch->commands, batch->capacity * sizeof(GeometryDrawCommand));
+        batch->counts = realloc(batch->counts, batch->capacity * sizeof(GLsizei));
+        batch->offsets = realloc(batch->offsets, batch->capacity * sizeof(const void *));
+        batch->base_vertices = realloc(batch->base_vertices, batch->capacity * sizeof(GLint));
+        if (!batch->commands || !batch->counts || !batch->offsets || !batch->base_vertices) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    batch->commands[batch->count] = (GeometryDrawCommand){ index_count, 1, first_index, base_vertex, 0 };
+    batch->counts[batch->count] = (GLsizei)index_count;
+    batch->offsets[batch->count] = (const void *)((uintptr_t)first_index * batch->pool->index_size);
+    batch->base_vertices[batch->count] = base_vertex;
+    batch->count++;
+}
+
+void GeometryBatch_add_allocation(GeometryBatch *batch, const GeometryAllocation *allocation) {
+    GeometryBatch_add(batch, allocation->first_index, allocation->index_count, (GLint)allocation->first_vertex);
+}
+
+// One call for the whole batch, with the pool's vertex array bound. Submitting the same batch
+// again, e.g. for another pass, reuses the commands already uploaded.
+void GeometryBatch_submit(GeometryBatch *batch, GLenum mode) {
+    if (batch->count == 0) return;
+    glBindVertexArray(batch->pool->vao);
+    if (batch->indirect_buffer) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch->indirect_buffer);
+        if (!batch->uploaded) {
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, (GLsizeiptr)batch->count * sizeof(GeometryDrawCommand), batch->commands, GL_STREAM_DRAW);
+            batch->uploaded = 1;
+        }
+        glMultiDrawElementsIndirect(mode, batch->pool->index_type, NULL, (GLsizei)batch->count, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    } else {
+        glMultiDrawElementsBaseVertex(mode, batch->counts, batch->pool->index_type, batch->offsets, (GLsizei)batch->count,
+            batch->base_vertices);
+    }
+}
+
+#endif
@@ -0,0 +1,681 @@
+#ifndef GLTF_H
+#define GLTF_H
+
+#include "glad/glad.h"
+#include "json.h"
+#include "linalg.h"
+#include "render_queue.h"
+#include "shader.h"
+#include "texture.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Loads binary glTF 2.0 (.glb) scenes. The file is mmapped and its JSON chunk tokenized in place;
+// accessors and buffer views only record offsets into the mapped binary chunk (or mmapped external
+// .bin buffers). Gltf_upload then hands every buffer to GL exactly once, straight from the mapping,
+// and builds one vertex array object per primitive whose attribute and index pointers are byte
+// offsets into those shared buffers, so no vertex data is ever copied on the CPU.
+// Not supported: sparse accessors, data: URIs, required extensions, morph targets and skins.
+// Images are only described: a uri resolves to a path, and images stored in a buffer view are copied
+// out of the mapping so they can be decoded after Gltf_upload has let it go.
+
+#define GLB_MAGIC 0x46546c67u       // "glTF"
+#define GLB_CHUNK_JSON 0x4e4f534au  // "JSON"
+#define GLB_CHUNK_BIN 0x004e4942u   // "BIN\0"
+#define GLTF_PATH_LENGTH 512
+
+// Values double as the vertex attribute locations used by the shaders.
+typedef enum {
+    GLTF_ATTRIBUTE_POSITION,
+    GLTF_ATTRIBUTE_TEXCOORD_0,
+    GLTF_ATTRIBUTE_NORMAL,
+    GLTF_ATTRIBUTE_COUNT,
+} GltfAttribute;
+
+static const char *gltf_attribute_names[GLTF_ATTRIBUTE_COUNT] = { "POSITION", "TEXCOORD_0", "NORMAL" };
+
+typedef struct {
+    void *mapping; // NULL for the .glb binary chunk, which lives in the file's own mapping
+    size_t mapping_size;
+    const unsigned char *data; // NULL once uploaded
+    size_t size;
+    GLuint buffer;
+} GltfBuffer;
+
+typedef struct {
+    int buffer;
+    size_t byte_offset;
+    size_t byte_length;
+    unsigned int byte_stride; // 0 when tightly packed
+} GltfBufferView;
+
+typedef struct {
+    int buffer_view;
+    size_t byte_offset; // within the buffer view
+    GLenum component_type; // glTF component types are GL enums
+    GLboolean normalized;
+    unsigned int count;
+    unsigned int components;
+    GLfloat min[3]; // bounds, which glTF requires for positions
+    GLfloat max[3];
+} GltfAccessor;
+
+typedef struct {
+    int attributes[GLTF_ATTRIBUTE_COUNT]; // accessor indices, -1 if absent
+    int indices; // accessor index, -1 for non-indexed primitives
+    int material; // -1 for the default material
+    GLenum mode;
+    GLuint vao;
+} GltfPrimitive;
+
+typedef struct {
+    int first_primitive;
+    int primitive_count;
+} GltfMesh;
+
+typedef struct {
+    Matrix4 local;
+    int mesh; // -1 for pure transform nodes
+    int first_child; // into Gltf.node_children
+    int child_count;
+} GltfNode;
+
+// glTF samplers use the GL enums. Filters are 0 where the file leaves them to the renderer.
+typedef struct {
+    GLenum min_filter;
+    GLenum mag_filter;
+    GLenum wrap_s;
+    GLenum wrap_t;
+} GltfSampler;
+
+typedef struct {
+    Vector4 base_color;
+    float metallic;
+    float roughness;
+    int base_color_image; // -1 without a base color texture
+    GltfSampler base_color_sampler;
+    int double_sided;
+    int blend; // alphaMode BLEND
+} GltfMaterial;
+
+typedef struct {
+    char path[GLTF_PATH_LENGTH]; // resolved against the .glb's directory, empty for embedded images
+    int buffer_view; // -1 unless embedded
+    unsigned char *data; // a copy of the buffer view's bytes, NULL unless stored in one
+    size_t size;
+} GltfImage;
+
+typedef struct {
+    void *mapping;
+    size_t mapping_size;
+
+    GltfBuffer *buffers;
+    int buffer_count;
+    GltfBufferView *buffer_views;
+    int buffer_view_count;
+    GltfAccessor *accessors;
+    int accessor_count;
+    GltfPrimitive *primitives;
+    int primitive_count;
+    GltfMesh *meshes;
+    int mesh_count;
+    GltfNode *nodes;
+    int node_count;
+    int *node_children;
+    GltfMaterial *materials;
+    int material_count;
+    GltfImage *images;
+    int image_count;
+    int *roots; // top level nodes of the default scene
+    int root_count;
+} Gltf;
+
+void *Gltf_allocate(int count, size_t size) {
+    void *data = calloc(count > 0 ? count : 1, size);
+    if (!data) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return data;
+}
+
+unsigned int Gltf_component_size(GLenum component_type) {
+    switch (component_type) {
+        case GL_BYTE: case GL_UNSIGNED_BYTE: return 1;
+        case GL_SHORT: case GL_UNSIGNED_SHORT: return 2;
+        case GL_UNSIGNED_INT: case GL_FLOAT: return 4;
+        default: return 0;
+    }
+}
+
+unsigned int Gltf_type_components(const Json *json, int token) {
+    static const char *names[] = { "SCALAR", "VEC2", "VEC3", "VEC4", "MAT2", "MAT3", "MAT4" };
+    static const unsigned int components[] = { 1, 2, 3, 4, 4, 9, 16 };
+    for (int i = 0; i < 7; i++) {
+        if (Json_string_equals(json, token, names[i])) return components[i];
+    }
+    return 0;
+}
+
+// Reads up to count numbers from a JSON array into values, keeping the defaults already there.
+void Gltf_read_floats(const Json *json, int array, GLfloat *values, int count) {
+    for (int i = 0; i < count && i < Json_size(json, array); i++) {
+        values[i] = (GLfloat)Json_number(json, Json_at(json, array, i), values[i]);
+    }
+}
+
+// Joins a uri onto the directory of base_path.
+int Gltf_resolve_path(char *path, const char *base_path, const Json *json, int uri) {
+    char relative[GLTF_PATH_LENGTH];
+    if (!Json_string_copy(json, uri, relative, sizeof(relative))) return 0;
+    const char *slash = strrchr(base_path, '/');
+    int directory_length = slash ? (int)(slash - base_path + 1) : 0;
+    return snprintf(path, GLTF_PATH_LENGTH, "%.*s%s", directory_length, base_path, relative) < GLTF_PATH_LENGTH;
+}
+
+int Gltf_map_buffer(GltfBuffer *buffer, const char *file_path) {
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open file %s\n", file_path);
+        return 0;
+    }
+    struct stat info;
+    void *mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Could not map file %s\n", file_path);
+        return 0;
+    }
+    buffer->mapping = mapping;
+    buffer->mapping_size = info.st_size;
+    buffer->data = mapping;
+    return 1;
+}
+
+void Gltf_release_buffers(Gltf *gltf) {
+    for (int i = 0; i < gltf->buffer_count; i++) {
+        if (gltf->buffers[i].mapping) munmap(gltf->buffers[i].mapping, gltf->buffers[i].mapping_size);
+        gltf->buffers[i].mapping = NULL;
+        gltf->buffers[i].data = NULL;
+    }
+    if (gltf->mapping) munmap(gltf->mapping, gltf->mapping_size);
+    gltf->mapping = NULL;
+}
+
+// Releases the mappings and the GL objects made by Gltf_upload.
+void Gltf_free(Gltf *gltf) {
+    Gltf_release_buffers(gltf);
+    for (int i = 0; i < gltf->buffer_count; i++) {
+        if (gltf->buffers[i].buffer) glDeleteBuffers(1, &gltf->buffers[i].buffer);
+    }
+    for (int i = 0; i < gltf->primitive_count; i++) {
+        if (gltf->primitives[i].vao) glDeleteVertexArrays(1, &gltf->primitives[i].vao);
+    }
+    free(gltf->buffers);
+    free(gltf->buffer_views);
+    free(gltf->accessors);
+    free(gltf->primitives);
+    free(gltf->meshes);
+    free(gltf->nodes);
+    free(gltf->node_children);
+    free(gltf->materials);
+    for (int i = 0; i < gltf->image_count; i++) free(gltf->images[i].data);
+    free(gltf->images);
+    free(gltf->roots);
+    memset(gltf, 0, sizeof(*gltf));
+}
+
+int Gltf_parse_buffers(Gltf *gltf, const Json *json, const char *file_path, const unsigned char *bin, size_t bin_size) {
+    int array = Json_find(json, 0, "buffers");
+    gltf->buffer_count = Json_size(json, array);
+    gltf->buffers = Gltf_allocate(gltf->buffer_count, sizeof(GltfBuffer));
+    for (int i = 0; i < gltf->buffer_count; i++) {
+        int object = Json_at(json, array, i);
+        GltfBuffer *buffer = &gltf->buffers[i];
+        double byte_length = Json_number(json, Json_find(json, object, "byteLength"), -1.0);
+        int uri = Json_find(json, object, "uri");
+        if (uri < 0) {
+            if (i != 0 || !bin) {
+                fprintf(stderr, "Buffer %d in %s has no data\n", i, file_path);
+                return 0;
+            }
+            buffer->data = bin;
+            buffer->size = bin_size;
+        } else {
+            char path[GLTF_PATH_LENGTH];
+            if (json->tokens[uri].end - json->tokens[uri].start >= 5 && memcmp(json->text + json->tokens[uri].start, "data:", 5) == 0) {
+                fprintf(stderr, "Embedded data URIs are not supported in %s\n", file_path);
+                return 0;
+            }
+            if (!Gltf_resolve_path(path, file_path, json, uri) || !Gltf_map_buffer(buffer, path)) return 0;
+            buffer->size = buffer->mapping_size;
+        }
+        if (byte_length < 0.0 || byte_length > (double)buffer->size) {
+            fprintf(stderr, "Buffer %d in %s is shorter than its byteLength\n", i, file_path);
+            return 0;
+        }
+        buffer->size = (size_t)byte_length;
+    }
+
+    array = Json_find(json, 0, "bufferViews");
+    gltf->buffer_view_count = Json_size(json, array);
+    gltf->buffer_views = Gltf_allocate(gltf->buffer_view_count, sizeof(GltfBufferView));
+    for (int i = 0; i < gltf->buffer_view_count; i++) {
+        int object = Json_at(json, array, i);
+        GltfBufferView *view = &gltf->buffer_views[i];
+        view->buffer = Json_int(json, Json_find(json, object, "buffer"), -1);
+        double byte_offset = Json_number(json, Json_find(json, object, "byteOffset"), 0.0);
+        double byte_length = Json_number(json, Json_find(json, object, "byteLength"), -1.0);
+        int byte_stride = Json_int(json, Json_find(json, object, "byteStride"), 0);
+        if (view->buffer < 0 || view->buffer >= gltf->buffer_count || byte_offset < 0.0 || byte_length < 0.0
+            || byte_offset + byte_length > (double)gltf->buffers[view->buffer].size || byte_stride < 0 || byte_stride > 252) {
+            fprintf(stderr, "Invalid buffer view %d in %s\n", i, file_path);
+            return 0;
+        }
+        view->byte_offset = (size_t)byte_offset;
+        view->byte_length = (size_t)byte_length;
+        view->byte_stride = (unsigned int)byte_stride;
+    }
+
+    array = Json_find(json, 0, "accessors");
+    gltf->accessor_count = Json_size(json, array);
+    gltf->accessors = Gltf_allocate(gltf->accessor_count, sizeof(GltfAccessor));
+    for (int i = 0; i < gltf->accessor_count; i++) {
+        int object = Json_at(json, array, i);
+        GltfAccessor *accessor = &gltf->accessors[i];
+        accessor->buffer_view = Json_int(json, Json_find(json, object, "bufferView"), -1);
+        accessor->component_type = (GLenum)Json_int(json, Json_find(json, object, "componentType"), 0);
+        accessor->normalized = Json_bool(json, Json_find(json, object, "normalized"), 0) ? GL_TRUE : GL_FALSE;
+        accessor->components = Gltf_type_components(json, Json_find(json, object, "type"));
+        double byte_offset = Json_number(json, Json_find(json, object, "byteOffset"), 0.0);
+        double count = Json_number(json, Json_find(json, object, "count"), -1.0);
+        unsigned int component_size = Gltf_component_size(accessor->component_type);
+        if (component_size == 0 || accessor->components == 0 || count < 1.0 || count > 4294967295.0 || byte_offset < 0.0
+            || Json_find(json, object, "sparse") >= 0 || accessor->buffer_view >= gltf->buffer_view_count) {
+            fprintf(stderr, "Invalid or unsupported accessor %d in %s\n", i, file_path);
+            return 0;
+        }
+        accessor->byte_offset = (size_t)byte_offset;
+        accessor->count = (unsigned int)count;
+        Gltf_read_floats(json, Json_find(json, object, "min"), accessor->min, 3);
+        Gltf_read_floats(json, Json_find(json, object, "max"), accessor->max, 3);
+        if (accessor->buffer_view < 0) continue; // all zeros, treated as absent
+
+        // Every element must lie inside the view, and GL needs components aligned to their size.
+        const GltfBufferView *view = &gltf->buffer_views[accessor->buffer_view];
+        size_t element_size = (size_t)component_size * accessor->components;
+        size_t stride = view->byte_stride ? view->byte_stride : element_size;
+        double end = byte_offset + (count - 1.0) * (double)stride + (double)element_size;
+        if (end > (double)view->byte_length || (view->byte_offset + accessor->byte_offset) % component_size != 0 || stride % component_size != 0) {
+            fprintf(stderr, "Accessor %d in %s does not fit its buffer view\n", i, file_path);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int Gltf_parse_meshes(Gltf *gltf, const Json *json, const char *file_path) {
+    int array = Json_find(json, 0, "meshes");
+    gltf->mesh_count = Json_size(json, array);
+    gltf->meshes = Gltf_allocate(gltf->mesh_count, sizeof(GltfMesh));
+    for (int i = 0; i < gltf->mesh_count; i++) {
+        gltf->meshes[i].first_primitive = gltf->primitive_count;
+        gltf->meshes[i].primitive_count = Json_size(json, Json_find(json, Json_at(json, array, i), "primitives"));
+        gltf->primitive_count += gltf->meshes[i].primitive_count;
+    }
+
+    gltf->primitives = Gltf_allocate(gltf->primitive_count, sizeof(GltfPrimitive));
+    for (int i = 0; i < gltf->mesh_count; i++) {
+        int primitives = Json_find(json, Json_at(json, array, i), "primitives");
+        for (int p = 0; p < gltf->meshes[i].primitive_count; p++) {
+            int object = Json_at(json, primitives, p);
+            GltfPrimitive *primitive = &gltf->primitives[gltf->meshes[i].first_primitive + p];
+            int attributes = Json_find(json, object, "attributes");
+            unsigned int vertex_count = 0;
+            for (int a = 0; a < GLTF_ATTRIBUTE_COUNT; a++) {
+                int accessor = Json_int(json, Json_find(json, attributes, gltf_attribute_names[a]), -1);
+                if (accessor >= gltf->accessor_count) {
+                    fprintf(stderr, "Invalid attribute accessor in mesh %d of %s\n", i, file_path);
+                    return 0;
+                }
+                if (accessor >= 0 && gltf->accessors[accessor].buffer_view < 0) accessor = -1;
+                if (accessor >= 0 && (vertex_count == 0 || gltf->accessors[accessor].count < vertex_count)) vertex_count = gltf->accessors[accessor].count;
+                primitive->attributes[a] = accessor;
+            }
+            primitive->indices = Json_int(json, Json_find(json, object, "indices"), -1);
+            primitive->material = Json_int(json, Json_find(json, object, "material"), -1);
+            primitive->mode = (GLenum)Json_int(json, Json_find(json, object, "mode"), GL_TRIANGLES);
+            if (primitive->material >= gltf->material_count || primitive->mode > GL_TRIANGLE_FAN) {
+                fprintf(stderr, "Invalid primitive in mesh %d of %s\n", i, file_path);
+                return 0;
+            }
+            if (primitive->indices < 0) continue;
+
+            // Indices are checked once against the shortest attribute so a bad file cannot make GL read past a buffer.
+            const GltfAccessor *indices = primitive->indices < gltf->accessor_count ? &gltf->accessors[primitive->indices] : NULL;
+            if (!indices || indices->buffer_view < 0 || indices->components != 1 || indices->normalized
+                || (indices->component_type != GL_UNSIGNED_BYTE && indices->component_type != GL_UNSIGNED_SHORT && indices->component_type != GL_UNSIGNED_INT)
+                || gltf->buffer_views[indices->buffer_view].byte_stride != 0) {
+                fprintf(stderr, "Invalid index accessor in mesh %d of %s\n", i, file_path);
+                return 0;
+            }
+            const GltfBufferView *view = &gltf->buffer_views[indices->buffer_view];
+            const unsigned char *data = gltf->buffers[view->buffer].data + view->byte_offset + indices->byte_offset;
+            uint32_t max_index = 0;
+            for (unsigned int k = 0; k < indices->count; k++) {
+                uint32_t index;
+                switch (indices->component_type) {
+                    case GL_UNSIGNED_BYTE: index = data[k]; break;
+                    case GL_UNSIGNED_SHORT: index = ((const uint16_t *)data)[k]; break;
+                    default: index = ((const uint32_t *)data)[k]; break;
+                }
+                if (index > max_index) max_index = index;
+            }
+            if (max_index >= vertex_count && primitive->attributes[GLTF_ATTRIBUTE_POSITION] >= 0) {
+                fprintf(stderr, "Index out of range in mesh %d of %s\n", i, file_path);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+int Gltf_parse_materials(Gltf *gltf, const Json *json, const char *file_path) {
+    int array = Json_find(json, 0, "images");
+    gltf->image_count = Json_size(json, array);
+    gltf->images = Gltf_allocate(gltf->image_count, sizeof(GltfImage));
+    for (int i = 0; i < gltf->image_count; i++) {
+        int object = Json_at(json, array, i);
+        GltfImage *image = &gltf->images[i];
+        image->buffer_view = Json_int(json, Json_find(json, object, "bufferView"), -1);
+        int uri = Json_find(json, object, "uri");
+        int embedded = uri >= 0 && json->tokens[uri].end - json->tokens[uri].start >= 5 && memcmp(json->text + json->tokens[uri].start, "data:", 5) == 0;
+        if (uri >= 0 && !embedded && !Gltf_resolve_path(image->path, file_path, json, uri)) image->path[0] = '\0';
+        if (uri < 0 && image->buffer_view >= 0 && image->buffer_view < gltf->buffer_view_count) {
+            const GltfBufferView *view = &gltf->buffer_views[image->buffer_view];
+            image->size = view->byte_length;
+            image->data = Gltf_allocate(1, image->size);
+            memcpy(image->data, gltf->buffers[view->buffer].data + view->byte_offset, image->size);
+        }
+    }
+
+    int textures = Json_find(json, 0, "textures");
+    int samplers = Json_find(json, 0, "samplers");
+    array = Json_find(json, 0, "materials");
+    gltf->material_count = Json_size(json, array);
+    gltf->materials = Gltf_allocate(gltf->material_count, sizeof(GltfMaterial));
+    for (int i = 0; i < gltf->material_count; i++) {
+        int object = Json_at(json, array, i);
+        GltfMaterial *material = &gltf->materials[i];
+        int pbr = Json_find(json, object, "pbrMetallicRoughness");
+        for (int c = 0; c < 4; c++) material->base_color[c] = 1.0f;
+        Gltf_read_floats(json, Json_find(json, pbr, "baseColorFactor"), material->base_color, 4);
+        material->metallic = (float)Json_number(json, Json_find(json, pbr, "metallicFactor"), 1.0);
+        material->roughness = (float)Json_number(json, Json_find(json, pbr, "roughnessFactor"), 1.0);
+        material->double_sided = Json_bool(json, Json_find(json, object, "doubleSided"), 0);
+        material->blend = Json_string_equals(json, Json_find(json, object, "alphaMode"), "BLEND");
+        int texture = Json_at(json, textures, Json_int(json, Json_find(json, Json_find(json, pbr, "baseColorTexture"), "index"), -1));
+        material->base_color_image = Json_int(json, Json_find(json, texture, "source"), -1);
+        if (material->base_color_image >= gltf->image_count) material->base_color_image = -1;
+        int sampler = Json_at(json, samplers, Json_int(json, Json_find(json, texture, "sampler"), -1));
+        material->base_color_sampler = (GltfSampler){ (GLenum)Json_int(json, Json_find(json, sampler, "minFilter"), 0),
+            (GLenum)Json_int(json, Json_find(json, sampler, "magFilter"), 0), (GLenum)Json_int(json, Json_find(json, sampler, "wrapS"), GL_REPEAT),
+            (GLenum)Json_int(json, Json_find(json, sampler, "wrapT"), GL_REPEAT) };
+    }
+    return 1;
+}
+
+int Gltf_parse_nodes(Gltf *gltf, const Json *json, const char *file_path) {
+    int array = Json_find(json, 0, "nodes");
+    gltf->node_count = Json_size(json, array);
+    gltf->nodes = Gltf_allocate(gltf->node_count, sizeof(GltfNode));
+    int child_count = 0;
+    for (int i = 0; i < gltf->node_count; i++) child_count += Json_size(json, Json_find(json, Json_at(json, array, i), "children"));
+    gltf->node_children = Gltf_allocate(child_count, sizeof(int));
+
+    // Every node may have one parent at most, which together with parentless roots rules out cycles.
+    unsigned char *has_parent = Gltf_allocate(gltf->node_count, 1);
+    int success = 1;
+    child_count = 0;
+    for (int i = 0; i < gltf->node_count && success; i++) {
+        int object = Json_at(json, array, i);
+        GltfNode *node = &gltf->nodes[i];
+        node->mesh = Json_int(json, Json_find(json, object, "mesh"), -1);
+        if (node->mesh >= gltf->mesh_count) success = 0;
+
+        int matrix = Json_find(json, object, "matrix");
+        if (matrix >= 0) {
+            Matrix4_identity(node->local);
+            Gltf_read_floats(json, matrix, (GLfloat *)node->local, 16);
+        } else {
+            Vector3 translation = { 0.0f, 0.0f, 0.0f };
+            Vector4 rotation = { 0.0f, 0.0f, 0.0f, 1.0f };
+            Vector3 scale = { 1.0f, 1.0f, 1.0f };
+            Gltf_read_floats(json, Json_find(json, object, "translation"), translation, 3);
+            Gltf_read_floats(json, Json_find(json, object, "rotation"), rotation, 4);
+            Gltf_read_floats(json, Json_find(json, object, "scale"), scale, 3);
+            Matrix4_compose(node->local, translation, rotation, scale);
+        }
+
+        int children = Json_find(json, object, "children");
+        node->first_child = child_count;
+        node->child_count = Json_size(json, children);
+        for (int c = 0; c < node->child_count && success; c++) {
+            int child = Json_int(json, Json_at(json, children, c), -1);
+            if (child < 0 || child >= gltf->node_count || child == i || has_parent[child]) success = 0;
+            else has_parent[child] = 1;
+            gltf->node_children[child_count++] = child;
+        }
+    }
+
+    int scenes = Json_find(json, 0, "scenes");
+    int scene = Json_at(json, scenes, Json_int(json, Json_find(json, 0, "scene"), 0));
+    int scene_nodes = Json_find(json, scene, "nodes");
+    if (success && scene_nodes >= 0) {
+        gltf->root_count = Json_size(json, scene_nodes);
+        gltf->roots = Gltf_allocate(gltf->root_count, sizeof(int));
+        for (int i = 0; i < gltf->root_count && success; i++) {
+            gltf->roots[i] = Json_int(json, Json_at(json, scene_nodes, i), -1);
+            if (gltf->roots[i] < 0 || gltf->roots[i] >= gltf->node_count || has_parent[gltf->roots[i]]) success = 0;
+        }
+    } else if (success) {
+        // Without a scene every parentless node is drawn.
+        gltf->roots = Gltf_allocate(gltf->node_count, sizeof(int));
+        for (int i = 0; i < gltf->node_count; i++) {
+            if (!has_parent[i]) gltf->roots[gltf->root_count++] = i;
+        }
+    }
+    free(has_parent);
+    if (!success) fprintf(stderr, "Invalid node hierarchy in %s\n", file_path);
+    return success;
+}
+
+// Parses a .glb already in memory; contents must stay valid until Gltf_upload or Gltf_free.
+int Gltf_parse(Gltf *gltf, const char *file_path, const unsigned char *contents, size_t size) {
+    if (size < 20 || TextureImage_read_u32(contents) != GLB_MAGIC || TextureImage_read_u32(contents + 4) != 2
+        || TextureImage_read_u32(contents + 8) > size) {
+        fprintf(stderr, "%s is not a glTF 2.0 binary\n", file_path);
+        return 0;
+    }
+    size = TextureImage_read_u32(contents + 8);
+
+    const unsigned char *json_chunk = NULL, *bin = NULL;
+    size_t json_size = 0, bin_size = 0;
+    for (size_t offset = 12; offset + 8 <= size;) {
+        uint32_t chunk_size = TextureImage_read_u32(contents + offset);
+        uint32_t chunk_type = TextureImage_read_u32(contents + offset + 4);
+        if (chunk_size > size - offset - 8) break;
+        if (chunk_type == GLB_CHUNK_JSON && !json_chunk) {
+            json_chunk = contents + offset + 8;
+            json_size = chunk_size;
+        } else if (chunk_type == GLB_CHUNK_BIN && !bin && json_chunk) {
+            bin = contents + offset + 8;
+            bin_size = chunk_size;
+        }
+        offset += 8 + (size_t)chunk_size;
+    }
+
+    Json json;
+    if (!json_chunk || !Json_parse(&json, (const char *)json_chunk, json_size) || json.tokens[0].type != JSON_OBJECT) {
+        if (json_chunk) Json_free(&json);
+        fprintf(stderr, "Could not parse the JSON chunk of %s\n", file_path);
+        return 0;
+    }
+    if (Json_size(&json, Json_find(&json, 0, "extensionsRequired")) > 0) {
+        fprintf(stderr, "%s requires unsupported extensions\n", file_path);
+        Json_free(&json);
+        return 0;
+    }
+
+    int success = Gltf_parse_buffers(gltf, &json, file_path, bin, bin_size)
+        && Gltf_parse_materials(gltf, &json, file_path)
+        && Gltf_parse_meshes(gltf, &json, file_path)
+        && Gltf_parse_nodes(gltf, &json, file_path);
+    Json_free(&json);
+    return success;
+}
+
+int Gltf_load(Gltf *gltf, const char *file_path) {
+    memset(gltf, 0, sizeof(*gltf));
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open file %s\n", file_path);
+        return 0;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        fprintf(stderr, "Could not read file %s\n", file_path);
+        close(fd);
+        return 0;
+    }
+    void *contents = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (contents == MAP_FAILED) {
+        fprintf(stderr, "Could not map file %s\n", file_path);
+        return 0;
+    }
+    gltf->mapping = contents;
+    gltf->mapping_size = info.st_size;
+    if (!Gltf_parse(gltf, file_path, contents, info.st_size)) {
+        Gltf_free(gltf);
+        return 0;
+    }
+    return 1;
+}
+
+// Uploads every referenced buffer once, directly from the mappings, then unmaps them.
+void Gltf_upload(Gltf *gltf) {
+    for (int i = 0; i < gltf->buffer_view_count; i++) {
+        GltfBuffer *buffer = &gltf->buffers[gltf->buffer_views[i].buffer];
+        if (buffer->buffer) continue;
+        glGenBuffers(1, &buffer->buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer->buffer);
+        glBufferData(GL_ARRAY_BUFFER, buffer->size, buffer->data, GL_STATIC_DRAW);
+    }
+
+    for (int i = 0; i < gltf->primitive_count; i++) {
+        GltfPrimitive *primitive = &gltf->primitives[i];
+        if (primitive->attributes[GLTF_ATTRIBUTE_POSITION] < 0) continue;
+        glGenVertexArrays(1, &primitive->vao);
+        glBindVertexArray(primitive->vao);
+        for (int a = 0; a < GLTF_ATTRIBUTE_COUNT; a++) {
+            if (primitive->attributes[a] < 0) continue;
+            const GltfAccessor *accessor = &gltf->accessors[primitive->attributes[a]];
+            const GltfBufferView *view = &gltf->buffer_views[accessor->buffer_view];
+            glBindBuffer(GL_ARRAY_BUFFER, gltf->buffers[view->buffer].buffer);
+            glEnableVertexAttribArray(a);
+            glVertexAttribPointer(a, (GLint)accessor->components, accessor->component_type, accessor->normalized,
+                (GLsizei)view->byte_stride, (void *)(uintptr_t)(view->byte_offset + accessor->byte_offset));
+        }
+        if (primitive->indices >= 0) {
+            const GltfBufferView *view = &gltf->buffer_views[gltf->accessors[primitive->indices].buffer_view];
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gltf->buffers[view->buffer].buffer);
+        }
+        glBindVertexArray(0);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    Gltf_release_buffers(gltf);
+}
+
+float Gltf_determinant(Matrix4 m) {
+    return m[0][0] * (m[1][1] * m[2][2] - m[2][1] * m[1][2])
+        - m[1][0] * (m[0][1] * m[2][2] - m[2][1] * m[0][2])
+        + m[2][0] * (m[0][1] * m[1][2] - m[1][1] * m[0][2]);
+}
+
+typedef struct {
+    const Gltf *gltf;
+    RenderQueue *queue;
+    unsigned int pass;
+    GLuint program;
+    const GLfloat *camera_position;
+    int root_mirrored;
+} GltfQueueState;
+
+void Gltf_queue_node(GltfQueueState *state, int node_index, Matrix4 parent) {
+    const Gltf *gltf = state->gltf;
+    const GltfNode *node = &gltf->nodes[node_index];
+    Matrix4 world;
+    Matrix4_multiply(world, (Vector4 *)node->local, parent);
+
+    if (node->mesh >= 0) {
+        // Mirroring transforms flip the winding; the root transform's own mirroring is expected by the caller.
+        int clockwise = (Gltf_determinant(world) < 0.0f) != state->root_mirrored;
+        const GltfMesh *mesh = &gltf->meshes[node->mesh];
+        for (int i = 0; i < mesh->primitive_count; i++) {
+            const GltfPrimitive *primitive = &gltf->primitives[mesh->first_primitive + i];
+            if (!primitive->vao) continue;
+            const GltfMaterial *material = primitive->material >= 0 ? &gltf->materials[primitive->material] : NULL;
+            const GltfAccessor *positions = &gltf->accessors[primitive->attributes[GLTF_ATTRIBUTE_POSITION]];
+
+            // Ordered by the distance to the center of the primitive's bounds.
+            Vector3 center, to_center;
+            for (int c = 0; c < 3; c++) center[c] = 0.5f * (positions->min[c] + positions->max[c]);
+            for (int c = 0; c < 3; c++) {
+                to_center[c] = world[0][c] * center[0] + world[1][c] * center[1] + world[2][c] * center[2] + world[3][c] - state->camera_position[c];
+            }
+            RenderItem *item = RenderQueue_push(state->queue, state->pass, state->program, primitive->material, material && material->blend,
+                sqrtf(Vector3_dot(to_center, to_center)));
+            item->vao = primitive->vao;
+            item->mode = primitive->mode;
+            item->double_sided = (unsigned char)(material && material->double_sided);
+            item->clockwise = (unsigned char)clockwise;
+            memcpy(item->model, world, sizeof(Matrix4));
+            if (primitive->indices >= 0) {
+                const GltfAccessor *indices = &gltf->accessors[primitive->indices];
+                item->index_type = indices->component_type;
+                item->count = (GLsizei)indices->count;
+                item->offset = gltf->buffer_views[indices->buffer_view].byte_offset + indices->byte_offset;
+            } else {
+                item->count = (GLsizei)positions->count;
+            }
+        }
+    }
+
+    for (int i = 0; i < node->child_count; i++) Gltf_queue_node(state, gltf->node_children[node->first_child + i], world);
+}
+
+// Adds a draw with program for every primitive of the default scene. program takes the node
+// transform as uModel; Gltf_bind_material sets the material's base color factor as uBaseColor.
+void Gltf_queue(const Gltf *gltf, RenderQueue *queue, unsigned int pass, GLuint program, Matrix4 transform, const Vector3 camera_position) {
+    GltfQueueState state = { gltf, queue, pass, program, camera_position, Gltf_determinant(transform) < 0.0f };
+    for (int i = 0; i < gltf->root_count; i++) Gltf_queue_node(&state, gltf->roots[i], transform);
+    // Absent attributes read the current generic value, which is not part of the vertex array state.
+    glVertexAttrib2f(GLTF_ATTRIBUTE_TEXCOORD_0, 0.0f, 0.0f);
+    glVertexAttrib3f(GLTF_ATTRIBUTE_NORMAL, 0.0f, 0.0f, 1.0f);
+}
+
+void Gltf_bind_material(const Gltf *gltf, GLuint program, int material) {
+    static const Vector4 white = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glUniform4fv(glGetUniformLocation(program, "uBaseColor"), 1, material >= 0 ? gltf->materials[material].base_color : white);
+}
+
+#endif
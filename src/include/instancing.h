@@ -0,0 +1,86 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include "glad/glad.h"
+#include "linalg.h"
+#include "stream_buffer.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Draws many copies of a mesh with one glDrawElementsInstanced instead of a uniform upload and a
+// draw per copy. Each copy's transform and tint are written into the stream buffer
+// every frame and read by the vertex shader through attributes with a divisor of 1. Draws without that
+// buffer enabled see the generic attribute values from Instances_set_defaults: identity and white.
+
+#define INSTANCE_ROW_LOCATION 4 // three consecutive locations, one per transform row
+#define INSTANCE_COLOR_LOCATION 7
+#define INSTANCE_ALIGNMENT 16
+
+typedef struct {
+    GLfloat rows[3][4]; // top three rows of the object to world transform; the fourth is always 0 0 0 1
+    GLubyte color[4];   // multiplies uBaseColor
+} Instance;
+
+// Rewritten whole every time it is mapped, into fresh room in the stream buffer, so nothing waits
+// for draws still reading the previous contents.
+typedef struct {
+    StreamBuffer *stream;
+    GLintptr offset; // of the instances in stream->buffer
+    unsigned int count;
+    Instance *mapped;
+} InstanceBuffer;
+
+void Instance_set(Instance *instance, Matrix4 transform, const GLubyte color[4]) {
+    for (int row = 0; row < 3; row++) {
+        for (int col = 0; col < 4; col++) instance->rows[row][col] = transform[col][row];
+    }
+    for (int c = 0; c < 4; c++) instance->color[c] = color[c];
+}
+
+// What non-instanced draws read: generic attribute values are context state, so setting them once is enough.
+void Instances_set_defaults(void) {
+    glVertexAttrib4f(INSTANCE_ROW_LOCATION + 0, 1.0f, 0.0f, 0.0f, 0.0f);
+    glVertexAttrib4f(INSTANCE_ROW_LOCATION + 1, 0.0f, 1.0f, 0.0f, 0.0f);
+    glVertexAttrib4f(INSTANCE_ROW_LOCATION + 2, 0.0f, 0.0f, 1.0f, 0.0f);
+    glVertexAttrib4f(INSTANCE_COLOR_LOCATION, 1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+void InstanceBuffer_init(InstanceBuffer *instances, StreamBuffer *stream) {
+    instances->stream = stream;
+    instances->offset = 0;
+    instances->count = 0;
+    instances->mapped = NULL;
+}
+
+// Room for count instances, to be written before InstanceBuffer_unmap and applied after it.
+Instance *InstanceBuffer_map(InstanceBuffer *instances, unsigned int count) {
+    instances->count = count;
+    if (count == 0) return NULL;
+    instances->mapped = StreamBuffer_map(instances->stream, (GLsizeiptr)count * sizeof(Instance), INSTANCE_ALIGNMENT, &instances->offset);
+    return instances->mapped;
+}
+
+void InstanceBuffer_unmap(InstanceBuffer *instances) {
+    if (!instances->mapped) return;
+    // Nothing is drawn until the next upload if the contents were lost.
+    if (!StreamBuffer_unmap(instances->stream)) instances->count = 0;
+    instances->mapped = NULL;
+}
+
+// Points the bound vertex array's instance attributes at the instances, starting at instance first.
+// Every map moves them, and GL 4.1 has no base instance, so this follows each map and each batch.
+void InstanceBuffer_apply(const InstanceBuffer *instances, unsigned int first) {
+    glBindBuffer(GL_ARRAY_BUFFER, instances->stream->buffer);
+    GLintptr base = instances->offset + (GLintptr)first * sizeof(Instance);
+    for (int row = 0; row < 3; row++) {
+        glEnableVertexAttribArray(INSTANCE_ROW_LOCATION + row);
+        glVertexAttribPointer(INSTANCE_ROW_LOCATION + row, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (const void *)(base + offsetof(Instance, rows) + row * sizeof(GLfloat[4])));
+        glVertexAttribDivisor(INSTANCE_ROW_LOCATION + row, 1);
+    }
+    glEnableVertexAttribArray(INSTANCE_COLOR_LOCATION);
+    glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance), (const void *)(base + offsetof(Instance, color)));
+    glVertexAttribDivisor(INSTANCE_COLOR_LOCATION, 1);
+}
+
+#endif
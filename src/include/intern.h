@@ -0,0 +1,88 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Interned strings: equal strings share one pointer, so keys built from them compare with ==.
+// Interned strings live until the table is destroyed.
+
+typedef struct {
+    char **slots;
+    unsigned int capacity; // power of two
+    unsigned int count;
+} StringTable;
+
+uint32_t StringTable_hash(const char *string) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)string; *c; c++) {
+        hash = (hash ^ *c) * 16777619u;
+    }
+    return hash;
+}
+
+void StringTable_init(StringTable *table) {
+    table->capacity = 64;
+    table->count = 0;
+    table->slots = calloc(table->capacity, sizeof(char *));
+    if (!table->slots) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+}
+
+char **StringTable_slot(char **slots, unsigned int capacity, const char *string) {
+    unsigned int i = StringTable_hash(string) & (capacity - 1);
+    while (slots[i] && strcmp(slots[i], string) != 0) i = (i + 1) & (capacity - 1);
+    return &slots[i];
+}
+
+void StringTable_grow(StringTable *table) {
+    unsigned int capacity = table->capacity * 2;
+    char **slots = calloc(capacity, sizeof(char *));
+    if (!slots) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (unsigned int i = 0; i < table->capacity; i++) {
+        if (table->slots[i]) *StringTable_slot(slots, capacity, table->slots[i]) = table->slots[i];
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
+}
+
+// The shared copy of string, or NULL if it was never interned.
+const char *StringTable_find(const StringTable *table, const char *string) {
+    return *StringTable_slot(table->slots, table->capacity, string);
+}
+
+const char *StringTable_intern(StringTable *table, const char *string) {
+    char **slot = StringTable_slot(table->slots, table->capacity, string);
+    if (*slot) return *slot;
+
+    if ((table->count + 1) * 4 > table->capacity * 3) {
+        StringTable_grow(table);
+        slot = StringTable_slot(table->slots, table->capacity, string);
+    }
+    *slot = malloc(strlen(string) + 1);
+    if (!*slot) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    strcpy(*slot, string);
+    table->count++;
+    return *slot;
+}
+
+void StringTable_destroy(StringTable *table) {
+    for (unsigned int i = 0; i < table->capacity; i++) free(table->slots[i]);
+    free(table->slots);
+    table->slots = NULL;
+    table->capacity = 0;
+    table->count = 0;
+}
+
+#endif
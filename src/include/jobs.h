@@ -0,0 +1,218 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_cpuinfo.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_thread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef void (*JobFunction)(void *data);
+typedef void (*JobRangeFunction)(void *data, int begin, int end);
+
+typedef struct {
+    JobFunction function;
+    void *data;
+    SDL_atomic_t *counter; // decremented once the job has run, may be NULL
+} Job;
+
+typedef struct {
+    SDL_Thread **threads;
+    int thread_count;
+
+    Job *queue;
+    int queue_capacity;
+    int queue_head;
+    int queue_count;
+
+    SDL_mutex *mutex;
+    SDL_cond *has_work;
+    SDL_cond *job_done;
+    int running;
+} JobSystem;
+
+typedef struct {
+    JobRangeFunction function;
+    void *data;
+    int begin;
+    int end;
+} JobRange;
+
+int JobSystem_pop(JobSystem *jobs, Job *job) {
+    if (jobs->queue_count == 0) return 0;
+    *job = jobs->queue[jobs->queue_head];
+    jobs->queue_head = (jobs->queue_head + 1) % jobs->queue_capacity;
+    jobs->queue_count--;
+    return 1;
+}
+
+void JobSystem_finish(JobSystem *jobs, Job *job) {
+    if (!job->counter) return;
+    SDL_AtomicAdd(job->counter, -1);
+    SDL_LockMutex(jobs->mutex);
+    SDL_CondBroadcast(jobs->job_done);
+    SDL_UnlockMutex(jobs->mutex);
+}
+
+int JobSystem_worker(void *data) {
+    JobSystem *jobs = data;
+    Job job;
+    SDL_LockMutex(jobs->mutex);
+    while (1) {
+        while (jobs->running && jobs->queue_count == 0) {
+            SDL_CondWait(jobs->has_work, jobs->mutex);
+        }
+        if (!JobSystem_pop(jobs, &job)) break; // only reached once stopped and drained
+        SDL_UnlockMutex(jobs->mutex);
+
+        job.function(job.data);
+        JobSystem_finish(jobs, &job);
+
+        SDL_LockMutex(jobs->mutex);
+    }
+    SDL_UnlockMutex(jobs->mutex);
+    return 0;
+}
+
+// thread_count < 0 picks one worker per extra CPU core; 0 runs every job on the waiting thread.
+void JobSystem_init(JobSystem *jobs, int thread_count) {
+    if (thread_count < 0) {
+        thread_count = SDL_GetCPUCount() - 1;
+        if (thread_count < 0) thread_count = 0;
+    }
+
+    jobs->queue_capacity = 64;
+    jobs->queue = malloc(jobs->queue_capacity * sizeof(Job));
+    if (!jobs->queue) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    jobs->queue_head = 0;
+    jobs->queue_count = 0;
+
+    jobs->mutex = SDL_CreateMutex();
+    jobs->has_work = SDL_CreateCond();
+    jobs->job_done = SDL_CreateCond();
+    jobs->running = 1;
+
+    jobs->thread_count = thread_count;
+    jobs->threads = thread_count > 0 ? malloc(thread_count * sizeof(SDL_Thread *)) : NULL;
+    for (int i = 0; i < thread_count; i++) {
+        jobs->threads[i] = SDL_CreateThread(JobSystem_worker, "job worker", jobs);
+    }
+}
+
+void JobSystem_destroy(JobSystem *jobs) {
+    SDL_LockMutex(jobs->mutex);
+    jobs->running = 0;
+    SDL_CondBroadcast(jobs->has_work);
+    SDL_UnlockMutex(jobs->mutex);
+
+    for (int i = 0; i < jobs->thread_count; i++) {
+        SDL_WaitThread(jobs->threads[i], NULL);
+    }
+    free(jobs->threads);
+
+    // Without workers, anything still queued runs here so its counter is released.
+    Job job;
+    while (JobSystem_pop(jobs, &job)) {
+        job.function(job.data);
+        if (job.counter) SDL_AtomicAdd(job.counter, -1);
+    }
+
+    SDL_DestroyCond(jobs->job_done);
+    SDL_DestroyCond(jobs->has_work);
+    SDL_DestroyMutex(jobs->mutex);
+    free(jobs->queue);
+}
+
+// The counter is incremented here and decremented once the job has run.
+void JobSystem_submit(JobSystem *jobs, JobFunction function, void *data, SDL_atomic_t *counter) {
+    if (counter) SDL_AtomicAdd(counter, 1);
+
+    SDL_LockMutex(jobs->mutex);
+    if (jobs->queue_count == jobs->queue_capacity) {
+        int capacity = jobs->queue_capacity * 2;
+        Job *queue = malloc(capacity * sizeof(Job));
+        if (!queue) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        for (int i = 0; i < jobs->queue_count; i++) {
+            queue[i] = jobs->queue[(jobs->queue_head + i) % jobs->queue_capacity];
+        }
+        free(jobs->queue);
+        jobs->queue = queue;
+        jobs->queue_capacity = capacity;
+        jobs->queue_head = 0;
+    }
+    Job *job = &jobs->queue[(jobs->queue_head + jobs->queue_count) % jobs->queue_capacity];
+    job->function = function;
+    job->data = data;
+    job->counter = counter;
+    jobs->queue_count++;
+    SDL_CondSignal(jobs->has_work);
+    SDL_UnlockMutex(jobs->mutex);
+}
+
+// Runs queued jobs on the calling thread until the counter drops to zero.
+void JobSystem_wait(JobSystem *jobs, SDL_atomic_t *counter) {
+    Job job;
+    SDL_LockMutex(jobs->mutex);
+    while (SDL_AtomicGet(counter) > 0) {
+        if (JobSystem_pop(jobs, &job)) {
+            SDL_UnlockMutex(jobs->mutex);
+            job.function(job.data);
+            JobSystem_finish(jobs, &job);
+            SDL_LockMutex(jobs->mutex);
+        } else {
+            SDL_CondWait(jobs->job_done, jobs->mutex);
+        }
+    }
+    SDL_UnlockMutex(jobs->mutex);
+}
+
+void JobSystem_run_range(void *data) {
+    JobRange *range = data;
+    range->function(range->data, range->begin, range->end);
+}
+
+// Splits [0, count) into batches of at most batch_size items and blocks until all have run.
+void JobSystem_parallel_for(JobSystem *jobs, int count, int batch_size, JobRangeFunction function, void *data) {
+    if (count <= 0) return;
+    if (batch_size < 1) batch_size = 1;
+
+    int batch_count = (count + batch_size - 1) / batch_size;
+    if (!jobs || batch_count == 1) {
+        function(data, 0, count);
+        return;
+    }
+
+    JobRange *ranges = malloc(batch_count * sizeof(JobRange));
+    if (!ranges) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    SDL_atomic_t counter;
+    SDL_AtomicSet(&counter, 0);
+    for (int i = 0; i < batch_count; i++) {
+        ranges[i].function = function;
+        ranges[i].data = data;
+        ranges[i].begin = i * batch_size;
+        ranges[i].end = (i + 1) * batch_size < count ? (i + 1) * batch_size : count;
+        JobSystem_submit(jobs, JobSystem_run_range, &ranges[i], &counter);
+    }
+    JobSystem_wait(jobs, &counter);
+
+    free(ranges);
+}
+
+// Runs [0, count) one item per job; the signature matches stbi_set_parallel_for.
+void JobSystem_run_tasks(void *jobs, int count, JobRangeFunction function, void *data) {
+    JobSystem_parallel_for(jobs, count, 1, function, data);
+}
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Tokenizes a JSON document into one flat array without copying any text: every value is a token
+// pointing into the source, containers are followed by their children, and each token knows where
+// its subtree ends so siblings can be walked without recursion. Object children alternate key, value.
+
+#define JSON_MAX_DEPTH 64
+
+typedef enum {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING, // start and end exclude the quotes, escapes are left in place
+    JSON_ARRAY,
+    JSON_OBJECT,
+} JsonType;
+
+typedef struct {
+    JsonType type;
+    int start, end; // byte range in the source
+    int size;       // elements of an array, key/value pairs of an object
+    int next;       // token after this one's subtree
+} JsonToken;
+
+typedef struct {
+    const char *text;
+    size_t length;
+    JsonToken *tokens;
+    int token_count;
+    int token_capacity;
+} Json;
+
+int Json_push(Json *json, JsonType type, int start) {
+    if (json->token_count == json->token_capacity) {
+        json->token_capacity = json->token_capacity ? json->token_capacity * 2 : 256;
+        json->tokens = realloc(json->tokens, json->token_capacity * sizeof(JsonToken));
+        if (!json->tokens) {
+            fprintf(stderr, "Memory reallocation failed\n");
+            exit(1);
+        }
+    }
+    JsonToken *token = &json->tokens[json->token_count];
+    token->type = type;
+    token->start = token->end = start;
+    token->size = 0;
+    token->next = json->token_count + 1;
+    return json->token_count++;
+}
+
+size_t Json_skip_spaces(const Json *json, size_t p) {
+    while (p < json->length && (json->text[p] == ' ' || json->text[p] == '\t' || json->text[p] == '\n' || json->text[p] == '\r')) p++;
+    return p;
+}
+
+// Parses the value at *p and everything inside it; returns 0 on malformed input.
+int Json_parse_value(Json *json, size_t *p, int depth) {
+    const char *text = json->text;
+    size_t i = Json_skip_spaces(json, *p);
+    if (i >= json->length || depth > JSON_MAX_DEPTH) return 0;
+
+    char c = text[i];
+    if (c == '{' || c == '[') {
+        int token = Json_push(json, c == '{' ? JSON_OBJECT : JSON_ARRAY, (int)i);
+        char close = c == '{' ? '}' : ']';
+        i = Json_skip_spaces(json, i + 1);
+        int size = 0;
+        if (i < json->length && text[i] == close) {
+            i++;
+        } else {
+            while (1) {
+                if (c == '{') {
+                    i = Json_skip_spaces(json, i);
+                    if (i >= json->length || text[i] != '"' || !Json_parse_value(json, &i, depth + 1)) return 0;
+                    i = Json_skip_spaces(json, i);
+                    if (i >= json->length || text[i] != ':') return 0;
+                    i++;
+                }
+                if (!Json_parse_value(json, &i, depth + 1)) return 0;
+                size++;
+                i = Json_skip_spaces(json, i);
+                if (i < json->length && text[i] == ',') {
+                    i++;
+                } else if (i < json->length && text[i] == close) {
+                    i++;
+                    break;
+                } else {
+                    return 0;
+                }
+            }
+        }
+        json->tokens[token].size = size;
+        json->tokens[token].end = (int)i;
+        json->tokens[token].next = json->token_count;
+    } else if (c == '"') {
+        int token = Json_push(json, JSON_STRING, (int)i + 1);
+        for (i++; i < json->length && text[i] != '"'; i++) {
+            if (text[i] == '\\') i++;
+        }
+        if (i >= json->length) return 0;
+        json->tokens[token].end = (int)i++;
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        int token = Json_push(json, JSON_NUMBER, (int)i);
+        while (i < json->length && strchr("+-.eE0123456789", text[i])) i++;
+        json->tokens[token].end = (int)i;
+    } else {
+        static const char *literals[] = { "true", "false", "null" };
+        int matched = 0;
+        for (int l = 0; l < 3 && !matched; l++) {
+            size_t n = strlen(literals[l]);
+            if (json->length - i >= n && memcmp(text + i, literals[l], n) == 0) {
+                int token = Json_push(json, l < 2 ? JSON_BOOL : JSON_NULL, (int)i);
+                json->tokens[token].end = (int)(i + n);
+                i += n;
+                matched = 1;
+            }
+        }
+        if (!matched) return 0;
+    }
+    *p = i;
+    return 1;
+}
+
+void Json_free(Json *json) {
+    free(json->tokens);
+    memset(json, 0, sizeof(*json));
+}
+
+// text must outlive the Json; the root value is token 0.
+int Json_parse(Json *json, const char *text, size_t length) {
+    memset(json, 0, sizeof(*json));
+    json->text = text;
+    json->length = length;
+    size_t p = 0;
+    if (length > 0x7fffffff || !Json_parse_value(json, &p, 0) || Json_skip_spaces(json, p) != length) {
+        Json_free(json);
+        return 0;
+    }
+    return 1;
+}
+
+int Json_string_equals(const Json *json, int token, const char *string) {
+    if (token < 0 || json->tokens[token].type != JSON_STRING) return 0;
+    size_t length = (size_t)(json->tokens[token].end - json->tokens[token].start);
+    return strlen(string) == length && memcmp(json->text + json->tokens[token].start, string, length) == 0;
+}
+
+// Value of key in object, or -1.
+int Json_find(const Json *json, int object, const char *key) {
+    if (object < 0 || json->tokens[object].type != JSON_OBJECT) return -1;
+    int token = object + 1;
+    for (int i = 0; i < json->tokens[object].size; i++) {
+        int value = json->tokens[token].next;
+        if (Json_string_equals(json, token, key)) return value;
+        token = json->tokens[value].next;
+    }
+    return -1;
+}
+
+// Element index of array, or -1.
+int Json_at(const Json *json, int array, int index) {
+    if (array < 0 || json->tokens[array].type != JSON_ARRAY || index < 0 || index >= json->tokens[array].size) return -1;
+    int token = array + 1;
+    while (index-- > 0) token = json->tokens[token].next;
+    return token;
+}
+
+int Json_size(const Json *json, int token) {
+    return token >= 0 && (json->tokens[token].type == JSON_ARRAY || json->tokens[token].type == JSON_OBJECT) ? json->tokens[token].size : 0;
+}
+
+double Json_number(const Json *json, int token, double fallback) {
+    if (token < 0 || json->tokens[token].type != JSON_NUMBER) return fallback;
+    char buffer[64];
+    size_t length = (size_t)(json->tokens[token].end - json->tokens[token].start);
+    if (length >= sizeof(buffer)) return fallback;
+    memcpy(buffer, json->text + json->tokens[token].start, length);
+    buffer[length] = '\0';
+    return strtod(buffer, NULL);
+}
+
+int Json_int(const Json *json, int token, int fallback) {
+    double value = Json_number(json, token, fallback);
+    return value >= -2147483648.0 && value <= 2147483647.0 ? (int)value : fallback;
+}
+
+int Json_bool(const Json *json, int token, int fallback) {
+    if (token < 0 || json->tokens[token].type != JSON_BOOL) return fallback;
+    return json->text[json->tokens[token].start] == 't';
+}
+
+// Unescapes a string into buffer; \u escapes outside ASCII become '?'. Returns 0 if it does not fit.
+int Json_string_copy(const Json *json, int token, char *buffer, size_t size) {
+    if (token < 0 || json->tokens[token].type != JSON_STRING || size == 0) return 0;
+    const char *p = json->text + json->tokens[token].start;
+    const char *end = json->text + json->tokens[token].end;
+    size_t length = 0;
+    while (p < end) {
+        char c = *p++;
+        if (c == '\\' && p < end) {
+            c = *p++;
+            switch (c) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'u': {
+                    unsigned int code = 0;
+                    for (int i = 0; i < 4 && p < end; i++, p++) {
+                        code = code * 16 + (unsigned int)(*p <= '9' ? *p - '0' : (*p | 0x20) - 'a' + 10);
+                    }
+                    c = code < 0x80 ? (char)code : '?';
+                    break;
+                }
+            }
+        }
+        if (length + 1 >= size) return 0;
+        buffer[length++] = c;
+    }
+    buffer[length] = '\0';
+    return 1;
+}
+
+#endif
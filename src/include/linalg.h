@@ -112,6 +112,25 @@ void Matrix4_rotate_z(Matrix4 m, float angle) {
     }
 }
 
+// Translation * rotation * scale, with the rotation given as a unit quaternion (x, y, z, w).
+void Matrix4_compose(Matrix4 m, Vector3 translation, Vector4 rotation, Vector3 scale) {
+    float x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+
+    Matrix4_identity(m);
+    m[0][0] = (1.0f - 2.0f * (y*y + z*z)) * scale[0];
+    m[0][1] = 2.0f * (x*y + w*z) * scale[0];
+    m[0][2] = 2.0f * (x*z - w*y) * scale[0];
+    m[1][0] = 2.0f * (x*y - w*z) * scale[1];
+    m[1][1] = (1.0f - 2.0f * (x*x + z*z)) * scale[1];
+    m[1][2] = 2.0f * (y*z + w*x) * scale[1];
+    m[2][0] = 2.0f * (x*z + w*y) * scale[2];
+    m[2][1] = 2.0f * (y*z - w*x) * scale[2];
+    m[2][2] = (1.0f - 2.0f * (x*x + y*y)) * scale[2];
+    m[3][0] = translation[0];
+    m[3][1] = translation[1];
+    m[3][2] = translation[2];
+}
+
 float Vector3_dot(Vector3 a, Vector3 b) {
     return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
 }
@@ -0,0 +1,155 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include "glad/glad.h"
+#include "linalg.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Interleaved vertex matching the attribute layout in main.c: position, uv, normal.
+typedef struct {
+    GLfloat position[3];
+    GLfloat uv[2];
+    GLfloat normal[3];
+} MeshVertex;
+
+// CPU side indexed triangle list, ready to upload as one vertex and one index buffer.
+typedef struct {
+    MeshVertex *vertices;
+    unsigned int vertex_count;
+    GLuint *indices;
+    unsigned int index_count;
+    Vector4 *tangents; // one per vertex once computed, xyz and handedness, otherwise NULL
+} Mesh;
+
+void Mesh_allocate(Mesh *mesh, unsigned int vertex_count, unsigned int index_count) {
+    mesh->vertex_count = vertex_count;
+    mesh->index_count = index_count;
+    mesh->tangents = NULL;
+    mesh->vertices = malloc((vertex_count > 0 ? vertex_count : 1) * sizeof(MeshVertex));
+    mesh->indices = malloc((index_count > 0 ? index_count : 1) * sizeof(GLuint));
+    if (!mesh->vertices || !mesh->indices) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+}
+
+void Mesh_free(Mesh *mesh) {
+    free(mesh->vertices);
+    free(mesh->indices);
+    free(mesh->tangents);
+    mesh->vertices = NULL;
+    mesh->indices = NULL;
+    mesh->tangents = NULL;
+    mesh->vertex_count = 0;
+    mesh->index_count = 0;
+}
+
+// 16-bit indices whenever every vertex can be reached with them, which halves the index buffer.
+GLenum Mesh_index_type(unsigned int vertex_count) {
+    return vertex_count <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+unsigned int Mesh_index_size(GLenum type) {
+    return type == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
+void Mesh_store_indices(void *destination, GLenum type, const GLuint *indices, unsigned int count) {
+    if (type == GL_UNSIGNED_INT) {
+        memcpy(destination, indices, count * sizeof(GLuint));
+        return;
+    }
+    uint16_t *narrow = destination;
+    for (unsigned int i = 0; i < count; i++) narrow[i] = (uint16_t)indices[i];
+}
+
+// Vertices are welded when their bits match, so the hash and comparison work on the raw 32 bytes.
+uint32_t MeshVertex_hash(const MeshVertex *vertex) {
+#if defined(__SSE2__)
+    // Every 32-bit lane gets its own odd multiplier; the products are folded down to 64 bits.
+    const __m128i k0 = _mm_set_epi32(0, (int)0x9e3779b1u, 0, (int)0x85ebca77u);
+    const __m128i k1 = _mm_set_epi32(0, (int)0xc2b2ae3du, 0, (int)0x27d4eb2fu);
+    const __m128i k2 = _mm_set_epi32(0, (int)0x165667b1u, 0, (int)0xd3a2646du);
+    const __m128i k3 = _mm_set_epi32(0, (int)0xfd7046c5u, 0, (int)0xb55a4f09u);
+    __m128i a = _mm_loadu_si128((const __m128i *)vertex);
+    __m128i b = _mm_loadu_si128((const __m128i *)vertex + 1);
+    __m128i h = _mm_xor_si128(_mm_mul_epu32(a, k0), _mm_mul_epu32(_mm_srli_epi64(a, 32), k1));
+    h = _mm_xor_si128(h, _mm_xor_si128(_mm_mul_epu32(b, k2), _mm_mul_epu32(_mm_srli_epi64(b, 32), k3)));
+    h = _mm_xor_si128(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(1, 0, 3, 2)));
+    uint64_t hash = (uint32_t)_mm_cvtsi128_si32(h) | (uint64_t)(uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(h, 4)) << 32;
+#else
+    uint32_t words[8];
+    memcpy(words, vertex, sizeof(words));
+    uint64_t hash = 0;
+    for (int i = 0; i < 8; i++) hash = (hash ^ words[i]) * 0x9e3779b97f4a7c15ull;
+#endif
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return (uint32_t)hash;
+}
+
+int MeshVertex_equal(const MeshVertex *a, const MeshVertex *b) {
+#if defined(__SSE2__)
+    __m128i low = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)a), _mm_loadu_si128((const __m128i *)b));
+    __m128i high = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)a + 1), _mm_loadu_si128((const __m128i *)b + 1));
+    return _mm_movemask_epi8(_mm_and_si128(low, high)) == 0xffff;
+#else
+    return memcmp(a, b, sizeof(MeshVertex)) == 0;
+#endif
+}
+
+// Builds mesh from a triangle list given as corners, vertices[indices[i]] (or vertices[i] without
+// indices), keeping one vertex per distinct corner. -0 is folded into 0 first so it welds too.
+void Mesh_weld(Mesh *mesh, const MeshVertex *vertices, const GLuint *indices, unsigned int index_count) {
+    unsigned int capacity = 16;
+    while (capacity < (uint64_t)index_count * 2) capacity *= 2;
+    GLuint *table = malloc(capacity * sizeof(GLuint)); // vertex index + 1, 0 when empty
+    if (!table) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    memset(table, 0, capacity * sizeof(GLuint));
+    Mesh_allocate(mesh, index_count, index_count);
+
+    unsigned int vertex_count = 0;
+    for (unsigned int i = 0; i < index_count; i++) {
+        MeshVertex *candidate = &mesh->vertices[vertex_count];
+        *candidate = vertices[indices ? indices[i] : i];
+        GLfloat *components = (GLfloat *)candidate;
+        for (int c = 0; c < 8; c++) components[c] += 0.0f;
+
+        unsigned int slot = MeshVertex_hash(candidate) & (capacity - 1);
+        while (table[slot] && !MeshVertex_equal(&mesh->vertices[table[slot] - 1], candidate)) slot = (slot + 1) & (capacity - 1);
+        if (!table[slot]) table[slot] = ++vertex_count;
+        mesh->indices[i] = table[slot] - 1;
+    }
+    free(table);
+
+    MeshVertex *welded = realloc(mesh->vertices, (vertex_count > 0 ? vertex_count : 1) * sizeof(MeshVertex));
+    if (welded) mesh->vertices = welded;
+    mesh->vertex_count = vertex_count;
+}
+
+// Gives every corner of a triangle list its face's normal, splitting the vertices shared by faces
+// that meet at an angle; Mesh_weld joins the corners within a face back up.
+void Mesh_flat_normals(MeshVertex *corners, unsigned int corner_count) {
+    for (unsigned int i = 0; i + 2 < corner_count; i += 3) {
+        Vector3 e0, e1, normal;
+        for (int c = 0; c < 3; c++) {
+            e0[c] = corners[i + 1].position[c] - corners[i].position[c];
+            e1[c] = corners[i + 2].position[c] - corners[i].position[c];
+        }
+        Vector3_cross(normal, e0, e1);
+        Vector3_normalize(normal);
+        for (int j = 0; j < 3; j++) memcpy(corners[i + j].normal, normal, sizeof(normal));
+    }
+}
+
+#endif
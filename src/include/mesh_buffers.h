@@ -0,0 +1,112 @@
+#ifndef MESH_BUFFERS_H
+#define MESH_BUFFERS_H
+
+#include "glad/glad.h"
+#include "jobs.h"
+#include "geometry_pool.h"
+#include "linalg.h"
+#include "mesh.h"
+#include "mesh_optimize.h"
+#include "mesh_simplify.h"
+#include "meshlet.h"
+#include "vertex_format.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// Everything the renderer keeps of a mesh, laid out for glBufferData: quantized vertices, the
+// indices of every LOD level in one buffer, and each level's meshlets. MeshBuffers_build runs the
+// whole import pipeline; MeshDiskCache_open instead points the same fields into a mapped file. Blobs
+// from an encoding cache leave vertices and indices NULL and point the encoded fields at MeshCodec
+// streams, which only MeshBuffers_upload turns into the glBufferData layout.
+
+typedef struct {
+    VertexFormat format;
+    Vector3 position_offset; // expands quantized positions, see VertexFormat_quantize
+    Vector3 position_scale;
+    unsigned int vertex_count;
+    void *vertices;
+    GLenum index_type;
+    unsigned int index_count;
+    void *indices;
+    const unsigned char *encoded_vertices; // MeshCodec streams standing in for vertices and indices, which are NULL then
+    size_t encoded_vertices_size;
+    const unsigned char *encoded_indices;
+    size_t encoded_indices_size;
+    MeshCacheStats loaded_stats; // post-transform cache before and after Mesh_optimize
+    MeshCacheStats optimized_stats;
+    int level_count;
+    MeshLod levels[MESH_LOD_MAX_LEVELS];
+    Meshlets meshlets[MESH_LOD_MAX_LEVELS];
+    void *mapping; // everything above points into it when set
+    size_t mapping_size;
+} MeshBuffers;
+
+// Optimizes mesh in place, then builds its LOD chain and meshlets and quantizes it.
+void MeshBuffers_build(MeshBuffers *buffers, Mesh *mesh, JobSystem *jobs) {
+    memset(buffers, 0, sizeof(*buffers));
+    buffers->loaded_stats = Mesh_cache_stats(mesh->indices, mesh->index_count, mesh->vertex_count, MESH_CACHE_SIZE);
+    Mesh_optimize(mesh, MESH_CACHE_SIZE);
+    buffers->optimized_stats = Mesh_cache_stats(mesh->indices, mesh->index_count, mesh->vertex_count, MESH_CACHE_SIZE);
+
+    MeshLodChain lods;
+    MeshLodChain_build(&lods, mesh, jobs, MESH_CACHE_SIZE);
+    buffers->level_count = lods.level_count;
+    memcpy(buffers->levels, lods.levels, sizeof(lods.levels));
+    for (int i = 0; i < lods.level_count; i++) {
+        const MeshLod *lod = &lods.levels[i];
+        Meshlets_build(&buffers->meshlets[i], lods.indices + lod->first_index, lod->index_count, lod->first_index, mesh->vertices, mesh->vertex_count);
+    }
+
+    QuantizedVertices quantized;
+    VertexFormat_quantize(&quantized, mesh);
+    buffers->format = quantized.format;
+    memcpy(buffers->position_offset, quantized.position_offset, sizeof(Vector3));
+    memcpy(buffers->position_scale, quantized.position_scale, sizeof(Vector3));
+    buffers->vertex_count = quantized.vertex_count;
+    buffers->vertices = quantized.vertices;
+
+    buffers->index_type = Mesh_index_type(mesh->vertex_count);
+    buffers->index_count = lods.index_count;
+    buffers->indices = malloc((size_t)(lods.index_count + 1) * Mesh_index_size(buffers->index_type));
+    if (!buffers->indices) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    Mesh_store_indices(buffers->indices, buffers->index_type, lods.indices, lods.index_count);
+    MeshLodChain_free(&lods);
+}
+
+void MeshBuffers_free(MeshBuffers *buffers) {
+    if (buffers->mapping) {
+        munmap(buffers->mapping, buffers->mapping_size);
+    } else {
+        free(buffers->vertices);
+        free(buffers->indices);
+        for (int i = 0; i < buffers->level_count; i++) Meshlets_free(&buffers->meshlets[i]);
+    }
+    memset(buffers, 0, sizeof(*buffers));
+}
+
+// Copies the vertices and indices into allocation, decoding them if they are still encoded. Returns 0 if they do not decode.
+int MeshBuffers_upload(const MeshBuffers *buffers, const GeometryPool *pool, const GeometryAllocation *allocation) {
+    if (!buffers->encoded_vertices) {
+        GeometryPool_upload(pool, allocation, buffers->vertices, buffers->indices);
+        return 1;
+    }
+    return GeometryPool_upload_encoded(pool, allocation, buffers->encoded_vertices, buffers->encoded_vertices_size, buffers->encoded_indices,
+        buffers->encoded_indices_size);
+}
+
+// The chain's level ranges, for MeshLodChain_select, without its CPU side indices.
+MeshLodChain MeshBuffers_lods(const MeshBuffers *buffers) {
+    MeshLodChain chain;
+    memset(&chain, 0, sizeof(chain));
+    chain.level_count = buffers->level_count;
+    chain.index_count = buffers->index_count;
+    memcpy(chain.levels, buffers->levels, sizeof(chain.levels));
+    return chain;
+}
+
+#endif
@@ -0,0 +1,406 @@
+#ifndef MESH_CODEC_H
+#define MESH_CODEC_H
+
+#include "glad/glad.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Lossless compression for index and vertex buffers, to keep meshes small on disk.
+// Indices: one code byte per triangle plus varints for the few vertices that need them. Most
+// triangles share an edge with a recent one, found in a 15 entry edge FIFO, so only the third
+// vertex is coded, and after Mesh_optimize_vertex_fetch that vertex is usually the next unseen
+// one or sits in a 15 entry vertex FIFO. Triangles may come back rotated (b c a for a b c), which
+// keeps their winding.
+// Vertices: blocks of up to 256 vertices are split into byte planes, one per byte of the vertex.
+// Each byte becomes its zigzagged difference from the same byte of the previous vertex, and groups
+// of 16 differences are packed at 0, 2, 4 or 8 bits each. Quantized attributes change little from
+// one vertex to the next, so most groups need 2 or 4 bits. The SSE2 decoder unpacks a group,
+// prefix sums it and transposes sixteen planes at a time back into vertices.
+
+#define MESH_CODEC_INDEX_VERSION 0xe1
+#define MESH_CODEC_VERTEX_VERSION 0xa1
+#define MESH_CODEC_FIFO_SIZE 16 // entries kept; the newest 15 can be referenced
+#define MESH_CODEC_BLOCK_VERTICES 256
+#define MESH_CODEC_GROUP 16
+
+unsigned int MeshCodec_indices_bound(unsigned int index_count) {
+    return 1 + (index_count / 3) * (1 + 3 * 5);
+}
+
+unsigned int MeshCodec_vertices_bound(unsigned int vertex_count, unsigned int vertex_size) {
+    unsigned int blocks = (vertex_count + MESH_CODEC_BLOCK_VERTICES - 1) / MESH_CODEC_BLOCK_VERTICES;
+    unsigned int groups = MESH_CODEC_BLOCK_VERTICES / MESH_CODEC_GROUP;
+    return 2 + blocks * vertex_size * (groups / 4 + groups * MESH_CODEC_GROUP);
+}
+
+unsigned char *MeshCodec_write_varint(unsigned char *data, uint32_t value) {
+    while (value >= 0x80) {
+        *data++ = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    *data++ = (unsigned char)value;
+    return data;
+}
+
+// Returns NULL past end or on overlong values.
+const unsigned char *MeshCodec_read_varint(const unsigned char *data, const unsigned char *end, uint32_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (data == end) return NULL;
+        unsigned char byte = *data++;
+        *value |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return data;
+    }
+    return NULL;
+}
+
+// Index of vertex in the vertex FIFO counting from the newest, or -1.
+int MeshCodec_find_vertex(const GLuint *fifo, unsigned int head, GLuint vertex) {
+    for (int i = 0; i < MESH_CODEC_FIFO_SIZE - 1; i++) {
+        if (fifo[(head - 1 - i) & (MESH_CODEC_FIFO_SIZE - 1)] == vertex) return i;
+    }
+    return -1;
+}
+
+void MeshCodec_push_edge(GLuint (*fifo)[2], unsigned int *head, GLuint a, GLuint b) {
+    fifo[*head & (MESH_CODEC_FIFO_SIZE - 1)][0] = a;
+    fifo[*head & (MESH_CODEC_FIFO_SIZE - 1)][1] = b;
+    (*head)++;
+}
+
+void MeshCodec_push_vertex(GLuint *fifo, unsigned int *head, GLuint vertex) {
+    fifo[*head & (MESH_CODEC_FIFO_SIZE - 1)] = vertex;
+    (*head)++;
+}
+
+// Writes at most MeshCodec_indices_bound(index_count) bytes and returns how many.
+unsigned int MeshCodec_encode_indices(unsigned char *buffer, const GLuint *indices, unsigned int index_count) {
+    unsigned int triangle_count = index_count / 3;
+    GLuint edges[MESH_CODEC_FIFO_SIZE][2], vertices[MESH_CODEC_FIFO_SIZE];
+    memset(edges, 0xff, sizeof(edges));
+    memset(vertices, 0xff, sizeof(vertices));
+    unsigned int edge_head = 0, vertex_head = 0;
+    GLuint next = 0, last = 0;
+    buffer[0] = MESH_CODEC_INDEX_VERSION;
+    unsigned char *codes = buffer + 1;
+    unsigned char *data = codes + triangle_count;
+
+    for (unsigned int t = 0; t < triangle_count; t++) {
+        const GLuint *triangle = &indices[t * 3];
+        int edge = -1, rotation = 0;
+        for (int e = 0; e < MESH_CODEC_FIFO_SIZE - 1 && edge < 0; e++) {
+            const GLuint *candidate = edges[(edge_head - 1 - e) & (MESH_CODEC_FIFO_SIZE - 1)];
+            for (int r = 0; r < 3; r++) {
+                if (triangle[r] == candidate[0] && triangle[(r + 1) % 3] == candidate[1]) {
+                    edge = e;
+                    rotation = r;
+                    break;
+                }
+            }
+        }
+
+        if (edge >= 0) {
+            GLuint a = triangle[rotation], b = triangle[(rotation + 1) % 3], c = triangle[(rotation + 2) % 3];
+            int cached = MeshCodec_find_vertex(vertices, vertex_head, c);
+            if (c == next) {
+                codes[t] = (unsigned char)(edge << 4);
+                next++;
+                MeshCodec_push_vertex(vertices, &vertex_head, c);
+            } else if (cached >= 0 && cached < 14) {
+                codes[t] = (unsigned char)(edge << 4 | (cached + 1));
+            } else {
+                codes[t] = (unsigned char)(edge << 4 | 15);
+                data = MeshCodec_write_varint(data, (uint32_t)(c - last) << 1 ^ (uint32_t)-(int32_t)((c - last) >> 31));
+                last = c;
+                MeshCodec_push_vertex(vertices, &vertex_head, c);
+            }
+            // The neighbours across the two new edges traverse them the other way.
+            MeshCodec_push_edge(edges, &edge_head, c, b);
+            MeshCodec_push_edge(edges, &edge_head, a, c);
+        } else {
+            unsigned char code = 0xf0;
+            for (int k = 0; k < 3; k++) {
+                GLuint v = triangle[k];
+                if (v == next) {
+                    code |= 1 << k;
+                    next++;
+                } else {
+                    data = MeshCodec_write_varint(data, (uint32_t)(v - last) << 1 ^ (uint32_t)-(int32_t)((v - last) >> 31));
+                    last = v;
+                }
+                MeshCodec_push_vertex(vertices, &vertex_head, v);
+            }
+            codes[t] = code;
+            MeshCodec_push_edge(edges, &edge_head, triangle[1], triangle[0]);
+            MeshCodec_push_edge(edges, &edge_head, triangle[2], triangle[1]);
+            MeshCodec_push_edge(edges, &edge_head, triangle[0], triangle[2]);
+        }
+    }
+    return (unsigned int)(data - buffer);
+}
+
+// Decodes index_count indices of index_size (2 or 4) bytes each; returns 0 if the buffer is
+// malformed or references a vertex at or past vertex_count.
+int MeshCodec_decode_indices(void *destination, unsigned int index_size, unsigned int index_count, unsigned int vertex_count,
+    const unsigned char *buffer, size_t size) {
+    unsigned int triangle_count = index_count / 3;
+    if (size < 1 + (size_t)triangle_count || buffer[0] != MESH_CODEC_INDEX_VERSION || index_count % 3) return 0;
+    GLuint edges[MESH_CODEC_FIFO_SIZE][2], vertices[MESH_CODEC_FIFO_SIZE];
+    memset(edges, 0, sizeof(edges));
+    memset(vertices, 0, sizeof(vertices));
+    unsigned int edge_head = 0, vertex_head = 0;
+    GLuint next = 0, last = 0;
+    const unsigned char *codes = buffer + 1;
+    const unsigned char *data = codes + triangle_count;
+    const unsigned char *end = buffer + size;
+
+    for (unsigned int t = 0; t < triangle_count; t++) {
+        unsigned char code = codes[t];
+        GLuint triangle[3];
+        if (code < 0xf0) {
+            const GLuint *edge = edges[(edge_head - 1 - (code >> 4)) & (MESH_CODEC_FIFO_SIZE - 1)];
+            GLuint a = edge[0], b = edge[1], c;
+            unsigned int low = code & 15;
+            if (low == 0) {
+                c = next++;
+                MeshCodec_push_vertex(vertices, &vertex_head, c);
+            } else if (low < 15) {
+                c = vertices[(vertex_head - low) & (MESH_CODEC_FIFO_SIZE - 1)];
+            } else {
+                uint32_t zigzag;
+                if (!(data = MeshCodec_read_varint(data, end, &zigzag))) return 0;
+                c = last + (GLuint)((zigzag >> 1) ^ -(zigzag & 1));
+                last = c;
+                MeshCodec_push_vertex(vertices, &vertex_head, c);
+            }
+            triangle[0] = a;
+            triangle[1] = b;
+            triangle[2] = c;
+            MeshCodec_push_edge(edges, &edge_head, c, b);
+            MeshCodec_push_edge(edges, &edge_head, a, c);
+        } else {
+            for (int k = 0; k < 3; k++) {
+                if (code & (1 << k)) {
+                    triangle[k] = next++;
+                } else {
+                    uint32_t zigzag;
+                    if (!(data = MeshCodec_read_varint(data, end, &zigzag))) return 0;
+                    triangle[k] = last + (GLuint)((zigzag >> 1) ^ -(zigzag & 1));
+                    last = triangle[k];
+                }
+                MeshCodec_push_vertex(vertices, &vertex_head, triangle[k]);
+            }
+            MeshCodec_push_edge(edges, &edge_head, triangle[1], triangle[0]);
+            MeshCodec_push_edge(edges, &edge_head, triangle[2], triangle[1]);
+            MeshCodec_push_edge(edges, &edge_head, triangle[0], triangle[2]);
+        }
+        if (triangle[0] >= vertex_count || triangle[1] >= vertex_count || triangle[2] >= vertex_count) return 0;
+        if (index_size == 2) {
+            uint16_t narrow[3] = { (uint16_t)triangle[0], (uint16_t)triangle[1], (uint16_t)triangle[2] };
+            memcpy((uint16_t *)destination + t * 3, narrow, sizeof(narrow));
+        } else {
+            memcpy((GLuint *)destination + t * 3, triangle, sizeof(triangle));
+        }
+    }
+    return data == end;
+}
+
+// Writes at most MeshCodec_vertices_bound bytes and returns how many. vertex_size must be a
+// multiple of 4 up to 256.
+unsigned int MeshCodec_encode_vertices(unsigned char *buffer, const void *vertices, unsigned int vertex_count, unsigned int vertex_size) {
+    const unsigned char *source = vertices;
+    unsigned char previous[256] = { 0 };
+    unsigned char deltas[MESH_CODEC_BLOCK_VERTICES];
+    unsigned char *data = buffer;
+    *data++ = MESH_CODEC_VERTEX_VERSION;
+    *data++ = (unsigned char)(vertex_size / 4 - 1);
+
+    for (unsigned int first = 0; first < vertex_count; first += MESH_CODEC_BLOCK_VERTICES) {
+        unsigned int count = vertex_count - first < MESH_CODEC_BLOCK_VERTICES ? vertex_count - first : MESH_CODEC_BLOCK_VERTICES;
+        unsigned int groups = (count + MESH_CODEC_GROUP - 1) / MESH_CODEC_GROUP;
+        for (unsigned int k = 0; k < vertex_size; k++) {
+            for (unsigned int i = 0; i < groups * MESH_CODEC_GROUP; i++) {
+                if (i >= count) {
+                    deltas[i] = 0;
+                    continue;
+                }
+                unsigned char value = source[(size_t)(first + i) * vertex_size + k];
+                unsigned char delta = (unsigned char)(value - previous[k]);
+                deltas[i] = (unsigned char)(delta << 1 ^ (delta & 0x80 ? 0xff : 0x00));
+                previous[k] = value;
+            }
+
+            unsigned char *headers = data;
+            data += (groups + 3) / 4;
+            memset(headers, 0, (groups + 3) / 4);
+            for (unsigned int g = 0; g < groups; g++) {
+                const unsigned char *group = &deltas[g * MESH_CODEC_GROUP];
+                unsigned char largest = 0;
+                for (int i = 0; i < MESH_CODEC_GROUP; i++) largest |= group[i];
+                unsigned int mode = largest == 0 ? 0 : largest < 4 ? 1 : largest < 16 ? 2 : 3;
+                headers[g / 4] |= (unsigned char)(mode << (g % 4 * 2));
+                if (mode == 1) {
+                    for (int i = 0; i < MESH_CODEC_GROUP; i += 4) *data++ = (unsigned char)(group[i] | group[i + 1] << 2 | group[i + 2] << 4 | group[i + 3] << 6);
+                } else if (mode == 2) {
+                    for (int i = 0; i < MESH_CODEC_GROUP; i += 2) *data++ = (unsigned char)(group[i] | group[i + 1] << 4);
+                } else if (mode == 3) {
+                    memcpy(data, group, MESH_CODEC_GROUP);
+                    data += MESH_CODEC_GROUP;
+                }
+            }
+        }
+    }
+    return (unsigned int)(data - buffer);
+}
+
+// Unpacks one byte plane of groups into plane, undoing the zigzag and the differences starting
+// from *previous; returns the data after it or NULL past end.
+#if defined(__SSE2__)
+const unsigned char *MeshCodec_decode_plane(unsigned char *plane, unsigned int groups, unsigned char *previous, const unsigned char *data,
+    const unsigned char *end) {
+    const unsigned char *headers = data;
+    data += (groups + 3) / 4;
+    if (data > end) return NULL;
+    const __m128i low2 = _mm_set1_epi8(0x03), low4 = _mm_set1_epi8(0x0f), one = _mm_set1_epi8(1), high7 = _mm_set1_epi8(0x7f);
+    __m128i carry = _mm_set1_epi8((char)*previous);
+    for (unsigned int g = 0; g < groups; g++) {
+        unsigned int mode = headers[g / 4] >> (g % 4 * 2) & 3;
+        __m128i group;
+        if (mode == 0) {
+            group = _mm_setzero_si128();
+        } else if (mode == 1) {
+            if (end - data < 4) return NULL;
+            int packed;
+            memcpy(&packed, data, 4);
+            data += 4;
+            __m128i x = _mm_cvtsi32_si128(packed);
+            __m128i a = _mm_and_si128(x, low2), b = _mm_and_si128(_mm_srli_epi16(x, 2), low2);
+            __m128i c = _mm_and_si128(_mm_srli_epi16(x, 4), low2), d = _mm_and_si128(_mm_srli_epi16(x, 6), low2);
+            group = _mm_unpacklo_epi16(_mm_unpacklo_epi8(a, b), _mm_unpacklo_epi8(c, d));
+        } else if (mode == 2) {
+            if (end - data < 8) return NULL;
+            __m128i x = _mm_loadl_epi64((const __m128i *)data);
+            data += 8;
+            group = _mm_unpacklo_epi8(_mm_and_si128(x, low4), _mm_and_si128(_mm_srli_epi16(x, 4), low4));
+        } else {
+            if (end - data < 16) return NULL;
+            group = _mm_loadu_si128((const __m128i *)data);
+            data += 16;
+        }
+        // Zigzag back to signed differences, then a running sum across the 16 lanes.
+        group = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(group, 1), high7), _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(group, one)));
+        group = _mm_add_epi8(group, _mm_slli_si128(group, 1));
+        group = _mm_add_epi8(group, _mm_slli_si128(group, 2));
+        group = _mm_add_epi8(group, _mm_slli_si128(group, 4));
+        group = _mm_add_epi8(group, _mm_slli_si128(group, 8));
+        group = _mm_add_epi8(group, carry);
+        _mm_storeu_si128((__m128i *)(plane + g * MESH_CODEC_GROUP), group);
+        // The last byte in every lane, without going through memory.
+        carry = _mm_shuffle_epi32(_mm_shufflehi_epi16(_mm_unpackhi_epi8(group, group), 0xff), 0xff);
+    }
+    return data;
+}
+
+// Interleaves plane_count decoded planes, a multiple of 4 up to 16, into bytes k.. of count vertices.
+// Sixteen vertices at a time go through a 16x16 byte transpose, so each vertex takes one store.
+void MeshCodec_transpose(unsigned char *destination, unsigned int vertex_size, unsigned int k, unsigned char (*planes)[MESH_CODEC_BLOCK_VERTICES],
+    unsigned int plane_count, unsigned int count) {
+    for (unsigned int first = 0; first < count; first += MESH_CODEC_GROUP) {
+        __m128i a[16];
+        for (unsigned int p = 0; p < 16; p += 2) {
+            __m128i even = p < plane_count ? _mm_loadu_si128((const __m128i *)(planes[p] + first)) : _mm_setzero_si128();
+            __m128i odd = p < plane_count ? _mm_loadu_si128((const __m128i *)(planes[p + 1] + first)) : _mm_setzero_si128();
+            a[p] = _mm_unpacklo_epi8(even, odd);
+            a[p + 1] = _mm_unpackhi_epi8(even, odd);
+        }
+        // b[q * 4 + m]: planes 4q..4q+3 of vertices 4m..4m+3.
+        __m128i b[16];
+        for (int q = 0; q < 4; q++) {
+            b[q * 4 + 0] = _mm_unpacklo_epi16(a[q * 4], a[q * 4 + 2]);
+            b[q * 4 + 1] = _mm_unpackhi_epi16(a[q * 4], a[q * 4 + 2]);
+            b[q * 4 + 2] = _mm_unpacklo_epi16(a[q * 4 + 1], a[q * 4 + 3]);
+            b[q * 4 + 3] = _mm_unpackhi_epi16(a[q * 4 + 1], a[q * 4 + 3]);
+        }
+        __m128i rows[16];
+        for (int m = 0; m < 4; m++) {
+            __m128i c0 = _mm_unpacklo_epi32(b[m], b[4 + m]), c1 = _mm_unpackhi_epi32(b[m], b[4 + m]);
+            __m128i d0 = _mm_unpacklo_epi32(b[8 + m], b[12 + m]), d1 = _mm_unpackhi_epi32(b[8 + m], b[12 + m]);
+            rows[m * 4 + 0] = _mm_unpacklo_epi64(c0, d0);
+            rows[m * 4 + 1] = _mm_unpackhi_epi64(c0, d0);
+            rows[m * 4 + 2] = _mm_unpacklo_epi64(c1, d1);
+            rows[m * 4 + 3] = _mm_unpackhi_epi64(c1, d1);
+        }
+        unsigned int left = count - first < MESH_CODEC_GROUP ? count - first : MESH_CODEC_GROUP;
+        unsigned char *vertex = destination + (size_t)first * vertex_size + k;
+        for (unsigned int i = 0; i < left; i++, vertex += vertex_size) {
+            if (plane_count == 16) {
+                _mm_storeu_si128((__m128i *)vertex, rows[i]);
+                continue;
+            }
+            if (plane_count >= 8) _mm_storel_epi64((__m128i *)vertex, rows[i]);
+            if (plane_count % 8 == 4) {
+                int word = _mm_cvtsi128_si32(plane_count == 4 ? rows[i] : _mm_srli_si128(rows[i], 8));
+                memcpy(vertex + plane_count - 4, &word, 4);
+            }
+        }
+    }
+}
+#else
+const unsigned char *MeshCodec_decode_plane(unsigned char *plane, unsigned int groups, unsigned char *previous, const unsigned char *data,
+    const unsigned char *end) {
+    const unsigned char *headers = data;
+    data += (groups + 3) / 4;
+    if (data > end) return NULL;
+    unsigned char value = *previous;
+    for (unsigned int g = 0; g < groups; g++) {
+        unsigned int mode = headers[g / 4] >> (g % 4 * 2) & 3;
+        unsigned int bits = mode == 0 ? 0 : 1u << mode;
+        if ((size_t)(end - data) < bits * 2) return NULL;
+        for (int i = 0; i < MESH_CODEC_GROUP; i++) {
+            unsigned char zigzag = bits ? (unsigned char)(data[i * bits / 8] >> (i * bits % 8) & ((1u << bits) - 1)) : 0;
+            value = (unsigned char)(value + ((zigzag >> 1) ^ -(zigzag & 1)));
+            plane[g * MESH_CODEC_GROUP + i] = value;
+        }
+        data += bits * 2;
+    }
+    return data;
+}
+
+void MeshCodec_transpose(unsigned char *destination, unsigned int vertex_size, unsigned int k, unsigned char (*planes)[MESH_CODEC_BLOCK_VERTICES],
+    unsigned int plane_count, unsigned int count) {
+    for (unsigned int i = 0; i < count; i++) {
+        for (unsigned int p = 0; p < plane_count; p++) destination[(size_t)i * vertex_size + k + p] = planes[p][i];
+    }
+}
+#endif
+
+// Decodes vertex_count vertices of vertex_size bytes; returns 0 if the buffer is malformed.
+int MeshCodec_decode_vertices(void *destination, unsigned int vertex_count, unsigned int vertex_size, const unsigned char *buffer, size_t size) {
+    const unsigned char *data = buffer, *end = buffer + size;
+    unsigned char previous[256] = { 0 };
+    if (vertex_size == 0 || vertex_size > sizeof(previous) || vertex_size % 4 != 0) return 0;
+    if (size < 2 || data[0] != MESH_CODEC_VERTEX_VERSION || (data[1] + 1u) * 4 != vertex_size) return 0;
+    data += 2;
+    unsigned char planes[16][MESH_CODEC_BLOCK_VERTICES];
+    for (unsigned int first = 0; first < vertex_count; first += MESH_CODEC_BLOCK_VERTICES) {
+        unsigned int count = vertex_count - first < MESH_CODEC_BLOCK_VERTICES ? vertex_count - first : MESH_CODEC_BLOCK_VERTICES;
+        unsigned int groups = (count + MESH_CODEC_GROUP - 1) / MESH_CODEC_GROUP;
+        for (unsigned int k = 0; k < vertex_size; k++) {
+            if (!(data = MeshCodec_decode_plane(planes[k % 16], groups, &previous[k], data, end))) return 0;
+            previous[k] = planes[k % 16][count - 1];
+            if (k % 16 == 15 || k + 1 == vertex_size) {
+                MeshCodec_transpose((unsigned char *)destination + (size_t)first * vertex_size, vertex_size, k - k % 16, planes, k % 16 + 1, count);
+            }
+        }
+    }
+    return data == end;
+}
+
+#endif
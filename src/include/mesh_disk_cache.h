@@ -0,0 +1,379 @@
+#ifndef MESH_DISK_CACHE_H
+#define MESH_DISK_CACHE_H
+
+#include "mesh_buffers.h"
+#include "mesh_codec.h"
+#include "texture_disk_cache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Keeps converted meshes on disk so later launches skip loading, optimizing, simplifying and
+// quantizing. A blob is the MeshBuffers of one source: a fixed header with the vertex format,
+// bounds, LOD levels and section offsets, then the vertex and index buffers exactly as glBufferData
+// takes them and every level's meshlets and meshlet bounds, each 64 byte aligned, the meshlets exactly
+// as they are culled. Opening maps the file and points MeshBuffers into it; nothing is parsed. A cache
+// created with encode set stores the vertex and index buffers as MeshCodec streams instead, about half
+// the size, which MeshBuffers_upload decodes straight into the GL buffers; either kind of blob opens
+// whatever the setting. Blobs are keyed and invalidated like the texture disk cache's, and a checksum
+// over the whole file rejects blobs that were truncated or damaged.
+
+#define MESH_DISK_CACHE_MAGIC 0x434d4c47u // "GLMC"
+#define MESH_DISK_CACHE_VERSION 4
+#define MESH_DISK_CACHE_ALIGNMENT 64
+#define MESH_DISK_CACHE_ENCODED 1u // header flag: vertices and indices are MeshCodec streams
+
+typedef struct {
+    uint32_t location;
+    uint32_t components;
+    uint32_t type;
+    uint32_t normalized;
+    uint32_t integer;
+    uint32_t offset;
+} MeshDiskAttribute;
+
+typedef struct {
+    uint32_t first_index;
+    uint32_t index_count;
+    float error;
+    uint32_t meshlet_count;
+    uint32_t padded_count; // meshlet bounds per stream
+    uint32_t reserved;
+    uint64_t meshlets_offset;
+    uint64_t bounds_offset;
+} MeshDiskLevel;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_size;
+    uint64_t source_mtime; // nanoseconds
+    uint64_t content_hash;
+    uint64_t settings_hash;
+    uint64_t checksum; // of the whole file with this field zeroed
+    uint64_t file_size;
+    uint32_t vertex_count;
+    uint32_t vertex_stride;
+    uint32_t attribute_count;
+    uint32_t index_type;
+    uint32_t index_count;
+    uint32_t level_count;
+    uint32_t flags;
+    uint32_t reserved;
+    MeshDiskAttribute attributes[VERTEX_FORMAT_MAX_ATTRIBUTES];
+    float position_offset[3];
+    float position_scale[3];
+    MeshCacheStats loaded_stats;
+    MeshCacheStats optimized_stats;
+    MeshDiskLevel levels[MESH_LOD_MAX_LEVELS];
+    uint64_t vertices_offset;
+    uint64_t vertices_size; // in bytes, encoded or not
+    uint64_t indices_offset;
+    uint64_t indices_size;
+} MeshDiskHeader;
+
+typedef struct {
+    char blob_path[TEXTURE_DISK_CACHE_BLOB_PATH_LENGTH];
+    const char *source_path;
+    uint64_t source_size;
+    uint64_t source_mtime;
+    uint64_t content_hash;
+    uint64_t settings_hash;
+    int have_content_hash;
+} MeshDiskKey;
+
+typedef struct {
+    char directory[TEXTURE_DISK_CACHE_PATH_LENGTH];
+    int hits;
+    int misses;
+    int stale; // misses caused by a changed source, settings or a bad checksum
+    int writes;
+    int encode; // store new blobs' vertices and indices as MeshCodec streams
+} MeshDiskCache;
+
+// Creates the directory if needed; returns 0 if it cannot be used, in which case nothing is cached.
+int MeshDiskCache_init(MeshDiskCache *disk, const char *directory, int encode) {
+    memset(disk, 0, sizeof(*disk));
+    snprintf(disk->directory, sizeof(disk->directory), "%s", directory);
+    disk->encode = encode;
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create mesh cache directory %s: %s\n", directory, strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+// Eight bytes at a time, so checking a blob costs little next to uploading it.
+uint64_t MeshDiskCache_checksum(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash ^= word;
+        hash = (hash << 31 | hash >> 33) * 0x9e3779b97f4a7c15ull;
+    }
+    hash = TextureDiskCache_hash(hash, bytes + i, size - i);
+    return hash ^ hash >> 29;
+}
+
+// Of a file that starts with file_header, whatever file itself starts with.
+uint64_t MeshDiskCache_file_checksum(const MeshDiskHeader *file_header, const unsigned char *file, size_t size) {
+    MeshDiskHeader header = *file_header;
+    header.checksum = 0;
+    uint64_t hash = MeshDiskCache_checksum(TEXTURE_DISK_CACHE_HASH_SEED, &header, sizeof(header));
+    return MeshDiskCache_checksum(hash, file + sizeof(header), size - sizeof(header));
+}
+
+int MeshDiskCache_key(const MeshDiskCache *disk, MeshDiskKey *key, const char *source_path) {
+    struct stat info;
+    if (stat(source_path, &info) != 0) return 0;
+
+    memset(key, 0, sizeof(*key));
+    key->source_path = source_path;
+    key->source_size = (uint64_t)info.st_size;
+    key->source_mtime = (uint64_t)info.st_mtim.tv_sec * 1000000000ull + (uint64_t)info.st_mtim.tv_nsec;
+
+    // Anything that changes what the import pipeline produces.
+    float settings_floats[7] = { MESH_LOD_REDUCTION, MESH_LOD_MAX_ERROR, MESH_SIMPLIFY_BORDER_WEIGHT, MESH_SIMPLIFY_ERROR_SLACK, MESH_OVERDRAW_THRESHOLD,
+        MESHLET_MIN_CONE_SPREAD, VERTEX_FORMAT_HALF_UV_RANGE };
+    uint32_t settings_words[8] = { MESH_DISK_CACHE_VERSION, MESH_CACHE_SIZE, MESH_LOD_MAX_LEVELS, MESH_LOD_MIN_TRIANGLES, MESHLET_MAX_VERTICES,
+        MESHLET_MAX_TRIANGLES, (uint32_t)sizeof(Meshlet), (uint32_t)sizeof(MeshDiskHeader) };
+    key->settings_hash = TextureDiskCache_hash(TEXTURE_DISK_CACHE_HASH_SEED, settings_words, sizeof(settings_words));
+    key->settings_hash = TextureDiskCache_hash(key->settings_hash, settings_floats, sizeof(settings_floats));
+
+    uint64_t name = TextureDiskCache_hash(key->settings_hash, source_path, strlen(source_path));
+    snprintf(key->blob_path, sizeof(key->blob_path), "%s/%016llx.mesh", disk->directory, (unsigned long long)name);
+    return 1;
+}
+
+int MeshDiskCache_content_hash(MeshDiskKey *key) {
+    if (!key->have_content_hash) key->have_content_hash = TextureDiskCache_hash_file(key->source_path, &key->content_hash);
+    return key->have_content_hash;
+}
+
+int MeshDiskCache_section_fits(const MeshDiskHeader *header, uint64_t offset, uint64_t size) {
+    return offset % MESH_DISK_CACHE_ALIGNMENT == 0 && offset >= sizeof(MeshDiskHeader) && offset <= header->file_size && size <= header->file_size - offset;
+}
+
+// Maps the blob for source_path into buffers if it is still valid. key is filled in either way, for MeshDiskCache_store.
+int MeshDiskCache_open(MeshDiskCache *disk, MeshDiskKey *key, const char *source_path, MeshBuffers *buffers) {
+    memset(buffers, 0, sizeof(*buffers));
+    memset(key, 0, sizeof(*key));
+    if (!MeshDiskCache_key(disk, key, source_path)) return 0;
+
+    int fd = open(key->blob_path, O_RDONLY);
+    if (fd < 0) {
+        disk->misses++;
+        return 0;
+    }
+    struct stat info;
+    void *mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(MeshDiskHeader)) {
+        mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        disk->misses++;
+        return 0;
+    }
+
+    const MeshDiskHeader *header = mapping;
+    int valid = header->magic == MESH_DISK_CACHE_MAGIC && header->version == MESH_DISK_CACHE_VERSION
+        && header->settings_hash == key->settings_hash && header->source_size == key->source_size
+        && header->file_size == (uint64_t)info.st_size && header->attribute_count <= VERTEX_FORMAT_MAX_ATTRIBUTES
+        && header->level_count >= 1 && header->level_count <= MESH_LOD_MAX_LEVELS
+        && (header->index_type == GL_UNSIGNED_SHORT || header->index_type == GL_UNSIGNED_INT) && (header->flags & ~MESH_DISK_CACHE_ENCODED) == 0
+        && ((header->flags & MESH_DISK_CACHE_ENCODED) || (header->vertices_size == (uint64_t)header->vertex_count * header->vertex_stride
+            && header->indices_size == (uint64_t)header->index_count * Mesh_index_size(header->index_type)))
+        && MeshDiskCache_section_fits(header, header->vertices_offset, header->vertices_size)
+        && MeshDiskCache_section_fits(header, header->indices_offset, header->indices_size);
+    for (uint32_t i = 0; valid && i < header->level_count; i++) {
+        const MeshDiskLevel *level = &header->levels[i];
+        valid = (uint64_t)level->first_index + level->index_count <= header->index_count && level->padded_count % 4 == 0
+            && level->padded_count >= level->meshlet_count
+            && MeshDiskCache_section_fits(header, level->meshlets_offset, (uint64_t)level->meshlet_count * sizeof(Meshlet))
+            && MeshDiskCache_section_fits(header, level->bounds_offset, (uint64_t)level->padded_count * MESHLET_BOUNDS_STREAMS * sizeof(float));
+    }
+    int touched = valid && header->source_mtime != key->source_mtime;
+    if (touched) {
+        // Touched but maybe not changed, e.g. by a checkout; the contents decide.
+        valid = MeshDiskCache_content_hash(key) && key->content_hash == header->content_hash;
+    }
+    if (valid) valid = MeshDiskCache_file_checksum(header, mapping, info.st_size) == header->checksum;
+    if (!valid) {
+        munmap(mapping, info.st_size);
+        disk->stale++;
+        disk->misses++;
+        return 0;
+    }
+
+    unsigned char *file = mapping;
+    buffers->mapping = mapping;
+    buffers->mapping_size = info.st_size;
+    buffers->format.attribute_count = (int)header->attribute_count;
+    buffers->format.stride = (GLsizei)header->vertex_stride;
+    for (uint32_t i = 0; i < header->attribute_count; i++) {
+        const MeshDiskAttribute *attribute = &header->attributes[i];
+        buffers->format.attributes[i] = (VertexAttribute){ attribute->location, (GLint)attribute->components, attribute->type,
+            (GLboolean)attribute->normalized, (GLboolean)attribute->integer, attribute->offset };
+    }
+    memcpy(buffers->position_offset, header->position_offset, sizeof(Vector3));
+    memcpy(buffers->position_scale, header->position_scale, sizeof(Vector3));
+    buffers->vertex_count = header->vertex_count;
+    buffers->index_type = header->index_type;
+    buffers->index_count = header->index_count;
+    if (header->flags & MESH_DISK_CACHE_ENCODED) {
+        buffers->encoded_vertices = file + header->vertices_offset;
+        buffers->encoded_vertices_size = header->vertices_size;
+        buffers->encoded_indices = file + header->indices_offset;
+        buffers->encoded_indices_size = header->indices_size;
+    } else {
+        buffers->vertices = file + header->vertices_offset;
+        buffers->indices = file + header->indices_offset;
+    }
+    buffers->loaded_stats = header->loaded_stats;
+    buffers->optimized_stats = header->optimized_stats;
+    buffers->level_count = (int)header->level_count;
+    for (int i = 0; i < buffers->level_count; i++) {
+        const MeshDiskLevel *level = &header->levels[i];
+        buffers->levels[i] = (MeshLod){ level->first_index, level->index_count, level->error };
+        buffers->meshlets[i] = (Meshlets){ (Meshlet *)(file + level->meshlets_offset), level->meshlet_count, (float *)(file + level->bounds_offset),
+            level->padded_count };
+    }
+    if (touched) {
+        // Unchanged, so later launches can trust the new mtime instead of hashing again.
+        MeshDiskHeader updated = *header;
+        updated.source_mtime = key->source_mtime;
+        updated.checksum = MeshDiskCache_file_checksum(&updated, file, info.st_size);
+        TextureDiskCache_rewrite(key->blob_path, &updated, sizeof(updated), 0);
+    }
+    disk->hits++;
+    return 1;
+}
+
+uint64_t MeshDiskCache_align(uint64_t offset) {
+    return (offset + MESH_DISK_CACHE_ALIGNMENT - 1) & ~(uint64_t)(MESH_DISK_CACHE_ALIGNMENT - 1);
+}
+
+// Writes buffers as the blob for key's source, through a temporary file so readers never see half a blob.
+int MeshDiskCache_store(MeshDiskCache *disk, MeshDiskKey *key, const MeshBuffers *buffers) {
+    if (!key->source_path || !MeshDiskCache_content_hash(key)) return 0;
+
+    MeshDiskHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MESH_DISK_CACHE_MAGIC;
+    header.version = MESH_DISK_CACHE_VERSION;
+    header.source_size = key->source_size;
+    header.source_mtime = key->source_mtime;
+    header.content_hash = key->content_hash;
+    header.settings_hash = key->settings_hash;
+    header.vertex_count = buffers->vertex_count;
+    header.vertex_stride = (uint32_t)buffers->format.stride;
+    header.attribute_count = (uint32_t)buffers->format.attribute_count;
+    for (int i = 0; i < buffers->format.attribute_count; i++) {
+        const VertexAttribute *attribute = &buffers->format.attributes[i];
+        header.attributes[i] = (MeshDiskAttribute){ attribute->location, (uint32_t)attribute->components, attribute->type, attribute->normalized,
+            attribute->integer, attribute->offset };
+    }
+    header.index_type = buffers->index_type;
+    header.index_count = buffers->index_count;
+    header.level_count = (uint32_t)buffers->level_count;
+    memcpy(header.position_offset, buffers->position_offset, sizeof(header.position_offset));
+    memcpy(header.position_scale, buffers->position_scale, sizeof(header.position_scale));
+    header.loaded_stats = buffers->loaded_stats;
+    header.optimized_stats = buffers->optimized_stats;
+
+    const void *vertices = buffers->vertices;
+    const void *indices = buffers->indices;
+    unsigned char *encoded_vertices = NULL, *encoded_indices = NULL;
+    header.vertices_size = (uint64_t)buffers->vertex_count * buffers->format.stride;
+    header.indices_size = (uint64_t)buffers->index_count * Mesh_index_size(buffers->index_type);
+    if (disk->encode) {
+        // The index codec reads 32 bit indices whatever the buffer stores.
+        GLuint *wide = malloc(((size_t)buffers->index_count + 1) * sizeof(GLuint));
+        encoded_vertices = malloc(MeshCodec_vertices_bound(buffers->vertex_count, buffers->format.stride));
+        encoded_indices = malloc(MeshCodec_indices_bound(buffers->index_count));
+        if (!wide || !encoded_vertices || !encoded_indices) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        for (unsigned int i = 0; i < buffers->index_count; i++) {
+            wide[i] = buffers->index_type == GL_UNSIGNED_SHORT ? ((const GLushort *)buffers->indices)[i] : ((const GLuint *)buffers->indices)[i];
+        }
+        header.flags |= MESH_DISK_CACHE_ENCODED;
+        header.vertices_size = MeshCodec_encode_vertices(encoded_vertices, buffers->vertices, buffers->vertex_count, (unsigned int)buffers->format.stride);
+        header.indices_size = MeshCodec_encode_indices(encoded_indices, wide, buffers->index_count);
+        free(wide);
+        vertices = encoded_vertices;
+        indices = encoded_indices;
+    }
+
+    header.vertices_offset = MeshDiskCache_align(sizeof(header));
+    header.indices_offset = MeshDiskCache_align(header.vertices_offset + header.vertices_size);
+    uint64_t offset = header.indices_offset + header.indices_size;
+    for (int i = 0; i < buffers->level_count; i++) {
+        const Meshlets *meshlets = &buffers->meshlets[i];
+        MeshDiskLevel *level = &header.levels[i];
+        level->first_index = buffers->levels[i].first_index;
+        level->index_count = buffers->levels[i].index_count;
+        level->error = buffers->levels[i].error;
+        level->meshlet_count = meshlets->meshlet_count;
+        level->padded_count = meshlets->padded_count;
+        level->meshlets_offset = MeshDiskCache_align(offset);
+        level->bounds_offset = MeshDiskCache_align(level->meshlets_offset + (uint64_t)meshlets->meshlet_count * sizeof(Meshlet));
+        offset = level->bounds_offset + (uint64_t)meshlets->padded_count * MESHLET_BOUNDS_STREAMS * sizeof(float);
+    }
+    header.file_size = offset;
+
+    // The file is assembled in memory first, since its checksum goes in front.
+    unsigned char *file = calloc(1, header.file_size);
+    if (!file) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    memcpy(file + header.vertices_offset, vertices, header.vertices_size);
+    memcpy(file + header.indices_offset, indices, header.indices_size);
+    free(encoded_vertices);
+    free(encoded_indices);
+    for (int i = 0; i < buffers->level_count; i++) {
+        const Meshlets *meshlets = &buffers->meshlets[i];
+        memcpy(file + header.levels[i].meshlets_offset, meshlets->meshlets, meshlets->meshlet_count * sizeof(Meshlet));
+        memcpy(file + header.levels[i].bounds_offset, meshlets->bounds, (size_t)meshlets->padded_count * MESHLET_BOUNDS_STREAMS * sizeof(float));
+    }
+    header.checksum = MeshDiskCache_file_checksum(&header, file, header.file_size);
+    memcpy(file, &header, sizeof(header));
+
+    char temporary_path[TEXTURE_DISK_CACHE_BLOB_PATH_LENGTH + 32];
+    snprintf(temporary_path, sizeof(temporary_path), "%s.%lu.tmp", key->blob_path, SDL_ThreadID());
+    FILE *fp = fopen(temporary_path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Could not open file %s\n", temporary_path);
+        free(file);
+        return 0;
+    }
+    fwrite(file, 1, header.file_size, fp);
+    free(file);
+    int success = !ferror(fp);
+    success = fclose(fp) == 0 && success;
+
+    if (success && rename(temporary_path, key->blob_path) == 0) {
+        disk->writes++;
+        return 1;
+    }
+    fprintf(stderr, "Could not write file %s\n", key->blob_path);
+    remove(temporary_path);
+    return 0;
+}
+
+void MeshDiskCache_print_stats(const MeshDiskCache *disk) {
+    printf("MESH DISK CACHE:\t%d hits, %d misses (%d stale), %d writes\n", disk->hits, disk->misses, disk->stale, disk->writes);
+}
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef MESH_NORMALS_H
+#define MESH_NORMALS_H
+
+#include "jobs.h"
+#include "linalg.h"
+#include "mesh.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Smooth normals and tangents for indexed triangle lists. Triangles are split into a few tasks that
+// each scatter their weighted contributions into a private per-vertex accumulator, so no two tasks
+// ever write the same memory; a second parallel pass sums the accumulators per vertex range and
+// normalizes. Contributions are weighted by corner angle times triangle area.
+// Tangents follow MikkTSpace's per-vertex rules (angle weighted, orthogonalized against the normal,
+// handedness in w) but do not split vertices of their own: vertices already split at uv seams and
+// hard edges, as loaded meshes are, come out the same.
+
+#define MESH_NORMALS_MAX_TASKS 8 // each one costs a private accumulator for every vertex
+#define MESH_NORMALS_TASK_TRIANGLES 65536
+#define MESH_NORMALS_REDUCE_BATCH 65536
+
+typedef struct {
+    Mesh *mesh;
+    int task_count;
+    unsigned int triangles_per_task;
+    int stride; // floats per vertex in an accumulator
+    GLfloat *accumulators; // task_count blocks of vertex_count * stride
+} MeshAccumulation;
+
+// Corner angles of triangle p0 p1 p2, 0 for degenerate corners.
+void Mesh_corner_angles(const GLfloat *p0, const GLfloat *p1, const GLfloat *p2, float angles[3]) {
+    const GLfloat *points[3] = { p0, p1, p2 };
+    for (int i = 0; i < 3; i++) {
+        const GLfloat *a = points[i], *b = points[(i + 1) % 3], *c = points[(i + 2) % 3];
+        Vector3 e0 = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        Vector3 e1 = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        float lengths = sqrtf(Vector3_dot(e0, e0) * Vector3_dot(e1, e1));
+        float cosine = lengths > 0.0f ? Vector3_dot(e0, e1) / lengths : 1.0f;
+        angles[i] = acosf(cosine < -1.0f ? -1.0f : cosine > 1.0f ? 1.0f : cosine);
+    }
+}
+
+int Mesh_accumulation_begin(MeshAccumulation *accumulation, Mesh *mesh, JobSystem *jobs, int stride) {
+    unsigned int triangle_count = mesh->index_count / 3;
+    int task_count = jobs ? jobs->thread_count + 1 : 1;
+    int useful_tasks = (int)((triangle_count + MESH_NORMALS_TASK_TRIANGLES - 1) / MESH_NORMALS_TASK_TRIANGLES);
+    if (task_count > useful_tasks) task_count = useful_tasks;
+    if (task_count > MESH_NORMALS_MAX_TASKS) task_count = MESH_NORMALS_MAX_TASKS;
+    if (task_count < 1) return 0;
+
+    accumulation->mesh = mesh;
+    accumulation->task_count = task_count;
+    accumulation->triangles_per_task = (triangle_count + task_count - 1) / task_count;
+    accumulation->stride = stride;
+    accumulation->accumulators = malloc((size_t)task_count * mesh->vertex_count * stride * sizeof(GLfloat));
+    if (!accumulation->accumulators) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return 1;
+}
+
+// Zeroes task's accumulator on the thread that fills it and returns it with its triangle range.
+GLfloat *Mesh_accumulation_task(MeshAccumulation *accumulation, int task, unsigned int *first, unsigned int *last) {
+    size_t size = (size_t)accumulation->mesh->vertex_count * accumulation->stride;
+    GLfloat *accumulator = accumulation->accumulators + (size_t)task * size;
+    memset(accumulator, 0, size * sizeof(GLfloat));
+    unsigned int triangle_count = accumulation->mesh->index_count / 3;
+    *first = task * accumulation->triangles_per_task;
+    *last = *first + accumulation->triangles_per_task < triangle_count ? *first + accumulation->triangles_per_task : triangle_count;
+    return accumulator;
+}
+
+// Sums component of vertex over all tasks' accumulators.
+float Mesh_accumulated(const MeshAccumulation *accumulation, unsigned int vertex, int component) {
+    size_t size = (size_t)accumulation->mesh->vertex_count * accumulation->stride;
+    const GLfloat *value = accumulation->accumulators + (size_t)vertex * accumulation->stride + component;
+    float sum = 0.0f;
+    for (int t = 0; t < accumulation->task_count; t++) sum += value[t * size];
+    return sum;
+}
+
+void Mesh_accumulate_normals(void *data, int begin, int end) {
+    MeshAccumulation *accumulation = data;
+    const Mesh *mesh = accumulation->mesh;
+    for (int task = begin; task < end; task++) {
+        unsigned int first, last;
+        GLfloat *accumulator = Mesh_accumulation_task(accumulation, task, &first, &last);
+        for (unsigned int t = first; t < last; t++) {
+            const GLuint *corner = &mesh->indices[t * 3];
+            const GLfloat *p0 = mesh->vertices[corner[0]].position;
+            const GLfloat *p1 = mesh->vertices[corner[1]].position;
+            const GLfloat *p2 = mesh->vertices[corner[2]].position;
+            Vector3 e0 = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            Vector3 e1 = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            Vector3 normal; // its length is twice the area, which supplies the area weight
+            Vector3_cross(normal, e0, e1);
+            float angles[3];
+            Mesh_corner_angles(p0, p1, p2, angles);
+            for (int i = 0; i < 3; i++) {
+                GLfloat *sum = accumulator + (size_t)corner[i] * accumulation->stride;
+                sum[0] += normal[0] * angles[i];
+                sum[1] += normal[1] * angles[i];
+                sum[2] += normal[2] * angles[i];
+            }
+        }
+    }
+}
+
+void Mesh_reduce_normals(void *data, int begin, int end) {
+    MeshAccumulation *accumulation = data;
+    for (int v = begin; v < end; v++) {
+        Vector3 normal = { Mesh_accumulated(accumulation, v, 0), Mesh_accumulated(accumulation, v, 1), Mesh_accumulated(accumulation, v, 2) };
+        if (Vector3_dot(normal, normal) == 0.0f) continue; // unreferenced or only in degenerate triangles
+        Vector3_normalize(normal);
+        memcpy(accumulation->mesh->vertices[v].normal, normal, sizeof(normal));
+    }
+}
+
+// Replaces every referenced vertex's normal with the weighted average of its triangles' normals.
+void Mesh_compute_normals(Mesh *mesh, JobSystem *jobs) {
+    MeshAccumulation accumulation;
+    if (!Mesh_accumulation_begin(&accumulation, mesh, jobs, 3)) return;
+    JobSystem_parallel_for(jobs, accumulation.task_count, 1, Mesh_accumulate_normals, &accumulation);
+    JobSystem_parallel_for(jobs, (int)mesh->vertex_count, MESH_NORMALS_REDUCE_BATCH, Mesh_reduce_normals, &accumulation);
+    free(accumulation.accumulators);
+}
+
+// Accumulates xyz of the tangent and, in w, the angle weighted handedness of each vertex's triangles.
+void Mesh_accumulate_tangents(void *data, int begin, int end) {
+    MeshAccumulation *accumulation = data;
+    const Mesh *mesh = accumulation->mesh;
+    for (int task = begin; task < end; task++) {
+        unsigned int first, last;
+        GLfloat *accumulator = Mesh_accumulation_task(accumulation, task, &first, &last);
+        for (unsigned int t = first; t < last; t++) {
+            const GLuint *corner = &mesh->indices[t * 3];
+            const MeshVertex *v0 = &mesh->vertices[corner[0]];
+            const MeshVertex *v1 = &mesh->vertices[corner[1]];
+            const MeshVertex *v2 = &mesh->vertices[corner[2]];
+            Vector3 e0 = { v1->position[0] - v0->position[0], v1->position[1] - v0->position[1], v1->position[2] - v0->position[2] };
+            Vector3 e1 = { v2->position[0] - v0->position[0], v2->position[1] - v0->position[1], v2->position[2] - v0->position[2] };
+            float s0 = v1->uv[0] - v0->uv[0], t0 = v1->uv[1] - v0->uv[1];
+            float s1 = v2->uv[0] - v0->uv[0], t1 = v2->uv[1] - v0->uv[1];
+            float signed_area = s0 * t1 - s1 * t0;
+            if (signed_area == 0.0f) continue; // no uv mapping to follow
+
+            // Direction of increasing u; only its direction matters, as in MikkTSpace.
+            Vector3 tangent = { e0[0] * t1 - e1[0] * t0, e0[1] * t1 - e1[1] * t0, e0[2] * t1 - e1[2] * t0 };
+            float handedness = signed_area > 0.0f ? 1.0f : -1.0f;
+            float angles[3];
+            Mesh_corner_angles(v0->position, v1->position, v2->position, angles);
+            for (int i = 0; i < 3; i++) {
+                // Each corner projects the tangent into its own vertex's tangent plane before weighting.
+                const GLfloat *n = mesh->vertices[corner[i]].normal;
+                float d = tangent[0] * n[0] + tangent[1] * n[1] + tangent[2] * n[2];
+                Vector3 projected = { tangent[0] - n[0] * d, tangent[1] - n[1] * d, tangent[2] - n[2] * d };
+                Vector3_normalize(projected);
+                GLfloat *sum = accumulator + (size_t)corner[i] * accumulation->stride;
+                sum[0] += projected[0] * angles[i];
+                sum[1] += projected[1] * angles[i];
+                sum[2] += projected[2] * angles[i];
+                sum[3] += handedness * angles[i];
+            }
+        }
+    }
+}
+
+void Mesh_reduce_tangents(void *data, int begin, int end) {
+    MeshAccumulation *accumulation = data;
+    Mesh *mesh = accumulation->mesh;
+    for (int v = begin; v < end; v++) {
+        const GLfloat *n = mesh->vertices[v].normal;
+        Vector3 tangent = { Mesh_accumulated(accumulation, v, 0), Mesh_accumulated(accumulation, v, 1), Mesh_accumulated(accumulation, v, 2) };
+        float d = Vector3_dot(tangent, (GLfloat *)n);
+        for (int c = 0; c < 3; c++) tangent[c] -= n[c] * d;
+        if (Vector3_dot(tangent, tangent) < 1e-12f) {
+            // No usable uvs: any direction in the tangent plane keeps the basis valid.
+            Vector3 axis = { fabsf(n[0]) < 0.9f ? 1.0f : 0.0f, fabsf(n[0]) < 0.9f ? 0.0f : 1.0f, 0.0f };
+            Vector3_cross(tangent, axis, (GLfloat *)n);
+        }
+        Vector3_normalize(tangent);
+        mesh->tangents[v][0] = tangent[0];
+        mesh->tangents[v][1] = tangent[1];
+        mesh->tangents[v][2] = tangent[2];
+        mesh->tangents[v][3] = Mesh_accumulated(accumulation, v, 3) < 0.0f ? -1.0f : 1.0f;
+    }
+}
+
+// Fills mesh->tangents, allocating it if needed, from the uvs and the current normals.
+void Mesh_compute_tangents(Mesh *mesh, JobSystem *jobs) {
+    if (!mesh->tangents) {
+        mesh->tangents = malloc((mesh->vertex_count > 0 ? mesh->vertex_count : 1) * sizeof(Vector4));
+        if (!mesh->tangents) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    MeshAccumulation accumulation;
+    if (!Mesh_accumulation_begin(&accumulation, mesh, jobs, 4)) {
+        memset(mesh->tangents, 0, mesh->vertex_count * sizeof(Vector4));
+        return;
+    }
+    JobSystem_parallel_for(jobs, accumulation.task_count, 1, Mesh_accumulate_tangents, &accumulation);
+    JobSystem_parallel_for(jobs, (int)mesh->vertex_count, MESH_NORMALS_REDUCE_BATCH, Mesh_reduce_tangents, &accumulation);
+    free(accumulation.accumulators);
+}
+
+#endif
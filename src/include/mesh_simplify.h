@@ -0,0 +1,508 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include "jobs.h"
+#include "linalg.h"
+#include "mesh.h"
+#include "mesh_optimize.h"
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Quadric error edge collapse (Garland and Heckbert 1997). Vertices only ever collapse onto a
+// neighbour, so simplified index buffers keep using the original vertices and a whole LOD chain
+// shares one vertex buffer. Every pass sorts the candidate collapses by error, applies the cheapest
+// ones that touch disjoint vertices and drops the triangles that became degenerate.
+// Topology decides what may move where:
+//   manifold  a vertex alone at its position with closed surroundings; collapses anywhere
+//   border    on one open edge loop; slides along it only, so holes and outlines keep their shape
+//   seam      one of two vertices sharing a position where uvs or normals are split; slides along
+//             the seam together with its twin, so the split never tears
+//   locked    everything else (corners, seams meeting, non-manifold fans); never moves
+// Errors are distances in mesh units: the root of the area weighted mean squared distance to the
+// planes of the triangles that were merged into a vertex.
+
+#define MESH_LOD_MAX_LEVELS 8
+#define MESH_LOD_REDUCTION 0.5f // triangles kept by each level relative to the previous one
+#define MESH_LOD_MIN_TRIANGLES 128 // no levels are made below this
+#define MESH_LOD_MAX_ERROR 0.05f // relative to the mesh's size; levels stop simplifying there
+#define MESH_LOD_PIXEL_ERROR 1.0f // projected error the runtime accepts
+#define MESH_SIMPLIFY_BORDER_WEIGHT 10.0f // keeps borders from sliding inward
+#define MESH_SIMPLIFY_ERROR_SLACK 1.5f // how far past the goal's error a pass may still collapse
+
+#define MESH_SIMPLIFY_NONE (~0u)
+#define MESH_SIMPLIFY_MULTIPLE (~0u - 1)
+
+enum {
+    MESH_VERTEX_MANIFOLD,
+    MESH_VERTEX_BORDER,
+    MESH_VERTEX_SEAM,
+    MESH_VERTEX_LOCKED,
+};
+
+typedef struct {
+    float a00, a11, a22, a10, a20, a21; // symmetric 3x3
+    float b0, b1, b2;
+    float c;
+    float weight;
+} MeshQuadric;
+
+typedef struct {
+    GLuint from, to;
+    float error;
+} MeshCollapse;
+
+typedef struct {
+    unsigned int first_index;
+    unsigned int index_count;
+    float error; // in mesh units, relative to level 0
+} MeshLod;
+
+// Level 0 is the mesh's own index buffer; every level's indices follow the previous level's.
+typedef struct {
+    GLuint *indices;
+    unsigned int index_count;
+    MeshLod levels[MESH_LOD_MAX_LEVELS];
+    int level_count;
+} MeshLodChain;
+
+// Plane n.p + d = 0, n unit length.
+void MeshQuadric_from_plane(MeshQuadric *q, const Vector3 n, float d, float weight) {
+    q->a00 = n[0] * n[0] * weight;
+    q->a11 = n[1] * n[1] * weight;
+    q->a22 = n[2] * n[2] * weight;
+    q->a10 = n[1] * n[0] * weight;
+    q->a20 = n[2] * n[0] * weight;
+    q->a21 = n[2] * n[1] * weight;
+    q->b0 = n[0] * d * weight;
+    q->b1 = n[1] * d * weight;
+    q->b2 = n[2] * d * weight;
+    q->c = d * d * weight;
+    q->weight = weight;
+}
+
+void MeshQuadric_add(MeshQuadric *q, const MeshQuadric *r) {
+    q->a00 += r->a00;
+    q->a11 += r->a11;
+    q->a22 += r->a22;
+    q->a10 += r->a10;
+    q->a20 += r->a20;
+    q->a21 += r->a21;
+    q->b0 += r->b0;
+    q->b1 += r->b1;
+    q->b2 += r->b2;
+    q->c += r->c;
+    q->weight += r->weight;
+}
+
+// Weighted mean squared distance of p to the quadric's planes.
+float MeshQuadric_error(const MeshQuadric *q, const float *p) {
+    float ax = q->a00 * p[0] + q->a10 * p[1] + q->a20 * p[2];
+    float ay = q->a10 * p[0] + q->a11 * p[1] + q->a21 * p[2];
+    float az = q->a20 * p[0] + q->a21 * p[1] + q->a22 * p[2];
+    float r = ax * p[0] + ay * p[1] + az * p[2] + 2.0f * (q->b0 * p[0] + q->b1 * p[1] + q->b2 * p[2]) + q->c;
+    return q->weight > 0.0f ? fabsf(r) / q->weight : 0.0f;
+}
+
+int MeshCollapse_compare(const void *a, const void *b) {
+    float x = ((const MeshCollapse *)a)->error, y = ((const MeshCollapse *)b)->error;
+    return (x > y) - (x < y);
+}
+
+// Whether a triangle around a has the half edge a -> b.
+int Mesh_has_edge(const MeshAdjacency *adjacency, const GLuint *indices, GLuint a, GLuint b) {
+    for (unsigned int i = adjacency->offsets[a]; i < adjacency->offsets[a + 1]; i++) {
+        const GLuint *corner = &indices[adjacency->triangles[i] * 3];
+        for (int c = 0; c < 3; c++) {
+            if (corner[c] == a && corner[(c + 1) % 3] == b) return 1;
+        }
+    }
+    return 0;
+}
+
+// remap[v] is the first vertex at v's position and wedge[v] the next one there, circularly.
+void Mesh_position_groups(GLuint *remap, GLuint *wedge, const MeshVertex *vertices, unsigned int vertex_count) {
+    unsigned int capacity = 1;
+    while (capacity < vertex_count * 2) capacity *= 2;
+    GLuint *table = malloc(capacity * sizeof(GLuint));
+    if (!table) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    memset(table, 0xff, capacity * sizeof(GLuint));
+    for (unsigned int v = 0; v < vertex_count; v++) {
+        uint32_t words[3];
+        memcpy(words, vertices[v].position, sizeof(words));
+        uint64_t hash = 0;
+        for (int i = 0; i < 3; i++) hash = (hash ^ (words[i] == 0x80000000u ? 0 : words[i])) * 0x9e3779b97f4a7c15ull; // -0 is 0
+        unsigned int slot = (unsigned int)(hash >> 32) & (capacity - 1);
+        while (table[slot] != MESH_SIMPLIFY_NONE) {
+            const GLfloat *p = vertices[table[slot]].position;
+            if (p[0] == vertices[v].position[0] && p[1] == vertices[v].position[1] && p[2] == vertices[v].position[2]) break;
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if (table[slot] == MESH_SIMPLIFY_NONE) {
+            table[slot] = v;
+            remap[v] = v;
+            wedge[v] = v;
+        } else {
+            GLuint root = table[slot];
+            remap[v] = root;
+            wedge[v] = wedge[root];
+            wedge[root] = v;
+        }
+    }
+    free(table);
+}
+
+// Finds each vertex's open half edges (loop: v -> loop[v], loopback: loopback[v] -> v) and kind.
+void Mesh_classify_vertices(unsigned char *kinds, GLuint *loop, GLuint *loopback, const GLuint *indices, unsigned int index_count,
+    unsigned int vertex_count, const GLuint *remap, const GLuint *wedge) {
+    MeshAdjacency adjacency;
+    MeshAdjacency_build(&adjacency, indices, index_count, vertex_count);
+    memset(loop, 0xff, vertex_count * sizeof(GLuint));
+    memset(loopback, 0xff, vertex_count * sizeof(GLuint));
+    for (unsigned int i = 0; i < index_count; i++) {
+        GLuint a = indices[i], b = indices[i - i % 3 + (i + 1) % 3];
+        if (Mesh_has_edge(&adjacency, indices, b, a)) continue;
+        loop[a] = loop[a] == MESH_SIMPLIFY_NONE || loop[a] == b ? b : MESH_SIMPLIFY_MULTIPLE;
+        loopback[b] = loopback[b] == MESH_SIMPLIFY_NONE || loopback[b] == a ? a : MESH_SIMPLIFY_MULTIPLE;
+    }
+    MeshAdjacency_free(&adjacency);
+
+    for (unsigned int v = 0; v < vertex_count; v++) {
+        if (remap[v] != v) continue;
+        unsigned char kind = MESH_VERTEX_LOCKED;
+        if (wedge[v] == v) {
+            if (loop[v] == MESH_SIMPLIFY_NONE && loopback[v] == MESH_SIMPLIFY_NONE) kind = MESH_VERTEX_MANIFOLD;
+            else if (loop[v] < MESH_SIMPLIFY_MULTIPLE && loopback[v] < MESH_SIMPLIFY_MULTIPLE) kind = MESH_VERTEX_BORDER;
+        } else if (wedge[wedge[v]] == v) {
+            // Two wedges whose open edges run opposite each other close the surface between them.
+            GLuint w = wedge[v];
+            if (loop[v] < MESH_SIMPLIFY_MULTIPLE && loopback[v] < MESH_SIMPLIFY_MULTIPLE && loop[w] < MESH_SIMPLIFY_MULTIPLE &&
+                loopback[w] < MESH_SIMPLIFY_MULTIPLE && remap[loop[v]] == remap[loopback[w]] && remap[loopback[v]] == remap[loop[w]] &&
+                remap[loop[v]] != remap[loopback[v]]) {
+                kind = MESH_VERTEX_SEAM;
+            }
+        }
+        kinds[v] = kind;
+    }
+    for (unsigned int v = 0; v < vertex_count; v++) kinds[v] = kinds[remap[v]];
+}
+
+// Whether moving every wedge of from onto to's position turns any surviving triangle over.
+int Mesh_collapse_flips(const MeshAdjacency *adjacency, const GLuint *indices, const float *positions, const GLuint *remap, const GLuint *wedge,
+    GLuint from, GLuint to) {
+    const float *target = &positions[remap[to] * 3];
+    GLuint w = from;
+    do {
+        for (unsigned int i = adjacency->offsets[w]; i < adjacency->offsets[w + 1]; i++) {
+            const GLuint *corner = &indices[adjacency->triangles[i] * 3];
+            int c = corner[0] == w ? 0 : corner[1] == w ? 1 : 2;
+            GLuint a = corner[(c + 1) % 3], b = corner[(c + 2) % 3];
+            if (remap[a] == remap[to] || remap[b] == remap[to]) continue; // collapses away
+            const float *p = &positions[remap[w] * 3], *pa = &positions[remap[a] * 3], *pb = &positions[remap[b] * 3];
+            Vector3 e0 = { pa[0] - p[0], pa[1] - p[1], pa[2] - p[2] };
+            Vector3 e1 = { pb[0] - p[0], pb[1] - p[1], pb[2] - p[2] };
+            Vector3 f0 = { pa[0] - target[0], pa[1] - target[1], pa[2] - target[2] };
+            Vector3 f1 = { pb[0] - target[0], pb[1] - target[1], pb[2] - target[2] };
+            Vector3 before, after;
+            Vector3_cross(before, e0, e1);
+            Vector3_cross(after, f0, f1);
+            if (Vector3_dot(before, after) <= 0.0f) return 1;
+        }
+        w = wedge[w];
+    } while (w != from);
+    return 0;
+}
+
+// Writes at most index_count indices simplifying indices towards target_index_count to destination
+// (which may alias indices) and returns how many; stops early rather than exceed target_error, in
+// mesh units. The error reached is stored in result_error if it is not NULL.
+unsigned int Mesh_simplify(GLuint *destination, const GLuint *indices, unsigned int index_count, const MeshVertex *vertices, unsigned int vertex_count,
+    unsigned int target_index_count, float target_error, float *result_error) {
+    index_count -= index_count % 3;
+    memmove(destination, indices, index_count * sizeof(GLuint));
+    if (result_error) *result_error = 0.0f;
+    if (index_count <= target_index_count || vertex_count == 0) return index_count;
+
+    GLuint *remap = malloc(vertex_count * sizeof(GLuint));
+    GLuint *wedge = malloc(vertex_count * sizeof(GLuint));
+    GLuint *loop = malloc(vertex_count * sizeof(GLuint));
+    GLuint *loopback = malloc(vertex_count * sizeof(GLuint));
+    GLuint *collapse_remap = malloc(vertex_count * sizeof(GLuint));
+    unsigned char *kinds = malloc(vertex_count);
+    unsigned char *locked = malloc(vertex_count);
+    float *positions = malloc((size_t)vertex_count * 3 * sizeof(float));
+    MeshQuadric *quadrics = calloc(vertex_count, sizeof(MeshQuadric));
+    MeshCollapse *collapses = malloc(index_count * sizeof(MeshCollapse));
+    if (!remap || !wedge || !loop || !loopback || !collapse_remap || !kinds || !locked || !positions || !quadrics || !collapses) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    Mesh_position_groups(remap, wedge, vertices, vertex_count);
+    Mesh_classify_vertices(kinds, loop, loopback, destination, index_count, vertex_count, remap, wedge);
+
+    // Quadrics are built in a unit box so their float sums keep their precision on any mesh size.
+    Vector3 low = { FLT_MAX, FLT_MAX, FLT_MAX }, high = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (unsigned int v = 0; v < vertex_count; v++) {
+        for (int c = 0; c < 3; c++) {
+            low[c] = fminf(low[c], vertices[v].position[c]);
+            high[c] = fmaxf(high[c], vertices[v].position[c]);
+        }
+    }
+    float extent = fmaxf(high[0] - low[0], fmaxf(high[1] - low[1], high[2] - low[2]));
+    float scale = extent > 0.0f ? 1.0f / extent : 0.0f;
+    for (unsigned int v = 0; v < vertex_count; v++) {
+        for (int c = 0; c < 3; c++) positions[v * 3 + c] = (vertices[v].position[c] - low[c]) * scale;
+    }
+    float error_limit = target_error * scale * target_error * scale;
+
+    for (unsigned int i = 0; i < index_count; i += 3) {
+        const float *p0 = &positions[remap[destination[i]] * 3];
+        const float *p1 = &positions[remap[destination[i + 1]] * 3];
+        const float *p2 = &positions[remap[destination[i + 2]] * 3];
+        Vector3 e0 = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        Vector3 e1 = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        Vector3 normal;
+        Vector3_cross(normal, e0, e1);
+        float area = sqrtf(Vector3_dot(normal, normal));
+        if (area == 0.0f) continue;
+        Vector3_scale(normal, normal, 1.0f / area);
+        MeshQuadric q;
+        MeshQuadric_from_plane(&q, normal, -Vector3_dot(normal, (float *)p0), area);
+        for (int c = 0; c < 3; c++) MeshQuadric_add(&quadrics[remap[destination[i + c]]], &q);
+
+        // Open edges also get a plane through them, perpendicular to the triangle, weighted by length.
+        for (int c = 0; c < 3; c++) {
+            GLuint a = destination[i + c], b = destination[i + (c + 1) % 3];
+            if (loop[a] != b || kinds[a] == MESH_VERTEX_SEAM) continue;
+            const float *pa = &positions[remap[a] * 3], *pb = &positions[remap[b] * 3], *po = &positions[remap[destination[i + (c + 2) % 3]] * 3];
+            Vector3 edge = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+            float length = sqrtf(Vector3_dot(edge, edge));
+            if (length == 0.0f) continue;
+            Vector3_scale(edge, edge, 1.0f / length);
+            Vector3 side = { po[0] - pa[0], po[1] - pa[1], po[2] - pa[2] };
+            float along = Vector3_dot(side, edge);
+            Vector3 perpendicular = { side[0] - edge[0] * along, side[1] - edge[1] * along, side[2] - edge[2] * along };
+            float perpendicular_length = sqrtf(Vector3_dot(perpendicular, perpendicular));
+            if (perpendicular_length == 0.0f) continue;
+            Vector3_scale(perpendicular, perpendicular, 1.0f / perpendicular_length);
+            MeshQuadric border;
+            MeshQuadric_from_plane(&border, perpendicular, -Vector3_dot(perpendicular, (float *)pa), length * length * MESH_SIMPLIFY_BORDER_WEIGHT);
+            MeshQuadric_add(&quadrics[remap[a]], &border);
+            MeshQuadric_add(&quadrics[remap[b]], &border);
+        }
+    }
+
+    static const unsigned char can_collapse[4][4] = {
+        { 1, 1, 1, 1 }, // manifold
+        { 0, 1, 0, 0 }, // border
+        { 0, 0, 1, 0 }, // seam
+        { 0, 0, 0, 0 }, // locked
+    };
+    float worst_error = 0.0f;
+    while (index_count > target_index_count) {
+        MeshAdjacency adjacency;
+        MeshAdjacency_build(&adjacency, destination, index_count, vertex_count);
+
+        unsigned int collapse_count = 0;
+        for (unsigned int i = 0; i < index_count; i++) {
+            GLuint i0 = destination[i], i1 = destination[i - i % 3 + (i + 1) % 3];
+            unsigned char k0 = kinds[i0], k1 = kinds[i1];
+            if (!can_collapse[k0][k1] && !can_collapse[k1][k0]) continue;
+            // Two vertices on borders or seams must share the open edge, not just a triangle.
+            if ((k0 == MESH_VERTEX_BORDER || k0 == MESH_VERTEX_SEAM) && k1 != MESH_VERTEX_MANIFOLD && loop[i0] != i1) continue;
+            if ((k1 == MESH_VERTEX_BORDER || k1 == MESH_VERTEX_SEAM) && k0 != MESH_VERTEX_MANIFOLD && loopback[i1] != i0) continue;
+            // Everything but the tracked open edges shows up in two triangles; keep one.
+            if (remap[i0] > remap[i1] && loop[i0] != i1) continue;
+
+            float e0 = can_collapse[k0][k1] ? MeshQuadric_error(&quadrics[remap[i0]], &positions[remap[i1] * 3]) : FLT_MAX;
+            float e1 = can_collapse[k1][k0] ? MeshQuadric_error(&quadrics[remap[i1]], &positions[remap[i0] * 3]) : FLT_MAX;
+            MeshCollapse *collapse = &collapses[collapse_count++];
+            collapse->from = e0 <= e1 ? i0 : i1;
+            collapse->to = e0 <= e1 ? i1 : i0;
+            collapse->error = fminf(e0, e1);
+        }
+        if (collapse_count == 0) {
+            MeshAdjacency_free(&adjacency);
+            break;
+        }
+        qsort(collapses, collapse_count, sizeof(MeshCollapse), MeshCollapse_compare);
+
+        // Most collapses remove two triangles; the pass aims for half of what is left to remove and
+        // stops once errors grow well past what reaching that would cost, or past what was already
+        // spent, since collapses below that leave the result's error as it is.
+        unsigned int triangle_goal = (index_count - target_index_count) / 3;
+        unsigned int edge_goal = (triangle_goal + 1) / 2;
+        float error_goal = collapses[edge_goal < collapse_count ? edge_goal : collapse_count - 1].error * MESH_SIMPLIFY_ERROR_SLACK;
+        error_goal = fmaxf(error_goal, worst_error);
+
+        for (unsigned int v = 0; v < vertex_count; v++) collapse_remap[v] = v;
+        memset(locked, 0, vertex_count);
+        unsigned int removed = 0, applied = 0;
+        for (unsigned int c = 0; c < collapse_count && removed < triangle_goal; c++) {
+            const MeshCollapse *collapse = &collapses[c];
+            if (collapse->error > error_limit) break;
+            if (collapse->error > error_goal && applied > 0) break;
+            GLuint from = collapse->from, to = collapse->to;
+            if (locked[remap[from]] || locked[remap[to]]) continue;
+            if (Mesh_collapse_flips(&adjacency, destination, positions, remap, wedge, from, to)) continue;
+
+            if (kinds[from] == MESH_VERTEX_SEAM) {
+                // The twin follows along its own open edge, which runs the other way.
+                GLuint twin = wedge[from];
+                GLuint twin_to = loop[from] == to ? loopback[twin] : loop[twin];
+                if (twin_to >= MESH_SIMPLIFY_MULTIPLE || remap[twin_to] != remap[to] || twin_to == to) continue;
+                collapse_remap[twin] = twin_to;
+            }
+            collapse_remap[from] = to;
+            MeshQuadric_add(&quadrics[remap[to]], &quadrics[remap[from]]);
+            locked[remap[from]] = locked[remap[to]] = 1;
+            removed += kinds[from] == MESH_VERTEX_BORDER ? 1 : 2;
+            applied++;
+            worst_error = fmaxf(worst_error, collapse->error);
+        }
+        MeshAdjacency_free(&adjacency);
+        if (applied == 0) break;
+
+        // Open edges that ended at a collapsed vertex now end where it went.
+        for (unsigned int v = 0; v < vertex_count; v++) {
+            GLuint *loops[2] = { &loop[v], &loopback[v] };
+            GLuint *reverse[2] = { loop, loopback };
+            for (int l = 0; l < 2; l++) {
+                GLuint next = *loops[l];
+                if (next >= MESH_SIMPLIFY_MULTIPLE) continue;
+                GLuint target = collapse_remap[next];
+                if (target == v) target = reverse[l][next] < MESH_SIMPLIFY_MULTIPLE ? collapse_remap[reverse[l][next]] : reverse[l][next]; // v swallowed next
+                *loops[l] = target;
+            }
+        }
+
+        unsigned int write = 0;
+        for (unsigned int i = 0; i < index_count; i += 3) {
+            GLuint a = collapse_remap[destination[i]], b = collapse_remap[destination[i + 1]], c = collapse_remap[destination[i + 2]];
+            if (a == b || b == c || c == a) continue;
+            destination[write++] = a;
+            destination[write++] = b;
+            destination[write++] = c;
+        }
+        index_count = write;
+    }
+
+    if (result_error) *result_error = sqrtf(worst_error) * extent;
+    free(remap);
+    free(wedge);
+    free(loop);
+    free(loopback);
+    free(collapse_remap);
+    free(kinds);
+    free(locked);
+    free(positions);
+    free(quadrics);
+    free(collapses);
+    return index_count;
+}
+
+typedef struct {
+    const Mesh *mesh;
+    unsigned int cache_size;
+    float max_error;
+    GLuint *indices[MESH_LOD_MAX_LEVELS];
+    MeshLod levels[MESH_LOD_MAX_LEVELS];
+} MeshLodBuild;
+
+// Each level is simplified from level 0, so its error is measured against the full mesh, then
+// reordered for the vertex cache.
+void MeshLodChain_build_level(void *data, int begin, int end) {
+    MeshLodBuild *build = data;
+    const Mesh *mesh = build->mesh;
+    for (int level = begin + 1; level < end + 1; level++) {
+        float target = (float)(mesh->index_count / 3) * powf(MESH_LOD_REDUCTION, (float)level);
+        GLuint *simplified = malloc((mesh->index_count + 1) * sizeof(GLuint));
+        unsigned int *clusters = malloc((mesh->index_count / 3 + 1) * sizeof(unsigned int));
+        build->indices[level] = malloc((mesh->index_count + 1) * sizeof(GLuint));
+        if (!simplified || !clusters || !build->indices[level]) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        MeshLod *lod = &build->levels[level];
+        lod->index_count = Mesh_simplify(simplified, mesh->indices, mesh->index_count, mesh->vertices, mesh->vertex_count, (unsigned int)target * 3,
+            build->max_error, &lod->error);
+        Mesh_tipsify(build->indices[level], clusters, simplified, lod->index_count, mesh->vertex_count, build->cache_size);
+        free(simplified);
+        free(clusters);
+    }
+}
+
+// Level 0 is mesh's index buffer as is; coarser levels halve the triangle count down to
+// MESH_LOD_MIN_TRIANGLES and are built in parallel. Levels that locked vertices or the error cap
+// kept from shrinking are dropped.
+void MeshLodChain_build(MeshLodChain *chain, const Mesh *mesh, JobSystem *jobs, unsigned int cache_size) {
+    MeshLodBuild build = { .mesh = mesh, .cache_size = cache_size };
+    Vector3 low = { FLT_MAX, FLT_MAX, FLT_MAX }, high = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (unsigned int v = 0; v < mesh->vertex_count; v++) {
+        for (int c = 0; c < 3; c++) {
+            low[c] = fminf(low[c], mesh->vertices[v].position[c]);
+            high[c] = fmaxf(high[c], mesh->vertices[v].position[c]);
+        }
+    }
+    build.max_error = fmaxf(high[0] - low[0], fmaxf(high[1] - low[1], high[2] - low[2])) * MESH_LOD_MAX_ERROR;
+    int level_count = 1;
+    float triangles = (float)(mesh->index_count / 3);
+    while (level_count < MESH_LOD_MAX_LEVELS && triangles * MESH_LOD_REDUCTION >= MESH_LOD_MIN_TRIANGLES) {
+        triangles *= MESH_LOD_REDUCTION;
+        level_count++;
+    }
+    JobSystem_parallel_for(jobs, level_count - 1, 1, MeshLodChain_build_level, &build);
+
+    build.indices[0] = mesh->indices;
+    build.levels[0].index_count = mesh->index_count - mesh->index_count % 3;
+    build.levels[0].error = 0.0f;
+    int sources[MESH_LOD_MAX_LEVELS];
+    chain->level_count = 0;
+    chain->index_count = 0;
+    for (int level = 0; level < level_count; level++) {
+        MeshLod *lod = &build.levels[level];
+        if (chain->level_count > 0) {
+            const MeshLod *previous = &chain->levels[chain->level_count - 1];
+            if (lod->index_count == 0 || lod->index_count > previous->index_count * 0.9f) continue;
+            lod->error = fmaxf(lod->error, previous->error);
+        }
+        lod->first_index = chain->index_count;
+        sources[chain->level_count] = level;
+        chain->levels[chain->level_count++] = *lod;
+        chain->index_count += lod->index_count;
+    }
+
+    chain->indices = malloc((chain->index_count > 0 ? chain->index_count : 1) * sizeof(GLuint));
+    if (!chain->indices) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (int level = 0; level < chain->level_count; level++) {
+        memcpy(chain->indices + chain->levels[level].first_index, build.indices[sources[level]], chain->levels[level].index_count * sizeof(GLuint));
+    }
+    for (int level = 1; level < level_count; level++) free(build.indices[level]);
+}
+
+void MeshLodChain_free(MeshLodChain *chain) {
+    free(chain->indices);
+    chain->indices = NULL;
+    chain->index_count = 0;
+    chain->level_count = 0;
+}
+
+// The coarsest level whose error projects to at most pixel_error pixels on a viewport_height tall
+// view, seen from distance mesh units away (measured to the bounds, so 0 when inside them).
+int MeshLodChain_select(const MeshLodChain *chain, float distance, float fov_y, float viewport_height, float pixel_error) {
+    if (distance <= 0.0f) return 0;
+    float pixels_per_unit = viewport_height / (2.0f * distance * tanf(fov_y / 2.0f));
+    int level = 0;
+    while (level + 1 < chain->level_count && chain->levels[level + 1].error * pixels_per_unit <= pixel_error) level++;
+    return level;
+}
+
+#endif
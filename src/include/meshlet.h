@@ -0,0 +1,356 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include "geometry_pool.h"
+#include "linalg.h"
+#include "mesh.h"
+#include "mesh_optimize.h"
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Splits an index buffer into meshlets, small clusters of triangles that are contiguous in the
+// buffer, and culls them against the camera every frame:
+// - Meshlets grow greedily from a seed triangle through shared vertices, preferring triangles that
+//   add no new vertex and then those facing the way the meshlet already does, so the clusters come
+//   out compact with tight normal cones.
+// - Each one gets a bounding sphere and a normal cone. The cone's apex is placed so that if the
+//   camera sees it from the back side, within the cone, every triangle in the meshlet faces away.
+// - Meshlets_cull tests four meshlets at a time from a structure of arrays copy of the bounds and
+//   adds the survivors to a GeometryBatch, which merges neighbours in the buffer into one draw.
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+#define MESHLET_MIN_CONE_SPREAD 0.1f // cones wider than about 84 degrees from the axis never cull
+
+typedef struct {
+    unsigned int first_index; // absolute, in the index buffer the meshlets were built for
+    unsigned int triangle_count;
+    unsigned int vertex_count;
+    Vector3 center;
+    float radius;
+    Vector3 cone_apex;
+    Vector3 cone_axis;
+    float cone_cutoff; // sine of the cone's half angle, 1 for cones that never cull
+} Meshlet;
+
+// Structure of arrays copy of the bounds, padded to a multiple of 4 with meshlets that always cull.
+enum {
+    MESHLET_CENTER_X,
+    MESHLET_CENTER_Y,
+    MESHLET_CENTER_Z,
+    MESHLET_RADIUS,
+    MESHLET_APEX_X,
+    MESHLET_APEX_Y,
+    MESHLET_APEX_Z,
+    MESHLET_AXIS_X,
+    MESHLET_AXIS_Y,
+    MESHLET_AXIS_Z,
+    MESHLET_CUTOFF,
+    MESHLET_BOUNDS_STREAMS,
+};
+
+typedef struct {
+    Meshlet *meshlets;
+    unsigned int meshlet_count;
+    float *bounds; // MESHLET_BOUNDS_STREAMS streams of padded_count floats
+    unsigned int padded_count;
+} Meshlets;
+
+// Frustum planes (inside where dot(xyz, p) + w >= 0, xyz unit length) and camera, in mesh space.
+typedef struct {
+    Vector4 planes[6];
+    Vector3 camera_position;
+} MeshletView;
+
+typedef struct {
+    unsigned int meshlets;
+    unsigned int triangles;
+    unsigned int ranges;
+} MeshletCullStats;
+
+// Triangles around a meshlet's vertices that are still unassigned; returns -1 if there are none.
+long long Meshlets_pick_triangle(const MeshAdjacency *adjacency, const GLuint *indices, const unsigned char *assigned, const unsigned char *in_meshlet,
+    const GLuint *meshlet_vertices, unsigned int vertex_count, const float *triangle_normals, const Vector3 normal_sum) {
+    long long best = -1;
+    int best_new = 4;
+    float best_facing = -FLT_MAX;
+    for (unsigned int v = 0; v < vertex_count; v++) {
+        GLuint vertex = meshlet_vertices[v];
+        for (unsigned int a = adjacency->offsets[vertex]; a < adjacency->offsets[vertex + 1]; a++) {
+            unsigned int t = adjacency->triangles[a];
+            if (assigned[t]) continue;
+            int new_vertices = !in_meshlet[indices[t * 3]] + !in_meshlet[indices[t * 3 + 1]] + !in_meshlet[indices[t * 3 + 2]];
+            const float *n = &triangle_normals[t * 3];
+            float facing = n[0] * normal_sum[0] + n[1] * normal_sum[1] + n[2] * normal_sum[2];
+            if (new_vertices < best_new || (new_vertices == best_new && facing > best_facing)) {
+                best = t;
+                best_new = new_vertices;
+                best_facing = facing;
+            }
+        }
+    }
+    return best;
+}
+
+// Sphere around the meshlet's vertices and the cone that bounds its triangle normals.
+void Meshlet_compute_bounds(Meshlet *meshlet, const GLuint *indices, const MeshVertex *vertices, const float *triangle_normals,
+    const unsigned int *triangles) {
+    Vector3 low = { FLT_MAX, FLT_MAX, FLT_MAX }, high = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (unsigned int i = 0; i < meshlet->triangle_count * 3; i++) {
+        const GLfloat *p = vertices[indices[i]].position;
+        for (int c = 0; c < 3; c++) {
+            low[c] = fminf(low[c], p[c]);
+            high[c] = fmaxf(high[c], p[c]);
+        }
+    }
+    float radius = 0.0f;
+    for (int c = 0; c < 3; c++) meshlet->center[c] = (low[c] + high[c]) * 0.5f;
+    for (unsigned int i = 0; i < meshlet->triangle_count * 3; i++) {
+        const GLfloat *p = vertices[indices[i]].position;
+        Vector3 d = { p[0] - meshlet->center[0], p[1] - meshlet->center[1], p[2] - meshlet->center[2] };
+        radius = fmaxf(radius, Vector3_dot(d, d));
+    }
+    meshlet->radius = sqrtf(radius);
+
+    Vector3 axis = { 0.0f, 0.0f, 0.0f };
+    for (unsigned int t = 0; t < meshlet->triangle_count; t++) {
+        for (int c = 0; c < 3; c++) axis[c] += triangle_normals[triangles[t] * 3 + c];
+    }
+    float length = sqrtf(Vector3_dot(axis, axis));
+    float spread = length > 0.0f ? 1.0f : -1.0f; // smallest cosine between the axis and a normal
+    if (length > 0.0f) Vector3_scale(axis, axis, 1.0f / length);
+    for (unsigned int t = 0; t < meshlet->triangle_count && spread > 0.0f; t++) {
+        const float *n = &triangle_normals[triangles[t] * 3];
+        if (n[0] == 0.0f && n[1] == 0.0f && n[2] == 0.0f) continue; // degenerate
+        spread = fminf(spread, n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2]);
+    }
+    memcpy(meshlet->cone_axis, axis, sizeof(Vector3));
+    memcpy(meshlet->cone_apex, meshlet->center, sizeof(Vector3));
+    meshlet->cone_cutoff = 1.0f;
+    if (spread < MESHLET_MIN_CONE_SPREAD) return;
+
+    // Back the apex off along the axis until it lies behind every triangle's plane.
+    float behind = 0.0f;
+    for (unsigned int t = 0; t < meshlet->triangle_count; t++) {
+        const float *n = &triangle_normals[triangles[t] * 3];
+        float along = n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2];
+        if (along <= 0.0f) continue;
+        const GLfloat *p = vertices[indices[t * 3]].position;
+        Vector3 d = { meshlet->center[0] - p[0], meshlet->center[1] - p[1], meshlet->center[2] - p[2] };
+        behind = fmaxf(behind, (d[0] * n[0] + d[1] * n[1] + d[2] * n[2]) / along);
+    }
+    for (int c = 0; c < 3; c++) meshlet->cone_apex[c] = meshlet->center[c] - axis[c] * behind;
+    meshlet->cone_cutoff = sqrtf(1.0f - spread * spread);
+}
+
+void Meshlets_free(Meshlets *meshlets) {
+    free(meshlets->meshlets);
+    free(meshlets->bounds);
+    meshlets->meshlets = NULL;
+    meshlets->bounds = NULL;
+    meshlets->meshlet_count = 0;
+    meshlets->padded_count = 0;
+}
+
+// Reorders the triangles of indices, which start at first_index in their index buffer, into
+// meshlets of at most MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles.
+void Meshlets_build(Meshlets *meshlets, GLuint *indices, unsigned int index_count, unsigned int first_index, const MeshVertex *vertices,
+    unsigned int vertex_count) {
+    unsigned int triangle_count = index_count / 3;
+    MeshAdjacency adjacency;
+    MeshAdjacency_build(&adjacency, indices, triangle_count * 3, vertex_count);
+    float *triangle_normals = malloc(((size_t)triangle_count * 3 + 1) * sizeof(float));
+    unsigned char *assigned = calloc(triangle_count + 1, 1);
+    unsigned char *in_meshlet = calloc(vertex_count + 1, 1);
+    unsigned int *order = malloc((triangle_count + 1) * sizeof(unsigned int));
+    GLuint *ordered = malloc(((size_t)triangle_count * 3 + 1) * sizeof(GLuint));
+    meshlets->meshlets = malloc((triangle_count + 1) * sizeof(Meshlet)); // each has at least one triangle
+    if (!triangle_normals || !assigned || !in_meshlet || !order || !ordered || !meshlets->meshlets) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (unsigned int t = 0; t < triangle_count; t++) {
+        const GLfloat *p0 = vertices[indices[t * 3]].position;
+        const GLfloat *p1 = vertices[indices[t * 3 + 1]].position;
+        const GLfloat *p2 = vertices[indices[t * 3 + 2]].position;
+        Vector3 e0 = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        Vector3 e1 = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        // Front faces wind counter-clockwise on screen, which through the left-handed view puts their
+        // outward side at e1 x e0.
+        Vector3 normal;
+        Vector3_cross(normal, e1, e0);
+        float length = sqrtf(Vector3_dot(normal, normal));
+        if (length > 0.0f) Vector3_scale(normal, normal, 1.0f / length);
+        memcpy(&triangle_normals[t * 3], normal, sizeof(Vector3));
+    }
+
+    GLuint meshlet_vertices[MESHLET_MAX_VERTICES];
+    unsigned int emitted = 0, seed = 0;
+    meshlets->meshlet_count = 0;
+    while (emitted < triangle_count) {
+        Meshlet *meshlet = &meshlets->meshlets[meshlets->meshlet_count++];
+        meshlet->first_index = first_index + emitted * 3;
+        meshlet->triangle_count = 0;
+        meshlet->vertex_count = 0;
+        Vector3 normal_sum = { 0.0f, 0.0f, 0.0f };
+        while (seed < triangle_count && assigned[seed]) seed++;
+        long long next = seed;
+        while (next >= 0 && meshlet->triangle_count < MESHLET_MAX_TRIANGLES) {
+            unsigned int t = (unsigned int)next;
+            const GLuint *corner = &indices[t * 3];
+            int new_vertices = !in_meshlet[corner[0]] + !in_meshlet[corner[1]] + !in_meshlet[corner[2]];
+            if (meshlet->vertex_count + new_vertices > MESHLET_MAX_VERTICES) break;
+            for (int c = 0; c < 3; c++) {
+                if (in_meshlet[corner[c]]) continue;
+                in_meshlet[corner[c]] = 1;
+                meshlet_vertices[meshlet->vertex_count++] = corner[c];
+            }
+            for (int c = 0; c < 3; c++) normal_sum[c] += triangle_normals[t * 3 + c];
+            assigned[t] = 1;
+            order[emitted] = t;
+            memcpy(&ordered[emitted * 3], corner, 3 * sizeof(GLuint));
+            emitted++;
+            meshlet->triangle_count++;
+            next = Meshlets_pick_triangle(&adjacency, indices, assigned, in_meshlet, meshlet_vertices, meshlet->vertex_count, triangle_normals,
+                normal_sum);
+        }
+        for (unsigned int v = 0; v < meshlet->vertex_count; v++) in_meshlet[meshlet_vertices[v]] = 0;
+        Meshlet_compute_bounds(meshlet, &ordered[(meshlet->first_index - first_index)], vertices, triangle_normals,
+            &order[(meshlet->first_index - first_index) / 3]);
+    }
+    memcpy(indices, ordered, (size_t)triangle_count * 3 * sizeof(GLuint));
+
+    meshlets->padded_count = (meshlets->meshlet_count + 3) & ~3u;
+    meshlets->bounds = malloc(((size_t)meshlets->padded_count * MESHLET_BOUNDS_STREAMS + 1) * sizeof(float));
+    if (!meshlets->bounds) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (unsigned int m = 0; m < meshlets->padded_count; m++) {
+        float *stream = meshlets->bounds;
+        unsigned int n = meshlets->padded_count;
+        if (m >= meshlets->meshlet_count) {
+            // Padding sits behind every frustum plane.
+            for (int s = 0; s < MESHLET_BOUNDS_STREAMS; s++) stream[s * n + m] = 0.0f;
+            stream[MESHLET_RADIUS * n + m] = -FLT_MAX;
+            stream[MESHLET_CUTOFF * n + m] = 1.0f;
+            continue;
+        }
+        const Meshlet *meshlet = &meshlets->meshlets[m];
+        for (int c = 0; c < 3; c++) {
+            stream[(MESHLET_CENTER_X + c) * n + m] = meshlet->center[c];
+            stream[(MESHLET_APEX_X + c) * n + m] = meshlet->cone_apex[c];
+            stream[(MESHLET_AXIS_X + c) * n + m] = meshlet->cone_axis[c];
+        }
+        stream[MESHLET_RADIUS * n + m] = meshlet->radius;
+        stream[MESHLET_CUTOFF * n + m] = meshlet->cone_cutoff;
+    }
+
+    free(triangle_normals);
+    free(assigned);
+    free(in_meshlet);
+    free(order);
+    free(ordered);
+    MeshAdjacency_free(&adjacency);
+}
+
+// clip_from_mesh takes positions relative to camera_position, as the vertex shader does.
+void MeshletView_init(MeshletView *view, Matrix4 clip_from_mesh, const Vector3 camera_position) {
+    for (int p = 0; p < 6; p++) {
+        int axis = p / 2;
+        float sign = p % 2 ? -1.0f : 1.0f;
+        Vector4 plane;
+        for (int c = 0; c < 4; c++) plane[c] = clip_from_mesh[c][3] + sign * clip_from_mesh[c][axis];
+        float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f) {
+            for (int c = 0; c < 4; c++) plane[c] /= length;
+        }
+        plane[3] -= plane[0] * camera_position[0] + plane[1] * camera_position[1] + plane[2] * camera_position[2];
+        memcpy(view->planes[p], plane, sizeof(Vector4));
+    }
+    memcpy(view->camera_position, camera_position, sizeof(Vector3));
+}
+
+// Sets a bit in visible for every meshlet of a group of four that is in the frustum and not facing away.
+#if defined(__SSE2__)
+unsigned int Meshlets_cull4(const Meshlets *meshlets, const MeshletView *view, unsigned int first) {
+    const float *stream = meshlets->bounds + first;
+    unsigned int n = meshlets->padded_count;
+    __m128 cx = _mm_loadu_ps(stream + MESHLET_CENTER_X * n), cy = _mm_loadu_ps(stream + MESHLET_CENTER_Y * n);
+    __m128 cz = _mm_loadu_ps(stream + MESHLET_CENTER_Z * n), radius = _mm_loadu_ps(stream + MESHLET_RADIUS * n);
+    __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int p = 0; p < 6; p++) {
+        const float *plane = view->planes[p];
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane[0])), _mm_mul_ps(cy, _mm_set1_ps(plane[1]))),
+            _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane[2])), _mm_set1_ps(plane[3])));
+        visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, _mm_sub_ps(_mm_setzero_ps(), radius)));
+    }
+    __m128 dx = _mm_sub_ps(_mm_loadu_ps(stream + MESHLET_APEX_X * n), _mm_set1_ps(view->camera_position[0]));
+    __m128 dy = _mm_sub_ps(_mm_loadu_ps(stream + MESHLET_APEX_Y * n), _mm_set1_ps(view->camera_position[1]));
+    __m128 dz = _mm_sub_ps(_mm_loadu_ps(stream + MESHLET_APEX_Z * n), _mm_set1_ps(view->camera_position[2]));
+    __m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(stream + MESHLET_AXIS_X * n)), _mm_mul_ps(dy, _mm_loadu_ps(stream + MESHLET_AXIS_Y * n))),
+        _mm_mul_ps(dz, _mm_loadu_ps(stream + MESHLET_AXIS_Z * n)));
+    __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+    __m128 backfacing = _mm_cmpge_ps(along, _mm_mul_ps(_mm_loadu_ps(stream + MESHLET_CUTOFF * n), length));
+    __m128 cone = _mm_cmplt_ps(_mm_loadu_ps(stream + MESHLET_CUTOFF * n), _mm_set1_ps(1.0f));
+    visible = _mm_andnot_ps(_mm_and_ps(backfacing, cone), visible);
+    return (unsigned int)_mm_movemask_ps(visible);
+}
+#else
+unsigned int Meshlets_cull4(const Meshlets *meshlets, const MeshletView *view, unsigned int first) {
+    const float *stream = meshlets->bounds;
+    unsigned int n = meshlets->padded_count;
+    unsigned int visible = 0;
+    for (unsigned int m = first; m < first + 4; m++) {
+        int inside = 1;
+        for (int p = 0; p < 6 && inside; p++) {
+            const float *plane = view->planes[p];
+            float distance = stream[MESHLET_CENTER_X * n + m] * plane[0] + stream[MESHLET_CENTER_Y * n + m] * plane[1] +
+                stream[MESHLET_CENTER_Z * n + m] * plane[2] + plane[3];
+            inside = distance >= -stream[MESHLET_RADIUS * n + m];
+        }
+        float cutoff = stream[MESHLET_CUTOFF * n + m];
+        if (inside && cutoff < 1.0f) {
+            Vector3 d;
+            for (int c = 0; c < 3; c++) d[c] = stream[(MESHLET_APEX_X + c) * n + m] - view->camera_position[c];
+            float along = d[0] * stream[MESHLET_AXIS_X * n + m] + d[1] * stream[MESHLET_AXIS_Y * n + m] + d[2] * stream[MESHLET_AXIS_Z * n + m];
+            inside = along < cutoff * sqrtf(Vector3_dot(d, d));
+        }
+        if (inside) visible |= 1u << (m - first);
+    }
+    return visible;
+}
+#endif
+
+// Adds a draw to batch for every run of visible meshlets and returns how many runs there were.
+// first_index and base_vertex place the meshlets' index buffer within the batch's pool.
+unsigned int Meshlets_cull(const Meshlets *meshlets, const MeshletView *view, GeometryBatch *batch, unsigned int first_index, GLint base_vertex,
+    MeshletCullStats *stats) {
+    unsigned int first_draw = batch->count;
+    if (stats) memset(stats, 0, sizeof(*stats));
+    for (unsigned int first = 0; first < meshlets->padded_count; first += 4) {
+        unsigned int visible = Meshlets_cull4(meshlets, view, first);
+        while (visible) {
+            unsigned int m = first + (unsigned int)__builtin_ctz(visible);
+            visible &= visible - 1;
+            const Meshlet *meshlet = &meshlets->meshlets[m];
+            GeometryBatch_add(batch, first_index + meshlet->first_index, meshlet->triangle_count * 3, base_vertex);
+            if (stats) {
+                stats->meshlets++;
+                stats->triangles += meshlet->triangle_count;
+            }
+        }
+    }
+    if (stats) stats->ranges = batch->count - first_draw;
+    return batch->count - first_draw;
+}
+
+#endif
@@ -0,0 +1,275 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include "jobs.h"
+#include "texture.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Builds mip chains on the CPU so textures can be shipped with every level instead of calling glGenerateMipmap.
+// Texels are filtered as four floats at a time, separably, from each level to the next.
+
+typedef enum {
+    MIP_FILTER_BOX,
+    MIP_FILTER_KAISER,
+    MIP_FILTER_LANCZOS,
+} MipFilter;
+
+typedef struct {
+    MipFilter filter;
+    int gamma_correct; // filter in linear light, for sRGB encoded color
+    int normal_map;    // treat rgb as a unit vector and renormalize every level
+} MipSettings;
+
+typedef struct {
+    int tap_count;
+    int *first;     // first source texel per destination texel
+    float *weights; // tap_count weights per destination texel
+} MipKernel;
+
+unsigned int Mipmap_level_count(unsigned int width, unsigned int height) {
+    unsigned int size = width > height ? width : height;
+    unsigned int count = 1;
+    while (size > 1 && count < TEXTURE_MAX_LEVELS) {
+        size /= 2;
+        count++;
+    }
+    return count;
+}
+
+float Mipmap_sinc(float x) {
+    if (fabsf(x) < 1e-5f) return 1.0f;
+    x *= 3.14159265f;
+    return sinf(x) / x;
+}
+
+float Mipmap_bessel_i0(float x) {
+    float sum = 1.0f, term = 1.0f;
+    for (int k = 1; k < 16; k++) {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+    }
+    return sum;
+}
+
+float Mipmap_filter_radius(MipFilter filter) {
+    switch (filter) {
+        case MIP_FILTER_BOX: return 0.5f;
+        case MIP_FILTER_KAISER: return 3.0f;
+        case MIP_FILTER_LANCZOS: return 3.0f;
+    }
+    return 0.5f;
+}
+
+// Filter response at x, measured in destination texels.
+float Mipmap_filter_weight(MipFilter filter, float x) {
+    float radius = Mipmap_filter_radius(filter);
+    if (fabsf(x) >= radius) return 0.0f;
+    switch (filter) {
+        case MIP_FILTER_BOX:
+            return 1.0f;
+        case MIP_FILTER_KAISER: {
+            const float alpha = 4.0f;
+            float t = x / radius;
+            return Mipmap_sinc(x) * Mipmap_bessel_i0(alpha * sqrtf(1.0f - t * t)) / Mipmap_bessel_i0(alpha);
+        }
+        case MIP_FILTER_LANCZOS:
+            return Mipmap_sinc(x) * Mipmap_sinc(x / radius);
+    }
+    return 0.0f;
+}
+
+void MipKernel_create(MipKernel *kernel, MipFilter filter, int source_size, int destination_size) {
+    float scale = (float)source_size / destination_size;
+    float support = Mipmap_filter_radius(filter) * scale;
+    kernel->tap_count = (int)ceilf(support * 2.0f) + 1;
+    kernel->first = malloc(destination_size * sizeof(int));
+    kernel->weights = malloc((size_t)destination_size * kernel->tap_count * sizeof(float));
+    if (!kernel->first || !kernel->weights) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    for (int x = 0; x < destination_size; x++) {
+        float center = (x + 0.5f) * scale;
+        int first = (int)floorf(center - support);
+        float *weights = &kernel->weights[(size_t)x * kernel->tap_count];
+        float total = 0.0f;
+        for (int t = 0; t < kernel->tap_count; t++) {
+            weights[t] = Mipmap_filter_weight(filter, (first + t + 0.5f - center) / scale);
+            total += weights[t];
+        }
+        for (int t = 0; t < kernel->tap_count; t++) weights[t] = total != 0.0f ? weights[t] / total : 0.0f;
+        kernel->first[x] = first;
+    }
+}
+
+void MipKernel_destroy(MipKernel *kernel) {
+    free(kernel->first);
+    free(kernel->weights);
+}
+
+// One destination texel as the weighted sum of source texels spaced stride floats apart, clamped to the edge.
+void Mipmap_filter_texel(float *destination, const float *source, int stride, int size, const MipKernel *kernel, int x) {
+    const float *weights = &kernel->weights[(size_t)x * kernel->tap_count];
+    int first = kernel->first[x];
+#if defined(__SSE2__)
+    __m128 sum = _mm_setzero_ps();
+    for (int t = 0; t < kernel->tap_count; t++) {
+        if (weights[t] == 0.0f) continue;
+        int i = first + t;
+        i = i < 0 ? 0 : i >= size ? size - 1 : i;
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(source + (size_t)i * stride)));
+    }
+    _mm_storeu_ps(destination, sum);
+#else
+    float sum[4] = { 0 };
+    for (int t = 0; t < kernel->tap_count; t++) {
+        if (weights[t] == 0.0f) continue;
+        int i = first + t;
+        i = i < 0 ? 0 : i >= size ? size - 1 : i;
+        for (int c = 0; c < 4; c++) sum[c] += weights[t] * source[(size_t)i * stride + c];
+    }
+    memcpy(destination, sum, sizeof(sum));
+#endif
+}
+
+typedef struct {
+    const float *source;
+    float *horizontal;
+    float *destination;
+    int source_width, source_height;
+    int destination_width, destination_height;
+    MipKernel kernel_x, kernel_y;
+    int normal_map;
+} MipLevelJob;
+
+void Mipmap_horizontal_rows(void *data, int begin, int end) {
+    MipLevelJob *job = data;
+    for (int y = begin; y < end; y++) {
+        const float *row = job->source + (size_t)y * job->source_width * 4;
+        float *out = job->horizontal + (size_t)y * job->destination_width * 4;
+        for (int x = 0; x < job->destination_width; x++) {
+            Mipmap_filter_texel(out + x * 4, row, 4, job->source_width, &job->kernel_x, x);
+        }
+    }
+}
+
+void Mipmap_vertical_rows(void *data, int begin, int end) {
+    MipLevelJob *job = data;
+    int stride = job->destination_width * 4;
+    for (int y = begin; y < end; y++) {
+        float *out = job->destination + (size_t)y * stride;
+        for (int x = 0; x < job->destination_width; x++) {
+            float *texel = out + x * 4;
+            Mipmap_filter_texel(texel, job->horizontal + x * 4, stride, job->source_height, &job->kernel_y, y);
+            if (job->normal_map) {
+                float length = sqrtf(texel[0] * texel[0] + texel[1] * texel[1] + texel[2] * texel[2]);
+                if (length > 0.0f) {
+                    texel[0] /= length;
+                    texel[1] /= length;
+                    texel[2] /= length;
+                } else {
+                    texel[0] = texel[1] = 0.0f;
+                    texel[2] = 1.0f;
+                }
+            }
+        }
+    }
+}
+
+// Resamples a float RGBA level into a smaller one.
+void Mipmap_downsample(float *destination, int destination_width, int destination_height, const float *source, int source_width, int source_height, const MipSettings *settings, JobSystem *jobs) {
+    MipLevelJob job;
+    job.source = source;
+    job.destination = destination;
+    job.source_width = source_width;
+    job.source_height = source_height;
+    job.destination_width = destination_width;
+    job.destination_height = destination_height;
+    job.normal_map = settings->normal_map;
+    job.horizontal = malloc((size_t)destination_width * source_height * 4 * sizeof(float));
+    if (!job.horizontal) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    MipKernel_create(&job.kernel_x, settings->filter, source_width, destination_width);
+    MipKernel_create(&job.kernel_y, settings->filter, source_height, destination_height);
+
+    int batch_size = jobs ? 16 : source_height;
+    JobSystem_parallel_for(jobs, source_height, batch_size, Mipmap_horizontal_rows, &job);
+    JobSystem_parallel_for(jobs, destination_height, batch_size, Mipmap_vertical_rows, &job);
+
+    MipKernel_destroy(&job.kernel_x);
+    MipKernel_destroy(&job.kernel_y);
+    free(job.horizontal);
+}
+
+float Mipmap_srgb_to_linear(float c) {
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+float Mipmap_linear_to_srgb(float c) {
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+void Mipmap_decode(float *texels, const unsigned char *rgba, size_t count, const MipSettings *settings) {
+    float table[256];
+    for (int i = 0; i < 256; i++) {
+        float c = i / 255.0f;
+        if (settings->normal_map) table[i] = c * 2.0f - 1.0f;
+        else if (settings->gamma_correct) table[i] = Mipmap_srgb_to_linear(c);
+        else table[i] = c;
+    }
+    for (size_t i = 0; i < count; i++) {
+        for (int c = 0; c < 3; c++) texels[i * 4 + c] = table[rgba[i * 4 + c]];
+        texels[i * 4 + 3] = rgba[i * 4 + 3] / 255.0f;
+    }
+}
+
+void Mipmap_encode(unsigned char *rgba, const float *texels, size_t count, const MipSettings *settings) {
+    for (size_t i = 0; i < count; i++) {
+        for (int c = 0; c < 4; c++) {
+            float v = texels[i * 4 + c];
+            if (c < 3 && settings->normal_map) v = v * 0.5f + 0.5f;
+            else if (c < 3 && settings->gamma_correct) v = Mipmap_linear_to_srgb(fminf(fmaxf(v, 0.0f), 1.0f));
+            v = fminf(fmaxf(v, 0.0f), 1.0f);
+            rgba[i * 4 + c] = (unsigned char)(v * 255.0f + 0.5f);
+        }
+    }
+}
+
+// Fills image with an RGBA8 chain down to 1x1, level 0 being a copy of rgba.
+void Mipmap_build_chain(TextureImage *image, const unsigned char *rgba, unsigned int width, unsigned int height, int srgb, const MipSettings *settings, JobSystem *jobs) {
+    TextureImage_allocate(image, TEXTURE_FORMAT_RGBA8, srgb, width, height, Mipmap_level_count(width, height));
+    memcpy(image->data, rgba, image->levels[0].size);
+
+    float *previous = malloc((size_t)width * height * 4 * sizeof(float));
+    float *current = malloc((size_t)(width / 2 + 1) * (height / 2 + 1) * 4 * sizeof(float));
+    if (!previous || !current) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    Mipmap_decode(previous, rgba, (size_t)width * height, settings);
+
+    for (unsigned int i = 1; i < image->level_count; i++) {
+        const TextureLevel *source = &image->levels[i - 1];
+        const TextureLevel *level = &image->levels[i];
+        Mipmap_downsample(current, level->width, level->height, previous, source->width, source->height, settings, jobs);
+        Mipmap_encode(image->data + level->offset, current, (size_t)level->width * level->height, settings);
+
+        float *swap = previous;
+        previous = current;
+        current = swap;
+    }
+
+    free(previous);
+    free(current);
+}
+
+#endif
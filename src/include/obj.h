@@ -0,0 +1,453 @@
+#ifndef OBJ_H
+#define OBJ_H
+
+#include "jobs.h"
+#include "mesh.h"
+#include "mesh_normals.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Wavefront OBJ loading. The file is mmapped and cut into chunks at line breaks. A parallel pass
+// counts what every chunk holds, a second one parses each chunk straight into the shared arrays
+// at its offsets, and identical position/uv/normal triplets are then merged into indexed vertices.
+// Polygons are fanned into triangles; materials, groups, lines and points are skipped.
+// Texture coordinates are flipped to the top-left origin the textures are uploaded with, and files
+// without normals get smooth ones.
+
+#define OBJ_CHUNK_SIZE (1 << 20)
+
+typedef struct {
+    int position;
+    int uv;     // -1 if the corner has none
+    int normal; // -1 if the corner has none
+} ObjCorner;
+
+typedef struct {
+    const char *begin;
+    const char *end;
+    // totals after the counting pass, start of this chunk's elements in the shared arrays after that
+    unsigned int position_count, uv_count, normal_count, corner_count;
+    unsigned int position_offset, uv_offset, normal_offset, corner_offset;
+    int invalid; // a face referenced index 0 or had an unreadable corner
+} ObjChunk;
+
+typedef struct {
+    ObjChunk *chunks;
+    int chunk_count;
+    GLfloat *positions;
+    GLfloat *uvs;
+    GLfloat *normals;
+    ObjCorner *corners;
+    unsigned int position_count, uv_count, normal_count, corner_count;
+} ObjData;
+
+static const double Obj_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+int Obj_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+const char *Obj_skip_spaces(const char *p, const char *end) {
+    while (p < end && Obj_is_space(*p)) p++;
+    return p;
+}
+
+const char *Obj_line_end(const char *p, const char *end) {
+    const char *newline = memchr(p, '\n', end - p);
+    return newline ? newline : end;
+}
+
+// The next whitespace separated token before line_end or a comment; returns 0 when there is none.
+int Obj_next_token(const char **p, const char *line_end, const char **token_end) {
+    const char *q = Obj_skip_spaces(*p, line_end);
+    if (q == line_end || *q == '#') return 0;
+    const char *e = q;
+    while (e < line_end && !Obj_is_space(*e)) e++;
+    *p = q;
+    *token_end = e;
+    return 1;
+}
+
+// Decimal floats take the fast path when the digits fit a double's mantissa and the exponent
+// is within 10^22, which is exact in double and at most one float ulp off after narrowing;
+// anything longer or stranger goes through strtof.
+const char *Obj_parse_float(const char *p, const char *end, GLfloat *value) {
+    const char *start = p;
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    int exact = 1;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+        if (mantissa < 100000000000000000ull) mantissa = mantissa * 10 + (*p - '0');
+        else exponent++, exact = 0;
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+            if (mantissa < 100000000000000000ull) mantissa = mantissa * 10 + (*p - '0'), exponent--;
+            else exact = 0;
+        }
+    }
+    if (digits > 0 && p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        int exponent_negative = 0;
+        int e = 0;
+        if (q < end && (*q == '-' || *q == '+')) exponent_negative = *q++ == '-';
+        if (q < end && *q >= '0' && *q <= '9') {
+            for (; q < end && *q >= '0' && *q <= '9'; q++) {
+                if (e < 10000) e = e * 10 + (*q - '0');
+            }
+            exponent += exponent_negative ? -e : e;
+            p = q;
+        }
+    }
+
+    if (digits > 0 && exact && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+        double result = (double)mantissa;
+        result = exponent < 0 ? result / Obj_powers_of_ten[-exponent] : result * Obj_powers_of_ten[exponent];
+        *value = (GLfloat)(negative ? -result : result);
+        return p;
+    }
+
+    // strtof needs a terminated copy; also covers inf and nan
+    char buffer[64];
+    size_t length = 0;
+    while (start + length < end && length < sizeof(buffer) - 1 && !Obj_is_space(start[length]) && start[length] != '\n') length++;
+    memcpy(buffer, start, length);
+    buffer[length] = '\0';
+    char *parsed;
+    GLfloat result = strtof(buffer, &parsed);
+    if (parsed == buffer) return start;
+    *value = result;
+    return start + (parsed - buffer);
+}
+
+const char *Obj_parse_int(const char *p, const char *end, int *value) {
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+    const char *digits = p;
+    long long result = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        if (result < 0x7fffffff) result = result * 10 + (*p - '0');
+    }
+    if (p == digits) return NULL;
+    if (result > 0x7fffffff) result = 0x7fffffff;
+    *value = (int)(negative ? -result : result);
+    return p;
+}
+
+// Reads up to count floats from the rest of the line; missing ones are left at zero.
+void Obj_parse_floats(const char *p, const char *line_end, GLfloat *values, int count) {
+    for (int i = 0; i < count; i++) {
+        values[i] = 0.0f;
+        p = Obj_skip_spaces(p, line_end);
+        const char *next = Obj_parse_float(p, line_end, &values[i]);
+        if (next == p) {
+            for (i++; i < count; i++) values[i] = 0.0f;
+            return;
+        }
+        p = next;
+    }
+}
+
+// OBJ indices are 1-based, or negative to count back from the last element read so far.
+int Obj_resolve_index(int index, unsigned int read_so_far) {
+    if (index > 0) return index - 1;
+    if (index < 0 && (unsigned int)-index <= read_so_far) return (int)read_so_far + index;
+    return -2; // invalid; rejected when the mesh is built
+}
+
+// A corner is v, v/vt, v//vn or v/vt/vn.
+int Obj_parse_corner(const char *p, const char *token_end, const ObjChunk *chunk, unsigned int positions, unsigned int uvs, unsigned int normals, ObjCorner *corner) {
+    int index;
+    corner->uv = -1;
+    corner->normal = -1;
+    if (!(p = Obj_parse_int(p, token_end, &index))) return 0;
+    corner->position = Obj_resolve_index(index, chunk->position_offset + positions);
+    if (p < token_end && *p == '/') {
+        p++;
+        if (p < token_end && *p != '/') {
+            if (!(p = Obj_parse_int(p, token_end, &index))) return 0;
+            corner->uv = Obj_resolve_index(index, chunk->uv_offset + uvs);
+        }
+        if (p < token_end && *p == '/') {
+            if (!(p = Obj_parse_int(p + 1, token_end, &index))) return 0;
+            corner->normal = Obj_resolve_index(index, chunk->normal_offset + normals);
+        }
+    }
+    return p == token_end && corner->position != -2 && corner->uv != -2 && corner->normal != -2;
+}
+
+// Classifies a line by its keyword: 'v' position, 't' uv, 'n' normal, 'f' face, 0 anything else.
+char Obj_line_type(const char **p, const char *line_end) {
+    const char *q = Obj_skip_spaces(*p, line_end);
+    char type = 0;
+    if (line_end - q >= 2 && q[0] == 'v' && Obj_is_space(q[1])) type = 'v', q += 1;
+    else if (line_end - q >= 3 && q[0] == 'v' && q[1] == 't' && Obj_is_space(q[2])) type = 't', q += 2;
+    else if (line_end - q >= 3 && q[0] == 'v' && q[1] == 'n' && Obj_is_space(q[2])) type = 'n', q += 2;
+    else if (line_end - q >= 2 && q[0] == 'f' && Obj_is_space(q[1])) type = 'f', q += 1;
+    *p = q;
+    return type;
+}
+
+void Obj_count_chunks(void *data, int begin, int end) {
+    ObjData *obj = data;
+    for (int c = begin; c < end; c++) {
+        ObjChunk *chunk = &obj->chunks[c];
+        for (const char *line = chunk->begin; line < chunk->end;) {
+            const char *line_end = Obj_line_end(line, chunk->end);
+            const char *p = line;
+            switch (Obj_line_type(&p, line_end)) {
+                case 'v': chunk->position_count++; break;
+                case 't': chunk->uv_count++; break;
+                case 'n': chunk->normal_count++; break;
+                case 'f': {
+                    unsigned int corners = 0;
+                    const char *token_end;
+                    for (; Obj_next_token(&p, line_end, &token_end); p = token_end) corners++;
+                    if (corners >= 3) chunk->corner_count += 3 * (corners - 2);
+                    break;
+                }
+            }
+            line = line_end < chunk->end ? line_end + 1 : line_end;
+        }
+    }
+}
+
+void Obj_parse_chunks(void *data, int begin, int end) {
+    ObjData *obj = data;
+    for (int c = begin; c < end; c++) {
+        ObjChunk *chunk = &obj->chunks[c];
+        GLfloat *positions = obj->positions + (size_t)chunk->position_offset * 3;
+        GLfloat *uvs = obj->uvs + (size_t)chunk->uv_offset * 2;
+        GLfloat *normals = obj->normals + (size_t)chunk->normal_offset * 3;
+        ObjCorner *corners = obj->corners + chunk->corner_offset;
+        unsigned int position_count = 0, uv_count = 0, normal_count = 0;
+
+        for (const char *line = chunk->begin; line < chunk->end;) {
+            const char *line_end = Obj_line_end(line, chunk->end);
+            const char *p = line;
+            switch (Obj_line_type(&p, line_end)) {
+                case 'v': Obj_parse_floats(p, line_end, positions + (size_t)position_count++ * 3, 3); break;
+                case 'n': Obj_parse_floats(p, line_end, normals + (size_t)normal_count++ * 3, 3); break;
+                case 't': {
+                    GLfloat *uv = uvs + (size_t)uv_count++ * 2;
+                    Obj_parse_floats(p, line_end, uv, 2);
+                    uv[1] = 1.0f - uv[1];
+                    break;
+                }
+                case 'f': {
+                    // fan around the first corner, tokenized exactly like the counting pass
+                    ObjCorner first = { -2, -1, -1 }, previous = first, current;
+                    unsigned int count = 0;
+                    const char *token_end;
+                    for (; Obj_next_token(&p, line_end, &token_end); p = token_end, count++) {
+                        if (!Obj_parse_corner(p, token_end, chunk, position_count, uv_count, normal_count, &current)) {
+                            chunk->invalid = 1;
+                            current.position = -2;
+                        }
+                        if (count >= 2) {
+                            *corners++ = first;
+                            *corners++ = previous;
+                            *corners++ = current;
+                        }
+                        if (count == 0) first = current;
+                        previous = current;
+                    }
+                    break;
+                }
+            }
+            line = line_end < chunk->end ? line_end + 1 : line_end;
+        }
+    }
+}
+
+// Gives every distinct corner one vertex. The hash map is keyed by the position index itself:
+// each position heads a chain of the vertices made from it, which stays short and, since faces
+// mostly reference nearby positions, cache friendly.
+int Obj_build_mesh(Mesh *mesh, const ObjData *obj, const char *file_path) {
+    GLuint *first = calloc(obj->position_count > 0 ? obj->position_count : 1, sizeof(GLuint)); // vertex index + 1, 0 when empty
+    GLuint *next = malloc((obj->corner_count > 0 ? obj->corner_count : 1) * sizeof(GLuint));
+    ObjCorner *keys = malloc((obj->corner_count > 0 ? obj->corner_count : 1) * sizeof(ObjCorner));
+    if (!first || !next || !keys) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    Mesh_allocate(mesh, obj->corner_count, obj->corner_count);
+
+    unsigned int vertex_count = 0;
+    for (unsigned int i = 0; i < obj->corner_count; i++) {
+        const ObjCorner *corner = &obj->corners[i];
+        if (corner->position < 0 || (unsigned int)corner->position >= obj->position_count
+            || corner->uv >= (int)obj->uv_count || corner->normal >= (int)obj->normal_count) {
+            fprintf(stderr, "Invalid face index in %s\n", file_path);
+            free(first);
+            free(next);
+            free(keys);
+            Mesh_free(mesh);
+            return 0;
+        }
+
+        GLuint vertex = first[corner->position];
+        while (vertex && (keys[vertex - 1].uv != corner->uv || keys[vertex - 1].normal != corner->normal)) {
+            vertex = next[vertex - 1];
+        }
+        if (!vertex) {
+            MeshVertex *v = &mesh->vertices[vertex_count];
+            memcpy(v->position, obj->positions + (size_t)corner->position * 3, sizeof(v->position));
+            if (corner->uv >= 0) memcpy(v->uv, obj->uvs + (size_t)corner->uv * 2, sizeof(v->uv));
+            else memset(v->uv, 0, sizeof(v->uv));
+            if (corner->normal >= 0) memcpy(v->normal, obj->normals + (size_t)corner->normal * 3, sizeof(v->normal));
+            else memset(v->normal, 0, sizeof(v->normal));
+            keys[vertex_count] = *corner;
+            next[vertex_count] = first[corner->position];
+            vertex = first[corner->position] = ++vertex_count;
+        }
+        mesh->indices[i] = vertex - 1;
+    }
+    free(first);
+    free(next);
+    free(keys);
+
+    MeshVertex *vertices = realloc(mesh->vertices, (vertex_count > 0 ? vertex_count : 1) * sizeof(MeshVertex));
+    if (vertices) mesh->vertices = vertices;
+    mesh->vertex_count = vertex_count;
+    return 1;
+}
+
+// Smooth normals for a file without any, averaged per position before Obj_build_mesh splits vertices
+// at uv seams, so both sides of a seam get the same normal. Every corner then uses its position's.
+void Obj_compute_normals(ObjData *obj, JobSystem *jobs) {
+    for (unsigned int i = 0; i < obj->corner_count; i++) {
+        if (obj->corners[i].position < 0 || (unsigned int)obj->corners[i].position >= obj->position_count) return; // rejected by Obj_build_mesh
+    }
+    Mesh positions;
+    Mesh_allocate(&positions, obj->position_count, obj->corner_count);
+    memset(positions.vertices, 0, obj->position_count * sizeof(MeshVertex));
+    for (unsigned int i = 0; i < obj->position_count; i++) {
+        memcpy(positions.vertices[i].position, obj->positions + (size_t)i * 3, sizeof(positions.vertices[i].position));
+    }
+    for (unsigned int i = 0; i < obj->corner_count; i++) positions.indices[i] = (GLuint)obj->corners[i].position;
+    Mesh_compute_normals(&positions, jobs);
+
+    GLfloat *normals = realloc(obj->normals, ((size_t)obj->position_count * 3 + 1) * sizeof(GLfloat));
+    if (!normals) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (unsigned int i = 0; i < obj->position_count; i++) memcpy(normals + (size_t)i * 3, positions.vertices[i].normal, 3 * sizeof(GLfloat));
+    for (unsigned int i = 0; i < obj->corner_count; i++) obj->corners[i].normal = obj->corners[i].position;
+    obj->normals = normals;
+    obj->normal_count = obj->position_count;
+    Mesh_free(&positions);
+}
+
+void ObjData_free(ObjData *obj) {
+    free(obj->chunks);
+    free(obj->positions);
+    free(obj->uvs);
+    free(obj->normals);
+    free(obj->corners);
+}
+
+// Parses contents into mesh using jobs, which may be NULL to parse on the calling thread.
+int Obj_parse(Mesh *mesh, const char *file_path, const char *contents, size_t size, JobSystem *jobs) {
+    ObjData obj;
+    memset(&obj, 0, sizeof(obj));
+    obj.chunk_count = (int)(size / OBJ_CHUNK_SIZE) + 1;
+    obj.chunks = calloc(obj.chunk_count, sizeof(ObjChunk));
+    if (!obj.chunks) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    // chunks end right after a line break so no line is split
+    const char *end = contents + size;
+    const char *begin = contents;
+    for (int c = 0; c < obj.chunk_count; c++) {
+        const char *chunk_end = end;
+        if (c + 1 < obj.chunk_count && contents + (size_t)(c + 1) * OBJ_CHUNK_SIZE > begin) {
+            chunk_end = Obj_line_end(contents + (size_t)(c + 1) * OBJ_CHUNK_SIZE, end);
+            if (chunk_end < end) chunk_end++;
+        } else if (c + 1 < obj.chunk_count) {
+            chunk_end = begin;
+        }
+        obj.chunks[c].begin = begin;
+        obj.chunks[c].end = chunk_end;
+        begin = chunk_end;
+    }
+
+    JobSystem_parallel_for(jobs, obj.chunk_count, 1, Obj_count_chunks, &obj);
+
+    for (int c = 0; c < obj.chunk_count; c++) {
+        ObjChunk *chunk = &obj.chunks[c];
+        chunk->position_offset = obj.position_count;
+        chunk->uv_offset = obj.uv_count;
+        chunk->normal_offset = obj.normal_count;
+        chunk->corner_offset = obj.corner_count;
+        obj.position_count += chunk->position_count;
+        obj.uv_count += chunk->uv_count;
+        obj.normal_count += chunk->normal_count;
+        obj.corner_count += chunk->corner_count;
+    }
+    obj.positions = malloc(((size_t)obj.position_count * 3 + 1) * sizeof(GLfloat));
+    obj.uvs = malloc(((size_t)obj.uv_count * 2 + 1) * sizeof(GLfloat));
+    obj.normals = malloc(((size_t)obj.normal_count * 3 + 1) * sizeof(GLfloat));
+    obj.corners = malloc(((size_t)obj.corner_count + 1) * sizeof(ObjCorner));
+    if (!obj.positions || !obj.uvs || !obj.normals || !obj.corners) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    JobSystem_parallel_for(jobs, obj.chunk_count, 1, Obj_parse_chunks, &obj);
+
+    int success = 1;
+    for (int c = 0; c < obj.chunk_count; c++) {
+        if (obj.chunks[c].invalid) success = 0;
+    }
+    if (!success) fprintf(stderr, "Invalid face in %s\n", file_path);
+    else if (obj.corner_count == 0) fprintf(stderr, "No faces in %s\n", file_path), success = 0;
+    else {
+        if (obj.normal_count == 0) Obj_compute_normals(&obj, jobs);
+        success = Obj_build_mesh(mesh, &obj, file_path);
+    }
+
+    ObjData_free(&obj);
+    return success;
+}
+
+int Obj_load(Mesh *mesh, const char *file_path, JobSystem *jobs) {
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open file %s\n", file_path);
+        return 0;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        fprintf(stderr, "Could not read file %s\n", file_path);
+        close(fd);
+        return 0;
+    }
+    void *contents = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (contents == MAP_FAILED) {
+        fprintf(stderr, "Could not map file %s\n", file_path);
+        return 0;
+    }
+    int success = Obj_parse(mesh, file_path, contents, info.st_size, jobs);
+    munmap(contents, info.st_size);
+    return success;
+}
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "command_list.h"
+#include "draw_data.h"
+#include "glad/glad.h"
+#include "jobs.h"
+#include "linalg.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Collects a frame's draws, sorts them by a packed 64 bit key and submits them in that order,
+// changing GL state only where consecutive draws differ. From the most significant bit down:
+//   opaque:      pass (4) | 0 | program (8) | material (16) | depth (24)
+//   translucent: pass (4) | 1 | far to near depth (24) | program (8) | material (16)
+// so opaque draws are grouped by program, then material, then go front to back for early z, and
+// translucent ones come after them back to front, as blending needs. The sort is an LSD radix sort
+// over the key bytes, skipping bytes every key shares.
+// Submitting splits the sorted draws into fixed size chunks that worker threads record into command
+// lists of their own, each starting from unknown state, and the GL thread then replays the lists
+// in order. Each draw's uModel goes into the draw data buffer, mapped once for the whole queue.
+
+#define RENDER_QUEUE_MIN_CAPACITY 256
+#define RENDER_QUEUE_CHUNK_SIZE 128  // draws recorded per command list
+
+typedef struct {
+    GLuint program;
+    GLuint vao;
+    GLenum mode;
+    GLenum index_type; // 0 for glDrawArrays
+    GLsizei count;
+    uintptr_t offset; // index buffer bytes, or the first vertex for glDrawArrays
+    int material;     // handed to the material function, -1 for none
+    unsigned char translucent;
+    unsigned char double_sided;
+    unsigned char clockwise;
+    Matrix4 model; // uModel
+} RenderItem;
+
+typedef struct {
+    uint64_t key;
+    uint32_t item;
+    uint32_t padding;
+} RenderSortEntry;
+
+typedef struct {
+    unsigned int draws;
+    unsigned int programs; // state changes made while submitting
+    unsigned int materials;
+    unsigned int vertex_arrays;
+    unsigned int sort_passes;
+    unsigned int lists;
+    size_t command_bytes;
+} RenderQueueStats;
+
+// Binds whatever the material needs for program. Called on the GL thread while the command lists
+// are replayed.
+typedef CommandFunction RenderMaterialFunction;
+
+typedef struct {
+    CommandList commands;
+    RenderQueueStats stats;
+} RenderQueueChunk;
+
+typedef struct {
+    RenderItem *items;
+    RenderSortEntry *entries;
+    RenderSortEntry *scratch;
+    unsigned int count;
+    unsigned int capacity;
+    RenderQueueChunk *chunks;
+    unsigned int chunk_capacity;
+    RenderQueueStats stats;
+} RenderQueue;
+
+void RenderQueue_init(RenderQueue *queue) {
+    memset(queue, 0, sizeof(*queue));
+}
+
+void RenderQueue_free(RenderQueue *queue) {
+    free(queue->items);
+    free(queue->entries);
+    free(queue->scratch);
+    for (unsigned int i = 0; i < queue->chunk_capacity; i++) CommandList_free(&queue->chunks[i].commands);
+    free(queue->chunks);
+    memset(queue, 0, sizeof(*queue));
+}
+
+void RenderQueue_clear(RenderQueue *queue) {
+    queue->count = 0;
+}
+
+// Positive floats order like their bits; the top 24 keep the exponent and 15 bits of mantissa.
+uint64_t RenderQueue_depth_bits(float depth) {
+    if (!(depth > 0.0f)) return 0;
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return bits >> 8;
+}
+
+uint64_t RenderQueue_key(unsigned int pass, int translucent, GLuint program, int material, float depth) {
+    uint64_t key = (uint64_t)(pass & 0xf) << 60;
+    uint64_t program_bits = program & 0xff;
+    uint64_t material_bits = (uint64_t)(material + 1) & 0xffff;
+    uint64_t depth_bits = RenderQueue_depth_bits(depth);
+    if (translucent) return key | 1ull << 59 | (0xffffff - depth_bits) << 35 | program_bits << 27 | material_bits << 11;
+    return key | program_bits << 51 | material_bits << 35 | depth_bits << 11;
+}
+
+// The returned item is filled in by the caller; depth is the distance from the camera, for ordering.
+RenderItem *RenderQueue_push(RenderQueue *queue, unsigned int pass, GLuint program, int material, int translucent, float depth) {
+    if (queue->count == queue->capacity) {
+        queue->capacity = queue->capacity ? queue->capacity * 2 : RENDER_QUEUE_MIN_CAPACITY;
+        queue->items = realloc(queue->items, queue->capacity * sizeof(RenderItem));
+        queue->entries = realloc(queue->entries, queue->capacity * sizeof(RenderSortEntry));
+        queue->scratch = realloc(queue->scratch, queue->capacity * sizeof(RenderSortEntry));
+        if (!queue->items || !queue->entries || !queue->scratch) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    RenderItem *item = &queue->items[queue->count];
+    memset(item, 0, sizeof(*item));
+    item->program = program;
+    item->material = material;
+    item->translucent = (unsigned char)(translucent != 0);
+    queue->entries[queue->count] = (RenderSortEntry){ RenderQueue_key(pass, translucent, program, material, depth), queue->count, 0 };
+    queue->count++;
+    return item;
+}
+
+void RenderQueue_sort(RenderQueue *queue) {
+    queue->stats.sort_passes = 0;
+    if (queue->count == 0) return;
+    unsigned int histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (unsigned int i = 0; i < queue->count; i++) {
+        uint64_t key = queue->entries[i].key;
+        for (int byte = 0; byte < 8; byte++) histograms[byte][key >> (byte * 8) & 0xff]++;
+    }
+
+    for (int byte = 0; byte < 8; byte++) {
+        unsigned int *histogram = histograms[byte];
+        if (histogram[queue->entries[0].key >> (byte * 8) & 0xff] == queue->count) continue; // every key has this byte
+        unsigned int offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            unsigned int count = histogram[digit];
+            histogram[digit] = offset;
+            offset += count;
+        }
+        for (unsigned int i = 0; i < queue->count; i++) {
+            const RenderSortEntry *entry = &queue->entries[i];
+            queue->scratch[histogram[entry->key >> (byte * 8) & 0xff]++] = *entry;
+        }
+        RenderSortEntry *swap = queue->entries;
+        queue->entries = queue->scratch;
+        queue->scratch = swap;
+        queue->stats.sort_passes++;
+    }
+}
+
+typedef struct {
+    RenderQueue *queue;
+    const DrawDataBuffer *draws;
+    RenderMaterialFunction bind_material;
+    void *user;
+} RenderQueueRecording;
+
+// Records the draws of chunks [begin, end) and writes their draw data. Makes no GL calls, so any
+// thread can run it.
+void RenderQueue_record(void *data, int begin, int end) {
+    RenderQueueRecording *recording = data;
+    RenderQueue *queue = recording->queue;
+    const DrawDataBuffer *draws = recording->draws;
+    for (int c = begin; c < end; c++) {
+        RenderQueueChunk *chunk = &queue->chunks[c];
+        CommandList *list = &chunk->commands;
+        RenderQueueStats *stats = &chunk->stats;
+        CommandList_reset(list);
+        memset(stats, 0, sizeof(*stats));
+
+        unsigned int first = (unsigned int)c * RENDER_QUEUE_CHUNK_SIZE;
+        unsigned int last = first + RENDER_QUEUE_CHUNK_SIZE < queue->count ? first + RENDER_QUEUE_CHUNK_SIZE : queue->count;
+        GLuint program = 0, vao = 0;
+        int material = -2, double_sided = -1, clockwise = -1, translucent = -1;
+        for (unsigned int i = first; i < last; i++) {
+            const RenderItem *item = &queue->items[queue->entries[i].item];
+            if (item->program != program || i == first) {
+                program = item->program;
+                CommandList_use_program(list, program);
+                material = -2; // materials may set per program uniforms
+                stats->programs++;
+            }
+            if (item->material != material) {
+                material = item->material;
+                if (recording->bind_material) CommandList_call(list, recording->bind_material, recording->user, program, material);
+                stats->materials++;
+            }
+            if (item->vao != vao || i == first) {
+                vao = item->vao;
+                CommandList_bind_vertex_array(list, vao);
+                stats->vertex_arrays++;
+            }
+            if (item->double_sided != double_sided) {
+                double_sided = item->double_sided;
+                CommandList_enable(list, GL_CULL_FACE, !double_sided);
+            }
+            if (item->clockwise != clockwise) {
+                clockwise = item->clockwise;
+                CommandList_front_face(list, clockwise ? GL_CW : GL_CCW);
+            }
+            if (item->translucent != translucent) {
+                translucent = item->translucent;
+                CommandList_enable(list, GL_BLEND, translucent);
+                if (translucent) CommandList_blend_func(list, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                CommandList_depth_mask(list, translucent ? GL_FALSE : GL_TRUE);
+            }
+            memcpy(DrawDataBuffer_at(draws, i)->model, item->model, sizeof(Matrix4));
+            CommandList_bind_buffer_range(list, GL_UNIFORM_BUFFER, DRAW_DATA_BINDING, draws->stream->buffer, DrawDataBuffer_offset(draws, i),
+                sizeof(DrawData));
+            if (item->index_type) CommandList_draw_elements(list, item->mode, item->count, item->index_type, item->offset);
+            else CommandList_draw_arrays(list, item->mode, (GLint)item->offset, item->count);
+            stats->draws++;
+        }
+        stats->command_bytes = list->size;
+    }
+}
+
+// Draws everything in key order; call RenderQueue_sort first. The chunks are recorded on jobs,
+// or here if it is NULL, and replayed on the calling thread, which must own the GL context.
+// bind_material may be NULL.
+void RenderQueue_submit(RenderQueue *queue, JobSystem *jobs, DrawDataBuffer *draws, RenderMaterialFunction bind_material, void *user) {
+    RenderQueueStats *stats = &queue->stats;
+    unsigned int sort_passes = stats->sort_passes;
+    memset(stats, 0, sizeof(*stats));
+    stats->sort_passes = sort_passes;
+
+    unsigned int chunk_count = (queue->count + RENDER_QUEUE_CHUNK_SIZE - 1) / RENDER_QUEUE_CHUNK_SIZE;
+    if (chunk_count > queue->chunk_capacity) {
+        queue->chunks = realloc(queue->chunks, chunk_count * sizeof(RenderQueueChunk));
+        if (!queue->chunks) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        for (unsigned int i = queue->chunk_capacity; i < chunk_count; i++) CommandList_init(&queue->chunks[i].commands);
+        queue->chunk_capacity = chunk_count;
+    }
+
+    DrawDataBuffer_map(draws, queue->count);
+    RenderQueueRecording recording = { queue, draws, bind_material, user };
+    JobSystem_parallel_for(jobs, (int)chunk_count, 1, RenderQueue_record, &recording);
+    DrawDataBuffer_unmap(draws);
+
+    for (unsigned int c = 0; c < chunk_count; c++) {
+        const RenderQueueChunk *chunk = &queue->chunks[c];
+        CommandList_execute(&chunk->commands);
+        stats->draws += chunk->stats.draws;
+        stats->programs += chunk->stats.programs;
+        stats->materials += chunk->stats.materials;
+        stats->vertex_arrays += chunk->stats.vertex_arrays;
+        stats->command_bytes += chunk->stats.command_bytes;
+    }
+    stats->lists = chunk_count;
+    glDisable(GL_BLEND);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_CULL_FACE);
+    glFrontFace(GL_CCW);
+    glBindVertexArray(0);
+    DrawDataBuffer_bind_identity(draws);
+}
+
+void RenderQueue_print_stats(const RenderQueue *queue) {
+    const RenderQueueStats *stats = &queue->stats;
+    printf("RENDER QUEUE:\t%u draws, %u program, %u material and %u vertex array changes, %u sort passes, %u command lists (%.1f KB)\n",
+        stats->draws, stats->programs, stats->materials, stats->vertex_arrays, stats->sort_passes, stats->lists, stats->command_bytes / 1024.0);
+}
+
+#endif
@@ -10,7 +10,8 @@ typedef struct {
     GLuint program;
 } Shader;
 
-GLuint Shader_compile_shader(GLuint type, const char *source) {
+// Compiles the concatenation of count source strings.
+GLuint Shader_compile_shader_sources(GLuint type, GLsizei count, const char **sources) {
     GLuint shader_object;
 
     switch (type) {
@@ -21,7 +22,7 @@ GLuint Shader_compile_shader(GLuint type, const char *source) {
             exit(1);
     }
 
-    glShaderSource(shader_object, 1, &source, (void *)0);
+    glShaderSource(shader_object, count, sources, (void *)0);
     glCompileShader(shader_object);
 
     GLint success;
@@ -35,13 +36,18 @@ GLuint Shader_compile_shader(GLuint type, const char *source) {
     return shader_object;
 }
 
-Shader Shader_create_program(const char *vertex, const char *fragment) {
+GLuint Shader_compile_shader(GLuint type, const char *source) {
+    return Shader_compile_shader_sources(type, 1, &source);
+}
+
+// Builds a program whose fragment shader is several source strings, e.g. a helper library followed by main.
+Shader Shader_create_program_sources(const char *vertex, GLsizei fragment_count, const char **fragment) {
     Shader shader;
 
     GLuint program_object = glCreateProgram();
 
     GLuint vertex_shader = Shader_compile_shader(GL_VERTEX_SHADER, vertex);
-    GLuint fragment_shader = Shader_compile_shader(GL_FRAGMENT_SHADER, fragment);
+    GLuint fragment_shader = Shader_compile_shader_sources(GL_FRAGMENT_SHADER, fragment_count, fragment);
 
     glAttachShader(program_object, vertex_shader);
     glAttachShader(program_object, fragment_shader);
@@ -60,6 +66,17 @@ Shader Shader_create_program(const char *vertex, const char *fragment) {
     return shader;
 }
 
+Shader Shader_create_program(const char *vertex, const char *fragment) {
+    return Shader_create_program_sources(vertex, 1, &fragment);
+}
+
+void Shader_set_uniform_float(Shader shader, const char *name, GLfloat value) {
+    glUseProgram(shader.program);
+    GLuint location = glGetUniformLocation(shader.program, name);
+    glUniform1f(location, value);
+    glUseProgram(0);
+}
+
 void Shader_set_uniform_vec3(Shader shader, const char *name, Vector3 value) {
     glUseProgram(shader.program);
     GLuint location = glGetUniformLocation(shader.program, name);
@@ -67,6 +84,19 @@ void Shader_set_uniform_vec3(Shader shader, const char *name, Vector3 value) {
     glUseProgram(0);
 }
 
+void Shader_set_uniform_vec4(Shader shader, const char *name, Vector4 value) {
+    glUseProgram(shader.program);
+    GLuint location = glGetUniformLocation(shader.program, name);
+    glUniform4f(location, value[0], value[1], value[2], value[3]);
+    glUseProgram(0);
+}
+
+// GLSL 4.10 cannot give a block its binding, so it is set here once the program is linked.
+void Shader_set_uniform_block(Shader shader, const char *name, GLuint binding) {
+    GLuint index = glGetUniformBlockIndex(shader.program, name);
+    if (index != GL_INVALID_INDEX) glUniformBlockBinding(shader.program, index, binding);
+}
+
 void Shader_set_uniform_mat4(Shader shader, const char *name, Matrix4 value) {
     glUseProgram(shader.program);
     GLuint location = glGetUniformLocation(shader.program, name);
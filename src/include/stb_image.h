@@ -274,6 +274,19 @@ RECENT REVISION HISTORY:
 // you have issues compiling it, you can disable it entirely by
 // defining STBI_NO_SIMD.
 //
+// On x86 the JPEG decoder also carries AVX2 versions of the IDCT, the 2x
+// upsamplers and the YCbCr-to-RGBA conversion. They are compiled with a
+// per-function target attribute and only used if a run-time test finds
+// AVX2, so the rest of the library still just needs SSE2. They produce
+// the same bytes as the generic C versions. Define STBI_NO_AVX2 to leave
+// them out.
+//
+// Baseline JPEGs with restart intervals can be decoded on several threads:
+// hand stbi_set_parallel_for() a function that runs a range of tasks on
+// your thread pool, and the entropy-coded data of each scan is split at
+// its restart markers and decoded in parallel. The output is identical to
+// a single-threaded decode.
+//
 // ===========================================================================
 //
 // HDR image support   (disable by defining STBI_NO_HDR)
@@ -524,6 +537,13 @@ STBIDEF void stbi_set_unpremultiply_on_load_thread(int flag_true_if_should_unpre
 STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
 STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+// run JPEG restart intervals in parallel: parallel_for must call task(data, begin, end)
+// over ranges covering [0, count) exactly once and return after all of them finished.
+// it may be called from several threads at once. pass NULL to decode single-threaded.
+typedef void (*stbi_parallel_task)(void *data, int begin, int end);
+typedef void (*stbi_parallel_for_func)(void *user, int count, stbi_parallel_task task, void *data);
+STBIDEF void stbi_set_parallel_for(stbi_parallel_for_func parallel_for, void *user);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -774,6 +794,33 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// AVX2 JPEG kernels; only the functions that use them are compiled for AVX2
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2) && !defined(STBI_NO_JPEG)
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+#define STBI_AVX2
+#include <immintrin.h>
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+static int stbi__avx2_available(void)
+{
+   return __builtin_cpu_supports("avx2");
+}
+#elif defined(_MSC_VER) && _MSC_VER >= 1900
+#define STBI_AVX2
+#include <immintrin.h>
+#define STBI__AVX2_TARGET
+static int stbi__avx2_available(void)
+{
+   int info[4];
+   __cpuid(info,1);
+   // the OS must save ymm registers too
+   if (((info[2] >> 27) & 1) == 0 || ((info[2] >> 28) & 1) == 0) return 0;
+   if ((_xgetbv(0) & 6) != 6) return 0;
+   __cpuidex(info,7,0);
+   return ((info[1] >> 5) & 1) != 0;
+}
+#endif
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -1113,6 +1160,15 @@ static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp);
 
 static int stbi__vertically_flip_on_load_global = 0;
 
+static stbi_parallel_for_func stbi__parallel_for = NULL;
+static void *stbi__parallel_for_user = NULL;
+
+STBIDEF void stbi_set_parallel_for(stbi_parallel_for_func parallel_for, void *user)
+{
+   stbi__parallel_for = parallel_for;
+   stbi__parallel_for_user = user;
+}
+
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
 {
    stbi__vertically_flip_on_load_global = flag_true_if_should_flip;
@@ -1998,6 +2054,8 @@ typedef struct
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
    void (*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step);
    stbi_uc *(*resample_row_hv_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
+   stbi_uc *(*resample_row_v_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
+   stbi_uc *(*resample_row_h_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
 } stbi__jpeg;
 
 static int stbi__build_huffman(stbi__huffman *h, int *count)
@@ -2912,6 +2970,128 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_NEON
 
+#ifdef STBI_AVX2
+
+// avx2 integer IDCT. each 1D pass runs STBI__IDCT_1D on all eight columns
+// (then rows) at once in 32-bit lanes, so it is bit-identical to the
+// generic C version, including the dc-only shortcut, which the full
+// transform reproduces exactly.
+static STBI__AVX2_TARGET void stbi__idct_1d_avx2(__m256i x[4], __m256i t[4], const __m256i s[8])
+{
+   #define dct_mul(a,c) _mm256_mullo_epi32(a, _mm256_set1_epi32(stbi__f2f(c)))
+   __m256i p1,p2,p3,p4,p5;
+
+   // even part
+   p1 = dct_mul(_mm256_add_epi32(s[2], s[6]), 0.5411961f);
+   t[2] = _mm256_add_epi32(p1, dct_mul(s[6], -1.847759065f));
+   t[3] = _mm256_add_epi32(p1, dct_mul(s[2],  0.765366865f));
+   t[0] = _mm256_slli_epi32(_mm256_add_epi32(s[0], s[4]), 12);
+   t[1] = _mm256_slli_epi32(_mm256_sub_epi32(s[0], s[4]), 12);
+   x[0] = _mm256_add_epi32(t[0], t[3]);
+   x[3] = _mm256_sub_epi32(t[0], t[3]);
+   x[1] = _mm256_add_epi32(t[1], t[2]);
+   x[2] = _mm256_sub_epi32(t[1], t[2]);
+
+   // odd part
+   p3 = _mm256_add_epi32(s[7], s[3]);
+   p4 = _mm256_add_epi32(s[5], s[1]);
+   p1 = _mm256_add_epi32(s[7], s[1]);
+   p2 = _mm256_add_epi32(s[5], s[3]);
+   p5 = dct_mul(_mm256_add_epi32(p3, p4), 1.175875602f);
+   t[0] = dct_mul(s[7], 0.298631336f);
+   t[1] = dct_mul(s[5], 2.053119869f);
+   t[2] = dct_mul(s[3], 3.072711026f);
+   t[3] = dct_mul(s[1], 1.501321110f);
+   p1 = _mm256_add_epi32(p5, dct_mul(p1, -0.899976223f));
+   p2 = _mm256_add_epi32(p5, dct_mul(p2, -2.562915447f));
+   p3 = dct_mul(p3, -1.961570560f);
+   p4 = dct_mul(p4, -0.390180644f);
+   t[3] = _mm256_add_epi32(t[3], _mm256_add_epi32(p1, p4));
+   t[2] = _mm256_add_epi32(t[2], _mm256_add_epi32(p2, p3));
+   t[1] = _mm256_add_epi32(t[1], _mm256_add_epi32(p2, p4));
+   t[0] = _mm256_add_epi32(t[0], _mm256_add_epi32(p1, p3));
+   #undef dct_mul
+}
+
+static STBI__AVX2_TARGET void stbi__transpose8_avx2(__m256i v[8])
+{
+   __m256i a0 = _mm256_unpacklo_epi32(v[0], v[1]);
+   __m256i a1 = _mm256_unpackhi_epi32(v[0], v[1]);
+   __m256i a2 = _mm256_unpacklo_epi32(v[2], v[3]);
+   __m256i a3 = _mm256_unpackhi_epi32(v[2], v[3]);
+   __m256i a4 = _mm256_unpacklo_epi32(v[4], v[5]);
+   __m256i a5 = _mm256_unpackhi_epi32(v[4], v[5]);
+   __m256i a6 = _mm256_unpacklo_epi32(v[6], v[7]);
+   __m256i a7 = _mm256_unpackhi_epi32(v[6], v[7]);
+   __m256i b0 = _mm256_unpacklo_epi64(a0, a2);
+   __m256i b1 = _mm256_unpackhi_epi64(a0, a2);
+   __m256i b2 = _mm256_unpacklo_epi64(a1, a3);
+   __m256i b3 = _mm256_unpackhi_epi64(a1, a3);
+   __m256i b4 = _mm256_unpacklo_epi64(a4, a6);
+   __m256i b5 = _mm256_unpackhi_epi64(a4, a6);
+   __m256i b6 = _mm256_unpacklo_epi64(a5, a7);
+   __m256i b7 = _mm256_unpackhi_epi64(a5, a7);
+   v[0] = _mm256_permute2x128_si256(b0, b4, 0x20);
+   v[1] = _mm256_permute2x128_si256(b1, b5, 0x20);
+   v[2] = _mm256_permute2x128_si256(b2, b6, 0x20);
+   v[3] = _mm256_permute2x128_si256(b3, b7, 0x20);
+   v[4] = _mm256_permute2x128_si256(b0, b4, 0x31);
+   v[5] = _mm256_permute2x128_si256(b1, b5, 0x31);
+   v[6] = _mm256_permute2x128_si256(b2, b6, 0x31);
+   v[7] = _mm256_permute2x128_si256(b3, b7, 0x31);
+}
+
+static STBI__AVX2_TARGET void stbi__idct_avx2(stbi_uc *out, int out_stride, short data[64])
+{
+   __m256i v[8], x[4], t[4];
+   __m256i p0, p1, rows;
+   int i;
+
+   // columns: v[i] holds row i of every column
+   for (i=0; i < 8; ++i)
+      v[i] = _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i *) (data + i*8)));
+   stbi__idct_1d_avx2(x, t, v);
+   for (i=0; i < 4; ++i)
+      x[i] = _mm256_add_epi32(x[i], _mm256_set1_epi32(512));
+   v[0] = _mm256_srai_epi32(_mm256_add_epi32(x[0], t[3]), 10);
+   v[7] = _mm256_srai_epi32(_mm256_sub_epi32(x[0], t[3]), 10);
+   v[1] = _mm256_srai_epi32(_mm256_add_epi32(x[1], t[2]), 10);
+   v[6] = _mm256_srai_epi32(_mm256_sub_epi32(x[1], t[2]), 10);
+   v[2] = _mm256_srai_epi32(_mm256_add_epi32(x[2], t[1]), 10);
+   v[5] = _mm256_srai_epi32(_mm256_sub_epi32(x[2], t[1]), 10);
+   v[3] = _mm256_srai_epi32(_mm256_add_epi32(x[3], t[0]), 10);
+   v[4] = _mm256_srai_epi32(_mm256_sub_epi32(x[3], t[0]), 10);
+
+   // rows: after the transpose v[i] holds column i of every row
+   stbi__transpose8_avx2(v);
+   stbi__idct_1d_avx2(x, t, v);
+   for (i=0; i < 4; ++i)
+      x[i] = _mm256_add_epi32(x[i], _mm256_set1_epi32(65536 + (128<<17)));
+   v[0] = _mm256_srai_epi32(_mm256_add_epi32(x[0], t[3]), 17);
+   v[7] = _mm256_srai_epi32(_mm256_sub_epi32(x[0], t[3]), 17);
+   v[1] = _mm256_srai_epi32(_mm256_add_epi32(x[1], t[2]), 17);
+   v[6] = _mm256_srai_epi32(_mm256_sub_epi32(x[1], t[2]), 17);
+   v[2] = _mm256_srai_epi32(_mm256_add_epi32(x[2], t[1]), 17);
+   v[5] = _mm256_srai_epi32(_mm256_sub_epi32(x[2], t[1]), 17);
+   v[3] = _mm256_srai_epi32(_mm256_add_epi32(x[3], t[0]), 17);
+   v[4] = _mm256_srai_epi32(_mm256_sub_epi32(x[3], t[0]), 17);
+
+   // back to rows, then saturate to bytes; saturating twice clamps the same as stbi__clamp
+   stbi__transpose8_avx2(v);
+   for (i=0; i < 8; i += 4) {
+      p0 = _mm256_packs_epi32(v[i+0], v[i+1]);
+      p1 = _mm256_packs_epi32(v[i+2], v[i+3]);
+      // each 128-bit lane now holds half of four rows
+      rows = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(p0, p1), _mm256_setr_epi32(0,4,1,5,2,6,3,7));
+      _mm_storel_epi64((__m128i *) out, _mm256_castsi256_si128(rows)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_unpackhi_epi64(_mm256_castsi256_si128(rows), _mm256_castsi256_si128(rows))); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm256_extracti128_si256(rows, 1)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_unpackhi_epi64(_mm256_extracti128_si256(rows, 1), _mm256_extracti128_si256(rows, 1))); out += out_stride;
+   }
+}
+
+#endif // STBI_AVX2
+
 #define STBI__MARKER_none  0xff
 // if there's a pending marker from the entropy stream, return that
 // otherwise, fetch from the stream and get a marker. if there's no
@@ -2946,67 +3126,204 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
-static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
-{
-   stbi__jpeg_reset(z);
-   if (!z->progressive) {
-      if (z->scan_n == 1) {
-         int i,j;
-         STBI_SIMD_ALIGN(short, data[64]);
-         int n = z->order[0];
-         // non-interleaved data, we just need to process one block at a time,
-         // in trivial scanline order
-         // number of blocks to do just depends on how many actual "pixels" this
-         // component has, independent of interleaved MCU blocking and such
-         int w = (z->img_comp[n].x+7) >> 3;
-         int h = (z->img_comp[n].y+7) >> 3;
-         for (j=0; j < h; ++j) {
-            for (i=0; i < w; ++i) {
-               int ha = z->img_comp[n].ha;
-               if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
-               // every data block is an MCU, so countdown the restart interval
-               if (--z->todo <= 0) {
-                  if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
-                  // if it's NOT a restart, then just bail, so we get corrupt data
-                  // rather than no data
-                  if (!STBI__RESTART(z->marker)) return 1;
-                  stbi__jpeg_reset(z);
-               }
-            }
+// number of MCUs in the current baseline scan; a single-component scan has one block per MCU
+static int stbi__jpeg_mcu_count(stbi__jpeg *z)
+{
+   if (z->scan_n == 1) {
+      int n = z->order[0];
+      return ((z->img_comp[n].x+7) >> 3) * ((z->img_comp[n].y+7) >> 3);
+   }
+   return z->img_mcu_x * z->img_mcu_y;
+}
+
+// decode MCUs [first,last) of a baseline scan, in scanline order
+static int stbi__jpeg_decode_mcus(stbi__jpeg *z, int first, int last)
+{
+   int i,j,m;
+   STBI_SIMD_ALIGN(short, data[64]);
+   if (z->scan_n == 1) {
+      int n = z->order[0];
+      // non-interleaved data, we just need to process one block at a time,
+      // in trivial scanline order
+      // number of blocks to do just depends on how many actual "pixels" this
+      // component has, independent of interleaved MCU blocking and such
+      int w = (z->img_comp[n].x+7) >> 3;
+      for (m=first, i=first % w, j=first / w; m < last; ++m) {
+         int ha = z->img_comp[n].ha;
+         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+         z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+         if (++i == w) { i = 0; ++j; }
+         // every data block is an MCU, so countdown the restart interval
+         if (--z->todo <= 0) {
+            if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
+            // if it's NOT a restart, then just bail, so we get corrupt data
+            // rather than no data
+            if (!STBI__RESTART(z->marker)) return 1;
+            stbi__jpeg_reset(z);
          }
-         return 1;
-      } else { // interleaved
-         int i,j,k,x,y;
-         STBI_SIMD_ALIGN(short, data[64]);
-         for (j=0; j < z->img_mcu_y; ++j) {
-            for (i=0; i < z->img_mcu_x; ++i) {
-               // scan an interleaved mcu... process scan_n components in order
-               for (k=0; k < z->scan_n; ++k) {
-                  int n = z->order[k];
-                  // scan out an mcu's worth of this component; that's just determined
-                  // by the basic H and V specified for the component
-                  for (y=0; y < z->img_comp[n].v; ++y) {
-                     for (x=0; x < z->img_comp[n].h; ++x) {
-                        int x2 = (i*z->img_comp[n].h + x)*8;
-                        int y2 = (j*z->img_comp[n].v + y)*8;
-                        int ha = z->img_comp[n].ha;
-                        if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
-                     }
-                  }
-               }
-               // after all interleaved components, that's an interleaved MCU,
-               // so now count down the restart interval
-               if (--z->todo <= 0) {
-                  if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
-                  if (!STBI__RESTART(z->marker)) return 1;
-                  stbi__jpeg_reset(z);
+      }
+   } else { // interleaved
+      int k,x,y;
+      for (m=first, i=first % z->img_mcu_x, j=first / z->img_mcu_x; m < last; ++m) {
+         // scan an interleaved mcu... process scan_n components in order
+         for (k=0; k < z->scan_n; ++k) {
+            int n = z->order[k];
+            // scan out an mcu's worth of this component; that's just determined
+            // by the basic H and V specified for the component
+            for (y=0; y < z->img_comp[n].v; ++y) {
+               for (x=0; x < z->img_comp[n].h; ++x) {
+                  int x2 = (i*z->img_comp[n].h + x)*8;
+                  int y2 = (j*z->img_comp[n].v + y)*8;
+                  int ha = z->img_comp[n].ha;
+                  if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+                  z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
                }
             }
          }
-         return 1;
+         if (++i == z->img_mcu_x) { i = 0; ++j; }
+         // after all interleaved components, that's an interleaved MCU,
+         // so now count down the restart interval
+         if (--z->todo <= 0) {
+            if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
+            if (!STBI__RESTART(z->marker)) return 1;
+            stbi__jpeg_reset(z);
+         }
       }
+   }
+   return 1;
+}
+
+// at least this many MCUs per parallel task, and at most this many tasks per scan
+#define STBI__JPEG_TASK_MCUS  256
+#define STBI__JPEG_MAX_TASKS  64
+
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi_uc *data;         // the scan's entropy-coded data, restart markers included
+   int size;
+   int *interval_offset;  // where each restart interval starts in data
+   int interval_count;
+   int intervals_per_task;
+   int mcu_count;
+   stbi_uc *task_ok;
+} stbi__jpeg_scan;
+
+static void stbi__jpeg_decode_intervals(void *data, int begin, int end)
+{
+   stbi__jpeg_scan *scan = (stbi__jpeg_scan *) data;
+   stbi__context s;
+   stbi__jpeg *z = (stbi__jpeg *) stbi__malloc(sizeof(stbi__jpeg));
+   int task;
+   for (task = begin; task < end; ++task) {
+      int first = task * scan->intervals_per_task;
+      int last = first + scan->intervals_per_task;
+      int offset = scan->interval_offset[first];
+      int first_mcu = first * scan->z->restart_interval;
+      int last_mcu = last * scan->z->restart_interval;
+      if (last_mcu > scan->mcu_count) last_mcu = scan->mcu_count;
+      scan->task_ok[task] = 0;
+      if (!z) continue;
+      // a private copy of the decoder reading from memory; the blocks it writes belong to this task alone
+      *z = *scan->z;
+      z->s = &s;
+      stbi__start_mem(&s, scan->data + offset, scan->size - offset);
+      stbi__jpeg_reset(z);
+      scan->task_ok[task] = (stbi_uc) stbi__jpeg_decode_mcus(z, first_mcu, last_mcu);
+   }
+   STBI_FREE(z);
+}
+
+// buffer the rest of a baseline scan, find its restart markers and decode groups of restart
+// intervals as parallel tasks. returns -1 without consuming anything if the scan can't be split.
+static int stbi__jpeg_decode_parallel(stbi__jpeg *z)
+{
+   stbi__jpeg_scan scan;
+   int marker = STBI__MARKER_none;
+   int capacity = 1 << 16, found = 1, task_count, i, ok = 1;
+   if (!stbi__parallel_for || z->progressive || z->restart_interval <= 0) return -1;
+
+   scan.z = z;
+   scan.mcu_count = stbi__jpeg_mcu_count(z);
+   scan.interval_count = (scan.mcu_count + z->restart_interval - 1) / z->restart_interval;
+   scan.intervals_per_task = (STBI__JPEG_TASK_MCUS + z->restart_interval - 1) / z->restart_interval;
+   if (scan.interval_count > scan.intervals_per_task * STBI__JPEG_MAX_TASKS)
+      scan.intervals_per_task = (scan.interval_count + STBI__JPEG_MAX_TASKS - 1) / STBI__JPEG_MAX_TASKS;
+   if (scan.interval_count <= scan.intervals_per_task) return -1;
+
+   scan.size = 0;
+   scan.data = (stbi_uc *) stbi__malloc(capacity);
+   scan.interval_offset = (int *) stbi__malloc_mad2(scan.interval_count, sizeof(int), 0);
+   scan.task_ok = (stbi_uc *) stbi__malloc(STBI__JPEG_MAX_TASKS + 1);
+   if (!scan.data || !scan.interval_offset || !scan.task_ok) {
+      STBI_FREE(scan.data); STBI_FREE(scan.interval_offset); STBI_FREE(scan.task_ok);
+      return stbi__err("outofmem", "Out of memory");
+   }
+
+   // copy bytes up to the first marker that isn't a restart, keeping stuffed bytes and
+   // restart markers for the decoder and dropping fill bytes
+   scan.interval_offset[0] = 0;
+   while (!stbi__at_eof(z->s)) {
+      stbi_uc bytes[2], *run = z->s->img_buffer;
+      stbi_uc *ff = (stbi_uc *) memchr(run, 0xff, z->s->img_buffer_end - run);
+      int c, n = (int) ((ff ? ff : z->s->img_buffer_end) - run);
+      if (n == 0) {
+         c = stbi__get8(z->s);
+         bytes[0] = (stbi_uc) c;
+         run = bytes;
+         n = 1;
+         if (c == 0xff) {
+            c = stbi__get8(z->s);
+            while (c == 0xff) c = stbi__get8(z->s);
+            if (c != 0 && !STBI__RESTART(c)) { marker = c; break; }
+            bytes[1] = (stbi_uc) c;
+            n = 2;
+         }
+      } else {
+         // plain bytes already in the buffer go in one copy
+         z->s->img_buffer += n;
+         c = 0;
+      }
+      while (scan.size + n > capacity) {
+         stbi_uc *grown = (stbi_uc *) STBI_REALLOC_SIZED(scan.data, capacity, capacity * 2);
+         if (!grown) { ok = 0; break; }
+         scan.data = grown;
+         capacity *= 2;
+      }
+      if (!ok) break;
+      memcpy(scan.data + scan.size, run, n);
+      scan.size += n;
+      if (run == bytes && n == 2 && c != 0 && found < scan.interval_count)
+         scan.interval_offset[found++] = scan.size;
+   }
+   z->marker = (unsigned char) marker;
+
+   if (ok) {
+      if (found == scan.interval_count) {
+         task_count = (scan.interval_count + scan.intervals_per_task - 1) / scan.intervals_per_task;
+         stbi__parallel_for(stbi__parallel_for_user, task_count, stbi__jpeg_decode_intervals, &scan);
+      } else {
+         // restart markers missing; decode everything in order as the sequential path would
+         task_count = 1;
+         scan.intervals_per_task = scan.interval_count;
+         stbi__jpeg_decode_intervals(&scan, 0, 1);
+      }
+      for (i=0; i < task_count; ++i)
+         ok &= scan.task_ok[i];
+   }
+   STBI_FREE(scan.data);
+   STBI_FREE(scan.interval_offset);
+   STBI_FREE(scan.task_ok);
+   return ok ? 1 : stbi__err("bad restart interval", "Corrupt JPEG");
+}
+
+static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
+{
+   stbi__jpeg_reset(z);
+   if (!z->progressive) {
+      int result = stbi__jpeg_decode_parallel(z);
+      if (result >= 0) return result;
+      return stbi__jpeg_decode_mcus(z, 0, stbi__jpeg_mcu_count(z));
    } else {
       if (z->scan_n == 1) {
          int i,j;
@@ -3643,6 +3960,126 @@ static stbi_uc *stbi__resample_row_hv_2_simd(stbi_uc *out, stbi_uc *in_near, stb
 }
 #endif
 
+#ifdef STBI_AVX2
+static STBI__AVX2_TARGET stbi_uc *stbi__resample_row_v_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   // same as stbi__resample_row_v_2, 32 pixels at a time
+   int i=0;
+   __m256i bias = _mm256_set1_epi16(2);
+   for (; i+31 < w; i += 32) {
+      __m256i nearb = _mm256_loadu_si256((__m256i *) (in_near + i));
+      __m256i farb  = _mm256_loadu_si256((__m256i *) (in_far + i));
+      __m256i near0 = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(nearb));
+      __m256i near1 = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(nearb, 1));
+      __m256i far0  = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(farb));
+      __m256i far1  = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(farb, 1));
+      // 3*near + far + 2 = 4*near + (far - near) + 2
+      __m256i sum0  = _mm256_add_epi16(_mm256_add_epi16(_mm256_slli_epi16(near0, 2), _mm256_sub_epi16(far0, near0)), bias);
+      __m256i sum1  = _mm256_add_epi16(_mm256_add_epi16(_mm256_slli_epi16(near1, 2), _mm256_sub_epi16(far1, near1)), bias);
+      __m256i outv  = _mm256_packus_epi16(_mm256_srli_epi16(sum0, 2), _mm256_srli_epi16(sum1, 2));
+      // packus works per 128-bit lane
+      _mm256_storeu_si256((__m256i *) (out + i), _mm256_permute4x64_epi64(outv, 0xd8));
+   }
+   for (; i < w; ++i)
+      out[i] = stbi__div4(3*in_near[i] + in_far[i] + 2);
+   STBI_NOTUSED(hs);
+   return out;
+}
+
+static STBI__AVX2_TARGET stbi_uc *stbi__resample_row_h_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   // same as stbi__resample_row_h_2, 16 input pixels at a time
+   int i;
+   stbi_uc *input = in_near;
+   __m256i bias = _mm256_set1_epi16(2);
+
+   if (w == 1) {
+      out[0] = out[1] = input[0];
+      return out;
+   }
+
+   out[0] = input[0];
+   out[1] = stbi__div4(input[0]*3 + input[1] + 2);
+   for (i=1; i+16 < w; i += 16) {
+      __m256i prev = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (input + i - 1)));
+      __m256i curr = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (input + i)));
+      __m256i next = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (input + i + 1)));
+      __m256i n    = _mm256_add_epi16(_mm256_add_epi16(_mm256_slli_epi16(curr, 1), curr), bias);
+      __m256i even = _mm256_srli_epi16(_mm256_add_epi16(n, prev), 2);
+      __m256i odd  = _mm256_srli_epi16(_mm256_add_epi16(n, next), 2);
+      // interleaving and packing both work per 128-bit lane, so the pixels stay in order
+      __m256i outv = _mm256_packus_epi16(_mm256_unpacklo_epi16(even, odd), _mm256_unpackhi_epi16(even, odd));
+      _mm256_storeu_si256((__m256i *) (out + i*2), outv);
+   }
+   for (; i < w-1; ++i) {
+      int n = 3*input[i]+2;
+      out[i*2+0] = stbi__div4(n+input[i-1]);
+      out[i*2+1] = stbi__div4(n+input[i+1]);
+   }
+   out[i*2+0] = stbi__div4(input[w-2]*3 + input[w-1] + 2);
+   out[i*2+1] = input[w-1];
+
+   STBI_NOTUSED(in_far);
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+
+static STBI__AVX2_TARGET stbi_uc *stbi__resample_row_hv_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   // same as stbi__resample_row_hv_2_simd, 16 pixels at a time
+   int i=0,t0,t1;
+
+   if (w == 1) {
+      out[0] = out[1] = stbi__div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   for (; i < ((w-1) & ~15); i += 16) {
+      // vertical pass: 3*x + y = 4*x + (y - x)
+      __m256i farw  = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_far + i)));
+      __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_near + i)));
+      __m256i curr  = _mm256_add_epi16(_mm256_slli_epi16(nearw, 2), _mm256_sub_epi16(farw, nearw));
+
+      // shift the current row by one pixel across the 128-bit lanes and
+      // fill in the neighbours of the first and last pixel
+      __m256i prv0 = _mm256_alignr_epi8(curr, _mm256_permute2x128_si256(curr, curr, 0x08), 14);
+      __m256i nxt0 = _mm256_alignr_epi8(_mm256_permute2x128_si256(curr, curr, 0x81), curr, 2);
+      __m256i prev = _mm256_insert_epi16(prv0, t1, 0);
+      __m256i next = _mm256_insert_epi16(nxt0, 3*in_near[i+16] + in_far[i+16], 15);
+
+      // horizontal pass, polyphase as in the sse2 version
+      __m256i bias = _mm256_set1_epi16(8);
+      __m256i curb = _mm256_add_epi16(_mm256_slli_epi16(curr, 2), bias);
+      __m256i even = _mm256_add_epi16(_mm256_sub_epi16(prev, curr), curb);
+      __m256i odd  = _mm256_add_epi16(_mm256_sub_epi16(next, curr), curb);
+
+      __m256i de0  = _mm256_srli_epi16(_mm256_unpacklo_epi16(even, odd), 4);
+      __m256i de1  = _mm256_srli_epi16(_mm256_unpackhi_epi16(even, odd), 4);
+      _mm256_storeu_si256((__m256i *) (out + i*2), _mm256_packus_epi16(de0, de1));
+
+      t1 = 3*in_near[i+15] + in_far[i+15];
+   }
+
+   t0 = t1;
+   t1 = 3*in_near[i] + in_far[i];
+   out[i*2] = stbi__div16(3*t1 + t0 + 8);
+
+   for (++i; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = stbi__div16(3*t0 + t1 + 8);
+      out[i*2  ] = stbi__div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = stbi__div4(t1+2);
+
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+#endif
+
 static stbi_uc *stbi__resample_row_generic(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
 {
    // resample with nearest-neighbor
@@ -3817,12 +4254,69 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+static STBI__AVX2_TARGET void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+   // the sse2 arithmetic on 16 pixels at a time; the rest goes to the sse2 version
+   int i = 0;
+   if (step == 4) {
+      __m256i c_bias    = _mm256_set1_epi16(128);
+      __m256i cr_const0 = _mm256_set1_epi16(   (short) ( 1.40200f*4096.0f+0.5f));
+      __m256i cr_const1 = _mm256_set1_epi16( - (short) ( 0.71414f*4096.0f+0.5f));
+      __m256i cb_const0 = _mm256_set1_epi16( - (short) ( 0.34414f*4096.0f+0.5f));
+      __m256i cb_const1 = _mm256_set1_epi16(   (short) ( 1.77200f*4096.0f+0.5f));
+      __m256i y_bias = _mm256_set1_epi16(8);
+      __m256i xw = _mm256_set1_epi16(255); // alpha channel
+
+      for (; i+15 < count; i += 16) {
+         // load; (y<<8 | 128) >> 4 in the sse2 version is y*16 + 8
+         __m256i yws = _mm256_add_epi16(_mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (y+i))), 4), y_bias);
+         __m256i cr_biased = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (pcr+i))), c_bias);
+         __m256i cb_biased = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (pcb+i))), c_bias);
+         __m256i crw = _mm256_slli_epi16(cr_biased, 8); // (cr-128) << 8
+         __m256i cbw = _mm256_slli_epi16(cb_biased, 8);
+
+         // color transform
+         __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+         __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+         __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+         __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+         __m256i rws = _mm256_add_epi16(cr0, yws);
+         __m256i gwt = _mm256_add_epi16(cb0, yws);
+         __m256i bws = _mm256_add_epi16(yws, cb1);
+         __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+         // descale
+         __m256i rw = _mm256_srai_epi16(rws, 4);
+         __m256i bw = _mm256_srai_epi16(bws, 4);
+         __m256i gw = _mm256_srai_epi16(gws, 4);
+
+         // back to byte and interleave; each 128-bit lane holds 8 pixels
+         __m256i brb = _mm256_packus_epi16(rw, bw);
+         __m256i gxb = _mm256_packus_epi16(gw, xw);
+         __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+         __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+         __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+         __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+
+         // store
+         _mm256_storeu_si256((__m256i *) (out + 0), _mm256_permute2x128_si256(o0, o1, 0x20));
+         _mm256_storeu_si256((__m256i *) (out + 32), _mm256_permute2x128_si256(o0, o1, 0x31));
+         out += 64;
+      }
+   }
+   stbi__YCbCr_to_RGB_simd(out, y+i, pcb+i, pcr+i, count-i, step);
+}
+#endif
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
    j->idct_block_kernel = stbi__idct_block;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
+   j->resample_row_v_2_kernel = stbi__resample_row_v_2;
+   j->resample_row_h_2_kernel = stbi__resample_row_h_2;
 
 #ifdef STBI_SSE2
    if (stbi__sse2_available()) {
@@ -3832,6 +4326,16 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
    }
 #endif
 
+#ifdef STBI_AVX2
+   if (stbi__avx2_available()) {
+      j->idct_block_kernel = stbi__idct_avx2;
+      j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+      j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+      j->resample_row_v_2_kernel = stbi__resample_row_v_2_avx2;
+      j->resample_row_h_2_kernel = stbi__resample_row_h_2_avx2;
+   }
+#endif
+
 #ifdef STBI_NEON
    j->idct_block_kernel = stbi__idct_simd;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
@@ -3912,8 +4416,8 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
          r->line0   = r->line1 = z->img_comp[k].data;
 
          if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
-         else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
-         else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
+         else if (r->hs == 1 && r->vs == 2) r->resample = z->resample_row_v_2_kernel;
+         else if (r->hs == 2 && r->vs == 1) r->resample = z->resample_row_h_2_kernel;
          else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
          else                               r->resample = stbi__resample_row_generic;
       }
@@ -0,0 +1,191 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include "frame_sync.h"
+#include "glad/glad.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One large buffer that per-frame data is written into instead of being respecified with
+// glBufferData. It is split into a region for each frame the GPU may still be reading plus one for
+// the frame being recorded, which allocates linearly from its region. A frame's first allocation
+// moves to the next region, waiting only if the frame that last wrote it is not finished yet. With
+// ARB_buffer_storage the buffer stays persistently mapped; otherwise each allocation is mapped
+// unsynchronized, which is safe because the frame fences already keep writes away from ranges in use.
+// A frame that outgrows its region grows the buffer; once frames have used little of a grown one
+// for a while, it shrinks back toward the initial size, so one burst does not hold memory for good.
+
+#define STREAM_BUFFER_MAX_REGIONS (FRAME_SYNC_MAX_LATENCY + 1)
+#define STREAM_BUFFER_SHRINK_FRAMES 120 // in a row using at most a quarter of a grown region
+
+typedef struct {
+    unsigned int allocations; // in the last frame that made any
+    GLsizeiptr bytes;
+    unsigned int stalls;      // frames that had to wait for their region, in total
+    unsigned int grows;
+    unsigned int shrinks;
+} StreamBufferStats;
+
+typedef struct {
+    FrameSync *frames;
+    GLuint buffer;
+    GLsizeiptr region_size;
+    GLsizeiptr initial_region_size;
+    int region_count;
+    int region;
+    unsigned int region_frames[STREAM_BUFFER_MAX_REGIONS]; // the last frame to write each, 0 for none
+    GLsizeiptr head; // next free byte of the current region
+    int persistent;
+    unsigned char *memory; // the whole buffer, while persistently mapped
+    void *mapped;          // the allocation StreamBuffer_map mapped otherwise
+    unsigned int allocations;
+    unsigned int quiet_frames; // in a row that used little of a grown region
+    GLsizeiptr quiet_peak;     // the most any of them used
+    StreamBufferStats stats;
+} StreamBuffer;
+
+void StreamBuffer_create_storage(StreamBuffer *stream) {
+    GLsizeiptr size = stream->region_size * stream->region_count;
+    glGenBuffers(1, &stream->buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+    stream->persistent = GLAD_GL_ARB_buffer_storage;
+    if (stream->persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+        stream->memory = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+        if (!stream->memory) {
+            fprintf(stderr, "Could not map stream buffer\n");
+            exit(1);
+        }
+    } else {
+        glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+        stream->memory = NULL;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+// The buffer goes once the frames that may still read it are finished.
+void StreamBuffer_delete_storage(StreamBuffer *stream) {
+    if (stream->memory) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        stream->memory = NULL;
+    }
+    FrameSync_delete(stream->frames, FRAME_DELETE_BUFFER, stream->buffer);
+    stream->buffer = 0;
+}
+
+void StreamBuffer_init(StreamBuffer *stream, FrameSync *frames, GLsizeiptr region_size) {
+    memset(stream, 0, sizeof(*stream));
+    stream->frames = frames;
+    stream->region_size = region_size;
+    stream->initial_region_size = region_size;
+    stream->region_count = (int)frames->max_latency + 1;
+    StreamBuffer_create_storage(stream);
+}
+
+void StreamBuffer_free(StreamBuffer *stream) {
+    StreamBuffer_delete_storage(stream);
+    stream->region_size = 0;
+}
+
+// Replaces the buffer, the frame being recorded continuing at the start of the new one. Draws already
+// made keep reading the old one until it is deleted with their frame, but attribute pointers have to
+// be set again.
+void StreamBuffer_resize(StreamBuffer *stream, GLsizeiptr region_size) {
+    StreamBuffer_delete_storage(stream);
+    stream->region_size = region_size;
+    stream->region = 0;
+    memset(stream->region_frames, 0, sizeof(stream->region_frames));
+    stream->region_frames[0] = stream->frames->frame;
+    stream->head = 0;
+    stream->quiet_frames = 0;
+    stream->quiet_peak = 0;
+    StreamBuffer_create_storage(stream);
+}
+
+void StreamBuffer_grow(StreamBuffer *stream, GLsizeiptr needed) {
+    GLsizeiptr region_size = stream->region_size * 2;
+    while (region_size < needed) region_size *= 2;
+    StreamBuffer_resize(stream, region_size);
+    stream->stats.grows++;
+}
+
+// Counts frames that used at most a quarter of a grown region, and after enough of them in a row
+// shrinks it to twice what the busiest needed, but no smaller than it started.
+void StreamBuffer_shrink(StreamBuffer *stream, GLsizeiptr used) {
+    if (stream->region_size <= stream->initial_region_size || used > stream->region_size / 4) {
+        stream->quiet_frames = 0;
+        stream->quiet_peak = 0;
+        return;
+    }
+    if (used > stream->quiet_peak) stream->quiet_peak = used;
+    if (++stream->quiet_frames < STREAM_BUFFER_SHRINK_FRAMES) return;
+    GLsizeiptr region_size = stream->initial_region_size;
+    while (region_size < stream->quiet_peak * 2) region_size *= 2;
+    StreamBuffer_resize(stream, region_size);
+    stream->stats.shrinks++;
+}
+
+// Moves to the next region when a new frame starts allocating.
+void StreamBuffer_begin_frame(StreamBuffer *stream) {
+    unsigned int frame = stream->frames->frame;
+    if (stream->region_frames[stream->region] == frame) return;
+    if (stream->allocations) {
+        stream->stats.allocations = stream->allocations;
+        stream->stats.bytes = stream->head;
+    }
+    GLsizeiptr used = stream->head;
+    stream->allocations = 0;
+    stream->head = 0;
+    StreamBuffer_shrink(stream, used);
+    if (stream->region_frames[stream->region] == frame) return; // shrunk, and already in region 0
+    stream->region = (stream->region + 1) % stream->region_count;
+    if (stream->region_frames[stream->region] && FrameSync_wait(stream->frames, stream->region_frames[stream->region])) stream->stats.stalls++;
+    stream->region_frames[stream->region] = frame;
+}
+
+// Room for size bytes at a multiple of alignment, to be written before StreamBuffer_unmap and
+// drawn from this frame only. offset receives where they start in stream->buffer.
+void *StreamBuffer_map(StreamBuffer *stream, GLsizeiptr size, GLsizeiptr alignment, GLintptr *offset) {
+    StreamBuffer_begin_frame(stream);
+    GLsizeiptr start = (stream->head + alignment - 1) / alignment * alignment;
+    if (start + size > stream->region_size) {
+        StreamBuffer_grow(stream, size);
+        start = 0;
+    }
+    stream->head = start + size;
+    stream->allocations++;
+    *offset = (GLintptr)stream->region * stream->region_size + start;
+    if (stream->persistent) return stream->memory + *offset;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+    stream->mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, *offset, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if (!stream->mapped) {
+        fprintf(stderr, "Could not map stream buffer\n");
+        exit(1);
+    }
+    return stream->mapped;
+}
+
+// Returns 0 if the contents were lost, on mode switches and such.
+int StreamBuffer_unmap(StreamBuffer *stream) {
+    if (!stream->mapped) return 1;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+    GLboolean intact = glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    stream->mapped = NULL;
+    return intact == GL_TRUE;
+}
+
+void StreamBuffer_print_stats(const StreamBuffer *stream) {
+    const StreamBufferStats *stats = &stream->stats;
+    printf("STREAM BUFFER:\t%.1f KB in %u allocations last frame, %d regions of %.1f KB (%s), %u stalls, %u grows, %u shrinks\n", stats->bytes / 1024.0,
+        stats->allocations, stream->region_count, stream->region_size / 1024.0, stream->persistent ? "persistent" : "unsynchronized maps",
+        stats->stalls, stats->grows, stats->shrinks);
+}
+
+#endif
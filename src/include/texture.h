@@ -0,0 +1,736 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include "glad/glad.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEXTURE_MAX_LEVELS 16
+
+typedef enum {
+    TEXTURE_FORMAT_RGB8,
+    TEXTURE_FORMAT_RGBA8,
+    TEXTURE_FORMAT_BC1,
+    TEXTURE_FORMAT_BC3,
+    TEXTURE_FORMAT_BC4,
+    TEXTURE_FORMAT_BC5,
+    TEXTURE_FORMAT_BC7,
+} TextureFormat;
+
+typedef struct {
+    unsigned int width;
+    unsigned int height;
+    size_t offset;
+    size_t size;
+} TextureLevel;
+
+// CPU side copy of a texture, level 0 first and every level packed back to back in data.
+// Array textures store all layers of a level next to each other, as KTX2 does.
+typedef struct {
+    TextureFormat format;
+    int srgb;
+    unsigned int width;
+    unsigned int height;
+    unsigned int layer_count; // 0 for a plain 2D texture, otherwise the number of array layers
+    unsigned int level_count;
+    TextureLevel levels[TEXTURE_MAX_LEVELS];
+    unsigned char *data;
+    size_t data_size;
+} TextureImage;
+
+int TextureFormat_is_compressed(TextureFormat format) {
+    return format != TEXTURE_FORMAT_RGB8 && format != TEXTURE_FORMAT_RGBA8;
+}
+
+// Bytes per 4x4 block for compressed formats, bytes per texel otherwise.
+unsigned int TextureFormat_block_bytes(TextureFormat format) {
+    switch (format) {
+        case TEXTURE_FORMAT_RGB8: return 3;
+        case TEXTURE_FORMAT_RGBA8: return 4;
+        case TEXTURE_FORMAT_BC1:
+        case TEXTURE_FORMAT_BC4: return 8;
+        case TEXTURE_FORMAT_BC3:
+        case TEXTURE_FORMAT_BC5:
+        case TEXTURE_FORMAT_BC7: return 16;
+    }
+    return 0;
+}
+
+size_t TextureFormat_level_size(TextureFormat format, unsigned int width, unsigned int height) {
+    if (!TextureFormat_is_compressed(format)) {
+        return (size_t)width * height * TextureFormat_block_bytes(format);
+    }
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * TextureFormat_block_bytes(format);
+}
+
+GLenum TextureFormat_gl_internal_format(TextureFormat format, int srgb) {
+    switch (format) {
+        case TEXTURE_FORMAT_RGB8: return srgb ? GL_SRGB8 : GL_RGB8;
+        case TEXTURE_FORMAT_RGBA8: return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        case TEXTURE_FORMAT_BC1: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        case TEXTURE_FORMAT_BC3: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case TEXTURE_FORMAT_BC4: return GL_COMPRESSED_RED_RGTC1;
+        case TEXTURE_FORMAT_BC5: return GL_COMPRESSED_RG_RGTC2;
+        case TEXTURE_FORMAT_BC7: return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB : GL_COMPRESSED_RGBA_BPTC_UNORM_ARB;
+    }
+    return 0;
+}
+
+const char *TextureFormat_name(TextureFormat format) {
+    switch (format) {
+        case TEXTURE_FORMAT_RGB8: return "rgb8";
+        case TEXTURE_FORMAT_RGBA8: return "rgba8";
+        case TEXTURE_FORMAT_BC1: return "bc1";
+        case TEXTURE_FORMAT_BC3: return "bc3";
+        case TEXTURE_FORMAT_BC4: return "bc4";
+        case TEXTURE_FORMAT_BC5: return "bc5";
+        case TEXTURE_FORMAT_BC7: return "bc7";
+    }
+    return "unknown";
+}
+
+// Lays out level_count levels of layer_count layers starting at width x height without allocating storage for them.
+void TextureImage_layout_array(TextureImage *image, TextureFormat format, int srgb, unsigned int width, unsigned int height, unsigned int level_count, unsigned int layer_count) {
+    if (level_count < 1) level_count = 1;
+    if (level_count > TEXTURE_MAX_LEVELS) level_count = TEXTURE_MAX_LEVELS;
+
+    image->format = format;
+    image->srgb = srgb;
+    image->width = width;
+    image->height = height;
+    image->layer_count = layer_count;
+    image->level_count = level_count;
+
+    size_t offset = 0;
+    for (unsigned int i = 0; i < level_count; i++) {
+        TextureLevel *level = &image->levels[i];
+        level->width = width > 1 ? width : 1;
+        level->height = height > 1 ? height : 1;
+        level->offset = offset;
+        level->size = TextureFormat_level_size(format, level->width, level->height) * (layer_count > 0 ? layer_count : 1);
+        offset += level->size;
+        width /= 2;
+        height /= 2;
+    }
+
+    image->data_size = offset;
+    image->data = NULL;
+}
+
+void TextureImage_layout(TextureImage *image, TextureFormat format, int srgb, unsigned int width, unsigned int height, unsigned int level_count) {
+    TextureImage_layout_array(image, format, srgb, width, height, level_count, 0);
+}
+
+// Lays out the levels and allocates zeroed storage for them.
+void TextureImage_allocate_array(TextureImage *image, TextureFormat format, int srgb, unsigned int width, unsigned int height, unsigned int level_count, unsigned int layer_count) {
+    TextureImage_layout_array(image, format, srgb, width, height, level_count, layer_count);
+    image->data = calloc(image->data_size, 1);
+    if (!image->data) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+}
+
+void TextureImage_allocate(TextureImage *image, TextureFormat format, int srgb, unsigned int width, unsigned int height, unsigned int level_count) {
+    TextureImage_allocate_array(image, format, srgb, width, height, level_count, 0);
+}
+
+// Where one layer of one level starts in data.
+size_t TextureImage_layer_offset(const TextureImage *image, unsigned int level, unsigned int layer) {
+    const TextureLevel *info = &image->levels[level];
+    return info->offset + layer * TextureFormat_level_size(image->format, info->width, info->height);
+}
+
+void TextureImage_free(TextureImage *image) {
+    free(image->data);
+    image->data = NULL;
+    image->data_size = 0;
+    image->level_count = 0;
+}
+
+// Forgets the largest levels so low-memory configurations never upload them, always keeping the smallest level.
+void TextureImage_drop_top_levels(TextureImage *image, unsigned int count) {
+    if (count >= image->level_count) count = image->level_count - 1;
+    if (count == 0) return;
+
+    memmove(image->levels, image->levels + count, (image->level_count - count) * sizeof(TextureLevel));
+    image->level_count -= count;
+    image->width = image->levels[0].width;
+    image->height = image->levels[0].height;
+}
+
+unsigned char *TextureImage_read_file(const char *file_path, size_t *size) {
+    FILE *fp = fopen(file_path, "rb");
+    if (!fp) return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    long length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (length <= 0) {
+        fclose(fp);
+        return NULL;
+    }
+
+    unsigned char *contents = malloc(length);
+    if (!contents) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    if (fread(contents, 1, length, fp) != (size_t)length) {
+        free(contents);
+        fclose(fp);
+        return NULL;
+    }
+
+    fclose(fp);
+    *size = length;
+    return contents;
+}
+
+uint32_t TextureImage_read_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+uint64_t TextureImage_read_u64(const unsigned char *p) {
+    return (uint64_t)TextureImage_read_u32(p) | (uint64_t)TextureImage_read_u32(p + 4) << 32;
+}
+
+void TextureImage_write_u32(FILE *fp, uint32_t value) {
+    unsigned char bytes[4] = { value, value >> 8, value >> 16, value >> 24 };
+    fwrite(bytes, 1, 4, fp);
+}
+
+void TextureImage_write_u64(FILE *fp, uint64_t value) {
+    TextureImage_write_u32(fp, (uint32_t)value);
+    TextureImage_write_u32(fp, (uint32_t)(value >> 32));
+}
+
+/* DDS */
+
+#define DDS_MAGIC 0x20534444 // "DDS "
+#define DDS_HEADER_SIZE 124
+#define DDS_FOURCC(a, b, c, d) ((uint32_t)(a) | (uint32_t)(b) << 8 | (uint32_t)(c) << 16 | (uint32_t)(d) << 24)
+
+#define DDSD_CAPS 0x1
+#define DDSD_HEIGHT 0x2
+#define DDSD_WIDTH 0x4
+#define DDSD_PITCH 0x8
+#define DDSD_PIXELFORMAT 0x1000
+#define DDSD_MIPMAPCOUNT 0x20000
+#define DDSD_LINEARSIZE 0x80000
+#define DDPF_ALPHAPIXELS 0x1
+#define DDPF_FOURCC 0x4
+#define DDPF_RGB 0x40
+#define DDSCAPS_COMPLEX 0x8
+#define DDSCAPS_TEXTURE 0x1000
+#define DDSCAPS_MIPMAP 0x400000
+
+#define DXGI_FORMAT_R8G8B8A8_UNORM 28
+#define DXGI_FORMAT_R8G8B8A8_UNORM_SRGB 29
+#define DXGI_FORMAT_BC1_UNORM 71
+#define DXGI_FORMAT_BC1_UNORM_SRGB 72
+#define DXGI_FORMAT_BC3_UNORM 77
+#define DXGI_FORMAT_BC3_UNORM_SRGB 78
+#define DXGI_FORMAT_BC4_UNORM 80
+#define DXGI_FORMAT_BC5_UNORM 83
+#define DXGI_FORMAT_BC7_UNORM 98
+#define DXGI_FORMAT_BC7_UNORM_SRGB 99
+
+int TextureImage_dxgi_format(uint32_t dxgi, TextureFormat *format, int *srgb) {
+    *srgb = 0;
+    switch (dxgi) {
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB: *srgb = 1; /* fallthrough */
+        case DXGI_FORMAT_R8G8B8A8_UNORM: *format = TEXTURE_FORMAT_RGBA8; return 1;
+        case DXGI_FORMAT_BC1_UNORM_SRGB: *srgb = 1; /* fallthrough */
+        case DXGI_FORMAT_BC1_UNORM: *format = TEXTURE_FORMAT_BC1; return 1;
+        case DXGI_FORMAT_BC3_UNORM_SRGB: *srgb = 1; /* fallthrough */
+        case DXGI_FORMAT_BC3_UNORM: *format = TEXTURE_FORMAT_BC3; return 1;
+        case DXGI_FORMAT_BC4_UNORM: *format = TEXTURE_FORMAT_BC4; return 1;
+        case DXGI_FORMAT_BC5_UNORM: *format = TEXTURE_FORMAT_BC5; return 1;
+        case DXGI_FORMAT_BC7_UNORM_SRGB: *srgb = 1; /* fallthrough */
+        case DXGI_FORMAT_BC7_UNORM: *format = TEXTURE_FORMAT_BC7; return 1;
+    }
+    return 0;
+}
+
+uint32_t TextureFormat_dxgi_format(TextureFormat format, int srgb) {
+    switch (format) {
+        case TEXTURE_FORMAT_RGB8: return 0;
+        case TEXTURE_FORMAT_RGBA8: return srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+        case TEXTURE_FORMAT_BC1: return srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+        case TEXTURE_FORMAT_BC3: return srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+        case TEXTURE_FORMAT_BC4: return DXGI_FORMAT_BC4_UNORM;
+        case TEXTURE_FORMAT_BC5: return DXGI_FORMAT_BC5_UNORM;
+        case TEXTURE_FORMAT_BC7: return srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+    }
+    return 0;
+}
+
+// Fills in the layout of a DDS file and where each level starts in it, without reading texel data.
+int TextureImage_parse_dds_header(TextureImage *image, const char *file_path, const unsigned char *contents, size_t size, size_t file_offsets[TEXTURE_MAX_LEVELS]) {
+    if (size < 4 + DDS_HEADER_SIZE || TextureImage_read_u32(contents) != DDS_MAGIC || TextureImage_read_u32(contents + 4) != DDS_HEADER_SIZE) {
+        fprintf(stderr, "Not a DDS file: %s\n", file_path);
+        return 0;
+    }
+
+    const unsigned char *header = contents + 4;
+    uint32_t flags = TextureImage_read_u32(header + 4);
+    uint32_t height = TextureImage_read_u32(header + 8);
+    uint32_t width = TextureImage_read_u32(header + 12);
+    uint32_t level_count = (flags & DDSD_MIPMAPCOUNT) ? TextureImage_read_u32(header + 24) : 1;
+    if (level_count == 0) level_count = 1;
+
+    const unsigned char *pixel_format = header + 72;
+    uint32_t pf_flags = TextureImage_read_u32(pixel_format + 4);
+    uint32_t fourcc = TextureImage_read_u32(pixel_format + 8);
+    uint32_t bit_count = TextureImage_read_u32(pixel_format + 12);
+    uint32_t r_mask = TextureImage_read_u32(pixel_format + 16);
+
+    size_t data_offset = 4 + DDS_HEADER_SIZE;
+    TextureFormat format;
+    int srgb = 0;
+    if ((pf_flags & DDPF_FOURCC) && fourcc == DDS_FOURCC('D', 'X', '1', '0')) {
+        if (size < data_offset + 20) {
+            fprintf(stderr, "Truncated DDS header: %s\n", file_path);
+            return 0;
+        }
+        uint32_t dxgi = TextureImage_read_u32(contents + data_offset);
+        uint32_t array_size = TextureImage_read_u32(contents + data_offset + 12);
+        data_offset += 20;
+        if (array_size > 1 || !TextureImage_dxgi_format(dxgi, &format, &srgb)) {
+            fprintf(stderr, "Unsupported DDS DXGI format %u in %s\n", dxgi, file_path);
+            return 0;
+        }
+    } else if (pf_flags & DDPF_FOURCC) {
+        if (fourcc == DDS_FOURCC('D', 'X', 'T', '1')) format = TEXTURE_FORMAT_BC1;
+        else if (fourcc == DDS_FOURCC('D', 'X', 'T', '5')) format = TEXTURE_FORMAT_BC3;
+        else if (fourcc == DDS_FOURCC('A', 'T', 'I', '1') || fourcc == DDS_FOURCC('B', 'C', '4', 'U')) format = TEXTURE_FORMAT_BC4;
+        else if (fourcc == DDS_FOURCC('A', 'T', 'I', '2') || fourcc == DDS_FOURCC('B', 'C', '5', 'U')) format = TEXTURE_FORMAT_BC5;
+        else {
+            fprintf(stderr, "Unsupported DDS FourCC %.4s in %s\n", (const char *)(pixel_format + 8), file_path);
+            return 0;
+        }
+    } else if ((pf_flags & DDPF_RGB) && r_mask == 0xff && (bit_count == 24 || bit_count == 32)) {
+        format = bit_count == 32 ? TEXTURE_FORMAT_RGBA8 : TEXTURE_FORMAT_RGB8;
+    } else {
+        fprintf(stderr, "Unsupported DDS pixel format in %s\n", file_path);
+        return 0;
+    }
+
+    if (width == 0 || height == 0 || level_count > TEXTURE_MAX_LEVELS) {
+        fprintf(stderr, "Unsupported texture dimensions in %s\n", file_path);
+        return 0;
+    }
+
+    TextureImage_layout(image, format, srgb, width, height, level_count);
+    for (uint32_t i = 0; i < level_count; i++) {
+        file_offsets[i] = data_offset + image->levels[i].offset;
+    }
+    return 1;
+}
+
+int TextureImage_write_dds(const TextureImage *image, const char *file_path) {
+    if (image->layer_count > 0) {
+        fprintf(stderr, "Array textures need a KTX2 container: %s\n", file_path);
+        return 0;
+    }
+
+    FILE *fp = fopen(file_path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Could not open file: %s\n", file_path);
+        return 0;
+    }
+
+    int compressed = TextureFormat_is_compressed(image->format);
+    uint32_t fourcc = 0;
+    if (!image->srgb) {
+        switch (image->format) {
+            case TEXTURE_FORMAT_BC1: fourcc = DDS_FOURCC('D', 'X', 'T', '1'); break;
+            case TEXTURE_FORMAT_BC3: fourcc = DDS_FOURCC('D', 'X', 'T', '5'); break;
+            case TEXTURE_FORMAT_BC4: fourcc = DDS_FOURCC('A', 'T', 'I', '1'); break;
+            case TEXTURE_FORMAT_BC5: fourcc = DDS_FOURCC('A', 'T', 'I', '2'); break;
+            default: break;
+        }
+    }
+    int dx10 = fourcc == 0 && image->format != TEXTURE_FORMAT_RGB8 && (compressed || image->srgb);
+    if (dx10) fourcc = DDS_FOURCC('D', 'X', '1', '0');
+
+    uint32_t flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT;
+    flags |= compressed ? DDSD_LINEARSIZE : DDSD_PITCH;
+    uint32_t pitch = compressed ? image->levels[0].size : image->width * TextureFormat_block_bytes(image->format);
+    uint32_t caps = DDSCAPS_TEXTURE | (image->level_count > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+    TextureImage_write_u32(fp, DDS_MAGIC);
+    TextureImage_write_u32(fp, DDS_HEADER_SIZE);
+    TextureImage_write_u32(fp, flags);
+    TextureImage_write_u32(fp, image->height);
+    TextureImage_write_u32(fp, image->width);
+    TextureImage_write_u32(fp, pitch);
+    TextureImage_write_u32(fp, 0); // depth
+    TextureImage_write_u32(fp, image->level_count);
+    for (int i = 0; i < 11; i++) TextureImage_write_u32(fp, 0);
+
+    TextureImage_write_u32(fp, 32);
+    if (fourcc) {
+        TextureImage_write_u32(fp, DDPF_FOURCC);
+        TextureImage_write_u32(fp, fourcc);
+        for (int i = 0; i < 5; i++) TextureImage_write_u32(fp, 0);
+    } else {
+        int alpha = image->format == TEXTURE_FORMAT_RGBA8;
+        TextureImage_write_u32(fp, DDPF_RGB | (alpha ? DDPF_ALPHAPIXELS : 0));
+        TextureImage_write_u32(fp, 0);
+        TextureImage_write_u32(fp, alpha ? 32 : 24);
+        TextureImage_write_u32(fp, 0x000000ff);
+        TextureImage_write_u32(fp, 0x0000ff00);
+        TextureImage_write_u32(fp, 0x00ff0000);
+        TextureImage_write_u32(fp, alpha ? 0xff000000 : 0);
+    }
+
+    TextureImage_write_u32(fp, caps);
+    for (int i = 0; i < 4; i++) TextureImage_write_u32(fp, 0);
+
+    if (dx10) {
+        TextureImage_write_u32(fp, TextureFormat_dxgi_format(image->format, image->srgb));
+        TextureImage_write_u32(fp, 3); // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+        TextureImage_write_u32(fp, 0);
+        TextureImage_write_u32(fp, 1);
+        TextureImage_write_u32(fp, 0);
+    }
+
+    fwrite(image->data, 1, image->data_size, fp);
+    int success = !ferror(fp);
+    fclose(fp);
+    return success;
+}
+
+/* KTX2 */
+
+static const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+#define KTX2_HEADER_SIZE 80
+#define KTX2_LEVEL_INDEX_SIZE 24
+
+#define VK_FORMAT_R8G8B8_UNORM 23
+#define VK_FORMAT_R8G8B8_SRGB 29
+#define VK_FORMAT_R8G8B8A8_UNORM 37
+#define VK_FORMAT_R8G8B8A8_SRGB 43
+#define VK_FORMAT_BC1_RGB_UNORM_BLOCK 131
+#define VK_FORMAT_BC1_RGB_SRGB_BLOCK 132
+#define VK_FORMAT_BC1_RGBA_UNORM_BLOCK 133
+#define VK_FORMAT_BC1_RGBA_SRGB_BLOCK 134
+#define VK_FORMAT_BC3_UNORM_BLOCK 137
+#define VK_FORMAT_BC3_SRGB_BLOCK 138
+#define VK_FORMAT_BC4_UNORM_BLOCK 139
+#define VK_FORMAT_BC5_UNORM_BLOCK 141
+#define VK_FORMAT_BC7_UNORM_BLOCK 145
+#define VK_FORMAT_BC7_SRGB_BLOCK 146
+
+int TextureImage_vk_format(uint32_t vk_format, TextureFormat *format, int *srgb) {
+    *srgb = 0;
+    switch (vk_format) {
+        case VK_FORMAT_R8G8B8_SRGB: *srgb = 1; /* fallthrough */
+        case VK_FORMAT_R8G8B8_UNORM: *format = TEXTURE_FORMAT_RGB8; return 1;
+        case VK_FORMAT_R8G8B8A8_SRGB: *srgb = 1; /* fallthrough */
+        case VK_FORMAT_R8G8B8A8_UNORM: *format = TEXTURE_FORMAT_RGBA8; return 1;
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: *srgb = 1; /* fallthrough */
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: *format = TEXTURE_FORMAT_BC1; return 1;
+        case VK_FORMAT_BC3_SRGB_BLOCK: *srgb = 1; /* fallthrough */
+        case VK_FORMAT_BC3_UNORM_BLOCK: *format = TEXTURE_FORMAT_BC3; return 1;
+        case VK_FORMAT_BC4_UNORM_BLOCK: *format = TEXTURE_FORMAT_BC4; return 1;
+        case VK_FORMAT_BC5_UNORM_BLOCK: *format = TEXTURE_FORMAT_BC5; return 1;
+        case VK_FORMAT_BC7_SRGB_BLOCK: *srgb = 1; /* fallthrough */
+        case VK_FORMAT_BC7_UNORM_BLOCK: *format = TEXTURE_FORMAT_BC7; return 1;
+    }
+    return 0;
+}
+
+uint32_t TextureFormat_vk_format(TextureFormat format, int srgb) {
+    switch (format) {
+        case TEXTURE_FORMAT_RGB8: return srgb ? VK_FORMAT_R8G8B8_SRGB : VK_FORMAT_R8G8B8_UNORM;
+        case TEXTURE_FORMAT_RGBA8: return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+        case TEXTURE_FORMAT_BC1: return srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case TEXTURE_FORMAT_BC3: return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+        case TEXTURE_FORMAT_BC4: return VK_FORMAT_BC4_UNORM_BLOCK;
+        case TEXTURE_FORMAT_BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+        case TEXTURE_FORMAT_BC7: return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    }
+    return 0;
+}
+
+// Fills in the layout of a KTX2 file and where each level starts in it, without reading texel data.
+int TextureImage_parse_ktx2_header(TextureImage *image, const char *file_path, const unsigned char *contents, size_t size, size_t file_offsets[TEXTURE_MAX_LEVELS]) {
+    if (size < KTX2_HEADER_SIZE || memcmp(contents, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        fprintf(stderr, "Not a KTX2 file: %s\n", file_path);
+        return 0;
+    }
+
+    uint32_t vk_format = TextureImage_read_u32(contents + 12);
+    uint32_t width = TextureImage_read_u32(contents + 20);
+    uint32_t height = TextureImage_read_u32(contents + 24);
+    uint32_t depth = TextureImage_read_u32(contents + 28);
+    uint32_t layer_count = TextureImage_read_u32(contents + 32);
+    uint32_t face_count = TextureImage_read_u32(contents + 36);
+    uint32_t level_count = TextureImage_read_u32(contents + 40);
+    uint32_t supercompression = TextureImage_read_u32(contents + 44);
+    if (level_count == 0) level_count = 1;
+
+    TextureFormat format;
+    int srgb;
+    if (depth > 1 || face_count != 1 || supercompression != 0 || !TextureImage_vk_format(vk_format, &format, &srgb)) {
+        fprintf(stderr, "Unsupported KTX2 texture (vkFormat %u) in %s\n", vk_format, file_path);
+        return 0;
+    }
+    if (level_count > TEXTURE_MAX_LEVELS || size < KTX2_HEADER_SIZE + (size_t)level_count * KTX2_LEVEL_INDEX_SIZE) {
+        fprintf(stderr, "Truncated KTX2 level index in %s\n", file_path);
+        return 0;
+    }
+
+    if (width == 0 || height == 0) {
+        fprintf(stderr, "Unsupported texture dimensions in %s\n", file_path);
+        return 0;
+    }
+
+    TextureImage_layout_array(image, format, srgb, width, height, level_count, layer_count);
+    for (uint32_t i = 0; i < level_count; i++) {
+        const unsigned char *entry = contents + KTX2_HEADER_SIZE + i * KTX2_LEVEL_INDEX_SIZE;
+        if (TextureImage_read_u64(entry + 8) < image->levels[i].size) {
+            fprintf(stderr, "Truncated KTX2 level %u in %s\n", i, file_path);
+            return 0;
+        }
+        file_offsets[i] = TextureImage_read_u64(entry);
+    }
+    return 1;
+}
+
+// Basic data format descriptor (KHR_DF) for the formats TextureImage can hold.
+uint32_t TextureImage_write_ktx2_dfd(FILE *fp, const TextureImage *image) {
+    uint32_t model, block_dimensions, bytes_plane;
+    uint32_t samples[4][4];
+    int sample_count = 0;
+
+    uint32_t upper = 0xffffffff;
+    switch (image->format) {
+        case TEXTURE_FORMAT_RGB8:
+        case TEXTURE_FORMAT_RGBA8:
+            model = 1; // KHR_DF_MODEL_RGBSDA
+            block_dimensions = 0;
+            bytes_plane = TextureFormat_block_bytes(image->format);
+            for (unsigned int i = 0; i < bytes_plane; i++) {
+                uint32_t channel = i == 3 ? 15 : i;
+                uint32_t qualifiers = (i == 3 && image->srgb) ? 0x10 : 0; // alpha stays linear
+                samples[sample_count][0] = (i * 8) | (7 << 16) | ((channel | qualifiers) << 24);
+                samples[sample_count][1] = 0;
+                samples[sample_count][2] = 0;
+                samples[sample_count][3] = 255;
+                sample_count++;
+            }
+            break;
+        default:
+            block_dimensions = 3 | 3 << 8;
+            bytes_plane = TextureFormat_block_bytes(image->format);
+            switch (image->format) {
+                case TEXTURE_FORMAT_BC1: model = 128; break;
+                case TEXTURE_FORMAT_BC3: model = 130; break;
+                case TEXTURE_FORMAT_BC4: model = 131; break;
+                case TEXTURE_FORMAT_BC5: model = 132; break;
+                default: model = 134; break;
+            }
+            if (image->format == TEXTURE_FORMAT_BC3 || image->format == TEXTURE_FORMAT_BC5) {
+                uint32_t first = image->format == TEXTURE_FORMAT_BC3 ? 15 : 0;
+                uint32_t second = image->format == TEXTURE_FORMAT_BC3 ? 0 : 1;
+                uint32_t first_sample[4] = { 0 | (63 << 16) | (first << 24), 0, 0, upper };
+                uint32_t second_sample[4] = { 64 | (63 << 16) | (second << 24), 0, 0, upper };
+                memcpy(samples[sample_count++], first_sample, sizeof(first_sample));
+                memcpy(samples[sample_count++], second_sample, sizeof(second_sample));
+            } else {
+                uint32_t bits = bytes_plane * 8 - 1;
+                uint32_t sample[4] = { 0 | (bits << 16), 0, 0, upper };
+                memcpy(samples[sample_count++], sample, sizeof(sample));
+            }
+            break;
+    }
+
+    uint32_t block_size = 24 + 16 * sample_count;
+    TextureImage_write_u32(fp, 4 + block_size);
+    TextureImage_write_u32(fp, 0); // vendor KHRONOS, descriptor type basic
+    TextureImage_write_u32(fp, 2 | block_size << 16);
+    TextureImage_write_u32(fp, model | 1 << 8 | (image->srgb ? 2 : 1) << 16); // BT709 primaries, sRGB or linear transfer
+    TextureImage_write_u32(fp, block_dimensions);
+    TextureImage_write_u32(fp, bytes_plane);
+    TextureImage_write_u32(fp, 0);
+    for (int i = 0; i < sample_count; i++) {
+        for (int j = 0; j < 4; j++) TextureImage_write_u32(fp, samples[i][j]);
+    }
+    return 4 + block_size;
+}
+
+int TextureImage_write_ktx2(const TextureImage *image, const char *file_path) {
+    FILE *fp = fopen(file_path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Could not open file: %s\n", file_path);
+        return 0;
+    }
+
+    // Levels start at multiples of both the texel block size and 4, so 12 for RGB8.
+    uint32_t alignment = TextureFormat_block_bytes(image->format);
+    while (alignment % 4) alignment += TextureFormat_block_bytes(image->format);
+    uint32_t dfd_offset = KTX2_HEADER_SIZE + image->level_count * KTX2_LEVEL_INDEX_SIZE;
+
+    // The descriptor is written first so its size is known before the header.
+    fseek(fp, dfd_offset, SEEK_SET);
+    uint32_t dfd_length = TextureImage_write_ktx2_dfd(fp, image);
+
+    // Levels are stored smallest first, as the specification recommends for streaming.
+    uint64_t level_offsets[TEXTURE_MAX_LEVELS];
+    uint64_t offset = dfd_offset + dfd_length;
+    for (int i = (int)image->level_count - 1; i >= 0; i--) {
+        offset = (offset + alignment - 1) / alignment * alignment;
+        fseek(fp, offset, SEEK_SET);
+        fwrite(image->data + image->levels[i].offset, 1, image->levels[i].size, fp);
+        level_offsets[i] = offset;
+        offset += image->levels[i].size;
+    }
+
+    fseek(fp, 0, SEEK_SET);
+    fwrite(KTX2_IDENTIFIER, 1, sizeof(KTX2_IDENTIFIER), fp);
+    TextureImage_write_u32(fp, TextureFormat_vk_format(image->format, image->srgb));
+    TextureImage_write_u32(fp, 1); // typeSize
+    TextureImage_write_u32(fp, image->width);
+    TextureImage_write_u32(fp, image->height);
+    TextureImage_write_u32(fp, 0); // depth
+    TextureImage_write_u32(fp, image->layer_count);
+    TextureImage_write_u32(fp, 1); // faces
+    TextureImage_write_u32(fp, image->level_count);
+    TextureImage_write_u32(fp, 0); // no supercompression
+    TextureImage_write_u32(fp, dfd_offset);
+    TextureImage_write_u32(fp, dfd_length);
+    TextureImage_write_u32(fp, 0); // no key/value data
+    TextureImage_write_u32(fp, 0);
+    TextureImage_write_u64(fp, 0); // no supercompression global data
+    TextureImage_write_u64(fp, 0);
+    for (unsigned int i = 0; i < image->level_count; i++) {
+        TextureImage_write_u64(fp, level_offsets[i]);
+        TextureImage_write_u64(fp, image->levels[i].size);
+        TextureImage_write_u64(fp, image->levels[i].size);
+    }
+
+    int success = !ferror(fp);
+    fclose(fp);
+    return success;
+}
+
+int TextureImage_has_extension(const char *file_path, const char *extension) {
+    size_t path_length = strlen(file_path);
+    size_t extension_length = strlen(extension);
+    return path_length >= extension_length && strcmp(file_path + path_length - extension_length, extension) == 0;
+}
+
+// Header bytes needed to parse either container: the DDS headers, or KTX2 up to its level index.
+#define TEXTURE_HEADER_READ_SIZE (KTX2_HEADER_SIZE + TEXTURE_MAX_LEVELS * KTX2_LEVEL_INDEX_SIZE)
+
+int TextureImage_parse_header(TextureImage *image, const char *file_path, const unsigned char *contents, size_t size, size_t file_offsets[TEXTURE_MAX_LEVELS]) {
+    if (TextureImage_has_extension(file_path, ".ktx2")) return TextureImage_parse_ktx2_header(image, file_path, contents, size, file_offsets);
+    if (TextureImage_has_extension(file_path, ".dds")) return TextureImage_parse_dds_header(image, file_path, contents, size, file_offsets);
+    fprintf(stderr, "Unknown texture container: %s\n", file_path);
+    return 0;
+}
+
+// Parses a whole .dds or .ktx2 file held in memory into a freshly allocated image.
+int TextureImage_parse(TextureImage *image, const char *file_path, const unsigned char *contents, size_t size) {
+    size_t file_offsets[TEXTURE_MAX_LEVELS];
+    if (!TextureImage_parse_header(image, file_path, contents, size, file_offsets)) return 0;
+
+    for (unsigned int i = 0; i < image->level_count; i++) {
+        if (file_offsets[i] > size || size - file_offsets[i] < image->levels[i].size) {
+            fprintf(stderr, "Truncated texture level %u in %s\n", i, file_path);
+            return 0;
+        }
+    }
+
+    TextureImage_allocate_array(image, image->format, image->srgb, image->width, image->height, image->level_count, image->layer_count);
+    for (unsigned int i = 0; i < image->level_count; i++) {
+        memcpy(image->data + image->levels[i].offset, contents + file_offsets[i], image->levels[i].size);
+    }
+    return 1;
+}
+
+// Loads a .dds or .ktx2 container, returns 0 on failure.
+int TextureImage_load(TextureImage *image, const char *file_path) {
+    size_t size;
+    unsigned char *contents = TextureImage_read_file(file_path, &size);
+    if (!contents) return 0;
+
+    int success = TextureImage_parse(image, file_path, contents, size);
+    free(contents);
+    return success;
+}
+
+// Reads only the container header, leaving image->data NULL and recording where each level is stored.
+int TextureImage_load_header(TextureImage *image, const char *file_path, size_t file_offsets[TEXTURE_MAX_LEVELS]) {
+    FILE *fp = fopen(file_path, "rb");
+    if (!fp) return 0;
+
+    unsigned char header[TEXTURE_HEADER_READ_SIZE];
+    size_t size = fread(header, 1, sizeof(header), fp);
+    fclose(fp);
+
+    return TextureImage_parse_header(image, file_path, header, size, file_offsets);
+}
+
+// Reads one level's texels from the container into destination, which must hold levels[level].size bytes.
+int TextureImage_read_level(const TextureImage *image, const char *file_path, const size_t file_offsets[TEXTURE_MAX_LEVELS], unsigned int level, unsigned char *destination) {
+    FILE *fp = fopen(file_path, "rb");
+    if (!fp) return 0;
+
+    int success = fseek(fp, (long)file_offsets[level], SEEK_SET) == 0 && fread(destination, 1, image->levels[level].size, fp) == image->levels[level].size;
+    fclose(fp);
+    return success;
+}
+
+int TextureImage_write(const TextureImage *image, const char *file_path) {
+    if (TextureImage_has_extension(file_path, ".ktx2")) return TextureImage_write_ktx2(image, file_path);
+    if (TextureImage_has_extension(file_path, ".dds")) return TextureImage_write_dds(image, file_path);
+    fprintf(stderr, "Unknown texture container: %s\n", file_path);
+    return 0;
+}
+
+// Specifies one level of the bound GL_TEXTURE_2D_ARRAY, pixels being that level's bytes (or NULL to release it).
+// The shaders sample sampler2DArray, so a plain 2D image goes up as an array of one layer.
+void Texture_upload_level(const TextureImage *image, unsigned int level, const unsigned char *pixels) {
+    const TextureLevel *info = &image->levels[level];
+    GLsizei width = pixels ? (GLsizei)info->width : 0;
+    GLsizei height = pixels ? (GLsizei)info->height : 0;
+    GLsizei layers = pixels ? (GLsizei)(image->layer_count > 0 ? image->layer_count : 1) : 0;
+    GLsizei size = pixels ? (GLsizei)info->size : 0;
+    GLenum internal_format = TextureFormat_gl_internal_format(image->format, image->srgb);
+    GLenum format = image->format == TEXTURE_FORMAT_RGBA8 ? GL_RGBA : GL_RGB;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (TextureFormat_is_compressed(image->format)) {
+        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internal_format, width, height, layers, 0, size, pixels);
+    } else {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internal_format, width, height, layers, 0, format, GL_UNSIGNED_BYTE, pixels);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+// Uploads every level of the image into a new GL_TEXTURE_2D_ARRAY, which is left bound.
+GLuint Texture_create(const TextureImage *image) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+
+    for (unsigned int i = 0; i < image->level_count; i++) {
+        Texture_upload_level(image, i, image->data + image->levels[i].offset);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, image->level_count - 1);
+
+    return texture;
+}
+
+#endif
@@ -0,0 +1,385 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "glad/glad.h"
+#include "intern.h"
+#include "jobs.h"
+#include "mipmap.h"
+#include "stb_image.h"
+#include "texture.h"
+#include "texture_disk_cache.h"
+#include "texture_streaming.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Shares textures between everything that asks for the same file. Handles are refcounted and keyed by the
+// interned path plus sampler parameters: every distinct sampler gets its own GL sampler object while all
+// handles for one path share a single texture, so repeated materials cost one decode and one upload.
+// .dds/.ktx2 files go through the TextureStreamer; other images are decoded on job workers, and a request
+// for a file that is still decoding joins the pending load instead of starting another. With a
+// TextureDiskCache attached, decoded chains are kept on disk and later loads map them instead of decoding.
+// Images that only exist in memory, like those inside a .glb, are named by the caller and always decoded.
+
+typedef enum {
+    TEXTURE_SOURCE_LOADING, // decoding on a worker
+    TEXTURE_SOURCE_DECODED, // waiting for the GL thread to upload it, or to notice decoded.data is NULL
+    TEXTURE_SOURCE_READY,
+    TEXTURE_SOURCE_FAILED,
+} TextureSourceState;
+
+typedef struct {
+    GLenum min_filter;
+    GLenum mag_filter;
+    GLenum wrap_s;
+    GLenum wrap_t;
+} TextureSampler;
+
+// One file and the texture made from it.
+typedef struct {
+    const char *path; // interned
+    int refcount;     // live cache entries using this source
+    SDL_atomic_t state;
+    int stream_handle; // -1 unless the TextureStreamer owns the texture
+    GLuint texture;
+
+    MipSettings mip_settings;
+    JobSystem *jobs;
+    TextureDiskCache *disk;
+    unsigned char *encoded; // image file bytes decoded instead of reading path, freed by the worker
+    size_t encoded_size;
+    TextureImage decoded; // filled by the worker, data stays NULL if the image could not be read
+    TextureDiskBlob blob; // backs decoded.data when it was mapped from the disk cache
+} TextureSource;
+
+typedef struct {
+    TextureSource *source;
+    TextureSampler params;
+    GLuint sampler;
+    int refcount; // 0 marks a free slot
+} TextureCacheEntry;
+
+typedef struct {
+    unsigned long long hits;      // handle requests served by a texture already in the cache
+    unsigned long long coalesced; // of those, requests that joined a load still in progress
+    unsigned long long misses;
+    unsigned long long decodes;
+    unsigned long long failed_loads;
+    unsigned int textures;
+    unsigned int handles;
+    unsigned int pending_loads;
+} TextureCacheStats;
+
+typedef struct {
+    StringTable paths;
+    TextureSource **sources;
+    int source_count;
+    int source_capacity;
+    TextureCacheEntry *entries;
+    int entry_count;
+    int entry_capacity;
+
+    TextureStreamer *streamer; // may be NULL to load .dds/.ktx2 files whole
+    TextureDiskCache *disk;    // may be NULL to decode every time
+    JobSystem *jobs;
+    SDL_atomic_t pending;
+
+    MipSettings mip_settings;  // for images decoded by the cache
+    unsigned int detail_drop;  // top mip levels dropped from decoded images
+    GLuint placeholder;        // 1x1 single-layer array bound until a texture is ready
+
+    TextureCacheStats stats;
+} TextureCache;
+
+void TextureCache_init(TextureCache *cache, TextureStreamer *streamer, JobSystem *jobs) {
+    memset(cache, 0, sizeof(*cache));
+    StringTable_init(&cache->paths);
+    cache->streamer = streamer;
+    cache->jobs = jobs;
+    cache->mip_settings.filter = MIP_FILTER_KAISER;
+    cache->mip_settings.gamma_correct = 1;
+    SDL_AtomicSet(&cache->pending, 0);
+
+    static const unsigned char grey[4] = { 128, 128, 128, 255 };
+    glGenTextures(1, &cache->placeholder);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, cache->placeholder);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 1, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+}
+
+// Drops the decoded chain, whether it was allocated or mapped.
+void TextureSource_free_decoded(TextureSource *source) {
+    if (source->blob.mapping) {
+        TextureDiskBlob_close(&source->blob);
+        source->decoded.data = NULL;
+    }
+    TextureImage_free(&source->decoded);
+}
+
+void TextureCache_decode(void *data) {
+    TextureSource *source = data;
+    TextureDiskKey key;
+    if (source->disk && !source->encoded && TextureDiskCache_open(source->disk, &key, source->path, &source->mip_settings, &source->blob)) {
+        source->decoded = source->blob.image;
+        SDL_AtomicSet(&source->state, TEXTURE_SOURCE_DECODED);
+        return;
+    }
+
+    int width, height, channels;
+    unsigned char *rgba = source->encoded ? stbi_load_from_memory(source->encoded, (int)source->encoded_size, &width, &height, &channels, 4)
+        : stbi_load(source->path, &width, &height, &channels, 4);
+    int from_memory = source->encoded != NULL;
+    free(source->encoded);
+    source->encoded = NULL;
+    if (rgba) {
+        Mipmap_build_chain(&source->decoded, rgba, width, height, 0, &source->mip_settings, source->jobs);
+        stbi_image_free(rgba);
+        source->decoded.layer_count = 1; // binds wherever packed textures do
+        if (source->disk && !from_memory) TextureDiskCache_store(source->disk, &key, &source->decoded);
+    } else {
+        fprintf(stderr, "Could not load image %s: %s\n", source->path, stbi_failure_reason());
+    }
+    SDL_AtomicSet(&source->state, TEXTURE_SOURCE_DECODED);
+}
+
+// Uploads a source the worker has finished with, on the GL thread.
+void TextureCache_finish(TextureCache *cache, TextureSource *source) {
+    if (!source->decoded.data) {
+        SDL_AtomicSet(&source->state, TEXTURE_SOURCE_FAILED);
+        cache->stats.failed_loads++;
+        return;
+    }
+    TextureImage_drop_top_levels(&source->decoded, cache->detail_drop);
+    source->texture = Texture_create(&source->decoded);
+    TextureSource_free_decoded(source);
+    SDL_AtomicSet(&source->state, TEXTURE_SOURCE_READY);
+    cache->stats.decodes++;
+}
+
+// Starts loading a new source, returning 0 if a .dds/.ktx2 file cannot be read.
+int TextureCache_load(TextureCache *cache, TextureSource *source) {
+    if (!source->encoded && (TextureImage_has_extension(source->path, ".dds") || TextureImage_has_extension(source->path, ".ktx2"))) {
+        if (cache->streamer) {
+            source->stream_handle = TextureStreamer_add(cache->streamer, source->path);
+            if (source->stream_handle < 0) return 0;
+            source->texture = TextureStreamer_texture(cache->streamer, source->stream_handle);
+        } else {
+            TextureImage image;
+            if (!TextureImage_load(&image, source->path)) return 0;
+            source->texture = Texture_create(&image);
+            TextureImage_free(&image);
+        }
+        SDL_AtomicSet(&source->state, TEXTURE_SOURCE_READY);
+        return 1;
+    }
+
+    SDL_AtomicSet(&source->state, TEXTURE_SOURCE_LOADING);
+    if (cache->jobs && cache->jobs->thread_count > 0) {
+        JobSystem_submit(cache->jobs, TextureCache_decode, source, &cache->pending);
+    } else {
+        TextureCache_decode(source);
+        TextureCache_finish(cache, source);
+    }
+    return 1;
+}
+
+void TextureCache_free_source(TextureCache *cache, int index) {
+    TextureSource *source = cache->sources[index];
+    if (source->stream_handle >= 0) TextureStreamer_remove(cache->streamer, source->stream_handle);
+    else if (source->texture) glDeleteTextures(1, &source->texture);
+    TextureSource_free_decoded(source);
+    free(source);
+    cache->sources[index] = cache->sources[--cache->source_count];
+}
+
+// The source for file_path, loading it unless it is cached. With encoded set, those bytes are decoded instead of the file.
+TextureSource *TextureCache_source(TextureCache *cache, const char *file_path, const unsigned char *encoded, size_t encoded_size) {
+    const char *path = StringTable_find(&cache->paths, file_path);
+    if (path) {
+        for (int i = 0; i < cache->source_count; i++) {
+            TextureSource *source = cache->sources[i];
+            if (source->path != path) continue;
+            cache->stats.hits++;
+            int state = SDL_AtomicGet(&source->state);
+            if (state == TEXTURE_SOURCE_LOADING || state == TEXTURE_SOURCE_DECODED) cache->stats.coalesced++;
+            return source;
+        }
+    }
+
+    TextureSource *source = calloc(1, sizeof(TextureSource));
+    if (!source) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    source->path = StringTable_intern(&cache->paths, file_path);
+    source->stream_handle = -1;
+    source->mip_settings = cache->mip_settings;
+    source->jobs = cache->jobs;
+    source->disk = cache->disk;
+    if (encoded) {
+        source->encoded = malloc(encoded_size > 0 ? encoded_size : 1);
+        if (!source->encoded) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        memcpy(source->encoded, encoded, encoded_size);
+        source->encoded_size = encoded_size;
+    }
+    if (!TextureCache_load(cache, source)) {
+        free(source);
+        return NULL;
+    }
+    cache->stats.misses++;
+
+    if (cache->source_count == cache->source_capacity) {
+        cache->source_capacity = cache->source_capacity ? cache->source_capacity * 2 : 16;
+        cache->sources = realloc(cache->sources, cache->source_capacity * sizeof(TextureSource *));
+        if (!cache->sources) {
+            fprintf(stderr, "Memory reallocation failed\n");
+            exit(1);
+        }
+    }
+    cache->sources[cache->source_count++] = source;
+    return source;
+}
+
+int TextureCache_acquire_source(TextureCache *cache, const char *file_path, const unsigned char *encoded, size_t encoded_size,
+    const TextureSampler *params) {
+    const char *path = StringTable_find(&cache->paths, file_path);
+    int free_slot = -1;
+    for (int i = 0; i < cache->entry_count; i++) {
+        TextureCacheEntry *entry = &cache->entries[i];
+        if (entry->refcount == 0) {
+            if (free_slot < 0) free_slot = i;
+            continue;
+        }
+        if (path && entry->source->path == path && memcmp(&entry->params, params, sizeof(TextureSampler)) == 0) {
+            entry->refcount++;
+            cache->stats.hits++;
+            return i;
+        }
+    }
+
+    TextureSource *source = TextureCache_source(cache, file_path, encoded, encoded_size);
+    if (!source) return -1;
+    source->refcount++;
+
+    if (free_slot < 0) {
+        if (cache->entry_count == cache->entry_capacity) {
+            cache->entry_capacity = cache->entry_capacity ? cache->entry_capacity * 2 : 16;
+            cache->entries = realloc(cache->entries, cache->entry_capacity * sizeof(TextureCacheEntry));
+            if (!cache->entries) {
+                fprintf(stderr, "Memory reallocation failed\n");
+                exit(1);
+            }
+        }
+        free_slot = cache->entry_count++;
+    }
+
+    TextureCacheEntry *entry = &cache->entries[free_slot];
+    entry->source = source;
+    entry->params = *params;
+    entry->refcount = 1;
+    glGenSamplers(1, &entry->sampler);
+    glSamplerParameteri(entry->sampler, GL_TEXTURE_MIN_FILTER, params->min_filter);
+    glSamplerParameteri(entry->sampler, GL_TEXTURE_MAG_FILTER, params->mag_filter);
+    glSamplerParameteri(entry->sampler, GL_TEXTURE_WRAP_S, params->wrap_s);
+    glSamplerParameteri(entry->sampler, GL_TEXTURE_WRAP_T, params->wrap_t);
+    return free_slot;
+}
+
+// A handle to file_path sampled with params, or -1 if the file cannot be read. Release it when done.
+int TextureCache_acquire(TextureCache *cache, const char *file_path, const TextureSampler *params) {
+    return TextureCache_acquire_source(cache, file_path, NULL, 0, params);
+}
+
+// Like TextureCache_acquire for an image file already in memory, which is copied. name identifies it
+// in the cache, so asking again with the same name shares the texture without decoding it again.
+int TextureCache_acquire_memory(TextureCache *cache, const char *name, const unsigned char *data, size_t size, const TextureSampler *params) {
+    return TextureCache_acquire_source(cache, name, data, size, params);
+}
+
+void TextureCache_retain(TextureCache *cache, int handle) {
+    cache->entries[handle].refcount++;
+}
+
+// Drops a reference; the sampler goes with the last handle and the texture with the last handle to its file.
+void TextureCache_release(TextureCache *cache, int handle) {
+    TextureCacheEntry *entry = &cache->entries[handle];
+    if (--entry->refcount > 0) return;
+
+    glDeleteSamplers(1, &entry->sampler);
+    TextureSource *source = entry->source;
+    entry->source = NULL;
+
+    // A source still decoding is freed by TextureCache_update once its worker is done with it.
+    if (--source->refcount > 0 || SDL_AtomicGet(&source->state) == TEXTURE_SOURCE_LOADING) return;
+    for (int i = 0; i < cache->source_count; i++) {
+        if (cache->sources[i] == source) {
+            TextureCache_free_source(cache, i);
+            break;
+        }
+    }
+}
+
+int TextureCache_ready(const TextureCache *cache, int handle) {
+    return SDL_AtomicGet(&cache->entries[handle].source->state) == TEXTURE_SOURCE_READY;
+}
+
+GLuint TextureCache_texture(const TextureCache *cache, int handle) {
+    const TextureSource *source = cache->entries[handle].source;
+    return TextureCache_ready(cache, handle) ? source->texture : cache->placeholder;
+}
+
+void TextureCache_bind(const TextureCache *cache, int handle, GLuint unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, TextureCache_texture(cache, handle));
+    glBindSampler(unit, cache->entries[handle].sampler);
+}
+
+// Streaming feedback for handles backed by the TextureStreamer, see TextureStreamer_request.
+void TextureCache_request(TextureCache *cache, int handle, float screen_size) {
+    const TextureSource *source = cache->entries[handle].source;
+    if (source->stream_handle >= 0) TextureStreamer_request(cache->streamer, source->stream_handle, screen_size);
+}
+
+// Call once per frame on the GL thread to upload finished decodes and free abandoned ones.
+void TextureCache_update(TextureCache *cache) {
+    for (int i = 0; i < cache->source_count; i++) {
+        TextureSource *source = cache->sources[i];
+        int state = SDL_AtomicGet(&source->state);
+        if (state == TEXTURE_SOURCE_LOADING) continue;
+        if (state == TEXTURE_SOURCE_DECODED) TextureCache_finish(cache, source);
+        if (source->refcount == 0) TextureCache_free_source(cache, i--);
+    }
+}
+
+void TextureCache_stats(const TextureCache *cache, TextureCacheStats *stats) {
+    *stats = cache->stats;
+    stats->textures = cache->source_count;
+    stats->handles = 0;
+    for (int i = 0; i < cache->entry_count; i++) stats->handles += cache->entries[i].refcount;
+    stats->pending_loads = SDL_AtomicGet((SDL_atomic_t *)&cache->pending);
+}
+
+void TextureCache_print_stats(const TextureCache *cache) {
+    TextureCacheStats stats;
+    TextureCache_stats(cache, &stats);
+    printf("TEXTURE CACHE:\t%u textures, %u handles, %llu hits (%llu coalesced), %llu misses, %u loading, %llu failed\n",
+        stats.textures, stats.handles, stats.hits, stats.coalesced, stats.misses, stats.pending_loads, stats.failed_loads);
+}
+
+void TextureCache_destroy(TextureCache *cache) {
+    if (cache->jobs) JobSystem_wait(cache->jobs, &cache->pending);
+    for (int i = 0; i < cache->entry_count; i++) {
+        if (cache->entries[i].refcount > 0) glDeleteSamplers(1, &cache->entries[i].sampler);
+    }
+    while (cache->source_count > 0) TextureCache_free_source(cache, cache->source_count - 1);
+    glDeleteTextures(1, &cache->placeholder);
+    free(cache->sources);
+    free(cache->entries);
+    StringTable_destroy(&cache->paths);
+    memset(cache, 0, sizeof(*cache));
+}
+
+#endif
@@ -0,0 +1,249 @@
+#ifndef TEXTURE_DISK_CACHE_H
+#define TEXTURE_DISK_CACHE_H
+
+#include "mipmap.h"
+#include "texture.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_thread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Keeps decoded, mip-chained texels on disk so later launches skip image decoding entirely.
+// Blobs are named after a hash of the source path and mip settings and remember the source's
+// size, modification time and content hash: a matching mtime is trusted as is, a changed mtime
+// falls back to rehashing the source and, if the contents still match, is recorded in the blob,
+// and anything else rebuilds the blob. Hits are mmapped and uploaded straight from the mapping.
+
+#define TEXTURE_DISK_CACHE_MAGIC 0x43544c47u // "GLTC"
+#define TEXTURE_DISK_CACHE_VERSION 1
+#define TEXTURE_DISK_CACHE_PATH_LENGTH 512
+#define TEXTURE_DISK_CACHE_BLOB_PATH_LENGTH (TEXTURE_DISK_CACHE_PATH_LENGTH + 32) // the directory, then /<16 hex digits>.<extension>
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_size;
+    uint64_t source_mtime; // nanoseconds
+    uint64_t content_hash;
+    uint64_t settings_hash;
+    uint32_t format;
+    uint32_t srgb;
+    uint32_t width;
+    uint32_t height;
+    uint32_t layer_count;
+    uint32_t level_count;
+    uint64_t data_offset;
+    uint64_t data_size;
+} TextureDiskCacheHeader;
+
+// Everything known about a source after looking it up, reused to store the blob on a miss.
+typedef struct {
+    char blob_path[TEXTURE_DISK_CACHE_BLOB_PATH_LENGTH];
+    const char *source_path;
+    uint64_t source_size;
+    uint64_t source_mtime;
+    uint64_t content_hash;
+    uint64_t settings_hash;
+    int have_content_hash;
+} TextureDiskKey;
+
+// A mapped blob; image.data points into the mapping and must not be freed.
+typedef struct {
+    void *mapping;
+    size_t mapping_size;
+    TextureImage image;
+} TextureDiskBlob;
+
+typedef struct {
+    char directory[TEXTURE_DISK_CACHE_PATH_LENGTH];
+    SDL_atomic_t hits;
+    SDL_atomic_t misses;
+    SDL_atomic_t stale; // misses caused by a changed source
+    SDL_atomic_t writes;
+    SDL_atomic_t kib_mapped;
+} TextureDiskCache;
+
+uint64_t TextureDiskCache_hash(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+
+#define TEXTURE_DISK_CACHE_HASH_SEED 14695981039346656037ull
+
+// Creates the directory if needed; returns 0 if it cannot be used, in which case nothing is cached.
+int TextureDiskCache_init(TextureDiskCache *disk, const char *directory) {
+    memset(disk, 0, sizeof(*disk));
+    snprintf(disk->directory, sizeof(disk->directory), "%s", directory);
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create texture cache directory %s: %s\n", directory, strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+int TextureDiskCache_hash_file(const char *file_path, uint64_t *hash) {
+    FILE *fp = fopen(file_path, "rb");
+    if (!fp) return 0;
+    unsigned char buffer[65536];
+    size_t size;
+    *hash = TEXTURE_DISK_CACHE_HASH_SEED;
+    while ((size = fread(buffer, 1, sizeof(buffer), fp)) > 0) *hash = TextureDiskCache_hash(*hash, buffer, size);
+    int success = !ferror(fp);
+    fclose(fp);
+    return success;
+}
+
+int TextureDiskCache_key(const TextureDiskCache *disk, TextureDiskKey *key, const char *source_path, const MipSettings *settings) {
+    struct stat info;
+    if (stat(source_path, &info) != 0) return 0;
+
+    memset(key, 0, sizeof(*key));
+    key->source_path = source_path;
+    key->source_size = (uint64_t)info.st_size;
+    key->source_mtime = (uint64_t)info.st_mtim.tv_sec * 1000000000ull + (uint64_t)info.st_mtim.tv_nsec;
+
+    uint32_t settings_words[4] = { TEXTURE_DISK_CACHE_VERSION, settings->filter, settings->gamma_correct, settings->normal_map };
+    key->settings_hash = TextureDiskCache_hash(TEXTURE_DISK_CACHE_HASH_SEED, settings_words, sizeof(settings_words));
+
+    uint64_t name = TextureDiskCache_hash(key->settings_hash, source_path, strlen(source_path));
+    snprintf(key->blob_path, sizeof(key->blob_path), "%s/%016llx.texels", disk->directory, (unsigned long long)name);
+    return 1;
+}
+
+int TextureDiskCache_content_hash(TextureDiskKey *key) {
+    if (!key->have_content_hash) key->have_content_hash = TextureDiskCache_hash_file(key->source_path, &key->content_hash);
+    return key->have_content_hash;
+}
+
+// Overwrites size bytes of a blob at offset, like a recorded mtime that went stale. Returns 0 on failure,
+// which only means the source gets rehashed again next time.
+int TextureDiskCache_rewrite(const char *blob_path, const void *data, size_t size, off_t offset) {
+    int fd = open(blob_path, O_WRONLY);
+    if (fd < 0) return 0;
+    int success = pwrite(fd, data, size, offset) == (ssize_t)size;
+    close(fd);
+    return success;
+}
+
+void TextureDiskBlob_close(TextureDiskBlob *blob) {
+    if (blob->mapping) munmap(blob->mapping, blob->mapping_size);
+    blob->mapping = NULL;
+    blob->mapping_size = 0;
+    blob->image.data = NULL;
+}
+
+// Maps the blob for source_path if it is still valid. key is filled in either way, for TextureDiskCache_store.
+int TextureDiskCache_open(TextureDiskCache *disk, TextureDiskKey *key, const char *source_path, const MipSettings *settings, TextureDiskBlob *blob) {
+    memset(blob, 0, sizeof(*blob));
+    memset(key, 0, sizeof(*key));
+    if (!TextureDiskCache_key(disk, key, source_path, settings)) return 0;
+
+    int fd = open(key->blob_path, O_RDONLY);
+    if (fd < 0) {
+        SDL_AtomicAdd(&disk->misses, 1);
+        return 0;
+    }
+    struct stat info;
+    void *mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(TextureDiskCacheHeader)) {
+        mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        SDL_AtomicAdd(&disk->misses, 1);
+        return 0;
+    }
+    blob->mapping = mapping;
+    blob->mapping_size = info.st_size;
+
+    const TextureDiskCacheHeader *header = mapping;
+    int valid = header->magic == TEXTURE_DISK_CACHE_MAGIC && header->version == TEXTURE_DISK_CACHE_VERSION
+        && header->settings_hash == key->settings_hash && header->source_size == key->source_size
+        && header->level_count >= 1 && header->level_count <= TEXTURE_MAX_LEVELS
+        && header->data_offset + header->data_size <= blob->mapping_size;
+    int touched = valid && header->source_mtime != key->source_mtime;
+    if (touched) {
+        // Touched but maybe not changed, e.g. by a checkout; the contents decide.
+        valid = TextureDiskCache_content_hash(key) && key->content_hash == header->content_hash;
+    }
+    if (valid) {
+        TextureImage_layout_array(&blob->image, (TextureFormat)header->format, header->srgb, header->width, header->height, header->level_count, header->layer_count);
+        valid = blob->image.data_size == header->data_size;
+    }
+    if (!valid) {
+        TextureDiskBlob_close(blob);
+        SDL_AtomicAdd(&disk->stale, 1);
+        SDL_AtomicAdd(&disk->misses, 1);
+        return 0;
+    }
+
+    // Unchanged, so later launches can trust the new mtime instead of hashing again.
+    if (touched) TextureDiskCache_rewrite(key->blob_path, &key->source_mtime, sizeof(key->source_mtime), offsetof(TextureDiskCacheHeader, source_mtime));
+    blob->image.data = (unsigned char *)mapping + header->data_offset;
+    SDL_AtomicAdd(&disk->hits, 1);
+    SDL_AtomicAdd(&disk->kib_mapped, (int)(blob->image.data_size / 1024));
+    return 1;
+}
+
+// Writes image as the blob for key's source, through a temporary file so readers never see half a blob.
+int TextureDiskCache_store(TextureDiskCache *disk, TextureDiskKey *key, const TextureImage *image) {
+    if (!key->source_path || !TextureDiskCache_content_hash(key)) return 0;
+
+    TextureDiskCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = TEXTURE_DISK_CACHE_MAGIC;
+    header.version = TEXTURE_DISK_CACHE_VERSION;
+    header.source_size = key->source_size;
+    header.source_mtime = key->source_mtime;
+    header.content_hash = key->content_hash;
+    header.settings_hash = key->settings_hash;
+    header.format = image->format;
+    header.srgb = image->srgb;
+    header.width = image->width;
+    header.height = image->height;
+    header.layer_count = image->layer_count;
+    header.level_count = image->level_count;
+    header.data_offset = (sizeof(header) + 63) & ~(uint64_t)63;
+    header.data_size = image->data_size;
+
+    char temporary_path[TEXTURE_DISK_CACHE_BLOB_PATH_LENGTH + 32];
+    snprintf(temporary_path, sizeof(temporary_path), "%s.%lu.tmp", key->blob_path, SDL_ThreadID());
+    FILE *fp = fopen(temporary_path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Could not open file %s\n", temporary_path);
+        return 0;
+    }
+
+    static const unsigned char padding[64] = { 0 };
+    fwrite(&header, sizeof(header), 1, fp);
+    fwrite(padding, 1, header.data_offset - sizeof(header), fp);
+    fwrite(image->data, 1, image->data_size, fp);
+    int success = !ferror(fp);
+    success = fclose(fp) == 0 && success;
+
+    if (success && rename(temporary_path, key->blob_path) == 0) {
+        SDL_AtomicAdd(&disk->writes, 1);
+        return 1;
+    }
+    fprintf(stderr, "Could not write file %s\n", key->blob_path);
+    remove(temporary_path);
+    return 0;
+}
+
+void TextureDiskCache_print_stats(TextureDiskCache *disk) {
+    printf("TEXTURE DISK CACHE:\t%d hits, %d misses (%d stale), %d writes, %d KiB mapped\n",
+        SDL_AtomicGet(&disk->hits), SDL_AtomicGet(&disk->misses), SDL_AtomicGet(&disk->stale),
+        SDL_AtomicGet(&disk->writes), SDL_AtomicGet(&disk->kib_mapped));
+}
+
+#endif
@@ -0,0 +1,256 @@
+#ifndef TEXTURE_PACK_H
+#define TEXTURE_PACK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Many textures behind one GL_TEXTURE_2D_ARRAY binding, so differently textured objects can share a draw.
+// Textures as large as a layer get a layer of their own, smaller ones are shelf packed into atlas layers
+// with their edges repeated into a padding gutter so bilinear taps and the first few mips don't bleed.
+// Every packed texture is addressed by a layer index and a UV rect inside that layer.
+
+#define TEXTURE_PACK_NAME_LENGTH 64
+#define TEXTURE_PACK_PATH_LENGTH 256
+
+typedef struct {
+    char name[TEXTURE_PACK_NAME_LENGTH];
+    unsigned int layer;
+    float rect[4]; // u, v offset then u, v scale, mapping 0..1 texture coordinates into the layer
+} TexturePackEntry;
+
+// The pack table written next to the array texture by tools/texpack.
+typedef struct {
+    char texture_path[TEXTURE_PACK_PATH_LENGTH];
+    unsigned int layer_count;
+    TexturePackEntry *entries;
+    int entry_count;
+} TexturePack;
+
+// Placement of one texture while packing; x and y are the top left texel of the unpadded image.
+typedef struct {
+    unsigned int width;
+    unsigned int height;
+    unsigned int layer;
+    unsigned int x;
+    unsigned int y;
+} TexturePackRect;
+
+typedef struct {
+    unsigned int y;
+    unsigned int height;
+    unsigned int used_width;
+} TexturePackShelf;
+
+typedef struct {
+    unsigned int layer;
+    TexturePackShelf *shelves;
+    int shelf_count;
+    int shelf_capacity;
+} TexturePackAtlas;
+
+typedef struct {
+    unsigned int layer_size;
+    unsigned int padding;
+    unsigned int layer_count;
+    TexturePackAtlas *atlases;
+    int atlas_count;
+} TexturePacker;
+
+void TexturePacker_init(TexturePacker *packer, unsigned int layer_size, unsigned int padding) {
+    packer->layer_size = layer_size;
+    packer->padding = padding;
+    packer->layer_count = 0;
+    packer->atlases = NULL;
+    packer->atlas_count = 0;
+}
+
+void TexturePacker_destroy(TexturePacker *packer) {
+    for (int i = 0; i < packer->atlas_count; i++) free(packer->atlases[i].shelves);
+    free(packer->atlases);
+    packer->atlases = NULL;
+    packer->atlas_count = 0;
+}
+
+// Padded footprint of a texture, rounded up to whole 4x4 blocks so packed textures never share a block.
+unsigned int TexturePacker_footprint(const TexturePacker *packer, unsigned int size) {
+    return (size + packer->padding * 2 + 3) & ~3u;
+}
+
+int TexturePacker_place_in_atlas(TexturePacker *packer, TexturePackAtlas *atlas, TexturePackRect *rect) {
+    unsigned int width = TexturePacker_footprint(packer, rect->width);
+    unsigned int height = TexturePacker_footprint(packer, rect->height);
+
+    // Best fitting existing shelf, so short textures don't waste the height of tall shelves.
+    int best = -1;
+    for (int i = 0; i < atlas->shelf_count; i++) {
+        TexturePackShelf *shelf = &atlas->shelves[i];
+        if (shelf->height < height || shelf->used_width + width > packer->layer_size) continue;
+        if (best < 0 || shelf->height < atlas->shelves[best].height) best = i;
+    }
+
+    if (best < 0) {
+        unsigned int top = 0;
+        if (atlas->shelf_count > 0) {
+            const TexturePackShelf *last = &atlas->shelves[atlas->shelf_count - 1];
+            top = last->y + last->height;
+        }
+        if (top + height > packer->layer_size || width > packer->layer_size) return 0;
+
+        if (atlas->shelf_count == atlas->shelf_capacity) {
+            atlas->shelf_capacity = atlas->shelf_capacity ? atlas->shelf_capacity * 2 : 8;
+            atlas->shelves = realloc(atlas->shelves, atlas->shelf_capacity * sizeof(TexturePackShelf));
+            if (!atlas->shelves) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+        }
+        best = atlas->shelf_count++;
+        atlas->shelves[best].y = top;
+        atlas->shelves[best].height = height;
+        atlas->shelves[best].used_width = 0;
+    }
+
+    TexturePackShelf *shelf = &atlas->shelves[best];
+    rect->layer = atlas->layer;
+    rect->x = shelf->used_width + packer->padding;
+    rect->y = shelf->y + packer->padding;
+    shelf->used_width += width;
+    return 1;
+}
+
+// Assigns a layer and position to rect, opening a new layer when nothing fits. Feeding rects largest first packs best.
+int TexturePacker_place(TexturePacker *packer, TexturePackRect *rect) {
+    if (rect->width > packer->layer_size || rect->height > packer->layer_size) return 0;
+
+    if (rect->width == packer->layer_size && rect->height == packer->layer_size) {
+        rect->layer = packer->layer_count++;
+        rect->x = 0;
+        rect->y = 0;
+        return 1;
+    }
+
+    for (int i = 0; i < packer->atlas_count; i++) {
+        if (TexturePacker_place_in_atlas(packer, &packer->atlases[i], rect)) return 1;
+    }
+
+    packer->atlases = realloc(packer->atlases, (packer->atlas_count + 1) * sizeof(TexturePackAtlas));
+    if (!packer->atlases) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    TexturePackAtlas *atlas = &packer->atlases[packer->atlas_count++];
+    atlas->layer = packer->layer_count++;
+    atlas->shelves = NULL;
+    atlas->shelf_count = 0;
+    atlas->shelf_capacity = 0;
+    return TexturePacker_place_in_atlas(packer, atlas, rect);
+}
+
+// Copies an RGBA8 image into its place in an RGBA8 layer and repeats its edge texels across the padding.
+void TexturePacker_blit(const TexturePacker *packer, unsigned char *layer, const unsigned char *rgba, const TexturePackRect *rect) {
+    int size = (int)packer->layer_size;
+    int padding = (int)packer->padding;
+    for (int y = -padding; y < (int)rect->height + padding; y++) {
+        int ty = (int)rect->y + y;
+        if (ty < 0 || ty >= size) continue;
+        int sy = y < 0 ? 0 : y >= (int)rect->height ? (int)rect->height - 1 : y;
+        for (int x = -padding; x < (int)rect->width + padding; x++) {
+            int tx = (int)rect->x + x;
+            if (tx < 0 || tx >= size) continue;
+            int sx = x < 0 ? 0 : x >= (int)rect->width ? (int)rect->width - 1 : x;
+            memcpy(layer + ((size_t)ty * size + tx) * 4, rgba + ((size_t)sy * rect->width + sx) * 4, 4);
+        }
+    }
+}
+
+void TexturePacker_entry(const TexturePacker *packer, TexturePackEntry *entry, const char *name, const TexturePackRect *rect) {
+    float size = (float)packer->layer_size;
+    snprintf(entry->name, sizeof(entry->name), "%s", name);
+    entry->layer = rect->layer;
+    entry->rect[0] = rect->x / size;
+    entry->rect[1] = rect->y / size;
+    entry->rect[2] = rect->width / size;
+    entry->rect[3] = rect->height / size;
+}
+
+// A texture filling the whole of layer 0, for textures that were never packed.
+TexturePackEntry TexturePack_whole_layer(const char *name) {
+    TexturePackEntry entry;
+    snprintf(entry.name, sizeof(entry.name), "%s", name);
+    entry.layer = 0;
+    entry.rect[0] = 0.0f;
+    entry.rect[1] = 0.0f;
+    entry.rect[2] = 1.0f;
+    entry.rect[3] = 1.0f;
+    return entry;
+}
+
+int TexturePack_write(const TexturePack *pack, const char *file_path) {
+    FILE *fp = fopen(file_path, "w");
+    if (!fp) {
+        fprintf(stderr, "Could not open file %s\n", file_path);
+        return 0;
+    }
+
+    fprintf(fp, "texture %s %u\n", pack->texture_path, pack->layer_count);
+    for (int i = 0; i < pack->entry_count; i++) {
+        const TexturePackEntry *entry = &pack->entries[i];
+        fprintf(fp, "%s %u %.9g %.9g %.9g %.9g\n", entry->name, entry->layer, entry->rect[0], entry->rect[1], entry->rect[2], entry->rect[3]);
+    }
+
+    int success = !ferror(fp);
+    fclose(fp);
+    if (!success) fprintf(stderr, "Could not write file %s\n", file_path);
+    return success;
+}
+
+int TexturePack_load(TexturePack *pack, const char *file_path) {
+    pack->entries = NULL;
+    pack->entry_count = 0;
+
+    FILE *fp = fopen(file_path, "r");
+    if (!fp) return 0;
+
+    if (fscanf(fp, "texture %255s %u", pack->texture_path, &pack->layer_count) != 2) {
+        fprintf(stderr, "Bad texture pack header in %s\n", file_path);
+        fclose(fp);
+        return 0;
+    }
+
+    int capacity = 0;
+    TexturePackEntry entry;
+    while (fscanf(fp, "%63s %u %f %f %f %f", entry.name, &entry.layer, &entry.rect[0], &entry.rect[1], &entry.rect[2], &entry.rect[3]) == 6) {
+        if (entry.layer >= pack->layer_count) {
+            fprintf(stderr, "Texture %s uses missing layer %u in %s\n", entry.name, entry.layer, file_path);
+            continue;
+        }
+        if (pack->entry_count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            pack->entries = realloc(pack->entries, capacity * sizeof(TexturePackEntry));
+            if (!pack->entries) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+        }
+        pack->entries[pack->entry_count++] = entry;
+    }
+
+    fclose(fp);
+    return 1;
+}
+
+const TexturePackEntry *TexturePack_find(const TexturePack *pack, const char *name) {
+    for (int i = 0; i < pack->entry_count; i++) {
+        if (strcmp(pack->entries[i].name, name) == 0) return &pack->entries[i];
+    }
+    return NULL;
+}
+
+void TexturePack_free(TexturePack *pack) {
+    free(pack->entries);
+    pack->entries = NULL;
+    pack->entry_count = 0;
+}
+
+#endif
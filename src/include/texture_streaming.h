@@ -0,0 +1,335 @@
+#ifndef TEXTURE_STREAMING_H
+#define TEXTURE_STREAMING_H
+
+#include "glad/glad.h"
+#include "jobs.h"
+#include "texture.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Streams mip levels of .dds/.ktx2 textures, plain or array, in and out of VRAM.
+// The small tail of every chain is loaded up front; finer levels are read on job workers
+// one at a time as screen-space feedback asks for them, uploaded on the GL thread, and the
+// least recently used textures give their finest levels back when the budget runs out.
+// GL_TEXTURE_BASE_LEVEL always points at the finest resident level.
+
+#define TEXTURE_STREAMING_TAIL_SIZE 64 // levels no larger than this are always resident
+
+typedef struct {
+    char *path;
+    GLuint texture;
+    TextureImage layout; // format and level sizes, data stays NULL
+    size_t file_offsets[TEXTURE_MAX_LEVELS];
+
+    unsigned int tail_level;     // finest level that is never evicted
+    unsigned int resident_level; // finest level in VRAM
+    unsigned int wanted_level;   // finest level asked for since the last update
+    unsigned int finest_level;   // finest level worth reading; a level that failed to load is not retried
+    unsigned int last_used_frame;
+
+    int loading_level; // level being read by a worker, -1 when idle
+    unsigned char *loaded_data;
+    int load_failed;
+    SDL_atomic_t loaded; // set by the worker once loaded_data is ready
+} StreamedTexture;
+
+typedef struct {
+    size_t budget_bytes;
+    size_t resident_bytes;
+    size_t reserved_bytes; // budget held for levels still being read
+    unsigned int texture_count;
+    unsigned int levels_resident;
+    unsigned int levels_total;
+    unsigned int pending_loads;
+    unsigned long long uploads;
+    unsigned long long evictions;
+    unsigned long long bytes_uploaded;
+    unsigned long long failed_loads;
+} TextureStreamerStats;
+
+typedef struct {
+    StreamedTexture **textures; // removed textures leave a NULL slot for the next add
+    int texture_count;
+    int texture_capacity;
+
+    JobSystem *jobs;
+    SDL_atomic_t pending; // loads still running on workers
+
+    size_t budget_bytes;
+    size_t resident_bytes;
+    size_t reserved_bytes;
+    unsigned int detail_drop;          // finest levels never streamed in, for low-memory configurations
+    unsigned int max_uploads_per_frame;
+    unsigned int frame;
+
+    TextureStreamerStats stats;
+} TextureStreamer;
+
+void TextureStreamer_init(TextureStreamer *streamer, JobSystem *jobs, size_t budget_bytes) {
+    memset(streamer, 0, sizeof(*streamer));
+    streamer->jobs = jobs;
+    streamer->budget_bytes = budget_bytes;
+    streamer->max_uploads_per_frame = 4;
+    SDL_AtomicSet(&streamer->pending, 0);
+}
+
+void TextureStreamer_apply_levels(StreamedTexture *texture) {
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture->texture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, texture->resident_level);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, texture->layout.level_count - 1);
+}
+
+// Registers a texture and uploads its tail levels, returning a handle or -1 if the file cannot be read.
+int TextureStreamer_add(TextureStreamer *streamer, const char *file_path) {
+    StreamedTexture *texture = calloc(1, sizeof(StreamedTexture));
+    if (!texture) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    if (!TextureImage_load_header(&texture->layout, file_path, texture->file_offsets)) {
+        free(texture);
+        return -1;
+    }
+
+    TextureImage *layout = &texture->layout;
+    texture->tail_level = layout->level_count - 1;
+    while (texture->tail_level > 0) {
+        const TextureLevel *level = &layout->levels[texture->tail_level - 1];
+        if (level->width > TEXTURE_STREAMING_TAIL_SIZE || level->height > TEXTURE_STREAMING_TAIL_SIZE) break;
+        texture->tail_level--;
+    }
+
+    size_t tail_size = 0;
+    for (unsigned int i = texture->tail_level; i < layout->level_count; i++) tail_size += layout->levels[i].size;
+    unsigned char *tail = malloc(tail_size);
+    if (!tail) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    glGenTextures(1, &texture->texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture->texture);
+    for (unsigned int i = texture->tail_level; i < layout->level_count; i++) {
+        if (!TextureImage_read_level(layout, file_path, texture->file_offsets, i, tail)) {
+            fprintf(stderr, "Could not read level %u of %s\n", i, file_path);
+            glDeleteTextures(1, &texture->texture);
+            free(tail);
+            free(texture);
+            return -1;
+        }
+        Texture_upload_level(layout, i, tail);
+    }
+    free(tail);
+
+    texture->path = malloc(strlen(file_path) + 1);
+    strcpy(texture->path, file_path);
+    texture->resident_level = texture->tail_level;
+    texture->wanted_level = texture->tail_level;
+    texture->finest_level = 0;
+    texture->last_used_frame = streamer->frame;
+    texture->loading_level = -1;
+    SDL_AtomicSet(&texture->loaded, 0);
+    TextureStreamer_apply_levels(texture);
+
+    streamer->resident_bytes += tail_size;
+    streamer->stats.bytes_uploaded += tail_size;
+    streamer->stats.uploads += layout->level_count - texture->tail_level;
+
+    for (int i = 0; i < streamer->texture_count; i++) {
+        if (!streamer->textures[i]) {
+            streamer->textures[i] = texture;
+            return i;
+        }
+    }
+    if (streamer->texture_count == streamer->texture_capacity) {
+        streamer->texture_capacity = streamer->texture_capacity ? streamer->texture_capacity * 2 : 16;
+        streamer->textures = realloc(streamer->textures, streamer->texture_capacity * sizeof(StreamedTexture *));
+        if (!streamer->textures) {
+            fprintf(stderr, "Memory reallocation failed\n");
+            exit(1);
+        }
+    }
+    streamer->textures[streamer->texture_count] = texture;
+    return streamer->texture_count++;
+}
+
+GLuint TextureStreamer_texture(const TextureStreamer *streamer, int handle) {
+    return streamer->textures[handle]->texture;
+}
+
+// Approximate on-screen diameter in pixels of a sphere of the given radius.
+float TextureStreamer_screen_size(float radius, float distance, float fov_y, float viewport_height) {
+    if (distance <= radius) return viewport_height;
+    return radius / (distance * tanf(fov_y / 2.0f)) * viewport_height;
+}
+
+// Feedback for this frame: the texture covers about screen_size pixels across.
+void TextureStreamer_request(TextureStreamer *streamer, int handle, float screen_size) {
+    StreamedTexture *texture = streamer->textures[handle];
+    unsigned int size = texture->layout.width > texture->layout.height ? texture->layout.width : texture->layout.height;
+
+    unsigned int level = texture->tail_level;
+    if (screen_size >= 1.0f) {
+        float wanted = floorf(log2f((float)size / screen_size));
+        if (wanted < (float)level) level = wanted > 0.0f ? (unsigned int)wanted : 0;
+    }
+    if (level < streamer->detail_drop) level = streamer->detail_drop < texture->tail_level ? streamer->detail_drop : texture->tail_level;
+    if (level < texture->finest_level) level = texture->finest_level;
+
+    if (texture->last_used_frame != streamer->frame || level < texture->wanted_level) {
+        texture->wanted_level = level;
+    }
+    texture->last_used_frame = streamer->frame;
+}
+
+void TextureStreamer_load_level(void *data) {
+    StreamedTexture *texture = data;
+    const TextureLevel *level = &texture->layout.levels[texture->loading_level];
+    texture->loaded_data = malloc(level->size);
+    texture->load_failed = !texture->loaded_data || !TextureImage_read_level(&texture->layout, texture->path, texture->file_offsets, texture->loading_level, texture->loaded_data);
+    SDL_AtomicSet(&texture->loaded, 1);
+}
+
+void TextureStreamer_evict_level(TextureStreamer *streamer, StreamedTexture *texture) {
+    unsigned int level = texture->resident_level++;
+    TextureStreamer_apply_levels(texture);
+    Texture_upload_level(&texture->layout, level, NULL);
+    streamer->resident_bytes -= texture->layout.levels[level].size;
+    streamer->stats.evictions++;
+}
+
+// Evicts finest levels, least recently used first, until bytes more fit in the budget.
+int TextureStreamer_make_room(TextureStreamer *streamer, size_t bytes, const StreamedTexture *keep) {
+    while (streamer->resident_bytes + streamer->reserved_bytes + bytes > streamer->budget_bytes) {
+        StreamedTexture *victim = NULL;
+        for (int i = 0; i < streamer->texture_count; i++) {
+            StreamedTexture *texture = streamer->textures[i];
+            if (!texture || texture == keep || texture->loading_level >= 0 || texture->resident_level >= texture->tail_level) continue;
+
+            // Only textures not drawn in the last two frames, or holding more detail than they need.
+            int stale = texture->last_used_frame + 1 < streamer->frame;
+            if (!stale && texture->resident_level >= texture->wanted_level) continue;
+            if (!victim || texture->last_used_frame < victim->last_used_frame) victim = texture;
+        }
+        if (!victim) return 0;
+        TextureStreamer_evict_level(streamer, victim);
+    }
+    return 1;
+}
+
+// Call once per frame on the GL thread: uploads finished reads, evicts, and starts new reads.
+void TextureStreamer_update(TextureStreamer *streamer) {
+    unsigned int uploads = 0;
+    for (int i = 0; i < streamer->texture_count; i++) {
+        StreamedTexture *texture = streamer->textures[i];
+        if (!texture || texture->loading_level < 0 || !SDL_AtomicGet(&texture->loaded)) continue;
+        if (uploads == streamer->max_uploads_per_frame) break;
+
+        unsigned int level = texture->loading_level;
+        size_t size = texture->layout.levels[level].size;
+        streamer->reserved_bytes -= size;
+        if (texture->load_failed) {
+            fprintf(stderr, "Could not stream level %u of %s\n", level, texture->path);
+            streamer->stats.failed_loads++;
+            texture->finest_level = level + 1;
+            if (texture->wanted_level < texture->finest_level) texture->wanted_level = texture->finest_level;
+        } else {
+            glBindTexture(GL_TEXTURE_2D_ARRAY, texture->texture);
+            Texture_upload_level(&texture->layout, level, texture->loaded_data);
+            texture->resident_level = level;
+            TextureStreamer_apply_levels(texture);
+            streamer->resident_bytes += size;
+            streamer->stats.uploads++;
+            streamer->stats.bytes_uploaded += size;
+            uploads++;
+        }
+
+        free(texture->loaded_data);
+        texture->loaded_data = NULL;
+        texture->loading_level = -1;
+        SDL_AtomicSet(&texture->loaded, 0);
+    }
+
+    for (int i = 0; i < streamer->texture_count; i++) {
+        StreamedTexture *texture = streamer->textures[i];
+        if (!texture || texture->loading_level >= 0 || texture->wanted_level >= texture->resident_level) continue;
+
+        // Coarse to fine, one level at a time, so something sharper shows up as soon as possible.
+        unsigned int level = texture->resident_level - 1;
+        size_t size = texture->layout.levels[level].size;
+        if (!TextureStreamer_make_room(streamer, size, texture)) continue;
+
+        streamer->reserved_bytes += size;
+        texture->loading_level = level;
+        JobSystem_submit(streamer->jobs, TextureStreamer_load_level, texture, &streamer->pending);
+    }
+
+    // Settles any overshoot, e.g. after the budget was lowered at runtime.
+    TextureStreamer_make_room(streamer, 0, NULL);
+
+    streamer->frame++;
+}
+
+void TextureStreamer_stats(const TextureStreamer *streamer, TextureStreamerStats *stats) {
+    *stats = streamer->stats;
+    stats->budget_bytes = streamer->budget_bytes;
+    stats->resident_bytes = streamer->resident_bytes;
+    stats->reserved_bytes = streamer->reserved_bytes;
+    stats->texture_count = 0;
+    stats->levels_resident = 0;
+    stats->levels_total = 0;
+    stats->pending_loads = 0;
+    for (int i = 0; i < streamer->texture_count; i++) {
+        const StreamedTexture *texture = streamer->textures[i];
+        if (!texture) continue;
+        stats->texture_count++;
+        stats->levels_resident += texture->layout.level_count - texture->resident_level;
+        stats->levels_total += texture->layout.level_count;
+        stats->pending_loads += texture->loading_level >= 0;
+    }
+}
+
+void TextureStreamer_print_stats(const TextureStreamer *streamer) {
+    TextureStreamerStats stats;
+    TextureStreamer_stats(streamer, &stats);
+    printf("TEXTURES:\t%u textures, %u/%u levels, %zu/%zu KiB resident, %u loading, %llu uploads, %llu evictions\n",
+        stats.texture_count, stats.levels_resident, stats.levels_total, stats.resident_bytes / 1024, stats.budget_bytes / 1024,
+        stats.pending_loads, stats.uploads, stats.evictions);
+}
+
+// Deletes the texture and frees its handle; a read still in flight is waited for first.
+void TextureStreamer_remove(TextureStreamer *streamer, int handle) {
+    StreamedTexture *texture = streamer->textures[handle];
+    if (texture->loading_level >= 0) {
+        JobSystem_wait(streamer->jobs, &streamer->pending);
+        streamer->reserved_bytes -= texture->layout.levels[texture->loading_level].size;
+    }
+    for (unsigned int i = texture->resident_level; i < texture->layout.level_count; i++) {
+        streamer->resident_bytes -= texture->layout.levels[i].size;
+    }
+
+    glDeleteTextures(1, &texture->texture);
+    free(texture->loaded_data);
+    free(texture->path);
+    free(texture);
+    streamer->textures[handle] = NULL;
+}
+
+void TextureStreamer_destroy(TextureStreamer *streamer) {
+    JobSystem_wait(streamer->jobs, &streamer->pending);
+    for (int i = 0; i < streamer->texture_count; i++) {
+        StreamedTexture *texture = streamer->textures[i];
+        if (!texture) continue;
+        glDeleteTextures(1, &texture->texture);
+        free(texture->loaded_data);
+        free(texture->path);
+        free(texture);
+    }
+    free(streamer->textures);
+    streamer->textures = NULL;
+    streamer->texture_count = 0;
+}
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include "glad/glad.h"
+#include "linalg.h"
+#include "mesh.h"
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Describes how vertices are laid out in a buffer so the attribute pointers can be generated
+// instead of written by hand. VertexFormat_quantize packs a Mesh at import into 16 bytes per vertex,
+// half of MeshVertex:
+//   position  3 x 16-bit unorm over the mesh's bounding box (+2 bytes padding), expanded by
+//             uPositionOffset + uPositionScale * a_position in the vertex shader
+//   uv        2 x half float, or 2 x float (20 bytes per vertex) if the uvs leave [-2, 2] where
+//             half precision would be coarser than 1/1024
+//   normal    10:10:10:2 signed normalized
+
+#define VERTEX_FORMAT_MAX_ATTRIBUTES 8
+#define VERTEX_FORMAT_HALF_UV_RANGE 2.0f
+
+typedef struct {
+    GLuint location;
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    GLboolean integer; // read as ivec/uvec through glVertexAttribIPointer
+    GLuint offset;
+} VertexAttribute;
+
+typedef struct {
+    VertexAttribute attributes[VERTEX_FORMAT_MAX_ATTRIBUTES];
+    int attribute_count;
+    GLsizei stride;
+} VertexFormat;
+
+// Vertices packed by VertexFormat_quantize, plus what the shader needs to expand them.
+typedef struct {
+    VertexFormat format;
+    unsigned char *vertices;
+    unsigned int vertex_count;
+    Vector3 position_offset;
+    Vector3 position_scale;
+} QuantizedVertices;
+
+void VertexFormat_add(VertexFormat *format, GLuint location, GLint components, GLenum type, GLboolean normalized, GLboolean integer, GLuint offset) {
+    if (format->attribute_count == VERTEX_FORMAT_MAX_ATTRIBUTES) {
+        fprintf(stderr, "Too many vertex attributes\n");
+        exit(1);
+    }
+    VertexAttribute *attribute = &format->attributes[format->attribute_count++];
+    attribute->location = location;
+    attribute->components = components;
+    attribute->type = type;
+    attribute->normalized = normalized;
+    attribute->integer = integer;
+    attribute->offset = offset;
+}
+
+// The fp32 MeshVertex layout.
+VertexFormat VertexFormat_mesh_vertex(void) {
+    VertexFormat format = { .attribute_count = 0, .stride = sizeof(MeshVertex) };
+    VertexFormat_add(&format, 0, 3, GL_FLOAT, GL_FALSE, GL_FALSE, offsetof(MeshVertex, position));
+    VertexFormat_add(&format, 1, 2, GL_FLOAT, GL_FALSE, GL_FALSE, offsetof(MeshVertex, uv));
+    VertexFormat_add(&format, 2, 3, GL_FLOAT, GL_FALSE, GL_FALSE, offsetof(MeshVertex, normal));
+    return format;
+}
+
+// Points the bound vertex array's attributes at the bound GL_ARRAY_BUFFER, starting base_offset bytes in.
+void VertexFormat_apply(const VertexFormat *format, GLintptr base_offset) {
+    for (int i = 0; i < format->attribute_count; i++) {
+        const VertexAttribute *attribute = &format->attributes[i];
+        const void *pointer = (const void *)(base_offset + attribute->offset);
+        glEnableVertexAttribArray(attribute->location);
+        if (attribute->integer) glVertexAttribIPointer(attribute->location, attribute->components, attribute->type, format->stride, pointer);
+        else glVertexAttribPointer(attribute->location, attribute->components, attribute->type, attribute->normalized, format->stride, pointer);
+    }
+}
+
+// Round to nearest even, with subnormals, infinities and NaN.
+uint16_t VertexFormat_half(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t magnitude = bits & 0x7fffffff;
+    if (magnitude >= 0x7f800000) return (uint16_t)(sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0));
+    if (magnitude >= 0x477ff000) return (uint16_t)(sign | 0x7c00); // rounds past the largest half
+    if (magnitude < 0x38800000) {
+        // Subnormal half: shift the mantissa with its implicit bit into place.
+        if (magnitude < 0x33000000) return (uint16_t)sign;
+        uint32_t exponent = magnitude >> 23;
+        uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+        uint32_t shift = 126 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1))) half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = (magnitude - 0x38000000) >> 13;
+    uint32_t remainder = magnitude & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) half++;
+    return (uint16_t)(sign | half);
+}
+
+uint32_t VertexFormat_pack_snorm10(const GLfloat *normal) {
+    uint32_t packed = 0;
+    for (int c = 0; c < 3; c++) {
+        float value = normal[c] < -1.0f ? -1.0f : normal[c] > 1.0f ? 1.0f : normal[c];
+        packed |= ((uint32_t)(int32_t)lrintf(value * 511.0f) & 0x3ff) << (10 * c);
+    }
+    return packed;
+}
+
+void QuantizedVertices_free(QuantizedVertices *quantized) {
+    free(quantized->vertices);
+    quantized->vertices = NULL;
+    quantized->vertex_count = 0;
+}
+
+void VertexFormat_quantize(QuantizedVertices *quantized, const Mesh *mesh) {
+    Vector3 low = { 0.0f, 0.0f, 0.0f }, high = { 0.0f, 0.0f, 0.0f };
+    float uv_range = 0.0f;
+    for (unsigned int v = 0; v < mesh->vertex_count; v++) {
+        for (int c = 0; c < 3; c++) {
+            float p = mesh->vertices[v].position[c];
+            if (v == 0 || p < low[c]) low[c] = p;
+            if (v == 0 || p > high[c]) high[c] = p;
+        }
+        for (int c = 0; c < 2; c++) uv_range = fmaxf(uv_range, fabsf(mesh->vertices[v].uv[c]));
+    }
+    int half_uvs = uv_range <= VERTEX_FORMAT_HALF_UV_RANGE;
+
+    VertexFormat *format = &quantized->format;
+    format->attribute_count = 0;
+    VertexFormat_add(format, 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, GL_FALSE, 0);
+    if (half_uvs) {
+        VertexFormat_add(format, 1, 2, GL_HALF_FLOAT, GL_FALSE, GL_FALSE, 8);
+        VertexFormat_add(format, 2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, GL_FALSE, 12);
+        format->stride = 16;
+    } else {
+        VertexFormat_add(format, 1, 2, GL_FLOAT, GL_FALSE, GL_FALSE, 8);
+        VertexFormat_add(format, 2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, GL_FALSE, 16);
+        format->stride = 20;
+    }
+
+    for (int c = 0; c < 3; c++) {
+        quantized->position_offset[c] = low[c];
+        quantized->position_scale[c] = high[c] - low[c];
+    }
+    quantized->vertex_count = mesh->vertex_count;
+    quantized->vertices = calloc(mesh->vertex_count > 0 ? mesh->vertex_count : 1, format->stride);
+    if (!quantized->vertices) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    for (unsigned int v = 0; v < mesh->vertex_count; v++) {
+        const MeshVertex *vertex = &mesh->vertices[v];
+        unsigned char *out = quantized->vertices + (size_t)v * format->stride;
+        uint16_t position[3];
+        for (int c = 0; c < 3; c++) {
+            float extent = quantized->position_scale[c];
+            float t = extent > 0.0f ? (vertex->position[c] - low[c]) / extent : 0.0f;
+            position[c] = (uint16_t)lrintf(fminf(fmaxf(t, 0.0f), 1.0f) * 65535.0f);
+        }
+        memcpy(out, position, sizeof(position));
+        if (half_uvs) {
+            uint16_t uv[2] = { VertexFormat_half(vertex->uv[0]), VertexFormat_half(vertex->uv[1]) };
+            memcpy(out + 8, uv, sizeof(uv));
+        } else {
+            memcpy(out + 8, vertex->uv, sizeof(vertex->uv));
+        }
+        uint32_t normal = VertexFormat_pack_snorm10(vertex->normal);
+        memcpy(out + format->stride - 4, &normal, sizeof(normal));
+    }
+}
+
+#endif
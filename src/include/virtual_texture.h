@@ -0,0 +1,613 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include "glad/glad.h"
+#include "jobs.h"
+#include "shader.h"
+#include "texture.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Sparse virtual texturing on plain GL 4.1: a texture far larger than VRAM is cut into pages, and only the
+// pages the camera actually sees live in a fixed-size physical cache texture. An RGBA8 page table with one
+// texel per page and mip level tells the shader which cache slot holds a page, or which coarser ancestor
+// stands in for it while it loads. A low resolution feedback pass writes the page every pixel wants; it is
+// read back through pixel buffers a few frames later, missing pages are read from disk on job workers and
+// the least recently seen pages give up their slots. src/shaders/virtual_texture.glsl does the translation.
+// Sources are power of two .dds/.ktx2 files in any TextureFormat; pages are copied as stored, blocks and all.
+
+#define VIRTUAL_TEXTURE_PAGE_SIZE 128
+#define VIRTUAL_TEXTURE_PAGE_BORDER 4 // texels repeated from neighbouring pages for bilinear filtering
+#define VIRTUAL_TEXTURE_SLOT_SIZE (VIRTUAL_TEXTURE_PAGE_SIZE + 2 * VIRTUAL_TEXTURE_PAGE_BORDER)
+#define VIRTUAL_TEXTURE_MAX_LOADS 8        // page reads in flight
+#define VIRTUAL_TEXTURE_FEEDBACK_BUFFERS 3 // readbacks in flight
+#define VIRTUAL_TEXTURE_FEEDBACK_SCALE 8   // the feedback target is this much smaller than the viewport on each axis
+
+#define VIRTUAL_PAGE_NOT_RESIDENT -1
+#define VIRTUAL_PAGE_LOADING -2
+
+typedef struct {
+    int level; // -1 while free
+    int x;
+    int y;
+    unsigned int last_used_frame;
+    int pinned;
+} VirtualSlot;
+
+typedef struct {
+    int active;
+    int level;
+    int x;
+    int y;
+    int slot;
+
+    // Read by the worker.
+    int fd;
+    const TextureImage *layout;
+    size_t file_offset;
+
+    unsigned char *data;
+    int failed;
+    SDL_atomic_t done;
+} VirtualPageLoad;
+
+typedef struct {
+    unsigned int resident_pages;
+    unsigned int slot_count;
+    unsigned int requested_pages; // wanted by the last readback, resident or not
+    unsigned int missing_pages;   // of those, pages not resident yet
+    unsigned long long loads;
+    unsigned long long evictions;
+    unsigned long long readbacks;
+    unsigned long long dropped_feedback; // feedback passes skipped because every readback buffer was busy
+} VirtualTextureStats;
+
+typedef struct {
+    TextureImage layout; // level sizes of the source, data stays NULL
+    size_t file_offsets[TEXTURE_MAX_LEVELS];
+    int fd;
+
+    unsigned int level_count; // levels with pages; the coarsest is always resident
+    unsigned int pages_x[TEXTURE_MAX_LEVELS];
+    unsigned int pages_y[TEXTURE_MAX_LEVELS];
+    size_t first_page[TEXTURE_MAX_LEVELS]; // index of each level's first page in the per-page arrays
+    size_t page_count;
+
+    int *page_slot;                  // slot per page, or VIRTUAL_PAGE_NOT_RESIDENT / VIRTUAL_PAGE_LOADING
+    unsigned int *page_stamp;        // last readback that asked for the page
+    unsigned char *page_table;       // RGBA8 page table texels as uploaded
+    unsigned int dirty[TEXTURE_MAX_LEVELS][4]; // x0, y0, x1, y1 of page table texels to upload per level
+    size_t *requests;
+    size_t request_count;
+
+    VirtualSlot *slots;
+    int slots_x;
+    int slots_y;
+    GLuint physical_texture;
+    GLuint page_table_texture;
+
+    JobSystem *jobs;
+    SDL_atomic_t pending;
+    VirtualPageLoad loads[VIRTUAL_TEXTURE_MAX_LOADS];
+    unsigned int max_uploads_per_frame;
+
+    GLuint feedback_framebuffer;
+    GLuint feedback_color;
+    GLuint feedback_depth;
+    int feedback_width;
+    int feedback_height;
+    GLuint feedback_buffers[VIRTUAL_TEXTURE_FEEDBACK_BUFFERS];
+    GLsync feedback_fences[VIRTUAL_TEXTURE_FEEDBACK_BUFFERS];
+    int feedback_sizes[VIRTUAL_TEXTURE_FEEDBACK_BUFFERS][2];
+    int feedback_next;
+    unsigned int feedback_stamp;
+
+    unsigned int frame;
+    VirtualTextureStats stats;
+} VirtualTexture;
+
+int VirtualTexture_is_power_of_two(unsigned int value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+size_t VirtualTexture_page_index(const VirtualTexture *vt, unsigned int level, unsigned int x, unsigned int y) {
+    return vt->first_page[level] + (size_t)y * vt->pages_x[level] + x;
+}
+
+// Copies one page and its border out of the source file into slot sized storage, repeating edge blocks.
+int VirtualTexture_read_page(int fd, const TextureImage *layout, size_t file_offset, int level, int x, int y, unsigned char *destination) {
+    const TextureLevel *info = &layout->levels[level];
+    int block = TextureFormat_is_compressed(layout->format) ? 4 : 1;
+    size_t block_bytes = TextureFormat_block_bytes(layout->format);
+    int level_blocks_x = (info->width + block - 1) / block;
+    int level_blocks_y = (info->height + block - 1) / block;
+    int slot_blocks = VIRTUAL_TEXTURE_SLOT_SIZE / block;
+    int origin_x = (x * VIRTUAL_TEXTURE_PAGE_SIZE - VIRTUAL_TEXTURE_PAGE_BORDER) / block;
+    int origin_y = (y * VIRTUAL_TEXTURE_PAGE_SIZE - VIRTUAL_TEXTURE_PAGE_BORDER) / block;
+
+    int first = origin_x < 0 ? 0 : origin_x;
+    int last = origin_x + slot_blocks > level_blocks_x ? level_blocks_x : origin_x + slot_blocks;
+    for (int row = 0; row < slot_blocks; row++) {
+        int source_row = origin_y + row;
+        source_row = source_row < 0 ? 0 : source_row >= level_blocks_y ? level_blocks_y - 1 : source_row;
+
+        unsigned char *out = destination + (size_t)row * slot_blocks * block_bytes;
+        size_t span = (size_t)(last - first) * block_bytes;
+        off_t offset = (off_t)(file_offset + ((size_t)source_row * level_blocks_x + first) * block_bytes);
+        if (pread(fd, out + (size_t)(first - origin_x) * block_bytes, span, offset) != (ssize_t)span) return 0;
+
+        for (int column = 0; column < first - origin_x; column++) {
+            memcpy(out + column * block_bytes, out + (size_t)(first - origin_x) * block_bytes, block_bytes);
+        }
+        for (int column = last - origin_x; column < slot_blocks; column++) {
+            memcpy(out + column * block_bytes, out + (size_t)(last - origin_x - 1) * block_bytes, block_bytes);
+        }
+    }
+    return 1;
+}
+
+void VirtualTexture_load_page(void *data) {
+    VirtualPageLoad *load = data;
+    load->failed = !VirtualTexture_read_page(load->fd, load->layout, load->file_offset, load->level, load->x, load->y, load->data);
+    SDL_AtomicSet(&load->done, 1);
+}
+
+void VirtualTexture_mark_dirty(VirtualTexture *vt, unsigned int level, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1) {
+    unsigned int *dirty = vt->dirty[level];
+    if (dirty[0] >= dirty[2]) {
+        dirty[0] = x0;
+        dirty[1] = y0;
+        dirty[2] = x1;
+        dirty[3] = y1;
+        return;
+    }
+    if (x0 < dirty[0]) dirty[0] = x0;
+    if (y0 < dirty[1]) dirty[1] = y0;
+    if (x1 > dirty[2]) dirty[2] = x1;
+    if (y1 > dirty[3]) dirty[3] = y1;
+}
+
+// Rewrites the page table below a page whose residency changed: every page points at itself if resident,
+// otherwise at whatever its parent points at.
+void VirtualTexture_refresh(VirtualTexture *vt, int level, unsigned int x, unsigned int y) {
+    unsigned int x0 = x, y0 = y, x1 = x + 1, y1 = y + 1;
+    for (int l = level; l >= 0; l--) {
+        if (x1 > vt->pages_x[l]) x1 = vt->pages_x[l];
+        if (y1 > vt->pages_y[l]) y1 = vt->pages_y[l];
+        for (unsigned int py = y0; py < y1; py++) {
+            for (unsigned int px = x0; px < x1; px++) {
+                size_t index = VirtualTexture_page_index(vt, l, px, py);
+                unsigned char *entry = vt->page_table + index * 4;
+                int slot = vt->page_slot[index];
+                if (slot >= 0) {
+                    entry[0] = (unsigned char)(slot % vt->slots_x);
+                    entry[1] = (unsigned char)(slot / vt->slots_x);
+                    entry[2] = (unsigned char)l;
+                    entry[3] = 255;
+                } else if ((unsigned int)l + 1 < vt->level_count) {
+                    memcpy(entry, vt->page_table + VirtualTexture_page_index(vt, l + 1, px / 2, py / 2) * 4, 4);
+                } else {
+                    memset(entry, 0, 4);
+                }
+            }
+        }
+        VirtualTexture_mark_dirty(vt, l, x0, y0, x1, y1);
+        x0 *= 2;
+        y0 *= 2;
+        x1 *= 2;
+        y1 *= 2;
+    }
+}
+
+void VirtualTexture_upload_page(VirtualTexture *vt, int slot, const unsigned char *data) {
+    const TextureImage *layout = &vt->layout;
+    GLint x = (slot % vt->slots_x) * VIRTUAL_TEXTURE_SLOT_SIZE;
+    GLint y = (slot / vt->slots_x) * VIRTUAL_TEXTURE_SLOT_SIZE;
+    glBindTexture(GL_TEXTURE_2D, vt->physical_texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (TextureFormat_is_compressed(layout->format)) {
+        GLsizei size = (GLsizei)TextureFormat_level_size(layout->format, VIRTUAL_TEXTURE_SLOT_SIZE, VIRTUAL_TEXTURE_SLOT_SIZE);
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x, y, VIRTUAL_TEXTURE_SLOT_SIZE, VIRTUAL_TEXTURE_SLOT_SIZE, TextureFormat_gl_internal_format(layout->format, layout->srgb), size, data);
+    } else {
+        GLenum format = layout->format == TEXTURE_FORMAT_RGBA8 ? GL_RGBA : GL_RGB;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, VIRTUAL_TEXTURE_SLOT_SIZE, VIRTUAL_TEXTURE_SLOT_SIZE, format, GL_UNSIGNED_BYTE, data);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void VirtualTexture_make_resident(VirtualTexture *vt, int level, int x, int y, int slot) {
+    vt->page_slot[VirtualTexture_page_index(vt, level, x, y)] = slot;
+    vt->stats.resident_pages++;
+    VirtualTexture_refresh(vt, level, x, y);
+}
+
+void VirtualTexture_evict(VirtualTexture *vt, int slot) {
+    VirtualSlot *victim = &vt->slots[slot];
+    if (victim->level < 0) return;
+    vt->page_slot[VirtualTexture_page_index(vt, victim->level, victim->x, victim->y)] = VIRTUAL_PAGE_NOT_RESIDENT;
+    vt->stats.resident_pages--;
+    vt->stats.evictions++;
+    VirtualTexture_refresh(vt, victim->level, victim->x, victim->y);
+    victim->level = -1;
+}
+
+// A free slot, or the least recently seen one not touched by the latest readback. -1 if all are in use.
+int VirtualTexture_take_slot(VirtualTexture *vt) {
+    int best = -1;
+    int slot_count = vt->slots_x * vt->slots_y;
+    for (int i = 0; i < slot_count; i++) {
+        VirtualSlot *slot = &vt->slots[i];
+        if (slot->level < 0) return i;
+        if (slot->pinned || slot->last_used_frame == vt->frame) continue;
+        if (vt->page_slot[VirtualTexture_page_index(vt, slot->level, slot->x, slot->y)] == VIRTUAL_PAGE_LOADING) continue;
+        if (best < 0 || slot->last_used_frame < vt->slots[best].last_used_frame) best = i;
+    }
+    if (best >= 0) VirtualTexture_evict(vt, best);
+    return best;
+}
+
+void VirtualTexture_upload_page_table(VirtualTexture *vt) {
+    glBindTexture(GL_TEXTURE_2D, vt->page_table_texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (unsigned int l = 0; l < vt->level_count; l++) {
+        unsigned int *dirty = vt->dirty[l];
+        if (dirty[0] >= dirty[2]) continue;
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, vt->pages_x[l]);
+        glTexSubImage2D(GL_TEXTURE_2D, l, dirty[0], dirty[1], dirty[2] - dirty[0], dirty[3] - dirty[1], GL_RGBA, GL_UNSIGNED_BYTE,
+            vt->page_table + VirtualTexture_page_index(vt, l, dirty[0], dirty[1]) * 4);
+        dirty[0] = dirty[2] = 0;
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+// Frees whatever VirtualTexture_create made, which may be only part of it when creating failed.
+void VirtualTexture_destroy(VirtualTexture *vt) {
+    JobSystem_wait(vt->jobs, &vt->pending);
+    for (int i = 0; i < VIRTUAL_TEXTURE_MAX_LOADS; i++) free(vt->loads[i].data);
+    for (int i = 0; i < VIRTUAL_TEXTURE_FEEDBACK_BUFFERS; i++) {
+        if (vt->feedback_fences[i]) glDeleteSync(vt->feedback_fences[i]);
+    }
+    glDeleteBuffers(VIRTUAL_TEXTURE_FEEDBACK_BUFFERS, vt->feedback_buffers);
+    if (vt->feedback_framebuffer) {
+        glDeleteFramebuffers(1, &vt->feedback_framebuffer);
+        glDeleteRenderbuffers(1, &vt->feedback_color);
+        glDeleteRenderbuffers(1, &vt->feedback_depth);
+    }
+    glDeleteTextures(1, &vt->physical_texture);
+    glDeleteTextures(1, &vt->page_table_texture);
+    if (vt->fd >= 0) close(vt->fd);
+    free(vt->page_slot);
+    free(vt->page_stamp);
+    free(vt->page_table);
+    free(vt->requests);
+    free(vt->slots);
+    memset(vt, 0, sizeof(*vt));
+}
+
+// Opens a power of two .dds/.ktx2 file behind a cache of slots_x * slots_y pages. Returns 0 if it cannot be used.
+int VirtualTexture_create(VirtualTexture *vt, const char *file_path, int slots_x, int slots_y, JobSystem *jobs) {
+    memset(vt, 0, sizeof(*vt));
+    vt->jobs = jobs;
+    vt->slots_x = slots_x;
+    vt->slots_y = slots_y;
+    vt->max_uploads_per_frame = 4;
+    vt->feedback_stamp = 1;
+    vt->fd = -1;
+    SDL_AtomicSet(&vt->pending, 0);
+
+    TextureImage *layout = &vt->layout;
+    if (!TextureImage_load_header(layout, file_path, vt->file_offsets)) return 0;
+    if (layout->layer_count > 0 || !VirtualTexture_is_power_of_two(layout->width) || !VirtualTexture_is_power_of_two(layout->height)
+        || layout->width < VIRTUAL_TEXTURE_PAGE_SIZE || layout->height < VIRTUAL_TEXTURE_PAGE_SIZE || slots_x > 256 || slots_y > 256) {
+        fprintf(stderr, "Virtual textures need a plain power of two texture of at least one page: %s\n", file_path);
+        return 0;
+    }
+
+    // Pages cover each level's real extent, so a non-square source's coarsest levels are a single row or
+    // column of pages, only partly filled along their short side.
+    for (unsigned int l = 0; l < layout->level_count; l++) {
+        vt->pages_x[l] = (layout->levels[l].width + VIRTUAL_TEXTURE_PAGE_SIZE - 1) / VIRTUAL_TEXTURE_PAGE_SIZE;
+        vt->pages_y[l] = (layout->levels[l].height + VIRTUAL_TEXTURE_PAGE_SIZE - 1) / VIRTUAL_TEXTURE_PAGE_SIZE;
+        vt->first_page[l] = vt->page_count;
+        vt->page_count += (size_t)vt->pages_x[l] * vt->pages_y[l];
+        vt->level_count = l + 1;
+        if (vt->pages_x[l] == 1 && vt->pages_y[l] == 1) break;
+    }
+    unsigned int top = vt->level_count - 1;
+    if (vt->pages_x[top] * vt->pages_y[top] >= (unsigned int)(slots_x * slots_y)) {
+        fprintf(stderr, "Not enough virtual texture slots for the coarsest level of %s\n", file_path);
+        return 0;
+    }
+
+    vt->fd = open(file_path, O_RDONLY);
+    if (vt->fd < 0) {
+        fprintf(stderr, "Could not open virtual texture %s\n", file_path);
+        return 0;
+    }
+    vt->page_slot = malloc(vt->page_count * sizeof(int));
+    vt->page_stamp = calloc(vt->page_count, sizeof(unsigned int));
+    vt->page_table = calloc(vt->page_count, 4);
+    vt->requests = malloc(vt->page_count * sizeof(size_t));
+    vt->slots = calloc((size_t)slots_x * slots_y, sizeof(VirtualSlot));
+    if (!vt->page_slot || !vt->page_stamp || !vt->page_table || !vt->requests || !vt->slots) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < vt->page_count; i++) vt->page_slot[i] = VIRTUAL_PAGE_NOT_RESIDENT;
+    for (int i = 0; i < slots_x * slots_y; i++) vt->slots[i].level = -1;
+    vt->stats.slot_count = slots_x * slots_y;
+
+    GLsizei width = slots_x * VIRTUAL_TEXTURE_SLOT_SIZE;
+    GLsizei height = slots_y * VIRTUAL_TEXTURE_SLOT_SIZE;
+    GLenum internal_format = TextureFormat_gl_internal_format(layout->format, layout->srgb);
+    glGenTextures(1, &vt->physical_texture);
+    glBindTexture(GL_TEXTURE_2D, vt->physical_texture);
+    if (TextureFormat_is_compressed(layout->format)) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, (GLsizei)TextureFormat_level_size(layout->format, width, height), NULL);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, layout->format == TEXTURE_FORMAT_RGBA8 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenTextures(1, &vt->page_table_texture);
+    glBindTexture(GL_TEXTURE_2D, vt->page_table_texture);
+    for (unsigned int l = 0; l < vt->level_count; l++) {
+        glTexImage2D(GL_TEXTURE_2D, l, GL_RGBA8, vt->pages_x[l], vt->pages_y[l], 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        VirtualTexture_mark_dirty(vt, l, 0, 0, vt->pages_x[l], vt->pages_y[l]);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, vt->level_count - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // The coarsest level is read up front and pinned so every page always has something to fall back to.
+    size_t slot_bytes = TextureFormat_level_size(layout->format, VIRTUAL_TEXTURE_SLOT_SIZE, VIRTUAL_TEXTURE_SLOT_SIZE);
+    unsigned char *page = malloc(slot_bytes);
+    if (!page) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (unsigned int y = 0; y < vt->pages_y[top]; y++) {
+        for (unsigned int x = 0; x < vt->pages_x[top]; x++) {
+            int slot = VirtualTexture_take_slot(vt);
+            if (!VirtualTexture_read_page(vt->fd, layout, vt->file_offsets[top], top, x, y, page)) {
+                fprintf(stderr, "Could not read virtual texture %s\n", file_path);
+                free(page);
+                VirtualTexture_destroy(vt);
+                return 0;
+            }
+            VirtualTexture_upload_page(vt, slot, page);
+            vt->slots[slot] = (VirtualSlot){ (int)top, (int)x, (int)y, 0, 1 };
+            VirtualTexture_make_resident(vt, top, x, y, slot);
+        }
+    }
+    free(page);
+    VirtualTexture_upload_page_table(vt);
+
+    glGenBuffers(VIRTUAL_TEXTURE_FEEDBACK_BUFFERS, vt->feedback_buffers);
+    return 1;
+}
+
+// Binds the feedback target sized for the viewport. Returns 0 when every readback buffer is still busy,
+// in which case the feedback pass should be skipped this frame.
+int VirtualTexture_begin_feedback(VirtualTexture *vt, int viewport_width, int viewport_height) {
+    if (vt->feedback_fences[vt->feedback_next]) {
+        vt->stats.dropped_feedback++;
+        return 0;
+    }
+
+    int width = (viewport_width + VIRTUAL_TEXTURE_FEEDBACK_SCALE - 1) / VIRTUAL_TEXTURE_FEEDBACK_SCALE;
+    int height = (viewport_height + VIRTUAL_TEXTURE_FEEDBACK_SCALE - 1) / VIRTUAL_TEXTURE_FEEDBACK_SCALE;
+    if (!vt->feedback_framebuffer) {
+        glGenFramebuffers(1, &vt->feedback_framebuffer);
+        glGenRenderbuffers(1, &vt->feedback_color);
+        glGenRenderbuffers(1, &vt->feedback_depth);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, vt->feedback_framebuffer);
+    if (width != vt->feedback_width || height != vt->feedback_height) {
+        vt->feedback_width = width;
+        vt->feedback_height = height;
+        glBindRenderbuffer(GL_RENDERBUFFER, vt->feedback_color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA16UI, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, vt->feedback_depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, vt->feedback_color);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, vt->feedback_depth);
+    }
+
+    static const GLuint no_page[4] = { 0, 0, 0, 0 };
+    static const GLfloat far_depth = 1.0f;
+    glViewport(0, 0, width, height);
+    glClearBufferuiv(GL_COLOR, 0, no_page);
+    glClearBufferfv(GL_DEPTH, 0, &far_depth);
+    return 1;
+}
+
+// Starts reading the feedback target back into a pixel buffer and restores the default framebuffer.
+void VirtualTexture_end_feedback(VirtualTexture *vt, int viewport_width, int viewport_height) {
+    int index = vt->feedback_next;
+    GLsizeiptr size = (GLsizeiptr)vt->feedback_width * vt->feedback_height * 4 * sizeof(GLushort);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, vt->feedback_buffers[index]);
+    if (vt->feedback_sizes[index][0] != vt->feedback_width || vt->feedback_sizes[index][1] != vt->feedback_height) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        vt->feedback_sizes[index][0] = vt->feedback_width;
+        vt->feedback_sizes[index][1] = vt->feedback_height;
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, vt->feedback_width, vt->feedback_height, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    vt->feedback_fences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    vt->feedback_next = (index + 1) % VIRTUAL_TEXTURE_FEEDBACK_BUFFERS;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, viewport_width, viewport_height);
+}
+
+// Marks the page and its ancestors as seen, queueing the ones that are not resident.
+void VirtualTexture_want(VirtualTexture *vt, unsigned int level, unsigned int x, unsigned int y) {
+    if (level >= vt->level_count) return;
+    for (unsigned int l = level; l < vt->level_count; l++, x /= 2, y /= 2) {
+        if (x >= vt->pages_x[l] || y >= vt->pages_y[l]) return;
+        size_t index = VirtualTexture_page_index(vt, l, x, y);
+        if (vt->page_stamp[index] == vt->feedback_stamp) return; // the rest of the chain was seen already
+        vt->page_stamp[index] = vt->feedback_stamp;
+        vt->stats.requested_pages++;
+
+        int slot = vt->page_slot[index];
+        if (slot >= 0) vt->slots[slot].last_used_frame = vt->frame;
+        else if (slot == VIRTUAL_PAGE_NOT_RESIDENT) vt->requests[vt->request_count++] = index;
+    }
+}
+
+unsigned int VirtualTexture_page_level(const VirtualTexture *vt, size_t index) {
+    unsigned int level = 0;
+    while (level + 1 < vt->level_count && vt->first_page[level + 1] <= index) level++;
+    return level;
+}
+
+void VirtualTexture_read_feedback(VirtualTexture *vt, const GLushort *texels, int width, int height) {
+    vt->feedback_stamp++;
+    vt->request_count = 0;
+    vt->stats.requested_pages = 0;
+    for (size_t i = 0; i < (size_t)width * height; i++) {
+        const GLushort *texel = texels + i * 4;
+        if (texel[3] == 0) continue;
+        if (i > 0 && memcmp(texel, texel - 4, 4 * sizeof(GLushort)) == 0) continue; // neighbours mostly agree
+        VirtualTexture_want(vt, texel[2], texel[0], texel[1]);
+    }
+    vt->stats.missing_pages = vt->request_count;
+    vt->stats.readbacks++;
+}
+
+// Call once per frame on the GL thread: consumes finished readbacks, uploads finished reads and starts new ones.
+void VirtualTexture_update(VirtualTexture *vt) {
+    for (int n = 0; n < VIRTUAL_TEXTURE_FEEDBACK_BUFFERS; n++) {
+        int index = (vt->feedback_next + n) % VIRTUAL_TEXTURE_FEEDBACK_BUFFERS;
+        GLsync fence = vt->feedback_fences[index];
+        if (!fence) continue;
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+        glDeleteSync(fence);
+        vt->feedback_fences[index] = NULL;
+
+        int width = vt->feedback_sizes[index][0];
+        int height = vt->feedback_sizes[index][1];
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, vt->feedback_buffers[index]);
+        const GLushort *texels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)width * height * 4 * sizeof(GLushort), GL_MAP_READ_BIT);
+        if (texels) {
+            VirtualTexture_read_feedback(vt, texels, width, height);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    unsigned int uploads = 0;
+    for (int i = 0; i < VIRTUAL_TEXTURE_MAX_LOADS; i++) {
+        VirtualPageLoad *load = &vt->loads[i];
+        if (!load->active || !SDL_AtomicGet(&load->done)) continue;
+        if (uploads == vt->max_uploads_per_frame) break;
+
+        if (load->failed) {
+            fprintf(stderr, "Could not read virtual texture page %d (%d, %d)\n", load->level, load->x, load->y);
+            vt->page_slot[VirtualTexture_page_index(vt, load->level, load->x, load->y)] = VIRTUAL_PAGE_NOT_RESIDENT;
+            vt->slots[load->slot].level = -1;
+        } else {
+            VirtualTexture_upload_page(vt, load->slot, load->data);
+            VirtualTexture_make_resident(vt, load->level, load->x, load->y, load->slot);
+            vt->stats.loads++;
+            uploads++;
+        }
+        free(load->data);
+        load->data = NULL;
+        load->active = 0;
+    }
+
+    // Coarse pages first: they cover the most screen and every finer page falls back on them.
+    size_t next = 0;
+    for (int i = 0; i < VIRTUAL_TEXTURE_MAX_LOADS; i++) {
+        VirtualPageLoad *load = &vt->loads[i];
+        if (load->active) continue;
+
+        size_t best = vt->request_count;
+        unsigned int best_level = 0;
+        for (size_t r = next; r < vt->request_count; r++) {
+            size_t index = vt->requests[r];
+            if (vt->page_slot[index] != VIRTUAL_PAGE_NOT_RESIDENT) continue;
+            unsigned int level = VirtualTexture_page_level(vt, index);
+            if (best == vt->request_count || level > best_level) {
+                best = r;
+                best_level = level;
+            }
+        }
+        if (best == vt->request_count) break;
+
+        size_t index = vt->requests[best];
+        vt->requests[best] = vt->requests[next];
+        vt->requests[next++] = index;
+
+        int slot = VirtualTexture_take_slot(vt);
+        if (slot < 0) break;
+
+        size_t local = index - vt->first_page[best_level];
+        int x = (int)(local % vt->pages_x[best_level]);
+        int y = (int)(local / vt->pages_x[best_level]);
+        vt->slots[slot] = (VirtualSlot){ (int)best_level, x, y, vt->frame, 0 };
+        vt->page_slot[index] = VIRTUAL_PAGE_LOADING;
+
+        load->active = 1;
+        load->level = best_level;
+        load->x = x;
+        load->y = y;
+        load->slot = slot;
+        load->fd = vt->fd;
+        load->layout = &vt->layout;
+        load->file_offset = vt->file_offsets[best_level];
+        load->data = malloc(TextureFormat_level_size(vt->layout.format, VIRTUAL_TEXTURE_SLOT_SIZE, VIRTUAL_TEXTURE_SLOT_SIZE));
+        if (!load->data) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        SDL_AtomicSet(&load->done, 0);
+        JobSystem_submit(vt->jobs, VirtualTexture_load_page, load, &vt->pending);
+    }
+
+    VirtualTexture_upload_page_table(vt);
+    vt->frame++;
+}
+
+// Binds the page table and physical cache to two texture units and points the helper's uniforms at them.
+void VirtualTexture_bind(const VirtualTexture *vt, Shader shader, GLuint first_unit) {
+    glActiveTexture(GL_TEXTURE0 + first_unit);
+    glBindTexture(GL_TEXTURE_2D, vt->page_table_texture);
+    glBindSampler(first_unit, 0);
+    glActiveTexture(GL_TEXTURE0 + first_unit + 1);
+    glBindTexture(GL_TEXTURE_2D, vt->physical_texture);
+    glBindSampler(first_unit + 1, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    glUseProgram(shader.program);
+    glUniform1i(glGetUniformLocation(shader.program, "uVirtualPageTable"), first_unit);
+    glUniform1i(glGetUniformLocation(shader.program, "uVirtualPhysical"), first_unit + 1);
+    glUniform2f(glGetUniformLocation(shader.program, "uVirtualSize"), (GLfloat)vt->layout.width, (GLfloat)vt->layout.height);
+    glUniform1f(glGetUniformLocation(shader.program, "uVirtualLevelCount"), (GLfloat)vt->level_count);
+    glUniform1f(glGetUniformLocation(shader.program, "uVirtualFeedbackBias"), -log2f((float)VIRTUAL_TEXTURE_FEEDBACK_SCALE));
+}
+
+void VirtualTexture_print_stats(const VirtualTexture *vt) {
+    const VirtualTextureStats *stats = &vt->stats;
+    printf("VIRTUAL TEXTURE:\t%u/%u pages resident, %u seen, %u missing, %llu loads, %llu evictions, %llu readbacks (%llu dropped)\n",
+        stats->resident_pages, stats->slot_count, stats->requested_pages, stats->missing_pages, stats->loads, stats->evictions,
+        stats->readbacks, stats->dropped_feedback);
+}
+
+#endif
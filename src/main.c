@@ -1,6 +1,21 @@
+#include "geometry_pool.h"
 #include "glad/glad.h"
+#include "gltf.h"
+#include "instancing.h"
 #include "linalg.h"
+#include "mesh.h"
+#include "mesh_buffers.h"
+#include "mesh_disk_cache.h"
+#include "meshlet.h"
+#include "obj.h"
+#include "render_queue.h"
 #include "shader.h"
+#include "texture.h"
+#include "texture_cache.h"
+#include "texture_pack.h"
+#include "texture_streaming.h"
+#include "vertex_format.h"
+#include "virtual_texture.h"
 #include <GL/gl.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_keycode.h>
@@ -16,6 +31,16 @@
 static unsigned int window_width = 1280;
 static unsigned int window_height = 720;
 static const char *window_name = "Cool shaders idk";
+static unsigned int texture_detail_drop = 0; // top mip levels skipped on low-memory configurations
+static size_t texture_budget_bytes = 64 * 1024 * 1024;
+static const char *texture_cache_directory = "./.texture_cache";
+static const char *mesh_cache_directory = "./.mesh_cache";
+static int mesh_cache_encoded = 0; // MeshCodec streams instead of raw buffers: half the disk, but decoded on every load
+static unsigned int instance_grid_size = 32; // copies of the model drawn along each side of the instance grid
+static GLsizeiptr stream_region_size = 4 << 20; // per-frame data before the stream buffer has to grow
+static unsigned int max_frames_in_flight = 2; // frames the CPU may queue ahead of the GPU, at most FRAME_SYNC_MAX_LATENCY
+static const char *virtual_texture_path = "./res/wall.ktx2";
+static int virtual_texture_slots = 16; // the page cache is this many pages on each side
 
 void destroy_window(SDL_Window **window, SDL_GLContext *gl_context) {
     SDL_GL_DeleteContext(*gl_context);
@@ -95,28 +120,189 @@ char *read_file(const char *file_path) {
     return contents;
 }
 
-int main(void) {
+void set_view_uniforms(Shader shader, Vector3 camera_position, Matrix4 transform, Matrix4 projection, Matrix4 view) {
+    Shader_set_uniform_vec3(shader, "uCameraPosition", camera_position);
+    Shader_set_uniform_mat4(shader, "uTransform", transform);
+    Shader_set_uniform_mat4(shader, "uProjection", projection);
+    Shader_set_uniform_mat4(shader, "uView", view);
+}
+
+// Copies of the model at grid points spaced apart, each spinning about its own center at its own rate.
+void fill_instance_grid(Instance *instances, unsigned int grid_size, const Vector3 center, float spacing, float time) {
+    for (unsigned int i = 0; i < grid_size * grid_size; i++) {
+        Matrix4 transform;
+        Matrix4_identity(transform);
+        Matrix4_rotate_y(transform, time * (0.2f + 0.1f * (i % 7)));
+        Vector3 offset = { ((float)(i % grid_size) - 0.5f * (grid_size - 1)) * spacing, 0.0f, ((float)(i / grid_size) - 0.5f * (grid_size - 1)) * spacing };
+        for (int row = 0; row < 3; row++) {
+            transform[3][row] = center[row] + offset[row];
+            for (int col = 0; col < 3; col++) transform[3][row] -= transform[col][row] * center[col];
+        }
+        uint32_t hash = i * 2654435761u;
+        GLubyte tint[4] = { (GLubyte)(128 + (hash >> 8 & 127)), (GLubyte)(128 + (hash >> 16 & 127)), (GLubyte)(128 + (hash >> 24 & 127)), 255 };
+        Instance_set(&instances[i], transform, tint);
+    }
+}
+
+// B: draws 1 to 1M copies of one LOD level, once instanced and, up to 100k, once with a draw per copy
+// that binds its own draw data. CPU times include the map and fill; GPU times come from a time elapsed query.
+void benchmark_instancing(Shader shader, const GeometryPool *pool, GLuint instanced_vao, InstanceBuffer *instances, DrawDataBuffer *draws,
+    unsigned int first_index, unsigned int index_count, GLint base_vertex, float spacing) {
+    GLuint query;
+    glGenQueries(1, &query);
+    glUseProgram(shader.program);
+    const void *offset = (const void *)((uintptr_t)first_index * pool->index_size);
+    double ticks_per_ms = SDL_GetPerformanceFrequency() / 1000.0;
+    printf("INSTANCING:\t%u triangles per copy\n", index_count / 3);
+    for (unsigned int count = 1; count <= 1000000; count *= 10) {
+        unsigned int side = (unsigned int)ceilf(cbrtf((float)count));
+        Matrix4 transform;
+        Matrix4_identity(transform);
+        GLubyte white[4] = { 255, 255, 255, 255 };
+        GLuint64 instanced_ns = 0, uniform_ns = 0;
+
+        glFinish();
+        Uint64 start = SDL_GetPerformanceCounter();
+        Instance *mapped = InstanceBuffer_map(instances, count);
+        for (unsigned int i = 0; i < count; i++) {
+            transform[3][0] = (float)(i % side) * spacing;
+            transform[3][1] = (float)(i / side % side) * spacing;
+            transform[3][2] = (float)(i / (side * side)) * spacing;
+            Instance_set(&mapped[i], transform, white);
+        }
+        InstanceBuffer_unmap(instances);
+        Uint64 filled = SDL_GetPerformanceCounter();
+        glBindVertexArray(instanced_vao);
+        InstanceBuffer_apply(instances, 0);
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)index_count, pool->index_type, offset, (GLsizei)instances->count, base_vertex);
+        glEndQuery(GL_TIME_ELAPSED);
+        Uint64 submitted = SDL_GetPerformanceCounter();
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &instanced_ns);
+        printf("INSTANCING:\t%7u copies instanced: fill %8.3f ms, draw %6.3f ms, GPU %8.3f ms", count, (filled - start) / ticks_per_ms,
+            (submitted - filled) / ticks_per_ms, instanced_ns / 1e6);
+
+        if (count <= 100000) {
+            glBindVertexArray(pool->vao);
+            glFinish();
+            start = SDL_GetPerformanceCounter();
+            DrawDataBuffer_map(draws, count);
+            for (unsigned int i = 0; i < count; i++) {
+                transform[3][0] = (float)(i % side) * spacing;
+                transform[3][1] = (float)(i / side % side) * spacing;
+                transform[3][2] = (float)(i / (side * side)) * spacing;
+                memcpy(DrawDataBuffer_at(draws, i)->model, transform, sizeof(Matrix4));
+            }
+            DrawDataBuffer_unmap(draws);
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            for (unsigned int i = 0; i < count; i++) {
+                DrawDataBuffer_bind(draws, i);
+                glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)index_count, pool->index_type, offset, base_vertex);
+            }
+            glEndQuery(GL_TIME_ELAPSED);
+            submitted = SDL_GetPerformanceCounter();
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &uniform_ns);
+            printf(" | a draw each: CPU %8.3f ms, GPU %8.3f ms", (submitted - start) / ticks_per_ms, uniform_ns / 1e6);
+        }
+        printf("\n");
+        FrameSync_end_frame(instances->stream->frames); // each count gets a region to itself
+    }
+    DrawDataBuffer_bind_identity(draws);
+    glBindVertexArray(0);
+    glDeleteQueries(1, &query);
+}
+
+// Binds a glTF material's base color and texture, or the wall while that loads or when there is none.
+typedef struct {
+    const Gltf *gltf;
+    TextureCache *textures;
+    int *material_textures; // TextureCache handle for every glTF material's base color, -1 where there is none
+    int fallback_texture;
+    const TexturePackEntry *fallback;
+    GLint layer_location;
+    GLint rect_location;
+} SceneMaterials;
+
+void bind_scene_material(void *user, GLuint program, int material) {
+    SceneMaterials *materials = user;
+    Gltf_bind_material(materials->gltf, program, material);
+    int handle = material >= 0 ? materials->material_textures[material] : -1;
+    if (handle >= 0 && TextureCache_ready(materials->textures, handle)) {
+        static const Vector4 whole_layer = { 0.0f, 0.0f, 1.0f, 1.0f };
+        TextureCache_bind(materials->textures, handle, 0);
+        glUniform1f(materials->layer_location, 0.0f);
+        glUniform4fv(materials->rect_location, 1, whole_layer);
+    } else {
+        TextureCache_bind(materials->textures, materials->fallback_texture, 0);
+        glUniform1f(materials->layer_location, (GLfloat)materials->fallback->layer);
+        glUniform4fv(materials->rect_location, 1, materials->fallback->rect);
+    }
+}
+
+// glTF leaves filters it does not set to the renderer, and wraps with repeat unless told otherwise.
+TextureSampler scene_sampler(const GltfSampler *sampler) {
+    TextureSampler params = { sampler->min_filter ? sampler->min_filter : GL_LINEAR_MIPMAP_LINEAR, sampler->mag_filter ? sampler->mag_filter : GL_LINEAR,
+        sampler->wrap_s, sampler->wrap_t };
+    return params;
+}
+
+// Runs the import pipeline on an OBJ, storing the result under key when disk is given. Returns 0 if it cannot be loaded.
+int build_obj_buffers(MeshBuffers *buffers, const char *path, MeshDiskCache *disk, MeshDiskKey *key, JobSystem *jobs) {
+    Uint64 load_start = SDL_GetPerformanceCounter();
+    Mesh loaded;
+    if (!Obj_load(&loaded, path, jobs)) return 0;
+    printf("MODEL:\t\t%s, %u vertices, %u triangles in %.1f ms\n", path, loaded.vertex_count, loaded.index_count / 3,
+        (SDL_GetPerformanceCounter() - load_start) * 1000.0 / SDL_GetPerformanceFrequency());
+    Uint64 build_start = SDL_GetPerformanceCounter();
+    MeshBuffers_build(buffers, &loaded, jobs);
+    printf("MODEL:\t\toptimized, simplified and quantized in %.1f ms\n", (SDL_GetPerformanceCounter() - build_start) * 1000.0 / SDL_GetPerformanceFrequency());
+    if (disk) MeshDiskCache_store(disk, key, buffers);
+    Mesh_free(&loaded);
+    return 1;
+}
+
+// The scene's draws go through the queue, so they come out grouped by program and material and front to back.
+// Worker threads record them into command lists, which are replayed here.
+void draw_scene(RenderQueue *queue, JobSystem *jobs, DrawDataBuffer *draws, const Gltf *scene, GLuint program, Matrix4 transform,
+    const Vector3 camera_position, RenderMaterialFunction bind_material, void *user) {
+    RenderQueue_clear(queue);
+    Gltf_queue(scene, queue, 0, program, transform, camera_position);
+    RenderQueue_sort(queue);
+    RenderQueue_submit(queue, jobs, draws, bind_material, user);
+}
+
+int main(int argc, char **argv) {
     SDL_Window *window;
     SDL_GLContext gl_context;
     initialize_rendering(&window, &gl_context);
 
-    int width, height, nrChannels;
-    unsigned char *data = stbi_load("./res/wall.jpg", &width, &height, &nrChannels, 0);
-
     const char *vertex_shader = read_file("./src/shaders/vertex.glsl");
     const char *fragment_shader = read_file("./src/shaders/fragment.glsl");
     Shader shader = Shader_create_program(vertex_shader, fragment_shader);
 
+    const char *virtual_library = read_file("./src/shaders/virtual_texture.glsl");
+    const char *virtual_fragment[] = { virtual_library, read_file("./src/shaders/virtual_fragment.glsl") };
+    const char *virtual_feedback[] = { virtual_library, read_file("./src/shaders/virtual_feedback.glsl") };
+    Shader virtual_shader = Shader_create_program_sources(vertex_shader, 2, virtual_fragment);
+    Shader feedback_shader = Shader_create_program_sources(vertex_shader, 2, virtual_feedback);
+
+    // Only glTF scenes move their meshes and tint their materials.
+    Vector4 white = { 1.0f, 1.0f, 1.0f, 1.0f };
+    Shader_set_uniform_block(shader, "DrawData", DRAW_DATA_BINDING);
+    Shader_set_uniform_block(virtual_shader, "DrawData", DRAW_DATA_BINDING);
+    Shader_set_uniform_block(feedback_shader, "DrawData", DRAW_DATA_BINDING);
+    Shader_set_uniform_vec4(shader, "uBaseColor", white);
+
     const GLfloat vertices[] = {
-        -0.5f, -0.5f, -0.5f, -1.0f, -1.0f,
-        0.5f, -0.5f, -0.5f, 1.0f, -1.0f,
+        -0.5f, -0.5f, -0.5f, 0.0f, 0.0f,
+        0.5f, -0.5f, -0.5f, 1.0f, 0.0f,
         0.5f, 0.5f, -0.5f, 1.0f, 1.0f,
-        -0.5f, 0.5f, -0.5f, -1.0f, 1.0f,
+        -0.5f, 0.5f, -0.5f, 0.0f, 1.0f,
 
-        -0.5f, -0.5f, 0.5f, -1.0f, -1.0f,
-        0.5f, -0.5f, 0.5f, 1.0f, -1.0f,
+        -0.5f, -0.5f, 0.5f, 0.0f, 0.0f,
+        0.5f, -0.5f, 0.5f, 1.0f, 0.0f,
         0.5f, 0.5f, 0.5f, 1.0f, 1.0f,
-        -0.5f, 0.5f, 0.5f, -1.0f, 1.0f,
+        -0.5f, 0.5f, 0.5f, 0.0f, 1.0f,
     };
     const GLuint indices[] = {
         0, 1, 3,
@@ -137,75 +323,200 @@ int main(void) {
         0, 4, 1,
         1, 4, 5,
     };
-    GLfloat vertices_with_normals[8 * 8] = { 0 };
-    for (unsigned int i = 0; i < sizeof(indices) / sizeof(indices[0]); i += 3) {
-        GLuint i0 = indices[i];
-        GLuint i1 = indices[i + 1];
-        GLuint i2 = indices[i + 2];
-
-        Vector3 p0 = { vertices[i0 * 5], vertices[i0 * 5 + 1], vertices[i0 * 5 + 2] };
-        Vector3 p1 = { vertices[i1 * 5], vertices[i1 * 5 + 1], vertices[i1 * 5 + 2] };
-        Vector3 p2 = { vertices[i2 * 5], vertices[i2 * 5 + 1], vertices[i2 * 5 + 2] };
-
-        Vector3 e0 = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
-        Vector3 e1 = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
-
-        Vector3 normal;
-        Vector3_cross(normal, e0, e1);
-        Vector3_normalize(normal);
-
-        for (int j = 0; j < 3; j++) {
-            GLuint idx = indices[i + j];
-            vertices_with_normals[idx * 8] = vertices[idx * 5];
-            vertices_with_normals[idx * 8 + 1] = vertices[idx * 5 + 1];
-            vertices_with_normals[idx * 8 + 2] = vertices[idx * 5 + 2];
-            vertices_with_normals[idx * 8 + 3] = vertices[idx * 5 + 3];
-            vertices_with_normals[idx * 8 + 4] = vertices[idx * 5 + 4];
-            vertices_with_normals[idx * 8 + 5] = normal[0];
-            vertices_with_normals[idx * 8 + 6] = normal[1];
-            vertices_with_normals[idx * 8 + 7] = normal[2];
+    // Every face gets its own corners with the face normal; welding then shares them within each face.
+    unsigned int corner_count = sizeof(indices) / sizeof(indices[0]);
+    MeshVertex corners[sizeof(indices) / sizeof(indices[0])];
+    for (unsigned int i = 0; i < corner_count; i++) {
+        memcpy(corners[i].position, &vertices[indices[i] * 5], sizeof(corners[i].position));
+        memcpy(corners[i].uv, &vertices[indices[i] * 5 + 3], sizeof(corners[i].uv));
+    }
+    Mesh_flat_normals(corners, corner_count);
+    Mesh model;
+    Mesh_weld(&model, corners, NULL, corner_count);
+    printf("MESH:\t\tcube, %u corners welded into %u vertices\n", corner_count, model.vertex_count);
+
+    JobSystem jobs;
+    JobSystem_init(&jobs, -1);
+    stbi_set_parallel_for(JobSystem_run_tasks, &jobs);
+
+    // An OBJ or .glb given on the command line replaces the cube.
+    Gltf scene;
+    int scene_ready = 0;
+    if (argc > 1 && TextureImage_has_extension(argv[1], ".glb")) {
+        Uint64 load_start = SDL_GetPerformanceCounter();
+        if ((scene_ready = Gltf_load(&scene, argv[1]))) {
+            Gltf_upload(&scene);
+            printf("SCENE:\t\t%s, %d nodes, %d primitives, %d materials in %.1f ms\n", argv[1], scene.node_count, scene.primitive_count,
+                scene.material_count, (SDL_GetPerformanceCounter() - load_start) * 1000.0 / SDL_GetPerformanceFrequency());
         }
     }
 
-    GLuint vao;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices_with_normals), vertices_with_normals, GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void *)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void *)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8, (void *)(5 * sizeof(GLfloat)));
+    // OBJs are converted once and mapped from the mesh disk cache afterwards; the cube is built every time.
+    int obj_given = argc > 1 && !TextureImage_has_extension(argv[1], ".glb");
+    MeshDiskCache mesh_disk_cache;
+    int mesh_disk_cache_ready = obj_given && MeshDiskCache_init(&mesh_disk_cache, mesh_cache_directory, mesh_cache_encoded);
+    MeshDiskKey mesh_key;
+    MeshBuffers buffers;
+    int buffers_ready = 0;
+    if (mesh_disk_cache_ready) {
+        Uint64 map_start = SDL_GetPerformanceCounter();
+        if ((buffers_ready = MeshDiskCache_open(&mesh_disk_cache, &mesh_key, argv[1], &buffers))) {
+            printf("MODEL:\t\t%s, %u vertices, %u triangles mapped from the mesh cache in %.1f ms\n", argv[1], buffers.vertex_count,
+                buffers.levels[0].index_count / 3, (SDL_GetPerformanceCounter() - map_start) * 1000.0 / SDL_GetPerformanceFrequency());
+        }
+    }
+    if (obj_given && !buffers_ready) buffers_ready = build_obj_buffers(&buffers, argv[1], mesh_disk_cache_ready ? &mesh_disk_cache : NULL, &mesh_key, &jobs);
+    if (!buffers_ready) MeshBuffers_build(&buffers, &model, &jobs);
+
+    // Meshes share a vertex and an index buffer per vertex format, so draws switch no buffers.
+    // glTF scenes are drawn straight from their own buffers, whatever layout the file uses.
+    GeometryPools geometry;
+    GeometryPools_init(&geometry);
+    GeometryPool *model_pool = GeometryPools_get(&geometry, &buffers.format, buffers.index_type);
+    GeometryAllocation model_geometry;
+    GeometryPool_allocate(model_pool, buffers.vertex_count, buffers.index_count, &model_geometry);
+    if (!MeshBuffers_upload(&buffers, model_pool, &model_geometry)) {
+        // Only encoded blobs can fail here; the source is rebuilt, and without the blob next launch too.
+        fprintf(stderr, "Could not decode the cached vertices and indices of %s, rebuilding them\n", argv[1]);
+        remove(mesh_key.blob_path);
+        GeometryPool_release(model_pool, &model_geometry);
+        MeshBuffers_free(&buffers);
+        if (!build_obj_buffers(&buffers, argv[1], &mesh_disk_cache, &mesh_key, &jobs)) MeshBuffers_build(&buffers, &model, &jobs);
+        model_pool = GeometryPools_get(&geometry, &buffers.format, buffers.index_type);
+        GeometryPool_allocate(model_pool, buffers.vertex_count, buffers.index_count, &model_geometry);
+        MeshBuffers_upload(&buffers, model_pool, &model_geometry);
+    }
+    Mesh_free(&model);
+    printf("MESH:\t\tACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", buffers.loaded_stats.acmr, buffers.optimized_stats.acmr, buffers.loaded_stats.atvr,
+        buffers.optimized_stats.atvr);
+    // Every level indexes the same vertices, so they all live in one index buffer.
+    MeshLodChain lods = MeshBuffers_lods(&buffers);
+    printf("LOD:\t\t%d levels:", lods.level_count);
+    for (int i = 0; i < lods.level_count; i++) printf(" %u (%.4f)", lods.levels[i].index_count / 3, lods.levels[i].error);
+    printf("\n");
+    int lod_level = 0;
+
+    // Each level is split into meshlets, so culling can skip parts of it.
+    Meshlets *meshlets = buffers.meshlets;
+    unsigned int meshlet_count = 0;
+    for (int i = 0; i < lods.level_count; i++) meshlet_count += meshlets[i].meshlet_count;
+    printf("MESHLETS:\t%u over %d levels, %u in level 0\n", meshlet_count, lods.level_count, meshlets[0].meshlet_count);
+    MeshletCullStats cull_stats = { 0, 0, 0 };
+
+    GeometryBatch model_batch;
+    GeometryBatch_init(&model_batch);
+    printf("GEOMETRY:\t%s\n", model_batch.indirect_buffer ? "glMultiDrawElementsIndirect" : "glMultiDrawElementsBaseVertex");
+    GeometryPools_print_stats(&geometry);
+    // Positions come back through uPositionOffset + uPositionScale * a_position; glTF scenes keep floats.
+    printf("MESH:\t\t%u bytes per vertex quantized to %d\n", (unsigned int)sizeof(MeshVertex), buffers.format.stride);
+    Vector3 position_offset = { 0.0f, 0.0f, 0.0f };
+    Vector3 position_scale = { 1.0f, 1.0f, 1.0f };
+    Vector3 model_center;
+    for (int c = 0; c < 3; c++) model_center[c] = buffers.position_offset[c] + buffers.position_scale[c] * 0.5f;
+    float model_radius = 0.5f * sqrtf(Vector3_dot(buffers.position_scale, buffers.position_scale));
+    if (!scene_ready) {
+        memcpy(position_offset, buffers.position_offset, sizeof(Vector3));
+        memcpy(position_scale, buffers.position_scale, sizeof(Vector3));
+    }
+    Shader programs[] = { shader, virtual_shader, feedback_shader };
+    for (int i = 0; i < 3; i++) {
+        Shader_set_uniform_vec3(programs[i], "uPositionOffset", position_offset);
+        Shader_set_uniform_vec3(programs[i], "uPositionScale", position_scale);
+    }
 
-    GLuint ebo;
-    glGenBuffers(1, &ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    printf("MESH:\t\t%u bit indices\n", model_pool->index_size * 8);
+    // The meshlets stay in use for culling, so the buffers (or the mapping they point into) are kept.
+
+    // Per-frame data, like the instance grid and per-draw uniforms, goes through the stream buffer,
+    // whose regions are reused as the frames that wrote them finish.
+    FrameSync frames;
+    FrameSync_init(&frames, max_frames_in_flight);
+    StreamBuffer stream;
+    StreamBuffer_init(&stream, &frames, stream_region_size);
+    DrawDataBuffer draw_data;
+    DrawDataBuffer_init(&draw_data, &stream);
+    DrawDataBuffer_bind_identity(&draw_data);
+
+    // The instance grid shares the pool's buffers and adds the per-instance ones.
+    Instances_set_defaults();
+    InstanceBuffer instances;
+    InstanceBuffer_init(&instances, &stream);
+    GLuint instanced_vao;
+    glGenVertexArrays(1, &instanced_vao);
+    glBindVertexArray(instanced_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, model_pool->vertex_buffer);
+    VertexFormat_apply(&model_pool->format, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model_pool->index_buffer);
+    InstanceBuffer_apply(&instances, 0);
+    float instance_spacing = 2.5f * model_radius;
+    float instance_grid_radius = model_radius + 0.7072f * instance_spacing * (instance_grid_size - 1);
+    int use_instances = 0;
 
     glBindVertexArray(0);
     glDisableVertexAttribArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    GLuint texture;
-    glGenTextures(1, &texture);
+    TextureStreamer streamer;
+    TextureStreamer_init(&streamer, &jobs, texture_budget_bytes);
+    streamer.detail_drop = texture_detail_drop;
+
+    TextureDiskCache texture_disk_cache;
+    int texture_disk_cache_ready = TextureDiskCache_init(&texture_disk_cache, texture_cache_directory);
+
+    TextureCache textures;
+    TextureCache_init(&textures, &streamer, &jobs);
+    textures.detail_drop = texture_detail_drop;
+    if (texture_disk_cache_ready) textures.disk = &texture_disk_cache;
+
+    // Everything drawn samples one array texture; each draw picks its layer and rect.
+    // Packed textures clamp inside their rect in the shader, so the sampler must not wrap across the layer.
+    TextureSampler sampler = { GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE };
+    TexturePack pack;
+    TexturePackEntry wall = TexturePack_whole_layer("wall");
+    int wall_texture = -1;
+    if (TexturePack_load(&pack, "./res/textures.pack")) {
+        wall_texture = TextureCache_acquire(&textures, pack.texture_path, &sampler);
+        const TexturePackEntry *entry = TexturePack_find(&pack, "wall");
+        if (entry) wall = *entry;
+        TexturePack_free(&pack);
+    }
+    if (wall_texture < 0) {
+        fprintf(stderr, "Could not load ./res/textures.pack (run `make assets`), decoding ./res/wall.jpg instead\n");
+        wall = TexturePack_whole_layer("wall");
+        wall_texture = TextureCache_acquire(&textures, "./res/wall.jpg", &sampler);
+    }
 
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    // glTF is right handed while this view is left handed, so scenes are mirrored along z.
+    Matrix4 scene_transform;
+    Matrix4_identity(scene_transform);
+    scene_transform[2][2] = -1.0f;
+    SceneMaterials scene_materials = { &scene, &textures, NULL, wall_texture, &wall,
+        glGetUniformLocation(shader.program, "uTextureLayer"), glGetUniformLocation(shader.program, "uTextureRect") };
+    RenderQueue render_queue;
+    RenderQueue_init(&render_queue);
+    if (scene_ready) {
+        scene_materials.material_textures = malloc((scene.material_count > 0 ? scene.material_count : 1) * sizeof(int));
+        if (!scene_materials.material_textures) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        // Each material samples its image its own way; the cache shares the texture between them.
+        for (int i = 0; i < scene.material_count; i++) {
+            const GltfMaterial *material = &scene.materials[i];
+            const GltfImage *image = material->base_color_image >= 0 ? &scene.images[material->base_color_image] : NULL;
+            TextureSampler params = scene_sampler(&material->base_color_sampler);
+            char name[GLTF_PATH_LENGTH + 16];
+            snprintf(name, sizeof(name), "%s#%d", argv[1], material->base_color_image);
+            scene_materials.material_textures[i] = !image ? -1
+                : image->data ? TextureCache_acquire_memory(&textures, name, image->data, image->size, &params)
+                : image->path[0] ? TextureCache_acquire(&textures, image->path, &params) : -1;
+        }
+    }
 
-    stbi_image_free(data);
+    // V switches the cube over to the virtual texture, when `make assets` has built one.
+    VirtualTexture virtual_texture;
+    int virtual_texture_ready = VirtualTexture_create(&virtual_texture, virtual_texture_path, virtual_texture_slots, virtual_texture_slots, &jobs);
+    int use_virtual_texture = 0;
 
     Uint64 last_frame_time = SDL_GetPerformanceCounter();
     unsigned int frame_counter = 0;
@@ -215,7 +526,8 @@ int main(void) {
     Matrix4 uView;
 
     Matrix4_identity(uTransform);
-    Matrix4_perspective(uProjection, 80.0f * 3.1415f / 180.0f, (float)window_width / window_height, 0.01f, 1000.0f);
+    float camera_fov = 80.0f * 3.1415f / 180.0f;
+    Matrix4_perspective(uProjection, camera_fov, (float)window_width / window_height, 0.01f, 1000.0f);
     Matrix4_identity(uView);
 
     int shift = 0, space = 0;
@@ -250,6 +562,15 @@ int main(void) {
                         case SDLK_s: down = 1; break;
                         case SDLK_SPACE: space = 1; break;
                         case SDLK_LSHIFT: shift = 1; break;
+                        case SDLK_v: use_virtual_texture = virtual_texture_ready && !use_virtual_texture; break;
+                        case SDLK_i: use_instances = !scene_ready && !use_instances; break;
+                        case SDLK_b:
+                            if (!scene_ready) {
+                                const MeshLod *coarsest = &lods.levels[lods.level_count - 1];
+                                benchmark_instancing(shader, model_pool, instanced_vao, &instances, &draw_data, model_geometry.first_index + coarsest->first_index,
+                                    coarsest->index_count, (GLint)model_geometry.first_vertex, instance_spacing);
+                            }
+                            break;
                     }
                     break;
                 case SDL_KEYUP:
@@ -323,28 +644,99 @@ int main(void) {
         Matrix4_rotate_x(uTransform, camera_pitch * 3.1415f / 180.0f);
         Matrix4_rotate_y(uTransform, camera_yaw * 3.1415f / 180.0f);
 
-        Shader_set_uniform_vec3(shader, "uCameraPosition", camera_position);
-        Shader_set_uniform_mat4(shader, "uTransform", uTransform);
-        Shader_set_uniform_mat4(shader, "uProjection", uProjection);
-        Shader_set_uniform_mat4(shader, "uView", uView);
+        // The wall only covers its rect of the layer, so it needs proportionally more layer texels.
+        float camera_distance = sqrtf(Vector3_dot(camera_position, camera_position));
+        float screen_size = TextureStreamer_screen_size(0.87f, camera_distance, camera_fov, window_height);
+        TextureCache_request(&textures, wall_texture, screen_size / fmaxf(wall.rect[2], wall.rect[3]));
+        for (int i = 0; scene_ready && i < scene.material_count; i++) {
+            if (scene_materials.material_textures[i] >= 0) TextureCache_request(&textures, scene_materials.material_textures[i], screen_size);
+        }
+        TextureCache_update(&textures);
+        TextureStreamer_update(&streamer);
+
+        Vector3 to_model = { model_center[0] - camera_position[0], model_center[1] - camera_position[1], model_center[2] - camera_position[2] };
+        float model_distance = sqrtf(Vector3_dot(to_model, to_model)) - (use_instances ? instance_grid_radius : model_radius);
+        lod_level = MeshLodChain_select(&lods, model_distance, camera_fov, window_height, MESH_LOD_PIXEL_ERROR);
+        const MeshLod *lod = &lods.levels[lod_level];
+        const void *lod_offset = (const void *)((uintptr_t)(model_geometry.first_index + lod->first_index) * model_pool->index_size);
+        if (use_instances) {
+            // The whole grid is rewritten every frame, as anything animated would be.
+            Instance *mapped = InstanceBuffer_map(&instances, instance_grid_size * instance_grid_size);
+            fill_instance_grid(mapped, instance_grid_size, model_center, instance_spacing, frame_counter / 60.0f);
+            InstanceBuffer_unmap(&instances);
+            glBindVertexArray(instanced_vao);
+            InstanceBuffer_apply(&instances, 0);
+        }
+
+        // Positions reach the vertex shader relative to the camera, as they do here.
+        Matrix4 clip_from_view, clip_from_world;
+        Matrix4_multiply(clip_from_view, uView, uProjection);
+        Matrix4_multiply(clip_from_world, uTransform, clip_from_view);
+        MeshletView meshlet_view;
+        MeshletView_init(&meshlet_view, clip_from_world, camera_position);
+        GeometryBatch_begin(&model_batch, model_pool);
+        if (!use_instances) {
+            Meshlets_cull(&meshlets[lod_level], &meshlet_view, &model_batch, model_geometry.first_index, (GLint)model_geometry.first_vertex, &cull_stats);
+        }
+        glBindVertexArray(use_instances ? instanced_vao : model_pool->vao);
+
+        if (use_virtual_texture) {
+            // A low resolution pass tells the virtual texture which pages are visible; it is read back a few frames later.
+            set_view_uniforms(feedback_shader, camera_position, uTransform, uProjection, uView);
+            if (VirtualTexture_begin_feedback(&virtual_texture, window_width, window_height)) {
+                VirtualTexture_bind(&virtual_texture, feedback_shader, 1);
+                if (scene_ready) draw_scene(&render_queue, &jobs, &draw_data, &scene, feedback_shader.program, scene_transform, camera_position, NULL, NULL);
+                else if (use_instances) glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)lod->index_count, model_pool->index_type, lod_offset,
+                    (GLsizei)instances.count, (GLint)model_geometry.first_vertex);
+                else GeometryBatch_submit(&model_batch, GL_TRIANGLES);
+                VirtualTexture_end_feedback(&virtual_texture, window_width, window_height);
+            }
+            VirtualTexture_update(&virtual_texture);
 
-        glUseProgram(shader.program);
+            set_view_uniforms(virtual_shader, camera_position, uTransform, uProjection, uView);
+            VirtualTexture_bind(&virtual_texture, virtual_shader, 1);
+        } else {
+            set_view_uniforms(shader, camera_position, uTransform, uProjection, uView);
+            Shader_set_uniform_float(shader, "uTextureLayer", (GLfloat)wall.layer);
+            Shader_set_uniform_vec4(shader, "uTextureRect", wall.rect);
 
-        glBindTexture(GL_TEXTURE_2D, texture);
+            glUseProgram(shader.program);
 
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            TextureCache_bind(&textures, wall_texture, 0);
+        }
 
-        glDrawElements(GL_TRIANGLES, sizeof(indices) / sizeof(indices[0]), GL_UNSIGNED_INT, 0);
+        if (scene_ready && use_virtual_texture) draw_scene(&render_queue, &jobs, &draw_data, &scene, virtual_shader.program, scene_transform, camera_position, NULL, NULL);
+        else if (scene_ready) draw_scene(&render_queue, &jobs, &draw_data, &scene, shader.program, scene_transform, camera_position, bind_scene_material, &scene_materials);
+        else if (use_instances) glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)lod->index_count, model_pool->index_type, lod_offset,
+            (GLsizei)instances.count, (GLint)model_geometry.first_vertex);
+        else GeometryBatch_submit(&model_batch, GL_TRIANGLES);
 
         SDL_GL_SwapWindow(window);
+        FrameSync_end_frame(&frames);
 
         if (++frame_counter % 60 == 0) {
             Uint64 current_frame_time = SDL_GetPerformanceCounter();
             float framerate = 60.0f * (float)SDL_GetPerformanceFrequency() / (current_frame_time - last_frame_time);
             last_frame_time = current_frame_time;
             printf("FPS: %.0f\n", framerate);
+            if (use_instances) {
+                printf("INSTANCES: %u copies of LOD %d, %u triangles\n", instances.count, lod_level, instances.count * (lod->index_count / 3));
+                StreamBuffer_print_stats(&stream);
+            } else if (!scene_ready) {
+                printf("LOD: %d of %d, %u triangles\n", lod_level, lods.level_count, lods.levels[lod_level].index_count / 3);
+                printf("MESHLETS: %u of %u drawn in %u ranges, %u triangles\n", cull_stats.meshlets, meshlets[lod_level].meshlet_count,
+                    cull_stats.ranges, cull_stats.triangles);
+            }
+            if (scene_ready) {
+                RenderQueue_print_stats(&render_queue);
+                StreamBuffer_print_stats(&stream);
+            }
+            FrameSync_print_stats(&frames);
+            TextureStreamer_print_stats(&streamer);
+            TextureCache_print_stats(&textures);
+            if (texture_disk_cache_ready) TextureDiskCache_print_stats(&texture_disk_cache);
+            if (mesh_disk_cache_ready) MeshDiskCache_print_stats(&mesh_disk_cache);
+            if (use_virtual_texture) VirtualTexture_print_stats(&virtual_texture);
         }
     }
     
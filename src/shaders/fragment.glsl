@@ -2,12 +2,20 @@
 
 in vec3 normal;
 in vec2 uv_coord;
+in vec4 instance_color;
 
 out vec4 color;
 
-uniform sampler2D wall_texture;
+uniform sampler2DArray uTextures;
+uniform float uTextureLayer;
+uniform vec4 uTextureRect; // offset and scale of this texture inside its layer
+uniform vec4 uBaseColor;
 
 void main() {
-    color = texture(wall_texture, uv_coord / 2.0 + 0.5);
+    // A packed rect shares its layer with other textures, so its UVs are clamped rather than left to
+    // the sampler's wrap mode, which would reach into the neighbours.
+    bool packed = uTextureRect != vec4(0.0, 0.0, 1.0, 1.0);
+    vec2 uv = packed ? clamp(uv_coord, 0.0, 1.0) : uv_coord;
+    color = uBaseColor * instance_color * texture(uTextures, vec3(uTextureRect.xy + uv * uTextureRect.zw, uTextureLayer));
     // color = vec4(normal.x / 2.0 + 0.5, normal.y / 2.0 + 0.5, normal.z / 2.0 + 0.5, 1.0);
 }
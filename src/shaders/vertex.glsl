@@ -3,17 +3,33 @@
 layout (location = 0) in vec3 a_position;
 layout (location = 2) in vec3 a_normal;
 layout (location = 1) in vec2 a_uv_coord;
+// Per instance, see instancing.h; identity and white outside instanced draws.
+layout (location = 4) in vec4 a_instance_row0;
+layout (location = 5) in vec4 a_instance_row1;
+layout (location = 6) in vec4 a_instance_row2;
+layout (location = 7) in vec4 a_instance_color;
 
 out vec2 uv_coord;
 out vec3 normal;
+out vec4 instance_color;
+
+// Per draw, see draw_data.h.
+layout (std140) uniform DrawData {
+    mat4 uModel; // object to world
+};
 
 uniform vec3 uCameraPosition;
+uniform vec3 uPositionOffset; // expands quantized positions
+uniform vec3 uPositionScale;
 uniform mat4 uTransform;
 uniform mat4 uProjection;
 uniform mat4 uView;
 
 void main() {
+    mat4 model = uModel * transpose(mat4(a_instance_row0, a_instance_row1, a_instance_row2, vec4(0.0, 0.0, 0.0, 1.0)));
     uv_coord = a_uv_coord;
-    normal = a_normal;
-    gl_Position = uProjection * uView * uTransform * vec4(a_position - uCameraPosition, 1.0);
+    instance_color = a_instance_color;
+    normal = normalize(transpose(inverse(mat3(model))) * a_normal);
+    vec3 position = (model * vec4(uPositionOffset + uPositionScale * a_position, 1.0)).xyz;
+    gl_Position = uProjection * uView * uTransform * vec4(position - uCameraPosition, 1.0);
 }
@@ -0,0 +1,8 @@
+in vec3 normal;
+in vec2 uv_coord;
+
+out uvec4 feedback;
+
+void main() {
+    feedback = VirtualTexture_feedback(uv_coord);
+}
@@ -0,0 +1,8 @@
+in vec3 normal;
+in vec2 uv_coord;
+
+out vec4 color;
+
+void main() {
+    color = VirtualTexture_sample(uv_coord);
+}
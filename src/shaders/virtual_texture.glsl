@@ -0,0 +1,50 @@
+#version 410 core
+
+// Virtual texture address translation, see virtual_texture.h. Shaders using it are compiled right after this file.
+
+const float VIRTUAL_PAGE_SIZE = 128.0;
+const float VIRTUAL_PAGE_BORDER = 4.0;
+const float VIRTUAL_SLOT_SIZE = 136.0;
+
+uniform sampler2D uVirtualPageTable; // one texel per page and level: cache slot x, slot y, level actually resident
+uniform sampler2D uVirtualPhysical;  // cache slots holding page texels and their borders
+uniform vec2 uVirtualSize;           // level 0 size in texels
+uniform float uVirtualLevelCount;
+uniform float uVirtualFeedbackBias;  // makes up for the smaller feedback target
+
+vec2 VirtualTexture_clamp(vec2 uv) {
+    return clamp(uv, vec2(0.0), vec2(1.0) - 0.5 / uVirtualSize);
+}
+
+// Finest level needed for the texel footprint of this pixel.
+float VirtualTexture_level(vec2 uv, float bias) {
+    vec2 texels = uv * uVirtualSize;
+    vec2 dx = dFdx(texels);
+    vec2 dy = dFdy(texels);
+    float rho = max(dot(dx, dx), dot(dy, dy));
+    return clamp(floor(0.5 * log2(max(rho, 1e-8)) + bias), 0.0, uVirtualLevelCount - 1.0);
+}
+
+ivec2 VirtualTexture_page(vec2 uv, int level) {
+    ivec2 pages = textureSize(uVirtualPageTable, level);
+    return clamp(ivec2(uv * vec2(pages)), ivec2(0), pages - 1);
+}
+
+vec4 VirtualTexture_sample(vec2 uv) {
+    uv = VirtualTexture_clamp(uv);
+    int level = int(VirtualTexture_level(uv, 0.0));
+    vec3 entry = floor(texelFetch(uVirtualPageTable, VirtualTexture_page(uv, level), level).rgb * 255.0 + 0.5);
+
+    // The entry may be a coarser ancestor standing in for a page that is still loading.
+    vec2 page = uv * uVirtualSize / (VIRTUAL_PAGE_SIZE * exp2(entry.b));
+    vec2 within = (page - floor(page)) * VIRTUAL_PAGE_SIZE;
+    vec2 physical = (entry.rg * VIRTUAL_SLOT_SIZE + VIRTUAL_PAGE_BORDER + within) / vec2(textureSize(uVirtualPhysical, 0));
+    return textureLod(uVirtualPhysical, physical, 0.0);
+}
+
+// What the feedback pass writes: the page this pixel wants, its level, and 1 to tell it from the cleared background.
+uvec4 VirtualTexture_feedback(vec2 uv) {
+    uv = VirtualTexture_clamp(uv);
+    int level = int(VirtualTexture_level(uv, uVirtualFeedbackBias));
+    return uvec4(uvec2(VirtualTexture_page(uv, level)), uint(level), 1u);
+}
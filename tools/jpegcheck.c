@@ -0,0 +1,165 @@
+// Decodes JPEGs with every decoder stb_image carries and checks that they agree byte for byte: the
+// generic C kernels (STBI_NO_SIMD), SSE2 alone (STBI_NO_AVX2), and the default build with its AVX2
+// kernels, once on one thread and once split at its restart markers over the job system. The first
+// two are this file built again as objects that only export their decode function, see the Makefile.
+
+#ifdef JPEGCHECK_VARIANT
+
+#pragma GCC diagnostic ignored "-Wunused-function"
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+unsigned char *JPEGCHECK_VARIANT(const unsigned char *data, int size, int *width, int *height) {
+    int channels;
+    return stbi_load_from_memory(data, size, width, height, &channels, 4);
+}
+
+#else
+
+#include "jobs.h"
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+// Both allocate with stb_image's default STBI_MALLOC, so their pixels go back with free.
+unsigned char *jpegcheck_decode_generic(const unsigned char *data, int size, int *width, int *height);
+unsigned char *jpegcheck_decode_sse2(const unsigned char *data, int size, int *width, int *height);
+
+static int parallel_scans;
+
+// Counts the scans that really were split before handing them to the job system.
+void run_tasks(void *jobs, int count, JobRangeFunction function, void *data) {
+    parallel_scans++;
+    JobSystem_run_tasks(jobs, count, function, data);
+}
+
+void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-j threads] inputs.jpg...\n", program);
+}
+
+unsigned char *read_file(const char *path, int *size) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Could not open file %s\n", path);
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    unsigned char *data = malloc(length > 0 ? length : 1);
+    if (!data) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    if (length <= 0 || fread(data, 1, length, fp) != (size_t)length) {
+        fprintf(stderr, "Could not read file %s\n", path);
+        free(data);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+    *size = (int)length;
+    return data;
+}
+
+// Returns 0 and says why if pixels is missing or differs from the reference decode.
+int matches(const char *path, const char *decoder, const unsigned char *reference, int width, int height, const unsigned char *pixels,
+    int pixels_width, int pixels_height) {
+    if (!pixels) {
+        fprintf(stderr, "%s: the %s decoder failed: %s\n", path, decoder, stbi_failure_reason());
+        return 0;
+    }
+    if (pixels_width != width || pixels_height != height) {
+        fprintf(stderr, "%s: the %s decoder gave %dx%d instead of %dx%d\n", path, decoder, pixels_width, pixels_height, width, height);
+        return 0;
+    }
+    for (size_t i = 0; i < (size_t)width * height * 4; i++) {
+        if (pixels[i] != reference[i]) {
+            fprintf(stderr, "%s: the %s decoder differs from the generic one first at pixel (%d, %d)\n", path, decoder, (int)(i / 4 % width),
+                (int)(i / 4 / width));
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    int thread_count = -1;
+    const char **inputs = calloc(argc, sizeof(const char *));
+    int input_count = 0;
+    if (!inputs) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            thread_count = atoi(argv[++i]);
+        } else {
+            inputs[input_count++] = argv[i];
+        }
+    }
+    if (input_count == 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    JobSystem jobs;
+    JobSystem_init(&jobs, thread_count);
+#ifdef STBI_AVX2
+    const char *kernels = stbi__avx2_available() ? "AVX2" : "SSE2, no AVX2 on this CPU";
+#elif defined(STBI_SSE2)
+    const char *kernels = "SSE2";
+#else
+    const char *kernels = "generic";
+#endif
+    printf("Default decoder kernels: %s, %d threads\n", kernels, jobs.thread_count + 1);
+
+    int success = 1;
+    for (int i = 0; i < input_count; i++) {
+        int size;
+        unsigned char *data = read_file(inputs[i], &size);
+        if (!data) {
+            success = 0;
+            continue;
+        }
+        int width, height, channels, w, h;
+        unsigned char *reference = jpegcheck_decode_generic(data, size, &width, &height);
+        if (!reference) {
+            fprintf(stderr, "%s: the generic decoder failed\n", inputs[i]);
+            free(data);
+            success = 0;
+            continue;
+        }
+
+        unsigned char *pixels = jpegcheck_decode_sse2(data, size, &w, &h);
+        int same = matches(inputs[i], "SSE2", reference, width, height, pixels, w, h);
+        free(pixels);
+
+        stbi_set_parallel_for(NULL, NULL);
+        pixels = stbi_load_from_memory(data, size, &w, &h, &channels, 4);
+        same = matches(inputs[i], "default", reference, width, height, pixels, w, h) && same;
+        stbi_image_free(pixels);
+
+        stbi_set_parallel_for(run_tasks, &jobs);
+        int scans = parallel_scans;
+        pixels = stbi_load_from_memory(data, size, &w, &h, &channels, 4);
+        same = matches(inputs[i], "parallel", reference, width, height, pixels, w, h) && same;
+        stbi_image_free(pixels);
+
+        printf("%s: %dx%d, %s, %s\n", inputs[i], width, height, parallel_scans > scans ? "decoded in parallel" : "not split",
+            same ? "identical" : "MISMATCH");
+        success = success && same;
+        free(reference);
+        free(data);
+    }
+    JobSystem_destroy(&jobs);
+    free(inputs);
+    return success ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,141 @@
+#include "jobs.h"
+#include "mesh.h"
+#include "mesh_codec.h"
+#include "mesh_normals.h"
+#include "mesh_optimize.h"
+#include "mesh_simplify.h"
+#include "meshlet.h"
+#include "obj.h"
+#include "vertex_format.h"
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-cache entries] [-j threads] inputs.obj...\n", program);
+    fprintf(stderr, "Reports post-transform cache efficiency (ACMR, ATVR) of every input before and after optimization,\n");
+    fprintf(stderr, "the LOD chain and level 0 meshlets generated from it, and how small its buffers compress.\n");
+}
+
+void print_stats(const char *label, MeshCacheStats stats) {
+    printf("  %-10s ACMR %.3f  ATVR %.3f  %u vertex shader invocations\n", label, stats.acmr, stats.atvr, stats.transformed);
+}
+
+int main(int argc, char **argv) {
+    unsigned int cache_size = MESH_CACHE_SIZE;
+    int thread_count = -1;
+    const char **inputs = calloc(argc, sizeof(const char *));
+    int input_count = 0;
+    if (!inputs) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-cache") == 0 && i + 1 < argc) {
+            cache_size = (unsigned int)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            thread_count = atoi(argv[++i]);
+        } else {
+            inputs[input_count++] = argv[i];
+        }
+    }
+    if (input_count == 0 || cache_size < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    JobSystem jobs;
+    JobSystem_init(&jobs, thread_count);
+
+    int success = 1;
+    for (int i = 0; i < input_count; i++) {
+        Mesh mesh;
+        if (!Obj_load(&mesh, inputs[i], &jobs)) {
+            success = 0;
+            continue;
+        }
+        printf("%s: %u vertices, %u triangles, %u entry cache\n", inputs[i], mesh.vertex_count, mesh.index_count / 3, cache_size);
+        print_stats("loaded", Mesh_cache_stats(mesh.indices, mesh.index_count, mesh.vertex_count, cache_size));
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        Mesh_compute_tangents(&mesh, &jobs);
+        Uint64 end = SDL_GetPerformanceCounter();
+        printf("  tangents computed in %.1f ms on %d threads\n", (double)(end - start) * 1000.0 / SDL_GetPerformanceFrequency(), jobs.thread_count + 1);
+
+        start = SDL_GetPerformanceCounter();
+        Mesh_optimize(&mesh, cache_size);
+        end = SDL_GetPerformanceCounter();
+        print_stats("optimized", Mesh_cache_stats(mesh.indices, mesh.index_count, mesh.vertex_count, cache_size));
+        printf("  optimized in %.1f ms\n", (double)(end - start) * 1000.0 / SDL_GetPerformanceFrequency());
+
+        start = SDL_GetPerformanceCounter();
+        MeshLodChain lods;
+        MeshLodChain_build(&lods, &mesh, &jobs, cache_size);
+        end = SDL_GetPerformanceCounter();
+        for (int level = 0; level < lods.level_count; level++) {
+            const MeshLod *lod = &lods.levels[level];
+            MeshCacheStats stats = Mesh_cache_stats(lods.indices + lod->first_index, lod->index_count, mesh.vertex_count, cache_size);
+            printf("  LOD %d     %u triangles, error %.5f, ACMR %.3f\n", level, lod->index_count / 3, lod->error, stats.acmr);
+        }
+        printf("  LOD chain built in %.1f ms\n", (double)(end - start) * 1000.0 / SDL_GetPerformanceFrequency());
+
+        start = SDL_GetPerformanceCounter();
+        Meshlets meshlets;
+        Meshlets_build(&meshlets, lods.indices, lods.levels[0].index_count, 0, mesh.vertices, mesh.vertex_count);
+        end = SDL_GetPerformanceCounter();
+        unsigned int meshlet_vertices = 0, cones = 0;
+        for (unsigned int m = 0; m < meshlets.meshlet_count; m++) {
+            meshlet_vertices += meshlets.meshlets[m].vertex_count;
+            cones += meshlets.meshlets[m].cone_cutoff < 1.0f;
+        }
+        if (meshlets.meshlet_count > 0) {
+            printf("  meshlets  %u, %.1f vertices and %.1f triangles each, %u with a normal cone, built in %.1f ms\n", meshlets.meshlet_count,
+                (float)meshlet_vertices / meshlets.meshlet_count, (float)lods.levels[0].index_count / 3 / meshlets.meshlet_count, cones,
+                (double)(end - start) * 1000.0 / SDL_GetPerformanceFrequency());
+        }
+        Meshlets_free(&meshlets);
+
+        // Codec sizes and decode speed for the optimized index buffer and the quantized vertices.
+        QuantizedVertices quantized;
+        VertexFormat_quantize(&quantized, &mesh);
+        unsigned int vertex_bytes = quantized.vertex_count * quantized.format.stride;
+        unsigned int index_bytes = mesh.index_count * Mesh_index_size(Mesh_index_type(mesh.vertex_count));
+        unsigned char *encoded_indices = malloc(MeshCodec_indices_bound(mesh.index_count));
+        unsigned char *encoded_vertices = malloc(MeshCodec_vertices_bound(quantized.vertex_count, quantized.format.stride));
+        void *decoded = malloc((size_t)(vertex_bytes > index_bytes ? vertex_bytes : index_bytes) + 1);
+        if (!encoded_indices || !encoded_vertices || !decoded) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return 1;
+        }
+        memset(decoded, 0, (size_t)(vertex_bytes > index_bytes ? vertex_bytes : index_bytes)); // fault the pages in before timing
+        unsigned int encoded_index_bytes = MeshCodec_encode_indices(encoded_indices, mesh.indices, mesh.index_count);
+        unsigned int encoded_vertex_bytes = MeshCodec_encode_vertices(encoded_vertices, quantized.vertices, quantized.vertex_count, quantized.format.stride);
+        start = SDL_GetPerformanceCounter();
+        int decoded_indices = MeshCodec_decode_indices(decoded, Mesh_index_size(Mesh_index_type(mesh.vertex_count)), mesh.index_count, mesh.vertex_count,
+            encoded_indices, encoded_index_bytes);
+        Uint64 middle = SDL_GetPerformanceCounter();
+        int decoded_vertices = MeshCodec_decode_vertices(decoded, quantized.vertex_count, quantized.format.stride, encoded_vertices, encoded_vertex_bytes);
+        end = SDL_GetPerformanceCounter();
+        double frequency = (double)SDL_GetPerformanceFrequency();
+        if (!decoded_indices || !decoded_vertices || memcmp(decoded, quantized.vertices, vertex_bytes) != 0) {
+            fprintf(stderr, "%s: codec round trip failed\n", inputs[i]);
+            success = 0;
+        }
+        printf("  indices   %u bytes encoded to %u (%.2f bytes per triangle), decoded at %.2f GB/s\n", index_bytes, encoded_index_bytes,
+            mesh.index_count >= 3 ? (float)encoded_index_bytes / (mesh.index_count / 3) : 0.0f, index_bytes / ((middle - start) / frequency) / 1e9);
+        printf("  vertices  %u bytes encoded to %u (%.0f%%), decoded at %.2f GB/s\n", vertex_bytes, encoded_vertex_bytes,
+            vertex_bytes > 0 ? 100.0f * encoded_vertex_bytes / vertex_bytes : 0.0f, vertex_bytes / ((end - middle) / frequency) / 1e9);
+        free(encoded_indices);
+        free(encoded_vertices);
+        free(decoded);
+        QuantizedVertices_free(&quantized);
+        MeshLodChain_free(&lods);
+        Mesh_free(&mesh);
+    }
+
+    free(inputs);
+    JobSystem_destroy(&jobs);
+    return success ? 0 : 1;
+}
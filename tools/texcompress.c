@@ -0,0 +1,116 @@
+#include "bc.h"
+#include "jobs.h"
+#include "mipmap.h"
+#include "texture.h"
+#include "texture_args.h"
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-f bc1|bc3|bc4|bc5|bc7] [-q fast|normal|high] [-mips none|box|kaiser|lanczos] [-gamma] [-normal] [-srgb] [-j threads] input output.(dds|ktx2)\n", program);
+}
+
+int parse_filter(const char *name, MipFilter *filter, int *mips) {
+    *mips = 1;
+    if (strcmp(name, "none") == 0) *mips = 0;
+    else if (strcmp(name, "box") == 0) *filter = MIP_FILTER_BOX;
+    else if (strcmp(name, "kaiser") == 0) *filter = MIP_FILTER_KAISER;
+    else if (strcmp(name, "lanczos") == 0) *filter = MIP_FILTER_LANCZOS;
+    else return 0;
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    TextureFormat format = TEXTURE_FORMAT_BC1;
+    BCQuality quality = BC_QUALITY_NORMAL;
+    int srgb = 0;
+    int mips = 1;
+    MipSettings mip_settings = { MIP_FILTER_KAISER, 0, 0 };
+    int thread_count = -1;
+    const char *input = NULL;
+    const char *output = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            if (!parse_format(argv[++i], &format)) {
+                fprintf(stderr, "Unknown format: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            if (!parse_quality(argv[++i], &quality)) {
+                fprintf(stderr, "Unknown quality: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-mips") == 0 && i + 1 < argc) {
+            if (!parse_filter(argv[++i], &mip_settings.filter, &mips)) {
+                fprintf(stderr, "Unknown mip filter: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-gamma") == 0) {
+            mip_settings.gamma_correct = 1;
+        } else if (strcmp(argv[i], "-normal") == 0) {
+            mip_settings.normal_map = 1;
+        } else if (strcmp(argv[i], "-srgb") == 0) {
+            srgb = 1;
+            mip_settings.gamma_correct = 1;
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            thread_count = atoi(argv[++i]);
+        } else if (!input) {
+            input = argv[i];
+        } else if (!output) {
+            output = argv[i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!input || !output) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    JobSystem jobs;
+    JobSystem_init(&jobs, thread_count);
+    stbi_set_parallel_for(JobSystem_run_tasks, &jobs);
+
+    int width, height, channels;
+    unsigned char *rgba = stbi_load(input, &width, &height, &channels, 4);
+    if (!rgba) {
+        fprintf(stderr, "Could not load image %s: %s\n", input, stbi_failure_reason());
+        return 1;
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    TextureImage chain;
+    if (mips) {
+        Mipmap_build_chain(&chain, rgba, width, height, srgb, &mip_settings, &jobs);
+    } else {
+        TextureImage_allocate(&chain, TEXTURE_FORMAT_RGBA8, srgb, width, height, 1);
+        memcpy(chain.data, rgba, chain.data_size);
+    }
+
+    TextureImage image;
+    TextureImage_allocate(&image, format, srgb, width, height, chain.level_count);
+    for (unsigned int i = 0; i < image.level_count; i++) {
+        const TextureLevel *level = &chain.levels[i];
+        BC_compress(image.data + image.levels[i].offset, chain.data + level->offset, level->width, level->height, format, quality, &jobs);
+    }
+    Uint64 end = SDL_GetPerformanceCounter();
+
+    int success = TextureImage_write(&image, output);
+    if (success) {
+        double seconds = (double)(end - start) / SDL_GetPerformanceFrequency();
+        printf("%s: %dx%d %s, %u levels, %zu bytes in %.1f ms on %d threads\n", output, width, height, TextureFormat_name(format), image.level_count, image.data_size, seconds * 1000.0, jobs.thread_count + 1);
+    }
+
+    TextureImage_free(&image);
+    TextureImage_free(&chain);
+    JobSystem_destroy(&jobs);
+    stbi_image_free(rgba);
+    return success ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+#include "bc.h"
+#include "jobs.h"
+#include "mipmap.h"
+#include "texture.h"
+#include "texture_args.h"
+#include "texture_pack.h"
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+typedef struct {
+    const char *path;
+    unsigned char *rgba;
+    TexturePackRect rect;
+} PackInput;
+
+void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-f bc1|bc3|bc4|bc5|bc7] [-q fast|normal|high] [-mips box|kaiser|lanczos] [-size layer_size] [-padding texels] [-levels count] [-gamma] [-srgb] [-j threads] -o output inputs...\n", program);
+    fprintf(stderr, "Writes output.ktx2 and the output.pack table naming every input by its file name without extension.\n");
+}
+
+int parse_filter(const char *name, MipFilter *filter) {
+    if (strcmp(name, "box") == 0) *filter = MIP_FILTER_BOX;
+    else if (strcmp(name, "kaiser") == 0) *filter = MIP_FILTER_KAISER;
+    else if (strcmp(name, "lanczos") == 0) *filter = MIP_FILTER_LANCZOS;
+    else return 0;
+    return 1;
+}
+
+// File name without directory or extension.
+void entry_name(char *name, size_t size, const char *path) {
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    snprintf(name, size, "%s", base);
+    char *dot = strrchr(name, '.');
+    if (dot && dot != name) *dot = '\0';
+}
+
+int compare_inputs(const void *a, const void *b) {
+    const PackInput *x = a;
+    const PackInput *y = b;
+    if (x->rect.height != y->rect.height) return x->rect.height < y->rect.height ? 1 : -1;
+    if (x->rect.width != y->rect.width) return x->rect.width < y->rect.width ? 1 : -1;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    TextureFormat format = TEXTURE_FORMAT_BC1;
+    BCQuality quality = BC_QUALITY_NORMAL;
+    int srgb = 0;
+    MipSettings mip_settings = { MIP_FILTER_KAISER, 0, 0 };
+    unsigned int layer_size = 0;
+    unsigned int padding = 8;
+    unsigned int max_levels = TEXTURE_MAX_LEVELS;
+    int thread_count = -1;
+    const char *output = NULL;
+
+    PackInput *inputs = calloc(argc, sizeof(PackInput));
+    int input_count = 0;
+    if (!inputs) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            if (!parse_format(argv[++i], &format)) {
+                fprintf(stderr, "Unknown format: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            if (!parse_quality(argv[++i], &quality)) {
+                fprintf(stderr, "Unknown quality: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-mips") == 0 && i + 1 < argc) {
+            if (!parse_filter(argv[++i], &mip_settings.filter)) {
+                fprintf(stderr, "Unknown mip filter: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-size") == 0 && i + 1 < argc) {
+            layer_size = (unsigned int)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-padding") == 0 && i + 1 < argc) {
+            padding = (unsigned int)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-levels") == 0 && i + 1 < argc) {
+            max_levels = (unsigned int)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-gamma") == 0) {
+            mip_settings.gamma_correct = 1;
+        } else if (strcmp(argv[i], "-srgb") == 0) {
+            srgb = 1;
+            mip_settings.gamma_correct = 1;
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            thread_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            inputs[input_count++].path = argv[i];
+        }
+    }
+    if (!output || input_count == 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    JobSystem jobs;
+    JobSystem_init(&jobs, thread_count);
+    stbi_set_parallel_for(JobSystem_run_tasks, &jobs);
+
+    unsigned int largest = 0;
+    for (int i = 0; i < input_count; i++) {
+        int width, height, channels;
+        inputs[i].rgba = stbi_load(inputs[i].path, &width, &height, &channels, 4);
+        if (!inputs[i].rgba) {
+            fprintf(stderr, "Could not load image %s: %s\n", inputs[i].path, stbi_failure_reason());
+            return 1;
+        }
+        inputs[i].rect.width = width;
+        inputs[i].rect.height = height;
+        if ((unsigned int)width > largest) largest = width;
+        if ((unsigned int)height > largest) largest = height;
+    }
+    // Square layers sized to the largest input, which then fills a layer alone; anything smaller shares
+    // an atlas layer, so the default also leaves room for their padding.
+    TexturePacker packer;
+    TexturePacker_init(&packer, largest, padding);
+    if (layer_size == 0) {
+        layer_size = largest;
+        for (int i = 0; i < input_count; i++) {
+            const TexturePackRect *rect = &inputs[i].rect;
+            if (rect->width == largest && rect->height == largest) continue;
+            unsigned int size = rect->width > rect->height ? rect->width : rect->height;
+            if (TexturePacker_footprint(&packer, size) > layer_size) layer_size = TexturePacker_footprint(&packer, size);
+        }
+    }
+    TexturePacker_init(&packer, layer_size, padding);
+    qsort(inputs, input_count, sizeof(PackInput), compare_inputs);
+    for (int i = 0; i < input_count; i++) {
+        if (!TexturePacker_place(&packer, &inputs[i].rect)) {
+            fprintf(stderr, "%s (%ux%u) does not fit a %ux%u layer\n", inputs[i].path, inputs[i].rect.width, inputs[i].rect.height, layer_size, layer_size);
+            return 1;
+        }
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    unsigned int level_count = Mipmap_level_count(layer_size, layer_size);
+    if (level_count > max_levels && max_levels > 0) level_count = max_levels;
+
+    TextureImage image;
+    TextureImage_allocate_array(&image, format, srgb, layer_size, layer_size, level_count, packer.layer_count);
+
+    size_t layer_bytes = (size_t)layer_size * layer_size * 4;
+    unsigned char *layer = malloc(layer_bytes);
+    if (!layer) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+    for (unsigned int l = 0; l < packer.layer_count; l++) {
+        memset(layer, 0, layer_bytes);
+        for (int i = 0; i < input_count; i++) {
+            if (inputs[i].rect.layer == l) TexturePacker_blit(&packer, layer, inputs[i].rgba, &inputs[i].rect);
+        }
+
+        TextureImage chain;
+        Mipmap_build_chain(&chain, layer, layer_size, layer_size, srgb, &mip_settings, &jobs);
+        for (unsigned int i = 0; i < level_count; i++) {
+            const TextureLevel *level = &chain.levels[i];
+            BC_compress(image.data + TextureImage_layer_offset(&image, i, l), chain.data + level->offset, level->width, level->height, format, quality, &jobs);
+        }
+        TextureImage_free(&chain);
+    }
+    Uint64 end = SDL_GetPerformanceCounter();
+
+    char texture_path[TEXTURE_PACK_PATH_LENGTH];
+    char table_path[TEXTURE_PACK_PATH_LENGTH];
+    snprintf(texture_path, sizeof(texture_path), "%s.ktx2", output);
+    snprintf(table_path, sizeof(table_path), "%s.pack", output);
+
+    TexturePack pack;
+    snprintf(pack.texture_path, sizeof(pack.texture_path), "%s", texture_path);
+    pack.layer_count = packer.layer_count;
+    pack.entry_count = input_count;
+    pack.entries = malloc(input_count * sizeof(TexturePackEntry));
+    if (!pack.entries) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+    for (int i = 0; i < input_count; i++) {
+        char name[TEXTURE_PACK_NAME_LENGTH];
+        entry_name(name, sizeof(name), inputs[i].path);
+        TexturePacker_entry(&packer, &pack.entries[i], name, &inputs[i].rect);
+    }
+
+    int success = TextureImage_write(&image, texture_path) && TexturePack_write(&pack, table_path);
+    if (success) {
+        double seconds = (double)(end - start) / SDL_GetPerformanceFrequency();
+        printf("%s: %d textures in %u %ux%u %s layers, %u levels, %zu bytes in %.1f ms on %d threads\n", texture_path, input_count, packer.layer_count, layer_size, layer_size, TextureFormat_name(format), level_count, image.data_size, seconds * 1000.0, jobs.thread_count + 1);
+    }
+
+    TexturePack_free(&pack);
+    TextureImage_free(&image);
+    TexturePacker_destroy(&packer);
+    free(layer);
+    for (int i = 0; i < input_count; i++) stbi_image_free(inputs[i].rgba);
+    free(inputs);
+    JobSystem_destroy(&jobs);
+    return success ? 0 : 1;
+}
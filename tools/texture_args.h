@@ -0,0 +1,29 @@
+#ifndef TEXTURE_ARGS_H
+#define TEXTURE_ARGS_H
+
+#include "bc.h"
+#include "texture.h"
+#include <string.h>
+
+// Command line values shared by the texture tools.
+
+int parse_format(const char *name, TextureFormat *format) {
+    static const TextureFormat formats[] = { TEXTURE_FORMAT_BC1, TEXTURE_FORMAT_BC3, TEXTURE_FORMAT_BC4, TEXTURE_FORMAT_BC5, TEXTURE_FORMAT_BC7 };
+    for (unsigned int i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        if (strcmp(name, TextureFormat_name(formats[i])) == 0) {
+            *format = formats[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int parse_quality(const char *name, BCQuality *quality) {
+    if (strcmp(name, "fast") == 0) *quality = BC_QUALITY_FAST;
+    else if (strcmp(name, "normal") == 0) *quality = BC_QUALITY_NORMAL;
+    else if (strcmp(name, "high") == 0) *quality = BC_QUALITY_HIGH;
+    else return 0;
+    return 1;
+}
+
+#endif